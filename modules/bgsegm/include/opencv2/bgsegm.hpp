@@ -87,6 +87,18 @@ CV_EXPORTS_W Ptr<BackgroundSubtractorMOG>
     createBackgroundSubtractorMOG(int history=200, int nmixtures=5,
                                   double backgroundRatio=0.7, double noiseSigma=0);
 
+/** @brief Updates several mixture-of-gaussian background models in one call.
+
+Frame i is passed to subtractors[i], which computes its foreground mask in fgmasks[i] exactly as
+subtractors[i]->apply(images[i], fgmasks[i], learningRate) would. All the frames must have the same
+size, and each subtractor may appear only once in the batch. The rows of all the frames are
+processed by a single parallel loop, which amortizes the threading overhead when many streams are
+processed at once.
+ */
+CV_EXPORTS void applyMOGBatch(const std::vector<Ptr<BackgroundSubtractorMOG> >& subtractors,
+                              const std::vector<Mat>& images, std::vector<Mat>& fgmasks,
+                              double learningRate=-1);
+
 
 /** @brief Background Subtractor module based on the algorithm given in @cite Gold2012 .
 
@@ -198,6 +210,20 @@ public:
 CV_EXPORTS_W Ptr<BackgroundSubtractorGMG> createBackgroundSubtractorGMG(int initializationFrames=120,
                                                                         double decisionThreshold=0.8);
 
+/** @brief Computes the foreground masks of consecutive frames with one GMG model.
+
+Gives the same masks as calling subtractor->apply() on each frame in turn, but processes all the frames
+within a single parallel loop, which speeds up the processing of recorded video.
+
+@param subtractor A subtractor created by createBackgroundSubtractorGMG().
+@param images Consecutive video frames, all of the same size and type. See apply() for the supported types.
+@param fgmasks The output foreground masks, one per frame.
+@param learningRate See apply().
+ */
+CV_EXPORTS void applyGMGBatch(const Ptr<BackgroundSubtractorGMG>& subtractor,
+                              const std::vector<Mat>& images, std::vector<Mat>& fgmasks,
+                              double learningRate=-1);
+
 /** @brief Background subtraction based on counting.
 
   About as fast as MOG2 on a high end system.
@@ -255,6 +281,20 @@ createBackgroundSubtractorCNT(int minPixelStability = 15,
                               int maxPixelStability = 15*60,
                               bool isParallel = true);
 
+/** @brief Computes the foreground masks of consecutive frames with one CNT model.
+
+Gives the same masks as calling subtractor->apply() on each frame in turn, but processes all the frames
+within a single parallel loop, which speeds up the processing of recorded video.
+
+@param subtractor A subtractor created by createBackgroundSubtractorCNT().
+@param images Consecutive 8-bit video frames, all of the same size.
+@param fgmasks The output foreground masks, one per frame.
+@param learningRate See apply().
+ */
+CV_EXPORTS void applyCNTBatch(const Ptr<BackgroundSubtractorCNT>& subtractor,
+                              const std::vector<Mat>& images, std::vector<Mat>& fgmasks,
+                              double learningRate=-1);
+
 enum LSBPCameraMotionCompensation {
     LSBP_CAMERA_MOTION_COMPENSATION_NONE = 0,
     LSBP_CAMERA_MOTION_COMPENSATION_LK
@@ -271,6 +311,13 @@ public:
     CV_WRAP virtual void apply(InputArray image, OutputArray fgmask, double learningRate=-1) CV_OVERRIDE = 0;
 
     CV_WRAP virtual void getBackgroundImage(OutputArray backgroundImage) const CV_OVERRIDE = 0;
+
+    /** @brief Returns the size of the background model in bytes, 0 before the first frame.
+
+    The model takes 24*nSamples bytes per pixel. The copy used by camera motion compensation is
+    included once it has been allocated. The base class returns 0.
+     */
+    CV_WRAP virtual size_t getModelMemorySize() const;
 };
 
 /** @brief Background Subtraction using Local SVD Binary Pattern. More details about the algorithm can be found at @cite LGuo2016
@@ -282,6 +329,13 @@ public:
     CV_WRAP virtual void apply(InputArray image, OutputArray fgmask, double learningRate=-1) CV_OVERRIDE = 0;
 
     CV_WRAP virtual void getBackgroundImage(OutputArray backgroundImage) const CV_OVERRIDE = 0;
+
+    /** @brief Returns the size of the background model in bytes, 0 before the first frame.
+
+    The model takes 20*nSamples bytes per pixel. The copy used by camera motion compensation is
+    included once it has been allocated. The base class returns 0.
+     */
+    CV_WRAP virtual size_t getModelMemorySize() const;
 };
 
 /** @brief This is for calculation of the LSBP descriptors.
@@ -300,6 +354,8 @@ public:
 
 Implementation of the different yet better algorithm which is called GSOC, as it was implemented during GSOC and was not originated from any paper.
 
+The background model takes 24*nSamples bytes per pixel, twice as much when camera motion compensation is enabled.
+
 @param mc Whether to use camera motion compensation.
 @param nSamples Number of samples to maintain at each point of the frame.
 @param replaceRate Probability of replacing the old sample - how fast the model will update itself.
@@ -318,6 +374,8 @@ CV_EXPORTS_W Ptr<BackgroundSubtractorGSOC> createBackgroundSubtractorGSOC(int mc
 
 Background Subtraction using Local SVD Binary Pattern. More details about the algorithm can be found at @cite LGuo2016
 
+The background model takes 20*nSamples bytes per pixel, twice as much when camera motion compensation is enabled.
+
 @param mc Whether to use camera motion compensation.
 @param nSamples Number of samples to maintain at each point of the frame.
 @param LSBPRadius LSBP descriptor radius.
@@ -42,6 +42,7 @@
 
 #include "precomp.hpp"
 #include <float.h>
+#include "opencv2/core/hal/intrin.hpp"
 
 // to make sure we can use these short names
 #undef K
@@ -69,6 +70,22 @@ static const double defaultVarThreshold = 2.5*2.5;
 static const double defaultNoiseSigma = 30*0.5;
 static const double defaultInitialWeight = 0.05;
 
+struct MOGParams
+{
+    int nmixtures;
+    float alpha, T, vT, minVar;
+    float w0, sk0, var0;
+};
+
+//! a frame ready to be processed together with the model it updates
+struct MOGFrame
+{
+    Mat image;
+    Mat fgmask;
+    Mat bgmodel;
+    MOGParams params;
+};
+
 class BackgroundSubtractorMOGImpl CV_FINAL : public BackgroundSubtractorMOG
 {
 public:
@@ -104,6 +121,9 @@ public:
     //! the update operator
     virtual void apply(InputArray image, OutputArray fgmask, double learningRate=0) CV_OVERRIDE;
 
+    //! (re)initializes the model if needed and sets up the processing of the next frame
+    void prepare(InputArray image, OutputArray fgmask, double learningRate, MOGFrame& frame);
+
     //! re-initiaization method
     virtual void initialize(Size _frameSize, int _frameType)
     {
@@ -117,8 +137,10 @@ public:
         // for each gaussian mixture of each pixel bg model we store ...
         // the mixture sort key (w/sum_of_variances), the mixture weight (w),
         // the mean (nchannels values) and
-        // the diagonal covariance matrix (another nchannels values)
-        bgmodel.create( 1, frameSize.height*frameSize.width*nmixtures*(2 + 2*nchannels), CV_32F );
+        // the diagonal covariance matrix (another nchannels values).
+        // Each row of bgmodel keeps these values for one image row as
+        // separate planes, see MOGModelRow below.
+        bgmodel.create( frameSize.height, frameSize.width*nmixtures*(2 + 2*nchannels), CV_32F );
         bgmodel = Scalar::all(0);
     }
 
@@ -171,294 +193,463 @@ protected:
 };
 
 
-template<typename VT> struct MixData
+// For every image row the model keeps nmixtures*(2 + 2*nchannels) planes of
+// frame width floats. Mixture component k owns planes k*(2 + 2*nchannels) ...
+// (k+1)*(2 + 2*nchannels) - 1, which hold its sort key, its weight, the means
+// and the variances of all the channels. Neighbouring pixels are therefore
+// adjacent in every plane and are updated together with vector operations,
+// while the pixels of different rows never interact.
+template<int cn> struct MOGModelRow
 {
-    float sortKey;
-    float weight;
-    VT mean;
-    VT var;
-};
+    MOGModelRow(float* _m, int cols) : m(_m), step(cols), kstep((size_t)(2 + 2*cn)*cols) {}
 
+    float* sortKey(int k) const { return m + k*kstep; }
+    float* weight(int k) const { return m + k*kstep + step; }
+    float* mean(int k, int c) const { return m + k*kstep + (2 + c)*step; }
+    float* var(int k, int c) const { return m + k*kstep + (2 + cn + c)*step; }
 
-static void process8uC1( const Mat& image, Mat& fgmask, double learningRate,
-                         Mat& bgmodel, int nmixtures, double backgroundRatio,
-                         double varThreshold, double noiseSigma )
+    float* m;
+    size_t step, kstep;
+};
+
+template<int cn> static uchar updatePixel( const uchar* src, const MOGModelRow<cn>& mrow,
+                                           int x, const MOGParams& p )
 {
-    int x, y, k, k1, rows = image.rows, cols = image.cols;
-    float alpha = (float)learningRate, T = (float)backgroundRatio, vT = (float)varThreshold;
-    int K = nmixtures;
-    MixData<float>* mptr = (MixData<float>*)bgmodel.data;
+    int k, k1, K = p.nmixtures;
+    float wsum = 0, pix[cn];
+    int kHit = -1, kForeground = -1;
 
-    const float w0 = (float)defaultInitialWeight;
-    const float sk0 = (float)(w0/(defaultNoiseSigma*2));
-    const float var0 = (float)(defaultNoiseSigma*defaultNoiseSigma*4);
-    const float minVar = (float)(noiseSigma*noiseSigma);
+    for( int c = 0; c < cn; c++ )
+        pix[c] = src[c];
 
-    for( y = 0; y < rows; y++ )
+    for( k = 0; k < K; k++ )
     {
-        const uchar* src = image.ptr<uchar>(y);
-        uchar* dst = fgmask.ptr<uchar>(y);
-
-        if( alpha > 0 )
+        float w = mrow.weight(k)[x];
+        wsum += w;
+        if( w < FLT_EPSILON )
+            break;
+        float diff[cn], d2 = 0, vsum = 0;
+        for( int c = 0; c < cn; c++ )
         {
-            for( x = 0; x < cols; x++, mptr += K )
+            diff[c] = pix[c] - mrow.mean(k, c)[x];
+            d2 += diff[c]*diff[c];
+            vsum += mrow.var(k, c)[x];
+        }
+        if( d2 < p.vT*vsum )
+        {
+            wsum -= w;
+            float dw = p.alpha*(1.f - w);
+            mrow.weight(k)[x] = w + dw;
+            vsum = 0;
+            for( int c = 0; c < cn; c++ )
+            {
+                float mu = mrow.mean(k, c)[x], var = mrow.var(k, c)[x];
+                mrow.mean(k, c)[x] = mu + p.alpha*diff[c];
+                var = std::max(var + p.alpha*(diff[c]*diff[c] - var), p.minVar);
+                mrow.var(k, c)[x] = var;
+                vsum += var;
+            }
+            mrow.sortKey(k)[x] = w/std::sqrt(vsum);
+
+            for( k1 = k-1; k1 >= 0; k1-- )
             {
-                float wsum = 0;
-                float pix = src[x];
-                int kHit = -1, kForeground = -1;
-
-                for( k = 0; k < K; k++ )
-                {
-                    float w = mptr[k].weight;
-                    wsum += w;
-                    if( w < FLT_EPSILON )
-                        break;
-                    float mu = mptr[k].mean;
-                    float var = mptr[k].var;
-                    float diff = pix - mu;
-                    float d2 = diff*diff;
-                    if( d2 < vT*var )
-                    {
-                        wsum -= w;
-                        float dw = alpha*(1.f - w);
-                        mptr[k].weight = w + dw;
-                        mptr[k].mean = mu + alpha*diff;
-                        var = std::max(var + alpha*(d2 - var), minVar);
-                        mptr[k].var = var;
-                        mptr[k].sortKey = w/std::sqrt(var);
-
-                        for( k1 = k-1; k1 >= 0; k1-- )
-                        {
-                            if( mptr[k1].sortKey >= mptr[k1+1].sortKey )
-                                break;
-                            std::swap( mptr[k1], mptr[k1+1] );
-                        }
-
-                        kHit = k1+1;
-                        break;
-                    }
-                }
-
-                if( kHit < 0 ) // no appropriate gaussian mixture found at all, remove the weakest mixture and create a new one
-                {
-                    kHit = k = std::min(k, K-1);
-                    wsum += w0 - mptr[k].weight;
-                    mptr[k].weight = w0;
-                    mptr[k].mean = pix;
-                    mptr[k].var = var0;
-                    mptr[k].sortKey = sk0;
-                }
-                else
-                    for( ; k < K; k++ )
-                        wsum += mptr[k].weight;
-
-                float wscale = 1.f/wsum;
-                wsum = 0;
-                for( k = 0; k < K; k++ )
-                {
-                    wsum += mptr[k].weight *= wscale;
-                    mptr[k].sortKey *= wscale;
-                    if( wsum > T && kForeground < 0 )
-                        kForeground = k+1;
-                }
-
-                dst[x] = (uchar)(-(kHit >= kForeground));
+                float* m0 = mrow.sortKey(k1) + x;
+                float* m1 = m0 + mrow.kstep;
+                if( m0[0] >= m1[0] )
+                    break;
+                for( int i = 0; i < 2 + 2*cn; i++ )
+                    std::swap( m0[i*mrow.step], m1[i*mrow.step] );
             }
+
+            kHit = k1+1;
+            break;
         }
-        else
+    }
+
+    if( kHit < 0 ) // no appropriate gaussian mixture found at all, remove the weakest mixture and create a new one
+    {
+        kHit = k = std::min(k, K-1);
+        wsum += p.w0 - mrow.weight(k)[x];
+        mrow.weight(k)[x] = p.w0;
+        for( int c = 0; c < cn; c++ )
         {
-            for( x = 0; x < cols; x++, mptr += K )
+            mrow.mean(k, c)[x] = pix[c];
+            mrow.var(k, c)[x] = p.var0;
+        }
+        mrow.sortKey(k)[x] = p.sk0;
+    }
+    else
+        for( ; k < K; k++ )
+            wsum += mrow.weight(k)[x];
+
+    float wscale = 1.f/wsum;
+    wsum = 0;
+    for( k = 0; k < K; k++ )
+    {
+        wsum += mrow.weight(k)[x] *= wscale;
+        mrow.sortKey(k)[x] *= wscale;
+        if( wsum > p.T && kForeground < 0 )
+            kForeground = k+1;
+    }
+
+    return (uchar)(-(kHit >= kForeground));
+}
+
+template<int cn> static uchar classifyPixel( const uchar* src, const MOGModelRow<cn>& mrow,
+                                             int x, const MOGParams& p )
+{
+    int k, K = p.nmixtures;
+    int kHit = -1, kForeground = -1;
+
+    for( k = 0; k < K; k++ )
+    {
+        if( mrow.weight(k)[x] < FLT_EPSILON )
+            break;
+        float d2 = 0, vsum = 0;
+        for( int c = 0; c < cn; c++ )
+        {
+            float diff = src[c] - mrow.mean(k, c)[x];
+            d2 += diff*diff;
+            vsum += mrow.var(k, c)[x];
+        }
+        if( d2 < p.vT*vsum )
+        {
+            kHit = k;
+            break;
+        }
+    }
+
+    if( kHit >= 0 )
+    {
+        float wsum = 0;
+        for( k = 0; k < K; k++ )
+        {
+            wsum += mrow.weight(k)[x];
+            if( wsum > p.T )
             {
-                float pix = src[x];
-                int kHit = -1, kForeground = -1;
-
-                for( k = 0; k < K; k++ )
-                {
-                    if( mptr[k].weight < FLT_EPSILON )
-                        break;
-                    float mu = mptr[k].mean;
-                    float var = mptr[k].var;
-                    float diff = pix - mu;
-                    float d2 = diff*diff;
-                    if( d2 < vT*var )
-                    {
-                        kHit = k;
-                        break;
-                    }
-                }
-
-                if( kHit >= 0 )
-                {
-                    float wsum = 0;
-                    for( k = 0; k < K; k++ )
-                    {
-                        wsum += mptr[k].weight;
-                        if( wsum > T )
-                        {
-                            kForeground = k+1;
-                            break;
-                        }
-                    }
-                }
-
-                dst[x] = (uchar)(kHit < 0 || kHit >= kForeground ? 255 : 0);
+                kForeground = k+1;
+                break;
             }
         }
     }
-}
 
+    return (uchar)(kHit < 0 || kHit >= kForeground ? 255 : 0);
+}
 
-static void process8uC3( const Mat& image, Mat& fgmask, double learningRate,
-                         Mat& bgmodel, int nmixtures, double backgroundRatio,
-                         double varThreshold, double noiseSigma )
+#if CV_SIMD128
+template<int cn> static inline void loadPixels4( const uchar* src, v_float32x4* pix )
 {
-    int x, y, k, k1, rows = image.rows, cols = image.cols;
-    float alpha = (float)learningRate, T = (float)backgroundRatio, vT = (float)varThreshold;
-    int K = nmixtures;
+    float buf[cn][4];
+    for( int i = 0; i < 4; i++ )
+        for( int c = 0; c < cn; c++ )
+            buf[c][i] = src[i*cn + c];
+    for( int c = 0; c < cn; c++ )
+        pix[c] = v_load(buf[c]);
+}
 
-    const float w0 = (float)defaultInitialWeight;
-    const float sk0 = (float)(w0/(defaultNoiseSigma*2*std::sqrt(3.)));
-    const float var0 = (float)(defaultNoiseSigma*defaultNoiseSigma*4);
-    const float minVar = (float)(noiseSigma*noiseSigma);
-    MixData<Vec3f>* mptr = (MixData<Vec3f>*)bgmodel.data;
+static inline void storeMask4( uchar* dst, const v_int32x4& mask )
+{
+    int buf[4];
+    v_store(buf, mask);
+    for( int i = 0; i < 4; i++ )
+        dst[i] = (uchar)buf[i];
+}
 
-    for( y = 0; y < rows; y++ )
+// The same update as updatePixel() for 4 neighbouring pixels at once. Every lane
+// follows its own path through the mixture (the scalar loop breaks become lane
+// masks), and the floating-point operations of each lane are done in the scalar
+// order, so the results are identical. The few divisions and square roots stay
+// scalar since their vector versions are not exact on every platform.
+template<int cn> static void updatePixels4( const uchar* src, const MOGModelRow<cn>& mrow,
+                                            int x, const MOGParams& p, uchar* dst )
+{
+    const int K = p.nmixtures;
+    const v_float32x4 v_eps = v_setall_f32(FLT_EPSILON), v_one = v_setall_f32(1.f);
+    const v_float32x4 v_alpha = v_setall_f32(p.alpha), v_vT = v_setall_f32(p.vT);
+    const v_float32x4 v_minVar = v_setall_f32(p.minVar), v_T = v_setall_f32(p.T);
+    v_float32x4 pix[cn];
+    loadPixels4<cn>(src, pix);
+
+    v_float32x4 wsum = v_setzero_f32(), hitMask = v_setzero_f32();
+    v_float32x4 active = v_reinterpret_as_f32(v_setall_s32(-1));
+    v_int32x4 kHit = v_setall_s32(-1), kEnd = v_setall_s32(K);
+
+    for( int k = 0; k < K; k++ )
     {
-        const uchar* src = image.ptr<uchar>(y);
-        uchar* dst = fgmask.ptr<uchar>(y);
+        v_float32x4 w = v_load(mrow.weight(k) + x);
+        wsum = v_select(active, v_add(wsum, w), wsum);
+        v_float32x4 empty = v_and(active, v_lt(w, v_eps));
+        kEnd = v_select(v_reinterpret_as_s32(empty), v_setall_s32(k), kEnd);
+        active = v_and(active, v_not(empty));
+        if( !v_check_any(active) )
+            break;
+
+        v_float32x4 diff[cn], d2 = v_setzero_f32(), vsum = v_setzero_f32();
+        for( int c = 0; c < cn; c++ )
+        {
+            diff[c] = v_sub(pix[c], v_load(mrow.mean(k, c) + x));
+            d2 = v_add(d2, v_mul(diff[c], diff[c]));
+            vsum = v_add(vsum, v_load(mrow.var(k, c) + x));
+        }
+        v_float32x4 hit = v_and(active, v_lt(d2, v_mul(v_vT, vsum)));
+        if( !v_check_any(hit) )
+            continue;
+
+        wsum = v_select(hit, v_sub(wsum, w), wsum);
+        v_store(mrow.weight(k) + x, v_select(hit, v_add(w, v_mul(v_alpha, v_sub(v_one, w))), w));
+        vsum = v_setzero_f32();
+        for( int c = 0; c < cn; c++ )
+        {
+            v_float32x4 mu = v_load(mrow.mean(k, c) + x), var = v_load(mrow.var(k, c) + x);
+            v_store(mrow.mean(k, c) + x, v_select(hit, v_add(mu, v_mul(v_alpha, diff[c])), mu));
+            var = v_select(hit, v_max(v_add(var, v_mul(v_alpha, v_sub(v_mul(diff[c], diff[c]), var))), v_minVar), var);
+            v_store(mrow.var(k, c) + x, var);
+            vsum = v_add(vsum, var);
+        }
 
-        if( alpha > 0 )
+        float wbuf[4], vbuf[4], skbuf[4];
+        int hbuf[4];
+        v_store(wbuf, w);
+        v_store(vbuf, vsum);
+        v_store(skbuf, v_load(mrow.sortKey(k) + x));
+        v_store(hbuf, v_reinterpret_as_s32(hit));
+        for( int i = 0; i < 4; i++ )
+            if( hbuf[i] )
+                skbuf[i] = wbuf[i]/std::sqrt(vbuf[i]);
+        v_store(mrow.sortKey(k) + x, v_load(skbuf));
+
+        // move the updated components up while their sort keys are larger
+        v_float32x4 moving = hit;
+        v_int32x4 pos = v_setall_s32(k);
+        for( int k1 = k-1; k1 >= 0; k1-- )
         {
-            for( x = 0; x < cols; x++, mptr += K )
+            float* m0 = mrow.sortKey(k1) + x;
+            float* m1 = m0 + mrow.kstep;
+            moving = v_and(moving, v_not(v_ge(v_load(m0), v_load(m1))));
+            if( !v_check_any(moving) )
+                break;
+            for( int i = 0; i < 2 + 2*cn; i++ )
             {
-                float wsum = 0;
-                Vec3f pix(src[x*3], src[x*3+1], src[x*3+2]);
-                int kHit = -1, kForeground = -1;
-
-                for( k = 0; k < K; k++ )
-                {
-                    float w = mptr[k].weight;
-                    wsum += w;
-                    if( w < FLT_EPSILON )
-                        break;
-                    Vec3f mu = mptr[k].mean;
-                    Vec3f var = mptr[k].var;
-                    Vec3f diff = pix - mu;
-                    float d2 = diff.dot(diff);
-                    if( d2 < vT*(var[0] + var[1] + var[2]) )
-                    {
-                        wsum -= w;
-                        float dw = alpha*(1.f - w);
-                        mptr[k].weight = w + dw;
-                        mptr[k].mean = mu + alpha*diff;
-                        var = Vec3f(std::max(var[0] + alpha*(diff[0]*diff[0] - var[0]), minVar),
-                                    std::max(var[1] + alpha*(diff[1]*diff[1] - var[1]), minVar),
-                                    std::max(var[2] + alpha*(diff[2]*diff[2] - var[2]), minVar));
-                        mptr[k].var = var;
-                        mptr[k].sortKey = w/std::sqrt(var[0] + var[1] + var[2]);
-
-                        for( k1 = k-1; k1 >= 0; k1-- )
-                        {
-                            if( mptr[k1].sortKey >= mptr[k1+1].sortKey )
-                                break;
-                            std::swap( mptr[k1], mptr[k1+1] );
-                        }
-
-                        kHit = k1+1;
-                        break;
-                    }
-                }
-
-                if( kHit < 0 ) // no appropriate gaussian mixture found at all, remove the weakest mixture and create a new one
-                {
-                    kHit = k = std::min(k, K-1);
-                    wsum += w0 - mptr[k].weight;
-                    mptr[k].weight = w0;
-                    mptr[k].mean = pix;
-                    mptr[k].var = Vec3f(var0, var0, var0);
-                    mptr[k].sortKey = sk0;
-                }
-                else
-                    for( ; k < K; k++ )
-                        wsum += mptr[k].weight;
-
-                float wscale = 1.f/wsum;
-                wsum = 0;
-                for( k = 0; k < K; k++ )
-                {
-                    wsum += mptr[k].weight *= wscale;
-                    mptr[k].sortKey *= wscale;
-                    if( wsum > T && kForeground < 0 )
-                        kForeground = k+1;
-                }
-
-                dst[x] = (uchar)(-(kHit >= kForeground));
+                v_float32x4 a = v_load(m0 + i*mrow.step), b = v_load(m1 + i*mrow.step);
+                v_store(m0 + i*mrow.step, v_select(moving, b, a));
+                v_store(m1 + i*mrow.step, v_select(moving, a, b));
             }
+            pos = v_select(v_reinterpret_as_s32(moving), v_setall_s32(k1), pos);
         }
-        else
+
+        kHit = v_select(v_reinterpret_as_s32(hit), pos, kHit);
+        kEnd = v_select(v_reinterpret_as_s32(hit), v_setall_s32(k), kEnd);
+        hitMask = v_or(hitMask, hit);
+        active = v_and(active, v_not(hit));
+        if( !v_check_any(active) )
+            break;
+    }
+
+    // lanes without a match replace component min(kEnd, K-1), the others add
+    // the weights from their hit position on, as the scalar tail loop does
+    const v_float32x4 v_w0 = v_setall_f32(p.w0), v_var0 = v_setall_f32(p.var0), v_sk0 = v_setall_f32(p.sk0);
+    v_int32x4 kNew = v_min(kEnd, v_setall_s32(K-1));
+    kHit = v_select(v_reinterpret_as_s32(hitMask), kHit, kNew);
+    for( int k = 0; k < K; k++ )
+    {
+        v_int32x4 v_k = v_setall_s32(k);
+        v_float32x4 w = v_load(mrow.weight(k) + x);
+        v_float32x4 tail = v_and(hitMask, v_reinterpret_as_f32(v_le(kEnd, v_k)));
+        v_float32x4 replace = v_and(v_not(hitMask), v_reinterpret_as_f32(v_eq(kNew, v_k)));
+        wsum = v_select(tail, v_add(wsum, w), wsum);
+        if( !v_check_any(replace) )
+            continue;
+        wsum = v_select(replace, v_add(wsum, v_sub(v_w0, w)), wsum);
+        v_store(mrow.weight(k) + x, v_select(replace, v_w0, w));
+        for( int c = 0; c < cn; c++ )
         {
-            for( x = 0; x < cols; x++, mptr += K )
-            {
-                Vec3f pix(src[x*3], src[x*3+1], src[x*3+2]);
-                int kHit = -1, kForeground = -1;
-
-                for( k = 0; k < K; k++ )
-                {
-                    if( mptr[k].weight < FLT_EPSILON )
-                        break;
-                    Vec3f mu = mptr[k].mean;
-                    Vec3f var = mptr[k].var;
-                    Vec3f diff = pix - mu;
-                    float d2 = diff.dot(diff);
-                    if( d2 < vT*(var[0] + var[1] + var[2]) )
-                    {
-                        kHit = k;
-                        break;
-                    }
-                }
-
-                if( kHit >= 0 )
-                {
-                    float wsum = 0;
-                    for( k = 0; k < K; k++ )
-                    {
-                        wsum += mptr[k].weight;
-                        if( wsum > T )
-                        {
-                            kForeground = k+1;
-                            break;
-                        }
-                    }
-                }
-
-                dst[x] = (uchar)(kHit < 0 || kHit >= kForeground ? 255 : 0);
-            }
+            v_store(mrow.mean(k, c) + x, v_select(replace, pix[c], v_load(mrow.mean(k, c) + x)));
+            v_store(mrow.var(k, c) + x, v_select(replace, v_var0, v_load(mrow.var(k, c) + x)));
+        }
+        v_store(mrow.sortKey(k) + x, v_select(replace, v_sk0, v_load(mrow.sortKey(k) + x)));
+    }
+
+    float sbuf[4];
+    v_store(sbuf, wsum);
+    for( int i = 0; i < 4; i++ )
+        sbuf[i] = 1.f/sbuf[i];
+    v_float32x4 wscale = v_load(sbuf);
+
+    wsum = v_setzero_f32();
+    v_int32x4 kForeground = v_setall_s32(-1);
+    for( int k = 0; k < K; k++ )
+    {
+        v_float32x4 w = v_mul(v_load(mrow.weight(k) + x), wscale);
+        v_store(mrow.weight(k) + x, w);
+        v_store(mrow.sortKey(k) + x, v_mul(v_load(mrow.sortKey(k) + x), wscale));
+        wsum = v_add(wsum, w);
+        v_int32x4 fg = v_and(v_reinterpret_as_s32(v_gt(wsum, v_T)), v_lt(kForeground, v_setzero_s32()));
+        kForeground = v_select(fg, v_setall_s32(k+1), kForeground);
+    }
+
+    storeMask4(dst, v_ge(kHit, kForeground));
+}
+
+template<int cn> static void classifyPixels4( const uchar* src, const MOGModelRow<cn>& mrow,
+                                              int x, const MOGParams& p, uchar* dst )
+{
+    const int K = p.nmixtures;
+    const v_float32x4 v_eps = v_setall_f32(FLT_EPSILON), v_vT = v_setall_f32(p.vT), v_T = v_setall_f32(p.T);
+    v_float32x4 pix[cn];
+    loadPixels4<cn>(src, pix);
+
+    v_float32x4 active = v_reinterpret_as_f32(v_setall_s32(-1));
+    v_int32x4 kHit = v_setall_s32(-1);
+    for( int k = 0; k < K; k++ )
+    {
+        active = v_and(active, v_not(v_lt(v_load(mrow.weight(k) + x), v_eps)));
+        if( !v_check_any(active) )
+            break;
+        v_float32x4 d2 = v_setzero_f32(), vsum = v_setzero_f32();
+        for( int c = 0; c < cn; c++ )
+        {
+            v_float32x4 diff = v_sub(pix[c], v_load(mrow.mean(k, c) + x));
+            d2 = v_add(d2, v_mul(diff, diff));
+            vsum = v_add(vsum, v_load(mrow.var(k, c) + x));
         }
+        v_float32x4 hit = v_and(active, v_lt(d2, v_mul(v_vT, vsum)));
+        kHit = v_select(v_reinterpret_as_s32(hit), v_setall_s32(k), kHit);
+        active = v_and(active, v_not(hit));
+        if( !v_check_any(active) )
+            break;
+    }
+
+    v_float32x4 wsum = v_setzero_f32(), found = v_setzero_f32();
+    v_int32x4 kForeground = v_setall_s32(-1);
+    for( int k = 0; k < K; k++ )
+    {
+        wsum = v_add(wsum, v_load(mrow.weight(k) + x));
+        v_float32x4 fg = v_and(v_not(found), v_gt(wsum, v_T));
+        kForeground = v_select(v_reinterpret_as_s32(fg), v_setall_s32(k+1), kForeground);
+        found = v_or(found, fg);
+        if( v_check_all(found) )
+            break;
+    }
+
+    storeMask4(dst, v_or(v_lt(kHit, v_setzero_s32()), v_ge(kHit, kForeground)));
+}
+#endif
+
+template<int cn> static void processRow( MOGFrame& f, int y )
+{
+    const uchar* src = f.image.ptr<uchar>(y);
+    uchar* dst = f.fgmask.ptr<uchar>(y);
+    int x = 0, cols = f.image.cols;
+    MOGModelRow<cn> mrow(f.bgmodel.ptr<float>(y), cols);
+
+    if( f.params.alpha > 0 )
+    {
+#if CV_SIMD128
+        for( ; x <= cols - 4; x += 4 )
+            updatePixels4<cn>(src + x*cn, mrow, x, f.params, dst + x);
+#endif
+        for( ; x < cols; x++ )
+            dst[x] = updatePixel<cn>(src + x*cn, mrow, x, f.params);
+    }
+    else
+    {
+#if CV_SIMD128
+        for( ; x <= cols - 4; x += 4 )
+            classifyPixels4<cn>(src + x*cn, mrow, x, f.params, dst + x);
+#endif
+        for( ; x < cols; x++ )
+            dst[x] = classifyPixel<cn>(src + x*cn, mrow, x, f.params);
     }
 }
 
-void BackgroundSubtractorMOGImpl::apply(InputArray _image, OutputArray _fgmask, double learningRate)
+// Processes the rows of one or several same-sized frames; row r of the range
+// is row r % rows of frame r / rows.
+class MOGInvoker CV_FINAL : public ParallelLoopBody
+{
+public:
+    MOGInvoker(MOGFrame* _frames, int _rows) : frames(_frames), rows(_rows) {}
+
+    void operator()(const Range& range) const CV_OVERRIDE
+    {
+        for( int r = range.start; r < range.end; r++ )
+        {
+            MOGFrame& f = frames[r / rows];
+            if( f.image.channels() == 1 )
+                processRow<1>(f, r % rows);
+            else
+                processRow<3>(f, r % rows);
+        }
+    }
+
+private:
+    MOGFrame* frames;
+    int rows;
+};
+
+void BackgroundSubtractorMOGImpl::prepare(InputArray _image, OutputArray _fgmask, double learningRate, MOGFrame& frame)
 {
     Mat image = _image.getMat();
-    bool needToInitialize = nframes == 0 || learningRate >= 1 || image.size() != frameSize || image.type() != frameType;
+    bool needToInitialize = nframes == 0 || learningRate >= 1 || image.size() != frameSize || image.type() != frameType ||
+                            bgmodel.cols != image.cols*nmixtures*(2 + 2*image.channels());
 
     if( needToInitialize )
         initialize(image.size(), image.type());
 
     CV_Assert( image.depth() == CV_8U );
+    if( image.type() != CV_8UC1 && image.type() != CV_8UC3 )
+        CV_Error( Error::StsUnsupportedFormat, "Only 1- and 3-channel 8-bit images are supported in BackgroundSubtractorMOG" );
     _fgmask.create( image.size(), CV_8U );
-    Mat fgmask = _fgmask.getMat();
 
     ++nframes;
     learningRate = learningRate >= 0 && nframes > 1 ? learningRate : 1./std::min( nframes, history );
     CV_Assert(learningRate >= 0);
 
-    if( image.type() == CV_8UC1 )
-        process8uC1( image, fgmask, learningRate, bgmodel, nmixtures, backgroundRatio, varThreshold, noiseSigma );
-    else if( image.type() == CV_8UC3 )
-        process8uC3( image, fgmask, learningRate, bgmodel, nmixtures, backgroundRatio, varThreshold, noiseSigma );
-    else
-        CV_Error( Error::StsUnsupportedFormat, "Only 1- and 3-channel 8-bit images are supported in BackgroundSubtractorMOG" );
+    frame.image = image;
+    frame.fgmask = _fgmask.getMat();
+    frame.bgmodel = bgmodel;
+
+    MOGParams& p = frame.params;
+    p.nmixtures = nmixtures;
+    p.alpha = (float)learningRate;
+    p.T = (float)backgroundRatio;
+    p.vT = (float)varThreshold;
+    p.minVar = (float)(noiseSigma*noiseSigma);
+    p.w0 = (float)defaultInitialWeight;
+    p.sk0 = (float)(p.w0/(defaultNoiseSigma*2*std::sqrt((double)image.channels())));
+    p.var0 = (float)(defaultNoiseSigma*defaultNoiseSigma*4);
+}
+
+void BackgroundSubtractorMOGImpl::apply(InputArray image, OutputArray fgmask, double learningRate)
+{
+    MOGFrame frame;
+    prepare(image, fgmask, learningRate, frame);
+    parallel_for_(Range(0, frame.image.rows), MOGInvoker(&frame, frame.image.rows),
+                  frame.image.total()/(double)(1<<16));
+}
+
+void applyMOGBatch(const std::vector<Ptr<BackgroundSubtractorMOG> >& subtractors,
+                   const std::vector<Mat>& images, std::vector<Mat>& fgmasks, double learningRate)
+{
+    CV_Assert( subtractors.size() == images.size() );
+    size_t i, j, n = images.size();
+    fgmasks.resize(n);
+    if( n == 0 )
+        return;
+
+    std::vector<MOGFrame> frames(n);
+    for( i = 0; i < n; i++ )
+    {
+        BackgroundSubtractorMOGImpl* impl = dynamic_cast<BackgroundSubtractorMOGImpl*>(subtractors[i].get());
+        CV_Assert( impl != NULL );
+        CV_Assert( images[i].size() == images[0].size() );
+        for( j = 0; j < i; j++ )
+            CV_Assert( subtractors[j] != subtractors[i] );
+        impl->prepare(images[i], fgmasks[i], learningRate, frames[i]);
+    }
+
+    int rows = images[0].rows;
+    parallel_for_(Range(0, (int)n*rows), MOGInvoker(&frames[0], rows),
+                  (double)n*images[0].total()/(1<<16));
 }
 
 Ptr<BackgroundSubtractorMOG> createBackgroundSubtractorMOG(int history, int nmixtures,
@@ -50,6 +50,7 @@
 
 #include "precomp.hpp"
 #include "opencv2/core/utility.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <limits>
 
 namespace cv
@@ -98,6 +99,14 @@ public:
      */
     virtual void apply(InputArray image, OutputArray fgmask, double learningRate=-1.0) CV_OVERRIDE;
 
+    /**
+     * Performs background subtraction on consecutive frames of the same size and type
+     * within a single parallel loop.
+     * @param images  Input images
+     * @param fgmasks Output mask images, one per input image
+     */
+    void applyBatch(const std::vector<Mat>& images, std::vector<Mat>& fgmasks, double learningRate);
+
     /**
      * Releases all inner buffers.
      */
@@ -196,6 +205,9 @@ private:
     Mat_<int> nfeatures_;
     Mat_<int> colors_;
     Mat_<float> weights_;
+
+    void prepare(const Mat& frame, double newLearningRate);
+    void process(const std::vector<Mat>& frames, std::vector<Mat>& fgmasks);
 };
 
 
@@ -221,16 +233,45 @@ void BackgroundSubtractorGMGImpl::initialize(Size frameSize, double minVal, doub
     nfeatures_.setTo(Scalar::all(0));
 }
 
-static float findFeature(int color, const int* colors, const float* weights, int nfeatures)
+static int findFeatureIndex(int color, const int* colors, int nfeatures)
 {
-    for (int i = 0; i < nfeatures; ++i)
+    int i = 0;
+#if CV_SIMD128
+    // skip the groups of 4 features that do not contain the color
+    const v_int32x4 v_color = v_setall_s32(color);
+    for (; i <= nfeatures - 4; i += 4)
+    {
+        if (v_check_any(v_eq(v_load(colors + i), v_color)))
+            break;
+    }
+#endif
+    for (; i < nfeatures; ++i)
     {
         if (color == colors[i])
-            return weights[i];
+            return i;
     }
 
+    return -1;
+}
+
+static float findFeature(int color, const int* colors, const float* weights, int nfeatures)
+{
+    int idx = findFeatureIndex(color, colors, nfeatures);
+
     // not in histogram, so return 0.
-    return 0.0f;
+    return idx >= 0 ? weights[idx] : 0.0f;
+}
+
+static void scaleHistogram(float* weights, int nfeatures, float scale)
+{
+    int i = 0;
+#if CV_SIMD128
+    const v_float32x4 v_scale = v_setall_f32(scale);
+    for (; i <= nfeatures - 4; i += 4)
+        v_store(weights + i, v_mul(v_load(weights + i), v_scale));
+#endif
+    for (; i < nfeatures; ++i)
+        weights[i] *= scale;
 }
 
 static void normalizeHistogram(float* weights, int nfeatures)
@@ -248,16 +289,11 @@ static void normalizeHistogram(float* weights, int nfeatures)
 
 static bool insertFeature(int color, float weight, int* colors, float* weights, int& nfeatures, int maxFeatures)
 {
-    int idx = -1;
-    for (int i = 0; i < nfeatures; ++i)
+    int idx = findFeatureIndex(color, colors, nfeatures);
+    if (idx >= 0)
     {
-        if (color == colors[i])
-        {
-            // feature in histogram
-            weight += weights[i];
-            idx = i;
-            break;
-        }
+        // feature in histogram
+        weight += weights[idx];
     }
 
     if (idx >= 0)
@@ -308,13 +344,15 @@ template <typename T> struct Quantization
     }
 };
 
+// Processes consecutive frames; every pixel only depends on its own histogram,
+// so each row goes through all the frames at once.
 class GMG_LoopBody : public ParallelLoopBody
 {
 public:
-    GMG_LoopBody(const Mat& frame, const Mat& fgmask, const Mat_<int>& nfeatures, const Mat_<int>& colors, const Mat_<float>& weights,
+    GMG_LoopBody(const std::vector<Mat>& frames, const std::vector<Mat>& fgmasks, const Mat_<int>& nfeatures, const Mat_<int>& colors, const Mat_<float>& weights,
                  int maxFeatures, double learningRate, int numInitializationFrames, int quantizationLevels, double backgroundPrior, double decisionThreshold,
                  double maxVal, double minVal, int frameNum, bool updateBackgroundModel) :
-        frame_(frame), fgmask_(fgmask), nfeatures_(nfeatures), colors_(colors), weights_(weights),
+        frames_(frames), fgmasks_(fgmasks.begin(), fgmasks.end()), nfeatures_(nfeatures), colors_(colors), weights_(weights),
         maxFeatures_(maxFeatures), learningRate_(learningRate), numInitializationFrames_(numInitializationFrames), quantizationLevels_(quantizationLevels),
         backgroundPrior_(backgroundPrior), decisionThreshold_(decisionThreshold), updateBackgroundModel_(updateBackgroundModel),
         maxVal_(maxVal), minVal_(minVal), frameNum_(frameNum)
@@ -324,9 +362,11 @@ public:
     void operator() (const Range& range) const CV_OVERRIDE;
 
 private:
-    Mat frame_;
+    void processRow(const Mat& frame, Mat_<uchar>& fgmask, int y, int frameNum) const;
+
+    std::vector<Mat> frames_;
 
-    mutable Mat_<uchar> fgmask_;
+    mutable std::vector<Mat_<uchar> > fgmasks_;
 
     mutable Mat_<int> nfeatures_;
     mutable Mat_<int> colors_;
@@ -346,6 +386,17 @@ private:
 };
 
 void GMG_LoopBody::operator() (const Range& range) const
+{
+    for (int y = range.start; y < range.end; ++y)
+    {
+        for (size_t t = 0; t < frames_.size(); ++t)
+        {
+            processRow(frames_[t], fgmasks_[t], y, frameNum_ + (int)t);
+        }
+    }
+}
+
+void GMG_LoopBody::processRow(const Mat& frame, Mat_<uchar>& fgmask, int y, int frameNum) const
 {
     typedef int (*func_t)(const void* src_, int x, int cn, double minVal, double maxVal, int quantizationLevels);
     static const func_t funcs[] =
@@ -359,73 +410,67 @@ void GMG_LoopBody::operator() (const Range& range) const
         Quantization<double>::apply
     };
 
-    const func_t func = funcs[frame_.depth()];
+    const func_t func = funcs[frame.depth()];
     CV_Assert(func != 0);
 
-    const int cn = frame_.channels();
+    const int cn = frame.channels();
 
-    for (int y = range.start, featureIdx = y * frame_.cols; y < range.end; ++y)
-    {
-        const uchar* frame_row = frame_.ptr(y);
-        int* nfeatures_row = nfeatures_[y];
-        uchar* fgmask_row = fgmask_[y];
-
-        for (int x = 0; x < frame_.cols; ++x, ++featureIdx)
-        {
-            int nfeatures = nfeatures_row[x];
-            int* colors = colors_[featureIdx];
-            float* weights = weights_[featureIdx];
+    const uchar* frame_row = frame.ptr(y);
+    int* nfeatures_row = nfeatures_[y];
+    uchar* fgmask_row = fgmask[y];
 
-            int newFeatureColor = func(frame_row, x, cn, minVal_, maxVal_, quantizationLevels_);
+    for (int x = 0, featureIdx = y * frame.cols; x < frame.cols; ++x, ++featureIdx)
+    {
+        int nfeatures = nfeatures_row[x];
+        int* colors = colors_[featureIdx];
+        float* weights = weights_[featureIdx];
 
-            bool isForeground = false;
+        int newFeatureColor = func(frame_row, x, cn, minVal_, maxVal_, quantizationLevels_);
 
-            if (frameNum_ >= numInitializationFrames_)
-            {
-                // typical operation
+        bool isForeground = false;
 
-                const double weight = findFeature(newFeatureColor, colors, weights, nfeatures);
+        if (frameNum >= numInitializationFrames_)
+        {
+            // typical operation
 
-                // see Godbehere, Matsukawa, Goldberg (2012) for reasoning behind this implementation of Bayes rule
-                const double posterior = (weight * backgroundPrior_) / (weight * backgroundPrior_ + (1.0 - weight) * (1.0 - backgroundPrior_));
+            const double weight = findFeature(newFeatureColor, colors, weights, nfeatures);
 
-                isForeground = ((1.0 - posterior) > decisionThreshold_);
+            // see Godbehere, Matsukawa, Goldberg (2012) for reasoning behind this implementation of Bayes rule
+            const double posterior = (weight * backgroundPrior_) / (weight * backgroundPrior_ + (1.0 - weight) * (1.0 - backgroundPrior_));
 
-                // update histogram.
+            isForeground = ((1.0 - posterior) > decisionThreshold_);
 
-                if (updateBackgroundModel_)
-                {
-                    for (int i = 0; i < nfeatures; ++i)
-                        weights[i] *= (float)(1.0f - learningRate_);
+            // update histogram.
 
-                    bool inserted = insertFeature(newFeatureColor, (float)learningRate_, colors, weights, nfeatures, maxFeatures_);
-
-                    if (inserted)
-                    {
-                        normalizeHistogram(weights, nfeatures);
-                        nfeatures_row[x] = nfeatures;
-                    }
-                }
-            }
-            else if (updateBackgroundModel_)
+            if (updateBackgroundModel_)
             {
-                // training-mode update
+                scaleHistogram(weights, nfeatures, (float)(1.0f - learningRate_));
 
-                insertFeature(newFeatureColor, 1.0f, colors, weights, nfeatures, maxFeatures_);
+                bool inserted = insertFeature(newFeatureColor, (float)learningRate_, colors, weights, nfeatures, maxFeatures_);
 
-                if (frameNum_ == numInitializationFrames_ - 1)
+                if (inserted)
+                {
                     normalizeHistogram(weights, nfeatures);
+                    nfeatures_row[x] = nfeatures;
+                }
             }
+        }
+        else if (updateBackgroundModel_)
+        {
+            // training-mode update
+
+            insertFeature(newFeatureColor, 1.0f, colors, weights, nfeatures, maxFeatures_);
 
-            fgmask_row[x] = (uchar)(-(schar)isForeground);
+            if (frameNum == numInitializationFrames_ - 1)
+                normalizeHistogram(weights, nfeatures);
         }
+
+        fgmask_row[x] = (uchar)(-(schar)isForeground);
     }
 }
 
-void BackgroundSubtractorGMGImpl::apply(InputArray _frame, OutputArray _fgmask, double newLearningRate)
+void BackgroundSubtractorGMGImpl::prepare(const Mat& frame, double newLearningRate)
 {
-    Mat frame = _frame.getMat();
-
     const int depth = frame.depth();
     CV_CheckDepth(depth, (depth == CV_8U)  || (depth == CV_8S)  ||
                          (depth == CV_16U) || (depth == CV_16S) ||
@@ -455,22 +500,54 @@ void BackgroundSubtractorGMGImpl::apply(InputArray _frame, OutputArray _fgmask,
         }
         initialize(frame.size(), minval, maxval);
     }
+}
 
-    _fgmask.create(frameSize_, CV_8UC1);
-    Mat fgmask = _fgmask.getMat();
-
-    GMG_LoopBody body(frame, fgmask, nfeatures_, colors_, weights_,
+void BackgroundSubtractorGMGImpl::process(const std::vector<Mat>& frames, std::vector<Mat>& fgmasks)
+{
+    const Mat& frame = frames[0];
+    GMG_LoopBody body(frames, fgmasks, nfeatures_, colors_, weights_,
                       maxFeatures, learningRate, numInitializationFrames, quantizationLevels, backgroundPrior, decisionThreshold,
                       maxVal_, minVal_, frameNum_, updateBackgroundModel);
-    parallel_for_(Range(0, frame.rows), body, frame.total()/(double)(1<<16));
+    parallel_for_(Range(0, frame.rows), body, frames.size()*frame.total()/(double)(1<<16));
 
-    if (smoothingRadius > 0)
+    for (size_t t = 0; t < fgmasks.size(); ++t)
     {
-        medianBlur(fgmask, fgmask, smoothingRadius);
+        if (smoothingRadius > 0)
+        {
+            medianBlur(fgmasks[t], fgmasks[t], smoothingRadius);
+        }
+
+        // keep track of how many frames we have processed
+        ++frameNum_;
     }
+}
+
+void BackgroundSubtractorGMGImpl::apply(InputArray _frame, OutputArray _fgmask, double newLearningRate)
+{
+    Mat frame = _frame.getMat();
+    prepare(frame, newLearningRate);
+
+    _fgmask.create(frameSize_, CV_8UC1);
+    std::vector<Mat> frames(1, frame), fgmasks(1, _fgmask.getMat());
+
+    process(frames, fgmasks);
+}
 
-    // keep track of how many frames we have processed
-    ++frameNum_;
+void BackgroundSubtractorGMGImpl::applyBatch(const std::vector<Mat>& frames, std::vector<Mat>& fgmasks, double newLearningRate)
+{
+    fgmasks.resize(frames.size());
+    if (frames.empty())
+        return;
+
+    prepare(frames[0], newLearningRate);
+
+    for (size_t t = 0; t < frames.size(); ++t)
+    {
+        CV_Assert(frames[t].size() == frames[0].size() && frames[t].type() == frames[0].type());
+        fgmasks[t].create(frameSize_, CV_8UC1);
+    }
+
+    process(frames, fgmasks);
 }
 
 void BackgroundSubtractorGMGImpl::release()
@@ -492,6 +569,14 @@ Ptr<BackgroundSubtractorGMG> createBackgroundSubtractorGMG(int initializationFra
     return bgfg;
 }
 
+void applyGMGBatch(const Ptr<BackgroundSubtractorGMG>& subtractor,
+                   const std::vector<Mat>& images, std::vector<Mat>& fgmasks, double learningRate)
+{
+    BackgroundSubtractorGMGImpl* impl = dynamic_cast<BackgroundSubtractorGMGImpl*>(subtractor.get());
+    CV_Assert(impl != NULL);
+    impl->applyBatch(images, fgmasks, learningRate);
+}
+
 /*
  ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 
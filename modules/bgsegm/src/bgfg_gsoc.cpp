@@ -52,7 +52,10 @@
 #include "precomp.hpp"
 #include <opencv2/calib3d.hpp>
 #include <iostream>
+#include <cfloat>
+#include <climits>
 #include "opencv2/core/cvdef.h"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -191,11 +194,10 @@ void FindSparseCorrLK(const Mat& src, const Mat& dst, std::vector<Point2f>& srcP
 class BackgroundSampleGSOC {
 public:
     Point3f color;
-    int desc;
     uint64 time;
     uint64 hits;
 
-    BackgroundSampleGSOC(Point3f c = Point3f(), int d = 0, uint64 t = 0, uint64 h = 0) : color(c), desc(d), time(t), hits(h) {}
+    BackgroundSampleGSOC(Point3f c = Point3f(), uint64 t = 0, uint64 h = 0) : color(c), time(t), hits(h) {}
 };
 
 class BackgroundSampleLSBP {
@@ -207,24 +209,30 @@ public:
     BackgroundSampleLSBP(Point3f c = Point3f(), int d = 0, float mdd = 1e9f) : color(c), desc(d), minDecisionDist(mdd) {}
 };
 
-template<typename BackgroundSampleType>
+// The samples are stored field by field: every field has its own array, in which the samples
+// of one pixel are contiguous. This avoids the padding of the sample structures and lets
+// the loops over the samples of a pixel work on vectors.
+template<typename Derived>
 class BackgroundModel {
 protected:
-    std::vector<BackgroundSampleType> samples;
+    std::vector<float> color[3];
     const Size size;
     const int nSamples;
     const int stride;
 
 public:
     BackgroundModel(Size sz, int S) : size(sz), nSamples(S), stride(sz.width * S) {
-        samples.resize(sz.area() * S);
+        for (int c = 0; c < 3; ++c)
+            color[c].resize(sz.area() * S);
     }
 
-    void swap(BackgroundModel& bm) {
-        samples.swap(bm.samples);
+    void swap(Derived& bm) {
+        for (int c = 0; c < 3; ++c)
+            color[c].swap(bm.color[c]);
+        static_cast<Derived*>(this)->swapFields(bm);
     }
 
-    void motionCompensation(const BackgroundModel& bm, const std::vector<Point2f>& points) {
+    void motionCompensation(const Derived& bm, const std::vector<Point2f>& points) {
         for (int i = 0; i < size.height; ++i)
                 for (int j = 0; j < size.width; ++j) {
                     Point2i p = points[j * size.height + i];
@@ -238,42 +246,105 @@ public:
                         p.y = size.height - 1;
 
                     for (int k = 0; k < nSamples; k++)
-                        samples[i * stride + j * nSamples + k] = bm.samples[p.y * stride + p.x * nSamples + k];
+                        static_cast<Derived*>(this)->copySample(i * stride + j * nSamples + k, bm, p.y * stride + p.x * nSamples + k);
                 }
     }
 
-    const BackgroundSampleType& operator()(int k) const {
-        return samples[k];
-    }
-
-    BackgroundSampleType& operator()(int k) {
-        return samples[k];
+    int index(int i, int j, int k) const {
+        return i * stride + j * nSamples + k;
     }
 
-    const BackgroundSampleType& operator()(int i, int j, int k) const {
-        return samples[i * stride + j * nSamples + k];
+    Point3f getColor(int k) const {
+        return Point3f(color[0][k], color[1][k], color[2][k]);
     }
 
-    BackgroundSampleType& operator()(int i, int j, int k) {
-        return samples[i * stride + j * nSamples + k];
+    void setColor(int k, const Point3f& c) {
+        color[0][k] = c.x;
+        color[1][k] = c.y;
+        color[2][k] = c.z;
     }
 
     Size getSize() const {
         return size;
     }
+
+    size_t memorySize() const {
+        return 3 * color[0].size() * sizeof(float) + static_cast<const Derived*>(this)->fieldsMemorySize();
+    }
 };
 
-class BackgroundModelGSOC : public BackgroundModel<BackgroundSampleGSOC> {
+class BackgroundModelGSOC : public BackgroundModel<BackgroundModelGSOC> {
+    std::vector<uint64> time;
+    // saturated at UINT_MAX, which is above any hits threshold
+    std::vector<unsigned> hits;
+
 public:
-    BackgroundModelGSOC(Size sz, int S) : BackgroundModel(sz, S) {};
+    BackgroundModelGSOC(Size sz, int S) : BackgroundModel<BackgroundModelGSOC>(sz, S), time(sz.area() * S), hits(sz.area() * S) {};
 
-    float findClosest(int i, int j, const Point3f& color, int& indOut) const {
-        const int end = i * stride + (j + 1) * nSamples;
-        int minInd = i * stride + j * nSamples;
-        float minDist = L2sqdist(color - samples[minInd].color);
-        for (int k = minInd + 1; k < end; ++k) {
-            const float dist = L2sqdist(color - samples[k].color);
-            if (dist < minDist) {
+    void swapFields(BackgroundModelGSOC& bm) {
+        time.swap(bm.time);
+        hits.swap(bm.hits);
+    }
+
+    size_t fieldsMemorySize() const {
+        return time.size() * sizeof(time[0]) + hits.size() * sizeof(hits[0]);
+    }
+
+    void copySample(int k, const BackgroundModelGSOC& bm, int l) {
+        for (int c = 0; c < 3; ++c)
+            color[c][k] = bm.color[c][l];
+        time[k] = bm.time[l];
+        hits[k] = bm.hits[l];
+    }
+
+    BackgroundSampleGSOC getSample(int k) const {
+        return BackgroundSampleGSOC(getColor(k), time[k], hits[k]);
+    }
+
+    void setSample(int k, const BackgroundSampleGSOC& sample) {
+        setColor(k, sample.color);
+        time[k] = sample.time;
+        hits[k] = unsigned(std::min(sample.hits, uint64(UINT_MAX)));
+    }
+
+    float findClosest(int i, int j, const Point3f& c, int& indOut) const {
+        const int start = index(i, j, 0), end = start + nSamples;
+        const float* c0 = &color[0][0];
+        const float* c1 = &color[1][0];
+        const float* c2 = &color[2][0];
+        int k = start, minInd = start;
+        float minDist = FLT_MAX;
+#if CV_SIMD128
+        if (nSamples >= 4) {
+            const v_float32x4 vx = v_setall_f32(c.x), vy = v_setall_f32(c.y), vz = v_setall_f32(c.z);
+            v_float32x4 vMinDist = v_setall_f32(FLT_MAX);
+            v_int32x4 vMinInd = v_setall_s32(start), vInd(start, start + 1, start + 2, start + 3);
+            for (; k <= end - 4; k += 4, vInd = v_add(vInd, v_setall_s32(4))) {
+                const v_float32x4 dx = v_sub(vx, v_load(c0 + k));
+                const v_float32x4 dy = v_sub(vy, v_load(c1 + k));
+                const v_float32x4 dz = v_sub(vz, v_load(c2 + k));
+                const v_float32x4 dist = v_add(v_add(v_mul(dx, dx), v_mul(dy, dy)), v_mul(dz, dz));
+                const v_float32x4 less = v_lt(dist, vMinDist);
+                vMinDist = v_select(less, dist, vMinDist);
+                vMinInd = v_select(v_reinterpret_as_s32(less), vInd, vMinInd);
+            }
+            // every lane holds the first minimum of its samples, the earliest of the smallest ones wins
+            float dists[4];
+            int inds[4];
+            v_store(dists, vMinDist);
+            v_store(inds, vMinInd);
+            minDist = dists[0];
+            minInd = inds[0];
+            for (int l = 1; l < 4; ++l)
+                if (dists[l] < minDist || (dists[l] == minDist && inds[l] < minInd)) {
+                    minDist = dists[l];
+                    minInd = inds[l];
+                }
+        }
+#endif
+        for (; k < end; ++k) {
+            const float dist = L2sqdist(c - getColor(k));
+            if (k == start || dist < minDist) {
                 minInd = k;
                 minDist = dist;
             }
@@ -283,29 +354,29 @@ public:
     }
 
     void replaceOldest(int i, int j, const BackgroundSampleGSOC& sample) {
-        const int end = i * stride + (j + 1) * nSamples;
-        int minInd = i * stride + j * nSamples;
+        const int end = index(i, j + 1, 0);
+        int minInd = index(i, j, 0);
         for (int k = minInd + 1; k < end; ++k) {
-            if (samples[k].time < samples[minInd].time)
+            if (time[k] < time[minInd])
                 minInd = k;
         }
-        samples[minInd] = sample;
+        setSample(minInd, sample);
     }
 
     Point3f getMean(int i, int j, uint64 threshold) const {
-        const int end = i * stride + (j + 1) * nSamples;
+        const int end = index(i, j + 1, 0);
         Point3f acc(0, 0, 0);
         int cnt = 0;
-        for (int k = i * stride + j * nSamples; k < end; ++k) {
-            if (samples[k].hits > threshold) {
-                acc += samples[k].color;
+        for (int k = index(i, j, 0); k < end; ++k) {
+            if (hits[k] > threshold) {
+                acc += getColor(k);
                 ++cnt;
             }
         }
         if (cnt == 0) {
             cnt = nSamples;
-            for (int k = i * stride + j * nSamples; k < end; ++k)
-                acc += samples[k].color;
+            for (int k = index(i, j, 0); k < end; ++k)
+                acc += getColor(k);
         }
         acc.x /= cnt;
         acc.y /= cnt;
@@ -314,17 +385,63 @@ public:
     }
 };
 
-class BackgroundModelLSBP : public BackgroundModel<BackgroundSampleLSBP> {
+class BackgroundModelLSBP : public BackgroundModel<BackgroundModelLSBP> {
+    std::vector<int> desc;
+    std::vector<float> minDecisionDist;
+
 public:
-    BackgroundModelLSBP(Size sz, int S) : BackgroundModel(sz, S) {};
+    BackgroundModelLSBP(Size sz, int S) : BackgroundModel<BackgroundModelLSBP>(sz, S), desc(sz.area() * S), minDecisionDist(sz.area() * S) {};
+
+    void swapFields(BackgroundModelLSBP& bm) {
+        desc.swap(bm.desc);
+        minDecisionDist.swap(bm.minDecisionDist);
+    }
 
-    int countMatches(int i, int j, const Point3f& color, int desc, float threshold, int descThreshold, float& minDist) const {
-        const int end = i * stride + (j + 1) * nSamples;
+    size_t fieldsMemorySize() const {
+        return desc.size() * sizeof(desc[0]) + minDecisionDist.size() * sizeof(minDecisionDist[0]);
+    }
+
+    void copySample(int k, const BackgroundModelLSBP& bm, int l) {
+        for (int c = 0; c < 3; ++c)
+            color[c][k] = bm.color[c][l];
+        desc[k] = bm.desc[l];
+        minDecisionDist[k] = bm.minDecisionDist[l];
+    }
+
+    void setSample(int k, const BackgroundSampleLSBP& sample) {
+        setColor(k, sample.color);
+        desc[k] = sample.desc;
+        minDecisionDist[k] = sample.minDecisionDist;
+    }
+
+    int countMatches(int i, int j, const Point3f& c, int d, float threshold, int descThreshold, float& minDist) const {
+        const int end = index(i, j + 1, 0);
+        const float* c0 = &color[0][0];
+        const float* c1 = &color[1][0];
+        const float* c2 = &color[2][0];
+        int k = index(i, j, 0);
         int count = 0;
         minDist = 1e9;
-        for (int k = i * stride + j * nSamples; k < end; ++k) {
-            const float dist = L1dist(color - samples[k].color);
-            if (dist < threshold && LSBPDist32(static_cast<unsigned>(desc ^ samples[k].desc)) < descThreshold)
+#if CV_SIMD128
+        const v_float32x4 vx = v_setall_f32(c.x), vy = v_setall_f32(c.y), vz = v_setall_f32(c.z);
+        const v_float32x4 vThreshold = v_setall_f32(threshold);
+        const v_int32x4 vDesc = v_setall_s32(d), vDescThreshold = v_setall_s32(descThreshold);
+        v_float32x4 vMinDist = v_setall_f32(minDist);
+        v_int32x4 vCount = v_setzero_s32();
+        for (; k <= end - 4; k += 4) {
+            const v_float32x4 dist = v_add(v_add(v_abs(v_sub(vx, v_load(c0 + k))), v_abs(v_sub(vy, v_load(c1 + k)))),
+                                           v_abs(v_sub(vz, v_load(c2 + k))));
+            const v_int32x4 descDist = v_reinterpret_as_s32(v_popcount(v_reinterpret_as_u32(v_xor(vDesc, v_load(&desc[k])))));
+            const v_int32x4 match = v_and(v_reinterpret_as_s32(v_lt(dist, vThreshold)), v_lt(descDist, vDescThreshold));
+            vCount = v_sub(vCount, match);
+            vMinDist = v_min(vMinDist, dist);
+        }
+        count = v_reduce_sum(vCount);
+        minDist = v_reduce_min(vMinDist);
+#endif
+        for (; k < end; ++k) {
+            const float dist = L1dist(c - getColor(k));
+            if (dist < threshold && LSBPDist32(static_cast<unsigned>(d ^ desc[k])) < descThreshold)
                 ++count;
             if (dist < minDist)
                 minDist = dist;
@@ -333,10 +450,10 @@ public:
     }
 
     Point3f getMean(int i, int j) const {
-        const int end = i * stride + (j + 1) * nSamples;
+        const int end = index(i, j + 1, 0);
         Point3f acc(0, 0, 0);
-        for (int k = i * stride + j * nSamples; k < end; ++k) {
-            acc += samples[k].color;
+        for (int k = index(i, j, 0); k < end; ++k) {
+            acc += getColor(k);
         }
         acc.x /= nSamples;
         acc.y /= nSamples;
@@ -345,12 +462,12 @@ public:
     }
 
     float getDMean(int i, int j) const {
-        const int end = i * stride + (j + 1) * nSamples;
-        float d = 0;
-        for (int k = i * stride + j * nSamples; k < end; ++k)
-            d += samples[k].minDecisionDist;
+        const int end = index(i, j + 1, 0);
+        float dm = 0;
+        for (int k = index(i, j, 0); k < end; ++k)
+            dm += minDecisionDist[k];
 
-        return d / nSamples;
+        return dm / nSamples;
     }
 };
 
@@ -388,19 +505,52 @@ private:
 public:
     ParallelFromLocalSVDValues(const Size& _sz, Mat& _desc, const Mat& _localSVDValues, const Point2i* _LSBPSamplePoints) : sz(_sz), desc(_desc), localSVDValues(_localSVDValues), LSBPSamplePoints(_LSBPSamplePoints) {};
 
+    int computeDesc(int i, int j) const {
+        int descVal = 0;
+        const float centerVal = localSVDValues.at<float>(i, j);
+
+        for (int n = 0; n < 32; ++n) {
+            const int ri = i + LSBPSamplePoints[n].y;
+            const int rj = j + LSBPSamplePoints[n].x;
+            if (ri >= 0 && rj >= 0 && ri < sz.height && rj < sz.width && std::abs(localSVDValues.at<float>(ri, rj) - centerVal) > LSBPtau)
+                descVal |= int(1U << n);
+        }
+        return descVal;
+    }
+
     void operator()(const Range &range) const CV_OVERRIDE {
-        for (int index = range.start; index < range.end; ++index) {
-            const int i = index / sz.width, j = index % sz.width;
-            int& descVal = desc.at<int>(i, j);
-            descVal = 0;
-            const float centerVal = localSVDValues.at<float>(i, j);
-
-            for (int n = 0; n < 32; ++n) {
-                const int ri = i + LSBPSamplePoints[n].y;
-                const int rj = j + LSBPSamplePoints[n].x;
-                if (ri >= 0 && rj >= 0 && ri < sz.height && rj < sz.width && std::abs(localSVDValues.at<float>(ri, rj) - centerVal) > LSBPtau)
-                    descVal |= int(1U) << n;
+        int minX = 0, maxX = 0;
+        for (int n = 0; n < 32; ++n) {
+            minX = std::min(minX, LSBPSamplePoints[n].x);
+            maxX = std::max(maxX, LSBPSamplePoints[n].x);
+        }
+        // the columns for which no sample point falls outside the frame horizontally
+        const int jStart = std::min(-minX, sz.width), jEnd = std::max(sz.width - maxX, jStart);
+
+        for (int i = range.start; i < range.end; ++i) {
+            int* descRow = desc.ptr<int>(i);
+            int j = 0;
+            for (; j < jStart; ++j)
+                descRow[j] = computeDesc(i, j);
+#if CV_SIMD128
+            const float* centerRow = localSVDValues.ptr<float>(i);
+            const v_float32x4 tau = v_setall_f32(LSBPtau);
+            for (; j <= jEnd - 4; j += 4) {
+                const v_float32x4 centerVal = v_load(centerRow + j);
+                v_int32x4 descVal = v_setzero_s32();
+                for (int n = 0; n < 32; ++n) {
+                    const int ri = i + LSBPSamplePoints[n].y;
+                    if (ri < 0 || ri >= sz.height)
+                        continue;
+                    const v_float32x4 val = v_load(localSVDValues.ptr<float>(ri) + j + LSBPSamplePoints[n].x);
+                    const v_int32x4 bit = v_reinterpret_as_s32(v_gt(v_abs(v_sub(val, centerVal)), tau));
+                    descVal = v_or(descVal, v_and(bit, v_setall_s32(int(1U << n))));
+                }
+                v_store(descRow + j, descVal);
             }
+#endif
+            for (; j < sz.width; ++j)
+                descRow[j] = computeDesc(i, j);
         }
     }
 };
@@ -447,7 +597,7 @@ void BackgroundSubtractorLSBPDesc::computeFromLocalSVDValues(OutputArray _desc,
     _desc.create(sz, CV_32S);
     Mat desc = _desc.getMat();
 
-    parallel_for_(Range(0, sz.area()), ParallelFromLocalSVDValues(sz, desc, localSVDValues, LSBPSamplePoints));
+    parallel_for_(Range(0, sz.height), ParallelFromLocalSVDValues(sz, desc, localSVDValues, LSBPSamplePoints));
 }
 
 void BackgroundSubtractorLSBPDesc::compute(OutputArray desc, const Mat& frame, const Point2i* LSBPSamplePoints) {
@@ -497,6 +647,8 @@ public:
 
     CV_WRAP virtual void getBackgroundImage(OutputArray backgroundImage) const CV_OVERRIDE;
 
+    CV_WRAP virtual size_t getModelMemorySize() const CV_OVERRIDE;
+
     friend class ParallelGSOC;
 };
 
@@ -545,6 +697,8 @@ public:
 
     CV_WRAP virtual void getBackgroundImage(OutputArray backgroundImage) const CV_OVERRIDE;
 
+    CV_WRAP virtual size_t getModelMemorySize() const CV_OVERRIDE;
+
     friend class ParallelLSBP;
 };
 
@@ -569,25 +723,27 @@ public:
         for (int index = range.start; index < range.end; ++index) {
             const int i = index / sz.width, j = index % sz.width;
             int k;
-            const float minDist = backgroundModel->findClosest(i, j, frame.at<Point3f>(i, j), k);
+            const Point3f& color = frame.at<Point3f>(i, j);
+            const float minDist = backgroundModel->findClosest(i, j, color, k);
 
             distMovingAvg.at<float>(i, j) *= 1 - float(learningRate);
             distMovingAvg.at<float>(i, j) += float(learningRate) * minDist;
 
             const float threshold = bgs->alpha * distMovingAvg.at<float>(i, j) + bgs->beta;
-            BackgroundSampleGSOC& sample = (* backgroundModel)(k);
 
             if (minDist > threshold) {
                 fgMask.at<uchar>(i, j) = 255;
 
                 if (bgs->rng.uniform(0.0f, 1.0f) < bgs->replaceRate)
-                    backgroundModel->replaceOldest(i, j, BackgroundSampleGSOC(frame.at<Point3f>(i, j), 0, bgs->currentTime));
+                    backgroundModel->replaceOldest(i, j, BackgroundSampleGSOC(color, bgs->currentTime));
             }
             else {
+                BackgroundSampleGSOC sample = backgroundModel->getSample(k);
                 sample.color *= 1 - learningRate;
-                sample.color += learningRate * frame.at<Point3f>(i, j);
+                sample.color += learningRate * color;
                 sample.time = bgs->currentTime;
                 ++sample.hits;
+                backgroundModel->setSample(k, sample);
 
                 // Propagation to neighbors
                 if (sample.hits > bgs->hitsThreshold && bgs->rng.uniform(0.0f, 1.0f) < bgs->propagationRate) {
@@ -649,14 +805,14 @@ public:
                 T.at<float>(i, j) -= bgs->Tdec / DMean;
 
                 if (bgs->rng.uniform(0.0f, 1.0f) < 1 / T.at<float>(i, j))
-                    (* backgroundModel)(i, j, bgs->rng.uniform(0, bgs->nSamples)) = BackgroundSampleLSBP(frame.at<Point3f>(i, j), LSBPDesc.at<int>(i, j), minDist);
+                    backgroundModel->setSample(backgroundModel->index(i, j, bgs->rng.uniform(0, bgs->nSamples)), BackgroundSampleLSBP(frame.at<Point3f>(i, j), LSBPDesc.at<int>(i, j), minDist));
 
                 if (bgs->rng.uniform(0.0f, 1.0f) < 1 / T.at<float>(i, j)) {
                     const int oi = i + bgs->rng.uniform(-1, 2);
                     const int oj = j + bgs->rng.uniform(-1, 2);
 
                     if (oi >= 0 && oi < sz.height && oj >= 0 && oj < sz.width)
-                        (* backgroundModel)(oi, oj, bgs->rng.uniform(0, bgs->nSamples)) = BackgroundSampleLSBP(frame.at<Point3f>(oi, oj), LSBPDesc.at<int>(oi, oj), minDist);
+                        backgroundModel->setSample(backgroundModel->index(oi, oj, bgs->rng.uniform(0, bgs->nSamples)), BackgroundSampleLSBP(frame.at<Point3f>(oi, oj), LSBPDesc.at<int>(oi, oj), minDist));
                 }
             }
 
@@ -729,18 +885,15 @@ void BackgroundSubtractorGSOCImpl::apply(InputArray _image, OutputArray _fgmask,
 
     if (backgroundModel.empty()) {
         backgroundModel = makePtr<BackgroundModelGSOC>(sz, nSamples);
-        backgroundModelPrev = makePtr<BackgroundModelGSOC>(sz, nSamples);
         distMovingAvg = Mat(sz, CV_32F, Scalar::all(0.005f));
         prevFgMask = Mat(sz, CV_8U, Scalar::all(0));
         blinkingSupression = Mat(sz, CV_32F, Scalar::all(0.0f));
 
         for (int i = 0; i < sz.height; ++i)
             for (int j = 0; j < sz.width; ++j) {
-                BackgroundSampleGSOC sample(frame.at<Point3f>(i, j), 0);
-                for (int k = 0; k < nSamples; ++k) {
-                    (* backgroundModel)(i, j, k) = sample;
-                    (* backgroundModelPrev)(i, j, k) = sample;
-                }
+                BackgroundSampleGSOC sample(frame.at<Point3f>(i, j));
+                for (int k = 0; k < nSamples; ++k)
+                    backgroundModel->setSample(backgroundModel->index(i, j, k), sample);
             }
     }
 
@@ -766,6 +919,9 @@ void BackgroundSubtractorGSOCImpl::apply(InputArray _image, OutputArray _fgmask,
             dstPoints.resize(srcPoints.size());
             perspectiveTransform(srcPoints, dstPoints, H);
 
+            // the previous model is only needed with motion compensation, so it is allocated on demand
+            if (backgroundModelPrev.empty())
+                backgroundModelPrev = makePtr<BackgroundModelGSOC>(sz, nSamples);
             backgroundModel->swap(* backgroundModelPrev);
             backgroundModel->motionCompensation(* backgroundModelPrev, dstPoints);
         }
@@ -788,11 +944,24 @@ void BackgroundSubtractorGSOCImpl::apply(InputArray _image, OutputArray _fgmask,
     for (int i = 0; i < sz.height; ++i)
         for (int j = 0; j < sz.width; ++j)
             if (rng.uniform(0.0f, 1.0f) < prob.at<float>(i, j))
-                backgroundModel->replaceOldest(i, j, BackgroundSampleGSOC(frame.at<Point3f>(i, j), 0, currentTime));
+                backgroundModel->replaceOldest(i, j, BackgroundSampleGSOC(frame.at<Point3f>(i, j), currentTime));
 
     this->postprocessing(fgMask);
 }
 
+size_t BackgroundSubtractorGSOC::getModelMemorySize() const {
+    return 0;
+}
+
+size_t BackgroundSubtractorGSOCImpl::getModelMemorySize() const {
+    size_t bytes = 0;
+    if (!backgroundModel.empty())
+        bytes += backgroundModel->memorySize();
+    if (!backgroundModelPrev.empty())
+        bytes += backgroundModelPrev->memorySize();
+    return bytes;
+}
+
 void BackgroundSubtractorGSOCImpl::getBackgroundImage(OutputArray _backgroundImage) const {
     CV_Assert(!backgroundModel.empty());
     const Size sz = backgroundModel->getSize();
@@ -875,7 +1044,6 @@ void BackgroundSubtractorLSBPImpl::apply(InputArray _image, OutputArray _fgmask,
 
     if (backgroundModel.empty()) {
         backgroundModel = makePtr<BackgroundModelLSBP>(sz, nSamples);
-        backgroundModelPrev = makePtr<BackgroundModelLSBP>(sz, nSamples);
         T = Mat(sz, CV_32F);
         T = (Tlower + Tupper) * 0.5f;
         R = Mat(sz, CV_32F);
@@ -884,10 +1052,8 @@ void BackgroundSubtractorLSBPImpl::apply(InputArray _image, OutputArray _fgmask,
         for (int i = 0; i < sz.height; ++i)
             for (int j = 0; j < sz.width; ++j) {
                 BackgroundSampleLSBP sample(frame.at<Point3f>(i, j), LSBPDesc.at<int>(i, j));
-                for (int k = 0; k < nSamples; ++k) {
-                    (* backgroundModel)(i, j, k) = sample;
-                    (* backgroundModelPrev)(i, j, k) = sample;
-                }
+                for (int k = 0; k < nSamples; ++k)
+                    backgroundModel->setSample(backgroundModel->index(i, j, k), sample);
             }
     }
 
@@ -913,6 +1079,8 @@ void BackgroundSubtractorLSBPImpl::apply(InputArray _image, OutputArray _fgmask,
             dstPoints.resize(srcPoints.size());
             perspectiveTransform(srcPoints, dstPoints, H);
 
+            if (backgroundModelPrev.empty())
+                backgroundModelPrev = makePtr<BackgroundModelLSBP>(sz, nSamples);
             backgroundModel->swap(* backgroundModelPrev);
             backgroundModel->motionCompensation(* backgroundModelPrev, dstPoints);
         }
@@ -928,6 +1096,19 @@ void BackgroundSubtractorLSBPImpl::apply(InputArray _image, OutputArray _fgmask,
     this->postprocessing(fgMask);
 }
 
+size_t BackgroundSubtractorLSBP::getModelMemorySize() const {
+    return 0;
+}
+
+size_t BackgroundSubtractorLSBPImpl::getModelMemorySize() const {
+    size_t bytes = 0;
+    if (!backgroundModel.empty())
+        bytes += backgroundModel->memorySize();
+    if (!backgroundModelPrev.empty())
+        bytes += backgroundModelPrev->memorySize();
+    return bytes;
+}
+
 void BackgroundSubtractorLSBPImpl::getBackgroundImage(OutputArray _backgroundImage) const {
     CV_Assert(!backgroundModel.empty());
     const Size sz = backgroundModel->getSize();
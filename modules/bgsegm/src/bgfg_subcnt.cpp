@@ -43,6 +43,7 @@
 
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <functional>
 
 namespace cv
@@ -61,6 +62,7 @@ public:
 
     // BackgroundSubtractor interface
     virtual void apply(InputArray image, OutputArray fgmask, double learningRate) CV_OVERRIDE;
+    void applyBatch(const std::vector<Mat>& images, std::vector<Mat>& fgmasks, double learningRate);
     virtual void getBackgroundImage(OutputArray backgroundImage) const CV_OVERRIDE;
 
     int getMinPixelStability() const CV_OVERRIDE;
@@ -92,6 +94,9 @@ private:
     Mat_<Vec4i> data;
     Mat prevFrame;
     Mat fgMaskPrev;
+
+    //! updates the model with consecutive same-sized gray frames
+    void process(const std::vector<Mat>& frames, std::vector<Mat>& fgMasks, double learningRate);
 };
 
 BackgroundSubtractorCNTImpl::BackgroundSubtractorCNTImpl(int minStability,
@@ -163,23 +168,36 @@ void BackgroundSubtractorCNTImpl::setIsParallel(bool value)
     isParallel = value;
 }
 
+#if CV_SIMD128
+static inline v_int32x4 loadPixels4(const uchar* ptr)
+{
+    return v_reinterpret_as_s32(v_load_expand_q(ptr));
+}
+
+static inline void storeMask4(uchar* dst, const v_int32x4& mask)
+{
+    int buf[4];
+    v_store(buf, mask);
+    for (int i = 0; i < 4; ++i)
+        dst[i] = (uchar)buf[i];
+}
+#endif
+
 class CNTFunctor
 {
 public:
     virtual void operator()(Vec4i &vec, uchar currColor, uchar prevColor, uchar &fgMaskPixelRef) = 0;
+    //! processes a row of pixels, fgMaskRow must be cleared beforehand
+    virtual void processRow(Vec4i* row, const uchar* frameRow, const uchar* prevFrameRow, uchar* fgMaskRow, int cols) = 0;
     //! the destructor
     virtual ~CNTFunctor() {}
 };
 
 struct BGSubtractPixel : public CNTFunctor
 {
-    BGSubtractPixel(int _minPixelStability, int _threshold,
-                    const Mat &_frame, const Mat &_prevFrame, Mat &_fgMask)
+    BGSubtractPixel(int _minPixelStability, int _threshold)
         : minPixelStability(_minPixelStability),
-          threshold(_threshold),
-          frame(_frame),
-          prevFrame(_prevFrame),
-          fgMask(_fgMask)
+          threshold(_threshold)
     {}
 
     //! the destructor
@@ -209,24 +227,43 @@ struct BGSubtractPixel : public CNTFunctor
         }
     }
 
+    void processRow(Vec4i* row, const uchar* frameRow, const uchar* prevFrameRow, uchar* fgMaskRow, int cols) CV_OVERRIDE
+    {
+        int c = 0;
+#if CV_SIMD128
+        // the same decisions as operator() for 4 pixels, with masks instead of branches
+        const v_int32x4 vThreshold = v_setall_s32(threshold), vMinStability = v_setall_s32(minPixelStability);
+        for (; c <= cols - 4; c += 4)
+        {
+            v_int32x4 stability, history, histStability, bgImg;
+            v_load_deinterleave(row[c].val, stability, history, histStability, bgImg);
+            const v_int32x4 currColor = loadPixels4(frameRow + c), prevColor = loadPixels4(prevFrameRow + c);
+
+            const v_int32x4 same = v_lt(v_reinterpret_as_s32(v_absdiff(currColor, prevColor)), vThreshold);
+            const v_int32x4 incStability = v_add(stability, v_setall_s32(1));
+            const v_int32x4 bg = v_and(same, v_eq(incStability, vMinStability));
+            stability = v_and(same, v_select(bg, stability, incStability));
+            bgImg = v_select(bg, prevColor, bgImg);
+
+            v_store_interleave(row[c].val, stability, history, histStability, bgImg);
+            storeMask4(fgMaskRow + c, v_not(bg));
+        }
+#endif
+        for (; c < cols; ++c)
+            (*this)(row[c], frameRow[c], prevFrameRow[c], fgMaskRow[c]);
+    }
+
     int minPixelStability;
     int threshold;
-    const Mat &frame;
-    const Mat &prevFrame;
-    Mat &fgMask;
 };
 
 struct BGSubtractPixelWithHistory : public CNTFunctor
 {
-    BGSubtractPixelWithHistory(int _minPixelStability, int _maxPixelStability, int _threshold,
-                               const Mat &_frame, const Mat &_prevFrame, Mat &_fgMask)
+    BGSubtractPixelWithHistory(int _minPixelStability, int _maxPixelStability, int _threshold)
         : minPixelStability(_minPixelStability),
           maxPixelStability(_maxPixelStability),
           threshold(_threshold),
-          thresholdHistory(30),
-          frame(_frame),
-          prevFrame(_prevFrame),
-          fgMask(_fgMask)
+          thresholdHistory(30)
     {}
 
     //! the destructor
@@ -298,20 +335,63 @@ struct BGSubtractPixelWithHistory : public CNTFunctor
 
     }
 
+    void processRow(Vec4i* row, const uchar* frameRow, const uchar* prevFrameRow, uchar* fgMaskRow, int cols) CV_OVERRIDE
+    {
+        int c = 0;
+#if CV_SIMD128
+        // the three cases of operator() become lane masks, every lane takes exactly one of them
+        const v_int32x4 vThreshold = v_setall_s32(threshold), vThresholdHistory = v_setall_s32(thresholdHistory);
+        const v_int32x4 vMinStability = v_setall_s32(minPixelStability), vMaxStability = v_setall_s32(maxPixelStability);
+        const v_int32x4 vZero = v_setzero_s32(), vOne = v_setall_s32(1);
+        for (; c <= cols - 4; c += 4)
+        {
+            v_int32x4 stability, historyColor, histStability, bgImg;
+            v_load_deinterleave(row[c].val, stability, historyColor, histStability, bgImg);
+            const v_int32x4 currColor = loadPixels4(frameRow + c), prevColor = loadPixels4(prevFrameRow + c);
+
+            const v_int32x4 sameAsHistory = v_lt(v_reinterpret_as_s32(v_absdiff(currColor, historyColor)), vThresholdHistory);
+            const v_int32x4 sameAsPrev = v_and(v_not(sameAsHistory),
+                                               v_lt(v_reinterpret_as_s32(v_absdiff(currColor, prevColor)), vThreshold));
+            const v_int32x4 changed = v_not(v_or(sameAsHistory, sameAsPrev));
+
+            const v_int32x4 incHistStability = v_select(v_lt(histStability, vMaxStability), v_add(histStability, vOne), histStability);
+            const v_int32x4 decHistStability = v_select(v_gt(histStability, vZero), v_sub(histStability, vOne), histStability);
+            const v_int32x4 incStability = v_select(v_lt(stability, vMaxStability), v_add(stability, vOne), stability);
+
+            const v_int32x4 historyBg = v_and(sameAsHistory, v_gt(incHistStability, vMinStability));
+            const v_int32x4 stable = v_and(sameAsPrev, v_gt(incStability, vMinStability));
+            const v_int32x4 newHistory = v_and(stable, v_ge(incStability, histStability));
+            const v_int32x4 decrease = v_or(changed, v_and(stable, v_not(newHistory)));
+
+            bgImg = v_select(historyBg, historyColor, v_select(newHistory, currColor, bgImg));
+            historyColor = v_select(newHistory, currColor, historyColor);
+            histStability = v_select(sameAsHistory, incHistStability,
+                            v_select(newHistory, incStability,
+                            v_select(decrease, decHistStability, histStability)));
+            stability = v_and(sameAsPrev, incStability);
+
+            v_store_interleave(row[c].val, stability, historyColor, histStability, bgImg);
+            storeMask4(fgMaskRow + c, v_not(v_or(historyBg, newHistory)));
+        }
+#endif
+        for (; c < cols; ++c)
+            (*this)(row[c], frameRow[c], prevFrameRow[c], fgMaskRow[c]);
+    }
+
     int minPixelStability;
     int maxPixelStability;
     int threshold;
     int thresholdHistory;
-    const Mat &frame;
-    const Mat &prevFrame;
-    Mat &fgMask;
 };
 
+// Runs the functor over consecutive frames; the first one follows prevFrame.
+// Every pixel only depends on its own history, so each row goes through all
+// the frames at once.
 class CNTInvoker : public ParallelLoopBody
 {
 public:
-    CNTInvoker(Mat_<Vec4i> &_data, Mat &_img, Mat &_prevFrame, Mat &_fgMask, CNTFunctor &_functor)
-        : data(_data), img(_img), prevFrame(_prevFrame), fgMask(_fgMask), functor(_functor)
+    CNTInvoker(Mat_<Vec4i> &_data, const std::vector<Mat> &_frames, const Mat &_prevFrame, std::vector<Mat> &_fgMasks, CNTFunctor &_functor)
+        : data(_data), frames(_frames), prevFrame(_prevFrame), fgMasks(_fgMasks), functor(_functor)
     {
     }
 
@@ -321,38 +401,28 @@ public:
         for (int r = range.start; r < range.end; ++r)
         {
             Vec4i* row = data.ptr<Vec4i>(r);
-            uchar* frameRow = img.ptr<uchar>(r);
-            uchar* prevFrameRow = prevFrame.ptr<uchar>(r);
-            uchar* fgMaskRow = fgMask.ptr<uchar>(r);
-            for (int c = 0; c < data.cols; ++c)
+            const uchar* prevFrameRow = prevFrame.ptr<uchar>(r);
+            for (size_t t = 0; t < frames.size(); ++t)
             {
-                functor(row[c], frameRow[c], prevFrameRow[c], fgMaskRow[c]);
+                const uchar* frameRow = frames[t].ptr<uchar>(r);
+                functor.processRow(row, frameRow, prevFrameRow, fgMasks[t].ptr<uchar>(r), data.cols);
+                prevFrameRow = frameRow;
             }
         }
     }
 
 private:
     Mat_<Vec4i> &data;
-    Mat &img;
-    Mat &prevFrame;
-    Mat &fgMask;
+    const std::vector<Mat> &frames;
+    const Mat &prevFrame;
+    std::vector<Mat> &fgMasks;
     CNTFunctor &functor;
 };
 
-void BackgroundSubtractorCNTImpl::apply(InputArray image, OutputArray _fgmask, double learningRate)
+void BackgroundSubtractorCNTImpl::process(const std::vector<Mat>& frames, std::vector<Mat>& fgMasks, double learningRate)
 {
-    CV_Assert(image.depth() == CV_8U);
-
-    Mat frameIn = image.getMat();
-    if(frameIn.channels() != 1)
-        cvtColor(frameIn, frameIn, COLOR_BGR2GRAY);
-
-    _fgmask.create(image.size(), CV_8U); // OutputArray usage requires this step
-    Mat fgMask = _fgmask.getMat();
-
-    bool needToInitialize = data.empty() || learningRate >= 1 || frameIn.size() != prevFrame.size();
-
-    Mat frame = frameIn.clone();
+    const Mat& frame = frames[0];
+    bool needToInitialize = data.empty() || learningRate >= 1 || frame.size() != prevFrame.size();
 
     if (needToInitialize)
     {   // Usually done only once
@@ -367,7 +437,8 @@ void BackgroundSubtractorCNTImpl::apply(InputArray image, OutputArray _fgmask, d
         mixChannels(&tmp, 1, &data, 1, from_gray_to_history_color, 1);
     }
 
-    fgMask = Scalar(0);
+    for (size_t t = 0; t < fgMasks.size(); ++t)
+        fgMasks[t] = Scalar(0);
     CNTFunctor *functor;
     if (useHistory && learningRate)
     {
@@ -376,37 +447,71 @@ void BackgroundSubtractorCNTImpl::apply(InputArray image, OutputArray _fgmask, d
         {
             scaleMaxStability = learningRate;
         }
-        functor = new BGSubtractPixelWithHistory(minPixelStability, int(maxPixelStability * scaleMaxStability),
-                                                 threshold, frame, prevFrame, fgMask);
+        functor = new BGSubtractPixelWithHistory(minPixelStability, int(maxPixelStability * scaleMaxStability), threshold);
     }
     else
     {
-        functor = new BGSubtractPixel(minPixelStability, threshold*3, frame, prevFrame, fgMask);
+        functor = new BGSubtractPixel(minPixelStability, threshold*3);
     }
 
+    CNTInvoker invoker(data, frames, prevFrame, fgMasks, *functor);
     if (isParallel)
     {
-        parallel_for_(Range(0, frame.rows),
-                      CNTInvoker(data, frame, prevFrame, fgMask, *functor));
+        parallel_for_(Range(0, frame.rows), invoker);
     }
     else
     {
-        for (int r = 0; r < data.rows; ++r)
-        {
-            Vec4i* row = data.ptr<Vec4i>(r);
-            uchar* frameRow = frame.ptr<uchar>(r);
-            uchar* prevFrameRow = prevFrame.ptr<uchar>(r);
-            uchar* fgMaskRow = fgMask.ptr<uchar>(r);
-            for (int c = 0; c < data.cols; ++c)
-            {
-                (*functor)(row[c], frameRow[c], prevFrameRow[c], fgMaskRow[c]);
-            }
-        }
+        invoker(Range(0, frame.rows));
     }
 
     delete functor;
 
-    prevFrame = frame;
+    prevFrame = frames.back();
+}
+
+static Mat prepareFrame(InputArray image)
+{
+    CV_Assert(image.depth() == CV_8U);
+
+    Mat frameIn = image.getMat();
+    if(frameIn.channels() != 1)
+        cvtColor(frameIn, frameIn, COLOR_BGR2GRAY);
+
+    return frameIn.clone();
+}
+
+void BackgroundSubtractorCNTImpl::apply(InputArray image, OutputArray _fgmask, double learningRate)
+{
+    std::vector<Mat> frames(1, prepareFrame(image));
+
+    _fgmask.create(image.size(), CV_8U); // OutputArray usage requires this step
+    std::vector<Mat> fgMasks(1, _fgmask.getMat());
+
+    process(frames, fgMasks, learningRate);
+}
+
+void BackgroundSubtractorCNTImpl::applyBatch(const std::vector<Mat>& images, std::vector<Mat>& fgmasks, double learningRate)
+{
+    fgmasks.resize(images.size());
+    if (images.empty())
+        return;
+
+    if (learningRate >= 1)
+    {   // every frame reinitializes the model
+        for (size_t t = 0; t < images.size(); ++t)
+            apply(images[t], fgmasks[t], learningRate);
+        return;
+    }
+
+    std::vector<Mat> frames(images.size());
+    for (size_t t = 0; t < images.size(); ++t)
+    {
+        CV_Assert(images[t].size() == images[0].size());
+        frames[t] = prepareFrame(images[t]);
+        fgmasks[t].create(images[t].size(), CV_8U);
+    }
+
+    process(frames, fgmasks, learningRate);
 }
 
 
@@ -415,6 +520,14 @@ Ptr<BackgroundSubtractorCNT> createBackgroundSubtractorCNT(int minPixelStability
     return makePtr<BackgroundSubtractorCNTImpl>(minPixelStability, useHistory, maxStability, isParallel);
 }
 
+void applyCNTBatch(const Ptr<BackgroundSubtractorCNT>& subtractor,
+                   const std::vector<Mat>& images, std::vector<Mat>& fgmasks, double learningRate)
+{
+    BackgroundSubtractorCNTImpl* impl = dynamic_cast<BackgroundSubtractorCNTImpl*>(subtractor.get());
+    CV_Assert(impl != NULL);
+    impl->applyBatch(images, fgmasks, learningRate);
+}
+
 }
 }
 
@@ -0,0 +1,27 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+// 83 columns leave 3 pixels of every row after the 4 pixel SIMD steps of CNT
+static const Size frameSize(83, 61);
+
+TEST(BackgroundSubtractor_CNT, BatchMatchesSequentialApply)
+{
+    std::vector<Mat> frames = generateFrames(40, frameSize);
+    for (int useHistory = 0; useHistory < 2; ++useHistory)
+    {
+        checkBatchMatchesApply(createBackgroundSubtractorCNT(3, useHistory != 0, 20),
+                               createBackgroundSubtractorCNT(3, useHistory != 0, 20), applyCNTBatch, frames, 7);
+    }
+}
+
+TEST(BackgroundSubtractor_GMG, BatchMatchesSequentialApply)
+{
+    std::vector<Mat> frames = generateFrames(30, frameSize);
+    checkBatchMatchesApply(createBackgroundSubtractorGMG(10), createBackgroundSubtractorGMG(10), applyGMGBatch, frames, 7);
+}
+
+}} // namespace
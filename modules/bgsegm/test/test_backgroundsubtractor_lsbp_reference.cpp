@@ -0,0 +1,353 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+// Straightforward implementations of GSOC and LSBP with one struct per sample, as the models were
+// stored before they were split into per-field arrays. They follow the default parameters, no
+// camera motion compensation and the default learning rate. The random draws happen in the same
+// order as in the library when it runs on a single thread.
+
+static int popcount32(unsigned n)
+{
+    int count = 0;
+    for (; n; n &= n - 1)
+        ++count;
+    return count;
+}
+
+static void removeNoise(Mat& fgMask, const Mat& compMask, size_t threshold, uchar filler)
+{
+    Mat labels;
+    const int nComponents = connectedComponents(compMask, labels, 8, CV_32S);
+    std::vector<size_t> compArea(nComponents, 0);
+    for (int i = 0; i < labels.rows; ++i)
+        for (int j = 0; j < labels.cols; ++j)
+            ++compArea[labels.at<int>(i, j)];
+    for (int i = 0; i < labels.rows; ++i)
+        for (int j = 0; j < labels.cols; ++j)
+            if (compArea[labels.at<int>(i, j)] < threshold)
+                fgMask.at<uchar>(i, j) = filler;
+}
+
+static void postprocessing(Mat& fgMask)
+{
+    removeNoise(fgMask, fgMask, size_t(0.0004f * fgMask.size().area()), 0);
+    Mat invFgMask = 255 - fgMask;
+    removeNoise(fgMask, invFgMask, size_t(0.0008f * fgMask.size().area()), 255);
+    GaussianBlur(fgMask, fgMask, Size(5, 5), 0);
+    fgMask = fgMask > 127;
+}
+
+struct SampleGSOC
+{
+    Point3f color;
+    uint64 time;
+    uint64 hits;
+
+    SampleGSOC(Point3f c = Point3f(), uint64 t = 0, uint64 h = 0) : color(c), time(t), hits(h) {}
+};
+
+class ReferenceGSOC
+{
+public:
+    ReferenceGSOC() : nSamples(20), currentTime(0) {}
+
+    void apply(const Mat& image, Mat& fgMask)
+    {
+        const float replaceRate = 0.003f, propagationRate = 0.01f, alpha = 0.01f, beta = 0.0022f;
+        const float decay = 0.1f, multiplier = 0.1f;
+        const uint64 hitsThreshold = 32;
+        const double learningRate = 0.1;
+
+        Mat frame;
+        image.convertTo(frame, CV_32F);
+        frame /= 255;
+        const Size sz = frame.size();
+        if (samples.empty())
+        {
+            width = sz.width;
+            distMovingAvg = Mat(sz, CV_32F, Scalar::all(0.005f));
+            prevFgMask = Mat(sz, CV_8U, Scalar::all(0));
+            blinkingSupression = Mat(sz, CV_32F, Scalar::all(0.0f));
+            samples.resize(sz.area() * nSamples);
+            for (int i = 0; i < sz.height; ++i)
+                for (int j = 0; j < sz.width; ++j)
+                    for (int k = 0; k < nSamples; ++k)
+                        sample(i, j, k) = SampleGSOC(frame.at<Point3f>(i, j));
+        }
+
+        fgMask.create(sz, CV_8U);
+        for (int i = 0; i < sz.height; ++i)
+            for (int j = 0; j < sz.width; ++j)
+            {
+                const Point3f& color = frame.at<Point3f>(i, j);
+                int minK = 0;
+                float minDist = 0;
+                for (int k = 0; k < nSamples; ++k)
+                {
+                    const Point3f d = color - sample(i, j, k).color;
+                    const float dist = d.dot(d);
+                    if (k == 0 || dist < minDist)
+                    {
+                        minK = k;
+                        minDist = dist;
+                    }
+                }
+
+                float& avg = distMovingAvg.at<float>(i, j);
+                avg *= 1 - float(learningRate);
+                avg += float(learningRate) * minDist;
+
+                if (minDist > alpha * avg + beta)
+                {
+                    fgMask.at<uchar>(i, j) = 255;
+                    if (rng.uniform(0.0f, 1.0f) < replaceRate)
+                        replaceOldest(i, j, SampleGSOC(color, currentTime));
+                }
+                else
+                {
+                    SampleGSOC& s = sample(i, j, minK);
+                    s.color *= 1 - learningRate;
+                    s.color += learningRate * color;
+                    s.time = currentTime;
+                    ++s.hits;
+
+                    if (s.hits > hitsThreshold && rng.uniform(0.0f, 1.0f) < propagationRate)
+                    {
+                        if (i + 1 < sz.height)
+                            replaceOldest(i + 1, j, s);
+                        if (j + 1 < sz.width)
+                            replaceOldest(i, j + 1, s);
+                        if (i > 0)
+                            replaceOldest(i - 1, j, s);
+                        if (j > 0)
+                            replaceOldest(i, j - 1, s);
+                    }
+                    fgMask.at<uchar>(i, j) = 0;
+                }
+            }
+
+        ++currentTime;
+
+        cv::add(blinkingSupression, (fgMask != prevFgMask) / 255, blinkingSupression, cv::noArray(), CV_32F);
+        blinkingSupression *= decay;
+        fgMask.copyTo(prevFgMask);
+        Mat prob = blinkingSupression * (multiplier * (1 - decay) / decay);
+        for (int i = 0; i < sz.height; ++i)
+            for (int j = 0; j < sz.width; ++j)
+                if (rng.uniform(0.0f, 1.0f) < prob.at<float>(i, j))
+                    replaceOldest(i, j, SampleGSOC(frame.at<Point3f>(i, j), currentTime));
+
+        postprocessing(fgMask);
+    }
+
+private:
+    SampleGSOC& sample(int i, int j, int k) { return samples[(i * width + j) * nSamples + k]; }
+
+    void replaceOldest(int i, int j, const SampleGSOC& s)
+    {
+        int oldest = 0;
+        for (int k = 1; k < nSamples; ++k)
+            if (sample(i, j, k).time < sample(i, j, oldest).time)
+                oldest = k;
+        sample(i, j, oldest) = s;
+    }
+
+    const int nSamples;
+    int width;
+    std::vector<SampleGSOC> samples;
+    uint64 currentTime;
+    Mat distMovingAvg, prevFgMask, blinkingSupression;
+    RNG rng;
+};
+
+struct SampleLSBP
+{
+    Point3f color;
+    int desc;
+    float minDecisionDist;
+
+    SampleLSBP(Point3f c = Point3f(), int d = 0, float mdd = 1e9f) : color(c), desc(d), minDecisionDist(mdd) {}
+};
+
+class ReferenceLSBP
+{
+public:
+    ReferenceLSBP() : nSamples(20)
+    {
+        for (int i = 0; i < 32; ++i)
+        {
+            const double phi = i * CV_2PI / 32.0;
+            samplePoints[i] = Point2i(int(16 * std::cos(phi)), int(16 * std::sin(phi)));
+        }
+    }
+
+    void apply(const Mat& image, Mat& fgMask)
+    {
+        const float Tlower = 2.0f, Tupper = 32.0f, Tinc = 1.0f, Tdec = 0.05f, Rscale = 10.0f, Rincdec = 0.005f;
+        const int LSBPthreshold = 8, minCount = 2;
+
+        Mat frame, desc;
+        image.convertTo(frame, CV_32F, 1.0/255);
+        BackgroundSubtractorLSBPDesc::compute(desc, frame, samplePoints);
+        const Size sz = frame.size();
+        if (samples.empty())
+        {
+            width = sz.width;
+            T = Mat(sz, CV_32F, Scalar::all((Tlower + Tupper) * 0.5f));
+            R = Mat(sz, CV_32F, Scalar::all(0.1f));
+            samples.resize(sz.area() * nSamples);
+            for (int i = 0; i < sz.height; ++i)
+                for (int j = 0; j < sz.width; ++j)
+                    for (int k = 0; k < nSamples; ++k)
+                        sample(i, j, k) = SampleLSBP(frame.at<Point3f>(i, j), desc.at<int>(i, j));
+        }
+
+        fgMask.create(sz, CV_8U);
+        for (int i = 0; i < sz.height; ++i)
+            for (int j = 0; j < sz.width; ++j)
+            {
+                float DMean = 0;
+                for (int k = 0; k < nSamples; ++k)
+                    DMean += sample(i, j, k).minDecisionDist;
+                DMean /= nSamples;
+
+                float& r = R.at<float>(i, j);
+                float& t = T.at<float>(i, j);
+                if (r > DMean * Rscale)
+                    r *= 1 - Rincdec;
+                else
+                    r *= 1 + Rincdec;
+
+                const Point3f& color = frame.at<Point3f>(i, j);
+                const int d = desc.at<int>(i, j);
+                int count = 0;
+                float minDist = 1e9f;
+                for (int k = 0; k < nSamples; ++k)
+                {
+                    const Point3f diff = color - sample(i, j, k).color;
+                    const float dist = std::abs(diff.x) + std::abs(diff.y) + std::abs(diff.z);
+                    if (dist < r && popcount32(static_cast<unsigned>(d ^ sample(i, j, k).desc)) < LSBPthreshold)
+                        ++count;
+                    if (dist < minDist)
+                        minDist = dist;
+                }
+
+                if (count < minCount)
+                {
+                    fgMask.at<uchar>(i, j) = 255;
+                    t += Tinc / DMean;
+                }
+                else
+                {
+                    fgMask.at<uchar>(i, j) = 0;
+                    t -= Tdec / DMean;
+
+                    if (rng.uniform(0.0f, 1.0f) < 1 / t)
+                        sample(i, j, rng.uniform(0, nSamples)) = SampleLSBP(color, d, minDist);
+
+                    if (rng.uniform(0.0f, 1.0f) < 1 / t)
+                    {
+                        const int oi = i + rng.uniform(-1, 2);
+                        const int oj = j + rng.uniform(-1, 2);
+                        if (oi >= 0 && oi < sz.height && oj >= 0 && oj < sz.width)
+                            sample(oi, oj, rng.uniform(0, nSamples)) = SampleLSBP(frame.at<Point3f>(oi, oj), desc.at<int>(oi, oj), minDist);
+                    }
+                }
+
+                t = std::min(t, Tupper);
+                t = std::max(t, Tlower);
+            }
+
+        postprocessing(fgMask);
+    }
+
+private:
+    SampleLSBP& sample(int i, int j, int k) { return samples[(i * width + j) * nSamples + k]; }
+
+    const int nSamples;
+    int width;
+    std::vector<SampleLSBP> samples;
+    Mat T, R;
+    RNG rng;
+    Point2i samplePoints[32];
+};
+
+template<typename Reference, typename T>
+static void checkMasksMatchReference(Reference& reference, const Ptr<T>& bgs, const std::vector<Mat>& frames)
+{
+    // the library shares one random generator between the rows, so the draws only follow the
+    // reference order on a single thread
+    const int nthreads = getNumThreads();
+    setNumThreads(1);
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        SCOPED_TRACE(cv::format("frame %d", (int)i));
+        Mat expected, mask;
+        reference.apply(frames[i], expected);
+        bgs->apply(frames[i], mask);
+        checkMaskMatchesApply(expected, mask);
+    }
+    setNumThreads(nthreads);
+}
+
+// Odd widths leave a few samples and columns for the scalar tails of the vector loops
+static const Size frameSize(83, 61);
+
+TEST(BackgroundSubtractor_GSOC, MasksMatchScalarReference)
+{
+    // enough frames for samples to pass the hits threshold and propagate
+    std::vector<Mat> frames = generateFrames(60, frameSize);
+    Ptr<BackgroundSubtractorGSOC> gsoc = createBackgroundSubtractorGSOC();
+    ReferenceGSOC reference;
+    checkMasksMatchReference(reference, gsoc, frames);
+
+    // one struct of 32 bytes per sample before, 24 bytes in separate arrays now
+    EXPECT_EQ((size_t)24 * 20 * frameSize.area(), gsoc->getModelMemorySize());
+}
+
+TEST(BackgroundSubtractor_LSBP, MasksMatchScalarReference)
+{
+    std::vector<Mat> frames = generateFrames(30, frameSize);
+    Ptr<BackgroundSubtractorLSBP> lsbp = createBackgroundSubtractorLSBP();
+    ReferenceLSBP reference;
+    checkMasksMatchReference(reference, lsbp, frames);
+
+    EXPECT_EQ((size_t)20 * 20 * frameSize.area(), lsbp->getModelMemorySize());
+}
+
+TEST(BackgroundSubtractor_LSBP, DescriptorMatchesScalarReference)
+{
+    std::vector<Mat> frames = generateFrames(1, frameSize);
+    Mat frame, lsv, desc;
+    frames[0].convertTo(frame, CV_32F, 1.0/255);
+    BackgroundSubtractorLSBPDesc::calcLocalSVDValues(lsv, frame);
+
+    Point2i samplePoints[32];
+    for (int i = 0; i < 32; ++i)
+    {
+        const double phi = i * CV_2PI / 32.0;
+        samplePoints[i] = Point2i(int(16 * std::cos(phi)), int(16 * std::sin(phi)));
+    }
+    BackgroundSubtractorLSBPDesc::computeFromLocalSVDValues(desc, lsv, samplePoints);
+    ASSERT_EQ(CV_32SC1, desc.type());
+
+    for (int i = 0; i < lsv.rows; ++i)
+        for (int j = 0; j < lsv.cols; ++j)
+        {
+            int expected = 0;
+            const float center = lsv.at<float>(i, j);
+            for (int n = 0; n < 32; ++n)
+            {
+                const int ri = i + samplePoints[n].y, rj = j + samplePoints[n].x;
+                if (ri >= 0 && rj >= 0 && ri < lsv.rows && rj < lsv.cols && std::abs(lsv.at<float>(ri, rj) - center) > 0.05f)
+                    expected |= int(1U) << n;
+            }
+            ASSERT_EQ(expected, desc.at<int>(i, j)) << "i=" << i << " j=" << j;
+        }
+}
+
+}} // namespace
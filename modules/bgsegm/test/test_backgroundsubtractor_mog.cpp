@@ -0,0 +1,48 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+typedef testing::TestWithParam<int> BackgroundSubtractor_MOG_Batch;
+
+TEST_P(BackgroundSubtractor_MOG_Batch, MatchesSequentialApply)
+{
+    const int cn = GetParam();
+    const int nstreams = 3, nframes = 30;
+
+    // 123 columns leave 3 pixels of every row after the 4 pixel SIMD steps of update and classification
+    std::vector<std::vector<Mat> > streams;
+    std::vector<Ptr<BackgroundSubtractorMOG> > single, batched;
+    for (int i = 0; i < nstreams; ++i)
+    {
+        streams.push_back(generateFrames(nframes, Size(123, 97), cn));
+        single.push_back(createBackgroundSubtractorMOG());
+        batched.push_back(createBackgroundSubtractorMOG());
+    }
+
+    for (int frameNum = 0; frameNum < nframes; ++frameNum)
+    {
+        std::vector<Mat> frames(nstreams), masks;
+        for (int i = 0; i < nstreams; ++i)
+            frames[i] = streams[i][frameNum];
+
+        // a few frames only classify the pixels without updating the models
+        double learningRate = frameNum % 10 == 9 ? 0 : -1;
+        applyMOGBatch(batched, frames, masks, learningRate);
+        ASSERT_EQ((size_t)nstreams, masks.size());
+
+        for (int i = 0; i < nstreams; ++i)
+        {
+            SCOPED_TRACE(cv::format("stream %d, frame %d", i, frameNum));
+            Mat mask;
+            single[i]->apply(frames[i], mask, learningRate);
+            checkMaskMatchesApply(mask, masks[i]);
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, BackgroundSubtractor_MOG_Batch, testing::Values(1, 3));
+
+}} // namespace
@@ -0,0 +1,62 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#ifndef __OPENCV_BGSEGM_TEST_COMMON_HPP__
+#define __OPENCV_BGSEGM_TEST_COMMON_HPP__
+
+namespace opencv_test {
+
+// Frames of a synthetic sequence: an object moving over a random background
+static inline std::vector<Mat> generateFrames(int n, Size size, int cn = 3)
+{
+    RNG& rng = theRNG();
+    Mat background(size, CV_8UC3), object(size.height / 4, size.height / 4, CV_8UC3);
+    rng.fill(background, RNG::UNIFORM, 0, 256);
+    rng.fill(object, RNG::UNIFORM, 0, 256);
+    Ptr<SyntheticSequenceGenerator> generator = createSyntheticSequenceGenerator(background, object);
+
+    std::vector<Mat> frames(n);
+    for (int i = 0; i < n; ++i)
+    {
+        Mat gtMask;
+        generator->getNextFrame(frames[i], gtMask);
+        if (cn == 1)
+            cvtColor(frames[i], frames[i], COLOR_BGR2GRAY);
+    }
+    return frames;
+}
+
+// Checks a mask computed together with other frames against the one of a sequential apply()
+static inline void checkMaskMatchesApply(const Mat& mask, const Mat& batchMask)
+{
+    ASSERT_EQ(CV_8UC1, batchMask.type());
+    EXPECT_EQ(0, cvtest::norm(mask, batchMask, NORM_INF));
+}
+
+// Feeds the frames to applyBatch (applyGMGBatch or applyCNTBatch) in batches of batchSize
+// and to apply() one by one
+template<typename T>
+static void checkBatchMatchesApply(const Ptr<T>& single, const Ptr<T>& batched,
+                                   void (*applyBatch)(const Ptr<T>&, const std::vector<Mat>&, std::vector<Mat>&, double),
+                                   const std::vector<Mat>& frames, int batchSize)
+{
+    for (size_t start = 0; start < frames.size(); start += batchSize)
+    {
+        std::vector<Mat> batch(frames.begin() + start, frames.begin() + std::min(frames.size(), start + batchSize));
+        std::vector<Mat> masks;
+        applyBatch(batched, batch, masks, -1);
+        ASSERT_EQ(batch.size(), masks.size());
+
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            SCOPED_TRACE(cv::format("frame %d", (int)(start + i)));
+            Mat mask;
+            single->apply(batch[i], mask);
+            checkMaskMatchesApply(mask, masks[i]);
+        }
+    }
+}
+
+} // namespace
+
+#endif
@@ -13,4 +13,6 @@ namespace opencv_test {
 using namespace cv::bgsegm;
 }
 
+#include "test_common.hpp"
+
 #endif
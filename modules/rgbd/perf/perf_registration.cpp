@@ -0,0 +1,63 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html
+
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+/** A synthetic 16U depth image in millimeters: a slanted plane with a few boxes in front of it. */
+static Mat makeDepth(Size size)
+{
+    Mat_<unsigned short> depth(size);
+    for (int y = 0; y < size.height; y++)
+        for (int x = 0; x < size.width; x++)
+            depth(y, x) = (unsigned short)(1500 + x + y / 2);
+    for (int k = 0; k < 8; k++)
+    {
+        Rect box(size.width * k / 8, size.height / 4, size.width / 16, size.height / 2);
+        depth(box).setTo(800 + 50 * k);
+    }
+    depth(Rect(0, 0, size.width / 10, size.height / 10)).setTo(0);
+    return depth;
+}
+
+typedef tuple<bool, bool> RegistrationParams;
+typedef TestBaseWithParam<RegistrationParams> Perf_RegisterDepth;
+
+PERF_TEST_P_(Perf_RegisterDepth, vga_to_4k)
+{
+    const bool withDistortion = get<0>(GetParam());
+    const bool depthDilation = get<1>(GetParam());
+
+    Matx33f depthIntrinsics(525.f, 0, 319.5f, 0, 525.f, 239.5f, 0, 0, 1);
+    Matx33f colorIntrinsics(2950.f, 0, 1919.5f, 0, 2950.f, 1079.5f, 0, 0, 1);
+    Mat distCoeffs = Mat::zeros(1, 5, CV_32F);
+    if (withDistortion)
+        distCoeffs = (Mat_<float>(1, 5) << 0.1f, -0.05f, 0.001f, 0.001f, 0.f);
+    Matx44f rt = Matx44f::eye();
+    rt(0, 3) = 0.025f;
+
+    Mat depth = makeDepth(Size(640, 480));
+    Mat registeredDepth;
+
+    TEST_CYCLE() registerDepth(depthIntrinsics, colorIntrinsics, distCoeffs, rt, depth, Size(3840, 2160),
+                               registeredDepth, depthDilation);
+
+    SANITY_CHECK_NOTHING();
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, Perf_RegisterDepth, ::testing::Combine(::testing::Bool(), ::testing::Bool()));
+
+PERF_TEST(Perf_DepthCleaner, vga)
+{
+    Mat depth = makeDepth(Size(640, 480));
+    DepthCleaner cleaner(CV_16U, 5);
+    Mat cleaned;
+
+    TEST_CYCLE() cleaner(depth, cleaned);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
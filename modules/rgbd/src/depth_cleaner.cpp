@@ -115,51 +115,80 @@ namespace rgbd
 
       // Precompute some data
       const ContainerDepth sigma_L = (float)(0.8 + 0.035 * theta_mean / (CV_PI / 2 - theta_mean));
-      Mat_<ContainerDepth> sigma_z(rows, cols);
-      for (int y = 0; y < rows; ++y)
-        for (int x = 0; x < cols; ++x)
-          sigma_z(y, x) = (float)(0.0012 + 0.0019 * (depth_in(y, x) * scale - 0.4) * (depth_in(y, x) * scale - 0.4));
+      const ContainerDepth difference_threshold = 10;
 
-      ContainerDepth difference_threshold = 10;
-      Mat_<ContainerDepth> Dw_sum = Mat_<ContainerDepth>::zeros(rows, cols), w_sum =
-          Mat_<ContainerDepth>::zeros(rows, cols);
-      for (int y = 0; y < rows - 1; ++y)
+      // Every pixel of [0, rows - 1) x [1, cols - 1) is blended with itself and with the neighbors at the
+      // following offsets, and these neighbors are blended with it. The weight of a contribution only depends
+      // on the pixel receiving it, so both directions are gathered at the receiving pixel and rows are
+      // independent.
+      const int n_offsets = 5;
+      const int offset_y[n_offsets] = { 0, 0, 1, 1, 1 };
+      const int offset_x[n_offsets] = { 0, 1, -1, 0, 1 };
+      ContainerDepth spatial_term[n_offsets];
+      for (int k = 0; k < n_offsets; ++k)
       {
-        // Every pixel has had the contribution of previous pixels (in a row-major way)
-        for (int x = 1; x < cols - 1; ++x)
+        ContainerDepth delta_u = sqrt(ContainerDepth(offset_y[k] * offset_y[k] + offset_x[k] * offset_x[k]));
+        spatial_term[k] = -delta_u * delta_u / 2 / sigma_L / sigma_L;
+      }
+
+      Mat_<ContainerDepth> result(rows, cols);
+      parallel_for_(Range(0, rows), [&](const Range& range)
+      {
+        for (int y = range.start; y < range.end; ++y)
         {
-          for (int j = 0; j <= 1; ++j)
-            for (int i = -1; i <= 1; ++i)
+          ContainerDepth * result_row = result[y];
+          for (int x = 0; x < cols; ++x)
+          {
+            const DepthDepth depth = depth_in(y, x);
+            const ContainerDepth sigma_z = (float)(0.0012 + 0.0019 * (depth * scale - 0.4) * (depth * scale - 0.4));
+            const bool is_source = (y < rows - 1) && (x >= 1) && (x < cols - 1);
+            ContainerDepth w_sum = 0, Dw_sum = 0;
+
+            for (int k = 0; k < n_offsets; ++k)
             {
-              if ((j == 0) && (i == -1))
-                continue;
-              ContainerDepth delta_u = sqrt(
-                  ContainerDepth(j) * ContainerDepth(j) + ContainerDepth(i) * ContainerDepth(i));
-              ContainerDepth delta_z;
-              if (depth_in(y, x) > depth_in(y + j, x + i))
-                delta_z = (float)(depth_in(y, x) - depth_in(y + j, x + i));
-              else
-                delta_z = (float)(depth_in(y + j, x + i) - depth_in(y, x));
-              if (delta_z < difference_threshold)
+              for (int direction = 0; direction < 2; ++direction)
               {
-                delta_z *= scale;
-                ContainerDepth w = exp(
-                    -delta_u * delta_u / 2 / sigma_L / sigma_L - delta_z * delta_z / 2 / sigma_z(y, x) / sigma_z(y, x));
-                w_sum(y, x) += w;
-                Dw_sum(y, x) += depth_in(y + j, x + i) * w;
-                if ((j != 0) || (i != 0))
+                int yy, xx;
+                if (direction == 0)
+                {
+                  // Contribution of the neighbor after this pixel, if this pixel is a source
+                  if (!is_source)
+                    continue;
+                  yy = y + offset_y[k];
+                  xx = x + offset_x[k];
+                }
+                else
                 {
-                  w = exp(
-                      -delta_u * delta_u / 2 / sigma_L / sigma_L - delta_z * delta_z / 2 / sigma_z(y + j, x + i)
-                                                                   / sigma_z(y + j, x + i));
-                  w_sum(y + j, x + i) += w;
-                  Dw_sum(y + j, x + i) += depth_in(y, x) * w;
+                  // Contribution of the source before this pixel (the pixel itself was counted above)
+                  if (k == 0)
+                    continue;
+                  yy = y - offset_y[k];
+                  xx = x - offset_x[k];
+                  if ((yy < 0) || (yy >= rows - 1) || (xx < 1) || (xx >= cols - 1))
+                    continue;
+                }
+
+                const DepthDepth neighbor = depth_in(yy, xx);
+                ContainerDepth delta_z;
+                if (depth > neighbor)
+                  delta_z = (float)(depth - neighbor);
+                else
+                  delta_z = (float)(neighbor - depth);
+                if (delta_z < difference_threshold)
+                {
+                  delta_z *= scale;
+                  ContainerDepth w = exp(spatial_term[k] - delta_z * delta_z / 2 / sigma_z / sigma_z);
+                  w_sum += w;
+                  Dw_sum += neighbor * w;
                 }
               }
             }
+            // Same convention as cv::divide for the pixels that did not get any contribution
+            result_row[x] = (w_sum != 0) ? Dw_sum / w_sum : 0;
+          }
         }
-      }
-      Mat(Dw_sum / w_sum).copyTo(depth_out);
+      });
+      result.copyTo(depth_out);
     }
   };
 
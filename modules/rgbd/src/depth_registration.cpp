@@ -6,6 +6,8 @@
 
 #include "precomp.hpp"
 
+#include <atomic>
+
 namespace cv
 {
 namespace rgbd
@@ -79,6 +81,36 @@ namespace rgbd
         return (unsigned short)(value+0.5);
     }
 
+ ///////////////////////////////////////////////////////////////////////////////////
+
+    // The z-buffer is shared by all the threads projecting points. Depths are stored as ints that order
+    // like the floats they come from, so that the occlusion check is an atomic min.
+    static const int noDepthKey = std::numeric_limits<int>::max();
+
+    static inline int
+    depthToKey(float depth)
+    {
+        Cv32suf u;
+        u.f = depth;
+        return u.i >= 0 ? u.i : u.i ^ std::numeric_limits<int>::max();
+    }
+
+    static inline float
+    keyToDepth(int key)
+    {
+        Cv32suf u;
+        u.i = key >= 0 ? key : key ^ std::numeric_limits<int>::max();
+        return u.f;
+    }
+
+    static inline void
+    updateDepthKey(std::atomic<int> &target, int key)
+    {
+        int current = target.load(std::memory_order_relaxed);
+        while (key < current && !target.compare_exchange_weak(current, key, std::memory_order_relaxed))
+            ;
+    }
+
  ///////////////////////////////////////////////////////////////////////////////////
 
 
@@ -107,8 +139,8 @@ namespace rgbd
                         Mat &registeredDepth)
     {
 
-        // Create output Mat of the correct type, filled with an initial value indicating no depth
-        registeredDepth = Mat_<DepthDepth>(outputImagePlaneSize, noDepthSentinelValue<DepthDepth>());
+        // Create output Mat of the correct type
+        registeredDepth.create(outputImagePlaneSize, DataType<DepthDepth>::type);
 
         // Figure out whether we'll have to apply a distortion
         bool hasDistortion = (countNonZero(registeredDistCoeffs) > 0);
@@ -143,19 +175,39 @@ namespace rgbd
             initialProjection = initialProjection * rbtRgb2Depth * K.inv();
         }
 
-        // Apply the initial projection to the input depth
-        Mat_<Point3f> transformedCloud;
+        // The z-buffer, in meters
+        const int nOutputPixels = outputImagePlaneSize.area();
+        std::vector<std::atomic<int> > zBuffer(nOutputPixels);
+        parallel_for_(Range(0, nOutputPixels), [&](const Range& range)
         {
-            Mat_<Point3f> point_tmp(outputImagePlaneSize,Point3f(0.,0.,0.));
+            for (int k = range.start; k < range.end; ++k)
+                zBuffer[k].store(noDepthKey, std::memory_order_relaxed);
+        });
+
+        const Rect registeredDepthBounds(Point(), outputImagePlaneSize);
+        const int cols = unregisteredDepth.cols;
 
-            for(int j = 0; j < unregisteredDepth.rows; ++j)
+        // Every row of the input is transformed, projected and splatted into the z-buffer independently
+        parallel_for_(Range(0, unregisteredDepth.rows), [&](const Range& range)
+        {
+            // Per-thread row buffers: depth in meters, projected location and depth in the external camera
+            std::vector<float> rowDepth(cols), projectedX(cols), projectedY(cols), projectedDepth(cols);
+            std::vector<Point3f> rowCloud(hasDistortion ? cols : 0);
+            std::vector<Point2f> rowProjected(hasDistortion ? cols : 0);
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+            // Lane ramp 0, 1, 2, ... added to the column index of a vector
+            float laneIndex[VTraits<v_float32>::max_nlanes];
+            for (int l = 0; l < VTraits<v_float32>::vlanes(); ++l)
+                laneIndex[l] = (float)l;
+            const v_float32 vLaneIndex = vx_load(laneIndex);
+#endif
+
+            for (int j = range.start; j < range.end; ++j)
             {
                 const DepthDepth *unregisteredDepthPtr = unregisteredDepth[j];
-
-                Point3f *point = point_tmp[j];
-                for(int i = 0; i < unregisteredDepth.cols; ++i, ++unregisteredDepthPtr, ++point)
+                for (int i = 0; i < cols; ++i)
                 {
-                    float rescaled_depth = float(*unregisteredDepthPtr) * inputDepthToMetersScale;
+                    float rescaled_depth = float(unregisteredDepthPtr[i]) * inputDepthToMetersScale;
 
                     // If the DepthDepth is of type unsigned short, zero is a sentinel value to indicate
                     // no depth. CV_32F and CV_64F should already have NaN for no depth values.
@@ -163,113 +215,147 @@ namespace rgbd
                     {
                         rescaled_depth = std::numeric_limits<float>::quiet_NaN();
                     }
-
-                    point->x = i * rescaled_depth;
-                    point->y = j * rescaled_depth;
-                    point->z = rescaled_depth;
+                    rowDepth[i] = rescaled_depth;
                 }
-            }
-
-            perspectiveTransform(point_tmp, transformedCloud, initialProjection);
-        }
-
-        std::vector<Point2f> transformedAndProjectedPoints(transformedCloud.cols);
-        const float metersToInputUnitsScale = 1/inputDepthToMetersScale;
-        const Rect registeredDepthBounds(Point(), outputImagePlaneSize);
 
-        for( int y = 0; y < transformedCloud.rows; y++ )
-        {
-            if (hasDistortion)
-            {
-
-                // Project an entire row of points with distortion.
-                // Doing this for the entire image at once would require more memory.
-                projectPoints(transformedCloud.row(y),
-                              Vec3f(0,0,0),
-                              Vec3f(0,0,0),
-                              registeredCameraMatrix,
-                              registeredDistCoeffs,
-                              transformedAndProjectedPoints);
-
-            }
-            else
-            {
-
-                // With no distortion, we just have to dehomogenize the point since all major transforms
-                // already happened with initialProjection.
-                Point2f *point2d = &transformedAndProjectedPoints[0];
-                const Point2f *point2d_end = point2d + transformedAndProjectedPoints.size();
-                const Point3f *point3d = transformedCloud[y];
-                for( ; point2d < point2d_end; ++point2d, ++point3d )
+                // Apply the initial projection to the point (i * z, j * z, z, 1): every coordinate is
+                // z * (P(r, 0) * i + P(r, 1) * j + P(r, 2)) + P(r, 3)
+                const Matx44f &P = initialProjection;
+                float b[4], c[4];
+                for (int r = 0; r < 4; ++r)
                 {
-                    point2d->x = point3d->x / point3d->z;
-                    point2d->y = point3d->y / point3d->z;
+                    b[r] = P(r, 1) * j + P(r, 2);
+                    c[r] = P(r, 3);
                 }
 
-            }
+                int i = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                if (!hasDistortion)
+                {
+                    const int vlanes = VTraits<v_float32>::vlanes();
+                    const v_float32 a0 = vx_setall_f32(P(0, 0)), a1 = vx_setall_f32(P(1, 0));
+                    const v_float32 a2 = vx_setall_f32(P(2, 0)), a3 = vx_setall_f32(P(3, 0));
+                    const v_float32 b0 = vx_setall_f32(b[0]), b1 = vx_setall_f32(b[1]);
+                    const v_float32 b2 = vx_setall_f32(b[2]), b3 = vx_setall_f32(b[3]);
+                    const v_float32 c0 = vx_setall_f32(c[0]), c1 = vx_setall_f32(c[1]);
+                    const v_float32 c2 = vx_setall_f32(c[2]), c3 = vx_setall_f32(c[3]);
+                    for (; i <= cols - vlanes; i += vlanes)
+                    {
+                        v_float32 vi = v_add(vx_setall_f32((float)i), vLaneIndex);
+                        v_float32 z = vx_load(&rowDepth[i]);
+                        v_float32 x = v_fma(z, v_fma(vi, a0, b0), c0);
+                        v_float32 y = v_fma(z, v_fma(vi, a1, b1), c1);
+                        v_float32 zz = v_fma(z, v_fma(vi, a2, b2), c2);
+                        v_float32 w = v_fma(z, v_fma(vi, a3, b3), c3);
+                        // With no distortion, we just have to dehomogenize the point since all major
+                        // transforms already happened with initialProjection.
+                        v_store(&projectedX[i], v_div(x, zz));
+                        v_store(&projectedY[i], v_div(y, zz));
+                        v_store(&projectedDepth[i], v_div(zz, w));
+                    }
+                }
+#endif
+                for (; i < cols; ++i)
+                {
+                    float z = rowDepth[i];
+                    float x = z * (P(0, 0) * i + b[0]) + c[0];
+                    float y = z * (P(1, 0) * i + b[1]) + c[1];
+                    float zz = z * (P(2, 0) * i + b[2]) + c[2];
+                    float w = z * (P(3, 0) * i + b[3]) + c[3];
+                    if (hasDistortion)
+                    {
+                        rowCloud[i] = Point3f(x / w, y / w, zz / w);
+                    }
+                    else
+                    {
+                        projectedX[i] = x / zz;
+                        projectedY[i] = y / zz;
+                    }
+                    projectedDepth[i] = zz / w;
+                }
 
-            const Point2f *outputProjectedPoint = &transformedAndProjectedPoints[0];
-            const Point3f *p = transformedCloud[y], *p_end = p + transformedCloud.cols;
+                if (hasDistortion)
+                {
+                    // Project the entire row of points with distortion.
+                    projectPoints(rowCloud,
+                                  Vec3f(0,0,0),
+                                  Vec3f(0,0,0),
+                                  registeredCameraMatrix,
+                                  registeredDistCoeffs,
+                                  rowProjected);
+                    for (i = 0; i < cols; ++i)
+                    {
+                        projectedX[i] = rowProjected[i].x;
+                        projectedY[i] = rowProjected[i].y;
+                    }
+                }
 
+                for (i = 0; i < cols; ++i)
+                {
+                    // Skip this one if there isn't a valid depth
+                    const Point2f projectedPixelFloatLocation(projectedX[i], projectedY[i]);
+                    if (cvIsNaN(projectedPixelFloatLocation.x))
+                        continue;
 
-            for( ; p < p_end; ++outputProjectedPoint, ++p )
-            {
+                    //Get integer pixel location
+                    const Point2i projectedPixelLocation = projectedPixelFloatLocation;
 
+                    // Ensure that the projected point is actually contained in our output image
+                    if (!registeredDepthBounds.contains(projectedPixelLocation))
+                        continue;
 
+                    // Occlusion check
+                    const int cloudDepthKey = depthToKey(projectedDepth[i]);
+                    updateDepthKey(zBuffer[projectedPixelLocation.y * outputImagePlaneSize.width + projectedPixelLocation.x],
+                                   cloudDepthKey);
 
-                // Skip this one if there isn't a valid depth
-                const Point2f projectedPixelFloatLocation = *outputProjectedPoint;
-                if (cvIsNaN(projectedPixelFloatLocation.x))
-                    continue;
+                    // If desired, dilate this point to avoid holes in the final image
+                    if (depthDilation)
+                    {
 
-                //Get integer pixel location
-                const Point2i projectedPixelLocation = projectedPixelFloatLocation;
+                        // Choosing to dilate in a 2x2 region, where the original projected location is in the bottom right of this
+                        // region. This is what's done on PrimeSense devices, but a more accurate scheme could be used.
+                        const Point2i dilatedProjectedLocations[3] = {Point2i(projectedPixelLocation.x - 1, projectedPixelLocation.y    ),
+                                                                      Point2i(projectedPixelLocation.x    , projectedPixelLocation.y - 1),
+                                                                      Point2i(projectedPixelLocation.x - 1, projectedPixelLocation.y - 1)};
 
-                // Ensure that the projected point is actually contained in our output image
-                if (!registeredDepthBounds.contains(projectedPixelLocation))
-                    continue;
+                        for (int d = 0; d < 3; d++) {
 
-                // Go back to our original scale, since that's what our output will be
-                // The templated function is to ensure that integer values are rounded to the nearest integer
-                const DepthDepth cloudDepth = floatToInputDepth<DepthDepth>(p->z*metersToInputUnitsScale);
+                            const Point2i& dilatedCoordinates = dilatedProjectedLocations[d];
 
-                DepthDepth& outputDepth = registeredDepth.at<DepthDepth>(projectedPixelLocation.y, projectedPixelLocation.x);
+                            if (!registeredDepthBounds.contains(dilatedCoordinates))
+                                continue;
 
+                            // Occlusion check
+                            updateDepthKey(zBuffer[dilatedCoordinates.y * outputImagePlaneSize.width + dilatedCoordinates.x],
+                                           cloudDepthKey);
+                        }
 
-                // Occlusion check
-                if ( isEqualToNoDepthSentinelValue<DepthDepth>(outputDepth) || (outputDepth > cloudDepth) )
-                    outputDepth = cloudDepth;
+                    } // depthDilation
 
+                } // iterate cols
+            } // iterate rows
+        });
 
-                // If desired, dilate this point to avoid holes in the final image
-                if (depthDilation)
+        // Go back to our original scale, since that's what our output will be
+        // The templated function is to ensure that integer values are rounded to the nearest integer
+        const float metersToInputUnitsScale = 1/inputDepthToMetersScale;
+        parallel_for_(Range(0, outputImagePlaneSize.height), [&](const Range& range)
+        {
+            for (int y = range.start; y < range.end; ++y)
+            {
+                DepthDepth *outputDepth = registeredDepth.ptr<DepthDepth>(y);
+                const std::atomic<int> *key = &zBuffer[y * outputImagePlaneSize.width];
+                for (int x = 0; x < outputImagePlaneSize.width; ++x)
                 {
-
-                    // Choosing to dilate in a 2x2 region, where the original projected location is in the bottom right of this
-                    // region. This is what's done on PrimeSense devices, but a more accurate scheme could be used.
-                    const Point2i dilatedProjectedLocations[3] = {Point2i(projectedPixelLocation.x - 1, projectedPixelLocation.y    ),
-                                                                  Point2i(projectedPixelLocation.x    , projectedPixelLocation.y - 1),
-                                                                  Point2i(projectedPixelLocation.x - 1, projectedPixelLocation.y - 1)};
-
-                    for (int i = 0; i < 3; i++) {
-
-                        const Point2i& dilatedCoordinates = dilatedProjectedLocations[i];
-
-                        if (!registeredDepthBounds.contains(dilatedCoordinates))
-                            continue;
-
-                        DepthDepth& outputDilatedDepth = registeredDepth.at<DepthDepth>(dilatedCoordinates.y, dilatedCoordinates.x);
-
-                        // Occlusion check
-                        if ( isEqualToNoDepthSentinelValue(outputDilatedDepth) || (outputDilatedDepth > cloudDepth) )
-                            outputDilatedDepth = cloudDepth;
-
-                    }
-
-                } // depthDilation
-
-            } // iterate cols
-        } // iterate rows
+                    int k = key[x].load(std::memory_order_relaxed);
+                    if (k == noDepthKey)
+                        outputDepth[x] = noDepthSentinelValue<DepthDepth>();
+                    else
+                        outputDepth[x] = floatToInputDepth<DepthDepth>(keyToDepth(k)*metersToInputUnitsScale);
+                }
+            }
+        });
     }
 
 
@@ -57,6 +57,11 @@ public:
     // Consist of Voxel elements
     Mat volume;
 
+    // Number of warp field nodes already taken into account in the voxel neighbour lists.
+    // Nodes are only ever appended to the warp field, so the lists only need to be updated
+    // with the nodes added since the last integration.
+    size_t nodesIndexed;
+
 private:
     Point3f interpolate(Point3f p1, Point3f p2, float v1, float v2) const;
 };
@@ -112,7 +117,8 @@ TSDFVolume::TSDFVolume(Point3i _res, float _voxelSize, Affine3f _pose, float _tr
 // dimension in voxels, size in meters
 TSDFVolumeCPU::TSDFVolumeCPU(Point3i _res, float _voxelSize, cv::Affine3f _pose, float _truncDist, int _maxWeight,
                              float _raycastStepFactor, bool zFirstMemOrder) :
-    TSDFVolume(_res, _voxelSize, _pose, _truncDist, _maxWeight, _raycastStepFactor, zFirstMemOrder)
+    TSDFVolume(_res, _voxelSize, _pose, _truncDist, _maxWeight, _raycastStepFactor, zFirstMemOrder),
+    nodesIndexed(0)
 {
     volume = Mat(1, volResolution.x * volResolution.y * volResolution.z, rawType<Voxel>());
 
@@ -127,8 +133,9 @@ void TSDFVolumeCPU::reset()
     volume.forEach<VecT>([](VecT& vv, const int* /* position */)
     {
         Voxel& v = reinterpret_cast<Voxel&>(vv);
-        v.v = 0; v.weight = 0;
+        v.v = 0; v.weight = 0; v.n = 0;
     });
+    nodesIndexed = 0;
 }
 
 static const bool fixMissingData = false;
@@ -217,9 +224,37 @@ struct IntegrateInvoker : ParallelLoopBody
         vol2cam(cameraPose.inv() * _volume.pose),
         truncDistInv(1.f/_volume.truncDist),
         dfac(1.f/depthFactor),
-        warpfield(wf)
+        warpfield(wf),
+        firstNewNode((int)_volume.nodesIndexed)
     {
         volDataStart = volume.volume.ptr<Voxel>();
+
+        const NodeVectorType& nodes = warpfield->getNodes();
+        for(size_t i = volume.nodesIndexed; i < nodes.size(); i++)
+            newNodesPos.push_back(nodes[i]->pos);
+    }
+
+    // Merge the nodes added since the last integration into the sorted k-nearest list of the voxel.
+    // Distances are squared, like the ones of the flann L2_Simple index used before.
+    inline void updateNeighbours(Voxel& voxel, Point3f volPt) const
+    {
+        const int k = warpfield->k;
+        for(int j = 0; j < (int)newNodesPos.size(); j++)
+        {
+            Point3f diff = newNodesPos[j] - volPt;
+            float dist = diff.dot(diff);
+            if(voxel.n == k && dist >= voxel.neighbourDists[k-1])
+                continue;
+
+            int pos = (voxel.n < k) ? voxel.n++ : k-1;
+            for(; pos > 0 && voxel.neighbourDists[pos-1] > dist; pos--)
+            {
+                voxel.neighbourDists[pos] = voxel.neighbourDists[pos-1];
+                voxel.neighbours[pos] = voxel.neighbours[pos-1];
+            }
+            voxel.neighbourDists[pos] = dist;
+            voxel.neighbours[pos] = firstNewNode + j;
+        }
     }
 
     virtual void operator() (const Range& range) const override
@@ -239,21 +274,8 @@ struct IntegrateInvoker : ParallelLoopBody
 
                     Point3f volPt = Point3f((float)x, (float)y, (float)z)*volume.voxelSize;
 
-                    if(warpfield->getNodeIndex())
-                    {
-                        std::vector<int> indices(warpfield->k);
-                        std::vector<float> dists(warpfield->k);
-                        warpfield->findNeighbours(volPt, indices, dists);
-
-                        voxel.n = 0;
-                        for(size_t i = 0; i < indices.size(); i++)
-                        {
-                            if(std::isnan(dists[i])) continue;
-
-                            voxel.neighbourDists[voxel.n] = dists[i];
-                            voxel.neighbours[voxel.n++] = indices[i];
-                        }
-                    }
+                    if(!newNodesPos.empty())
+                        updateNeighbours(voxel, volPt);
 
                     Point3f camSpacePt =
                     vol2cam * warpfield->applyWarp(volPt, voxel.neighbours, voxel.n);
@@ -314,6 +336,8 @@ struct IntegrateInvoker : ParallelLoopBody
     const float dfac;
     Voxel* volDataStart;
     Ptr<WarpField> warpfield;
+    const int firstNewNode;
+    std::vector<Point3f> newNodesPos;
 };
 
 // use depth instead of distance (optimization)
@@ -327,6 +351,8 @@ void TSDFVolumeCPU::integrate(InputArray _depth, float depthFactor, cv::Affine3f
     IntegrateInvoker ii(*this, depth, intrinsics, cameraPose, depthFactor, wf);
     Range range(0, volResolution.x);
     parallel_for_(range, ii);
+
+    nodesIndexed = wf->getNodesLen();
 }
 
 inline volumeType TSDFVolumeCPU::interpolateVoxel(Point3f p) const
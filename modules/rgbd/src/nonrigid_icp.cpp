@@ -173,8 +173,6 @@ bool ICPImpl::estimateWarpNodes(WarpField& currentWarp, const Affine3f &pose,
         }
     }
 
-    Mat_<float> J_reg(6*numEdges, 6*totalNodes, 0.f);
-
     std::cout << "Total reg energy: " << RegEnergy << ", Average: " << RegEnergy/numEdges << std::endl;
 
     float reg_med = median(reg_residuals);
@@ -283,80 +281,92 @@ bool ICPImpl::estimateWarpNodes(WarpField& currentWarp, const Affine3f &pose,
         }
     }
 
-    std::vector<float> residuals;
-
     Mat Vg(oldPoints.size(), CV_32FC3, nan3);
 
     Mat Vc(oldPoints.size(), CV_32FC3, nan3);
     Mat Nc(oldPoints.size(), CV_32FC3, nan3);
+    // point-to-plane residual of every accepted correspondence, NaN elsewhere
+    Mat_<float> Rd(oldPoints.size(), std::numeric_limits<float>::quiet_NaN());
     cv::kinfu::Intr::Projector proj = intrinsics.makeProjector();
 
-    for (int y = 0; y < oldPoints.size().height; y++)
+    // Correspondences are found independently for every pixel
+    parallel_for_(Range(0, oldPoints.rows), [&](const Range& range)
     {
-        for (int x = 0; x < oldPoints.size().width; x++)
+        for (int y = range.start; y < range.end; y++)
         {
-            // Obtain correspondence by projecting Tu_Vg
-            Vec3f curV = oldPoints.at<Vec3f>(y, x);
-            if (curV == Vec3f::all(0) || cvIsNaN(curV[0]) || cvIsNaN(curV[1]) || cvIsNaN(curV[2]))
-                continue;
-
-            Point2f newCoords = proj(oldPoints.at<Point3f>(y, x));
-            if(!(newCoords.x >= 0 && newCoords.x < newPoints.cols - 1 &&
-                 newCoords.y >= 0 && newCoords.y < newPoints.rows - 1))
-                continue;
-
-            // TODO: interpolate Vg instead of simply converting projected coords to int
-            Vg.at<Vec3f>(y, x) = vertImage.at<Vec3f>((int)newCoords.y, (int)newCoords.x);
+            for (int x = 0; x < oldPoints.size().width; x++)
+            {
+                // Obtain correspondence by projecting Tu_Vg
+                Vec3f curV = oldPoints.at<Vec3f>(y, x);
+                if (curV == Vec3f::all(0) || cvIsNaN(curV[0]) || cvIsNaN(curV[1]) || cvIsNaN(curV[2]))
+                    continue;
 
-            // bilinearly interpolate newPoints under newCoords point
-            int xi = cvFloor(newCoords.x), yi = cvFloor(newCoords.y);
-            float tx  = newCoords.x - xi, ty = newCoords.y - yi;
+                Point2f newCoords = proj(oldPoints.at<Point3f>(y, x));
+                if(!(newCoords.x >= 0 && newCoords.x < newPoints.cols - 1 &&
+                     newCoords.y >= 0 && newCoords.y < newPoints.rows - 1))
+                    continue;
 
-            const ptype* prow0 = newPoints.ptr<ptype>(yi+0);
-            const ptype* prow1 = newPoints.ptr<ptype>(yi+1);
+                // TODO: interpolate Vg instead of simply converting projected coords to int
+                Vg.at<Vec3f>(y, x) = vertImage.at<Vec3f>((int)newCoords.y, (int)newCoords.x);
 
-            Point3f p00 = fromPtype(prow0[xi+0]);
-            Point3f p01 = fromPtype(prow0[xi+1]);
-            Point3f p10 = fromPtype(prow1[xi+0]);
-            Point3f p11 = fromPtype(prow1[xi+1]);
+                // bilinearly interpolate newPoints under newCoords point
+                int xi = cvFloor(newCoords.x), yi = cvFloor(newCoords.y);
+                float tx  = newCoords.x - xi, ty = newCoords.y - yi;
 
-            //do not fix missing data
-            if(!(fastCheck(p00) && fastCheck(p01) &&
-                fastCheck(p10) && fastCheck(p11)))
-                continue;
+                const ptype* prow0 = newPoints.ptr<ptype>(yi+0);
+                const ptype* prow1 = newPoints.ptr<ptype>(yi+1);
 
-            Point3f p0 = p00 + tx*(p01 - p00);
-            Point3f p1 = p10 + tx*(p11 - p10);
-            Point3f newP = (p0 + ty*(p1 - p0));
+                Point3f p00 = fromPtype(prow0[xi+0]);
+                Point3f p01 = fromPtype(prow0[xi+1]);
+                Point3f p10 = fromPtype(prow1[xi+0]);
+                Point3f p11 = fromPtype(prow1[xi+1]);
 
-            const ptype* nrow0 = newNormals.ptr<ptype>(yi+0);
-            const ptype* nrow1 = newNormals.ptr<ptype>(yi+1);
+                //do not fix missing data
+                if(!(fastCheck(p00) && fastCheck(p01) &&
+                    fastCheck(p10) && fastCheck(p11)))
+                    continue;
 
-            Point3f n00 = fromPtype(nrow0[xi+0]);
-            Point3f n01 = fromPtype(nrow0[xi+1]);
-            Point3f n10 = fromPtype(nrow1[xi+0]);
-            Point3f n11 = fromPtype(nrow1[xi+1]);
+                Point3f p0 = p00 + tx*(p01 - p00);
+                Point3f p1 = p10 + tx*(p11 - p10);
+                Point3f newP = (p0 + ty*(p1 - p0));
 
-            if(!(fastCheck(n00) && fastCheck(n01) &&
-                fastCheck(n10) && fastCheck(n11)))
-                continue;
+                const ptype* nrow0 = newNormals.ptr<ptype>(yi+0);
+                const ptype* nrow1 = newNormals.ptr<ptype>(yi+1);
 
-            Point3f n0 = n00 + tx*(n01 - n00);
-            Point3f n1 = n10 + tx*(n11 - n10);
-            Point3f newN = n0 + ty*(n1 - n0);
+                Point3f n00 = fromPtype(nrow0[xi+0]);
+                Point3f n01 = fromPtype(nrow0[xi+1]);
+                Point3f n10 = fromPtype(nrow1[xi+0]);
+                Point3f n11 = fromPtype(nrow1[xi+1]);
 
-            Vc.at<Point3f>(y, x) = newP;
-            Nc.at<Point3f>(y, x) = newN;
+                if(!(fastCheck(n00) && fastCheck(n01) &&
+                    fastCheck(n10) && fastCheck(n11)))
+                    continue;
 
-            Vec3f diff = oldPoints.at<Vec3f>(y, x) - Vec3f(newP);
-            if(diff.dot(diff) > 0.0004f) continue;
-            if(abs(newN.dot(oldNormals.at<Point3f>(y, x))) < std::cos((float)CV_PI / 2)) continue;
+                Point3f n0 = n00 + tx*(n01 - n00);
+                Point3f n1 = n10 + tx*(n11 - n10);
+                Point3f newN = n0 + ty*(n1 - n0);
 
-            float rd = newN.dot(diff);
+                Vc.at<Point3f>(y, x) = newP;
+                Nc.at<Point3f>(y, x) = newN;
 
+                Vec3f diff = oldPoints.at<Vec3f>(y, x) - Vec3f(newP);
+                if(diff.dot(diff) > 0.0004f) continue;
+                if(abs(newN.dot(oldNormals.at<Point3f>(y, x))) < std::cos((float)CV_PI / 2)) continue;
 
-            residuals.push_back(rd);
+                Rd(y, x) = newN.dot(diff);
+            }
+        }
+    });
 
+    // residuals are gathered in raster order, as the serial loop did
+    std::vector<float> residuals;
+    for (int y = 0; y < Rd.rows; y++)
+    {
+        const float* rdRow = Rd[y];
+        for (int x = 0; x < Rd.cols; x++)
+        {
+            if (!cvIsNaN(rdRow[x]))
+                residuals.push_back(rdRow[x]);
         }
     }
 
@@ -365,84 +375,104 @@ bool ICPImpl::estimateWarpNodes(WarpField& currentWarp, const Affine3f &pose,
     std::cout << "median: " << med << " from " << residuals.size() << " residuals " << std::endl;
     float sigma = MAD_SCALE * median(residuals);
 
-    for(int y = 0; y < oldPoints.size().height; y++)
+    // The data term only touches the diagonal 6x6 blocks of the warp nodes.
+    // Every task accumulates J^T*J and J^T*r into its own copy of these blocks,
+    // the touched ones are then added to A_reg and b_reg under the mutex.
+    const int numWarpNodes = (int)warpNodes.size();
+    const Matx33f Rt = T_lw.rotation().t();
+    Mutex mutex;
+    parallel_for_(Range(0, oldPoints.rows), [&](const Range& range)
     {
-        for(int x = 0; x < oldPoints.size().width; x++)
-        {
-            Vec3f curV = oldPoints.at<Vec3f>(y, x);
-            if (curV == Vec3f::all(0) || cvIsNaN(curV[0]))
-                continue;
+        std::vector<Matx66f> H_local(numWarpNodes, Matx66f::zeros());
+        std::vector<Vec6f> b_local(numWarpNodes, Vec6f::all(0));
+        std::vector<uchar> touched(numWarpNodes, 0);
 
-            Vec3f V = Vg.at<Vec3f>(y, x);
-            if (V == Vec3f::all(0) || cvIsNaN(V[0]))
-                continue;
+        for(int y = range.start; y < range.end; y++)
+        {
+            for(int x = 0; x < oldPoints.size().width; x++)
+            {
+                Vec3f curV = oldPoints.at<Vec3f>(y, x);
+                if (curV == Vec3f::all(0) || cvIsNaN(curV[0]))
+                    continue;
 
-            V[0] *= volume->volResolution.x;
-            V[1] *= volume->volResolution.y;
-            V[2] *= volume->volResolution.z;
+                Vec3f V = Vg.at<Vec3f>(y, x);
+                if (V == Vec3f::all(0) || cvIsNaN(V[0]))
+                    continue;
 
-            if(!fastCheck(Vc.at<Point3f>(y, x)))
-                continue;
+                V[0] *= volume->volResolution.x;
+                V[1] *= volume->volResolution.y;
+                V[2] *= volume->volResolution.z;
 
-            if(!fastCheck(Nc.at<Point3f>(y, x)))
-                continue;
+                if(!fastCheck(Vc.at<Point3f>(y, x)))
+                    continue;
 
-            Point3i p((int)V[0], (int)V[1], (int)V[2]);
-            Vec3f diff = oldPoints.at<Vec3f>(y, x) - Vc.at<Vec3f>(y, x);
+                if(!fastCheck(Nc.at<Point3f>(y, x)))
+                    continue;
 
-            float rd = Nc.at<Vec3f>(y, x).dot(diff);
+                Point3i p((int)V[0], (int)V[1], (int)V[2]);
+                Vec3f diff = oldPoints.at<Vec3f>(y, x) - Vc.at<Vec3f>(y, x);
 
-            int n;
-            nodeNeighboursType neighbours = volume->getVoxelNeighbours(p, n);
-            float totalNeighbourWeight = 0.f;
-            float neighWeights[DYNAFU_MAX_NEIGHBOURS];
-            for (int i = 0; i < n; i++)
-            {
-                int neigh = neighbours[i];
-                neighWeights[i] = warpNodes[neigh]->weight(Point3f(V)*volume->voxelSize);
+                float rd = Nc.at<Vec3f>(y, x).dot(diff);
 
-                totalNeighbourWeight += neighWeights[i];
-            }
+                int n;
+                nodeNeighboursType neighbours = volume->getVoxelNeighbours(p, n);
+                float totalNeighbourWeight = 0.f;
+                float neighWeights[DYNAFU_MAX_NEIGHBOURS];
+                for (int i = 0; i < n; i++)
+                {
+                    int neigh = neighbours[i];
+                    neighWeights[i] = warpNodes[neigh]->weight(Point3f(V)*volume->voxelSize);
 
-            if(totalNeighbourWeight < 1e-5) continue;
+                    totalNeighbourWeight += neighWeights[i];
+                }
 
-            for (int i = 0; i < n; i++)
-            {
-                if(neighWeights[i] < 0.01) continue;
-                int neigh = neighbours[i];
+                if(totalNeighbourWeight < 1e-5) continue;
 
-                Vec3f Tj_Vg_Vj = (warpNodes[neigh]->transform *
-                                 (Point3f(V)*volume->voxelSize - warpNodes[neigh]->pos));
+                float robustWeight = tukeyWeight(rd, sigma);
 
-                Matx33f Tj_Vg_Vj_x(0, -Tj_Vg_Vj[2], Tj_Vg_Vj[1],
-                                   Tj_Vg_Vj[2], 0, -Tj_Vg_Vj[0],
-                                   -Tj_Vg_Vj[1], Tj_Vg_Vj[0], 0);
+                for (int i = 0; i < n; i++)
+                {
+                    if(neighWeights[i] < 0.01) continue;
+                    int neigh = neighbours[i];
 
-                Vec3f v1 = (Tj_Vg_Vj_x * T_lw.rotation().t()) * Nc.at<Vec3f>(y, x);
-                Vec3f v2 = T_lw.rotation().t() * Nc.at<Vec3f>(y, x);
+                    Vec3f Tj_Vg_Vj = (warpNodes[neigh]->transform *
+                                     (Point3f(V)*volume->voxelSize - warpNodes[neigh]->pos));
 
-                Matx61f J_dataT(v1[0], v1[1], v1[2], v2[0], v2[1], v2[2]);
-                Matx16f J_data = J_dataT.t();
-                Matx66f H_data = J_dataT * J_data;
+                    Matx33f Tj_Vg_Vj_x(0, -Tj_Vg_Vj[2], Tj_Vg_Vj[1],
+                                       Tj_Vg_Vj[2], 0, -Tj_Vg_Vj[0],
+                                       -Tj_Vg_Vj[1], Tj_Vg_Vj[0], 0);
 
-                float w = (neighWeights[i] / totalNeighbourWeight);
+                    Vec3f v1 = (Tj_Vg_Vj_x * Rt) * Nc.at<Vec3f>(y, x);
+                    Vec3f v2 = Rt * Nc.at<Vec3f>(y, x);
 
-                float robustWeight = tukeyWeight(rd, sigma);
+                    Matx61f J_dataT(v1[0], v1[1], v1[2], v2[0], v2[1], v2[2]);
+                    Matx16f J_data = J_dataT.t();
+                    Matx66f H_data = J_dataT * J_data;
 
-                int blockIndex = baseIndices[0]+6*neigh;
-                for(int row = 0; row < 6; row++)
-                    for(int col = 0; col < 6; col++)
-                        A_reg(blockIndex+row, blockIndex+col) += robustWeight * w * w * H_data(row, col);
+                    float w = (neighWeights[i] / totalNeighbourWeight);
 
-                for(int row = 0; row < 6; row++)
-                    b_reg(blockIndex+row) += -robustWeight * rd * w * J_dataT(row);
+                    H_local[neigh] += (robustWeight * w * w) * H_data;
+                    for(int row = 0; row < 6; row++)
+                        b_local[neigh](row) += -robustWeight * rd * w * J_dataT(row);
+                    touched[neigh] = 1;
+                }
             }
-
         }
-    }
 
-    double det = determinant(A_reg);
-    std::cout << "A_reg det:" << det  << std::endl;
+        AutoLock al(mutex);
+        for(int neigh = 0; neigh < numWarpNodes; neigh++)
+        {
+            if(!touched[neigh]) continue;
+
+            int blockIndex = baseIndices[0]+6*neigh;
+            for(int row = 0; row < 6; row++)
+            {
+                for(int col = 0; col < 6; col++)
+                    A_reg(blockIndex+row, blockIndex+col) += H_local[neigh](row, col);
+                b_reg(blockIndex+row) += b_local[neigh](row);
+            }
+        }
+    });
 
     std::cout << "Solving " << 6*totalNodes << std::endl;
     Mat_<float> nodeTwists(6*totalNodes, 1, 0.f);
@@ -22,27 +22,92 @@ namespace rgbd
     return std::sqrt(vec[0] * vec[0] + vec[1] * vec[1] + vec[2] * vec[2]);
   }
 
+  /** Compute the distance to the origin of a row of 3d points, converting them on the fly
+   * @param point the 3d points
+   * @param r the output distances
+   * @param n the number of points
+   */
+  template<typename T, typename U>
+  inline
+  void
+  computeRadiusRow(const Vec<U, 3> * point, T * r, int n)
+  {
+    for (int i = 0; i < n; ++i)
+      r[i] = norm_vec(Vec<T, 3>(point[i]));
+  }
+
+  inline
+  void
+  computeRadiusRow(const Vec3f * point, float * r, int n)
+  {
+    int i = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vlanes = VTraits<v_float32>::vlanes();
+    const float * p = point[0].val;
+    for (; i <= n - vlanes; i += vlanes)
+    {
+      v_float32 x, y, z;
+      v_load_deinterleave(p + 3 * i, x, y, z);
+      v_store(r + i, v_sqrt(v_fma(x, x, v_fma(y, y, v_mul(z, z)))));
+    }
+#endif
+    for (; i < n; ++i)
+      r[i] = norm_vec(point[i]);
+  }
+
   /** Given 3d points, compute their distance to the origin
-   * @param points
+   * @param points 3d points of depth U
    * @return
    */
-  template<typename T>
+  template<typename T, typename U>
   Mat_<T>
   computeRadius(const Mat &points)
   {
-    typedef Vec<T, 3> PointT;
-
     // Compute the
     Size size(points.cols, points.rows);
     Mat_<T> r(size);
     if (points.isContinuous())
       size = Size(points.cols * points.rows, 1);
     for (int y = 0; y < size.height; ++y)
+      computeRadiusRow(points.ptr < Vec<U, 3> > (y), r[y], size.width);
+
+    return r;
+  }
+
+  template<typename T>
+  Mat_<T>
+  computeRadius(const Mat &points)
+  {
+    if (points.depth() == CV_32F)
+      return computeRadius<T, float>(points);
+    CV_Assert(points.depth() == CV_64F);
+    return computeRadius<T, double>(points);
+  }
+
+  /** Given a depth image, compute the distance of its points to the origin without building the 3d points
+   * @param depth the depth image, in millimeters for integer types and in meters otherwise
+   * @param ray_norm the norm of K^-1 * (u, v, 1) at every pixel
+   * @param scale the factor converting depth values to meters
+   * @return
+   */
+  template<typename T, typename DepthT>
+  Mat_<T>
+  computeRadiusFromDepth(const Mat &depth, const Mat_<T> &ray_norm, T scale)
+  {
+    Mat_<T> r(depth.size());
+    for (int y = 0; y < depth.rows; ++y)
     {
-      const PointT* point = points.ptr < PointT > (y), *point_end = points.ptr < PointT > (y) + size.width;
+      const DepthT * row_depth = depth.ptr < DepthT > (y);
+      const T * row_norm = ray_norm[y];
       T * row = r[y];
-      for (; point != point_end; ++point, ++row)
-        *row = norm_vec(*point);
+      for (int x = 0; x < depth.cols; ++x)
+      {
+        DepthT z = row_depth[x];
+        if (!isValidDepth(z))
+          row[x] = std::numeric_limits<T>::quiet_NaN();
+        else
+          row[x] = row_norm[x] * scale * z;
+      }
     }
 
     return r;
@@ -158,6 +223,45 @@ namespace rgbd
     virtual void
     cache()=0;
 
+    /** Copy the implementation: the cached tables are shared as they are never modified after cache()
+     */
+    virtual RgbdNormalsImpl *
+    clone() const = 0;
+
+    /** Cache the norm of the ray K^-1 * (u, v, 1) going through every pixel
+     */
+    void
+    cacheRayNorm()
+    {
+      Mat_<double> K(K_ori_);
+      double inv_fx = 1. / K(0, 0), inv_fy = 1. / K(1, 1), cx = K(0, 2), cy = K(1, 2);
+      Mat_<double> ray_norm(rows_, cols_);
+      for (int y = 0; y < rows_; ++y)
+      {
+        double yy = (y - cy) * inv_fy;
+        for (int x = 0; x < cols_; ++x)
+        {
+          double xx = (x - cx) * inv_fx;
+          ray_norm(y, x) = std::sqrt(xx * xx + yy * yy + 1);
+        }
+      }
+      ray_norm.convertTo(ray_norm_, depth_);
+    }
+
+    /** Compute the distance to the origin of the points of a depth image
+     * @param depth a CV_16U depth image in millimeters or a CV_32F/CV_64F one in meters
+     * @param r the output distances, of depth depth_
+     */
+    void
+    computeRadiusFromDepth(const Mat &depth, Mat &r) const
+    {
+      CV_Assert(depth.rows == rows_ && depth.cols == cols_);
+      if (depth_ == CV_32F)
+        r = radiusFromDepth<float>(depth);
+      else
+        r = radiusFromDepth<double>(depth);
+    }
+
     bool
     validate(int rows, int cols, int depth, const Mat &K_ori, int window_size, int method) const
     {
@@ -172,6 +276,25 @@ namespace rgbd
     Mat K_, K_ori_;
     int window_size_;
     RgbdNormals::RGBD_NORMALS_METHOD method_;
+    /** The norm of K^-1 * (u, v, 1) at every pixel */
+    Mat ray_norm_;
+
+  private:
+    template<typename T>
+    Mat_<T>
+    radiusFromDepth(const Mat &depth) const
+    {
+      switch (depth.depth())
+      {
+        case CV_16U:
+          return rgbd::computeRadiusFromDepth<T, unsigned short>(depth, ray_norm_, T(0.001));
+        case CV_32F:
+          return rgbd::computeRadiusFromDepth<T, float>(depth, ray_norm_, T(1));
+        default:
+          CV_Assert(depth.depth() == CV_64F);
+          return rgbd::computeRadiusFromDepth<T, double>(depth, ray_norm_, T(1));
+      }
+    }
   };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -198,6 +321,12 @@ namespace rgbd
     {
     }
 
+    virtual RgbdNormalsImpl *
+    clone() const CV_OVERRIDE
+    {
+      return new FALS<T>(*this);
+    }
+
     /** Compute cached data
      */
     virtual void
@@ -331,6 +460,12 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
     {
     }
 
+    virtual RgbdNormalsImpl *
+    clone() const CV_OVERRIDE
+    {
+      return new LINEMOD<T>(*this);
+    }
+
     /** Compute cached data
      */
     virtual void
@@ -487,6 +622,12 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
     {
     }
 
+    virtual RgbdNormalsImpl *
+    clone() const CV_OVERRIDE
+    {
+      return new SRI<T>(*this);
+    }
+
     /** Compute cached data
      */
     virtual void
@@ -567,11 +708,10 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
      * @return
      */
     virtual void
-    compute(const Mat& points3d, const Mat &r, Mat & normals) const
+    compute(const Mat&, const Mat &r, Mat & normals) const
     {
       const Mat_<T>& r_T(r);
-      const Mat_<Vec3T> &points3d_T(points3d);
-      compute(points3d_T, r_T, normals);
+      compute(Mat_<Vec3T>(), r_T, normals);
     }
 
     /** Compute the normals
@@ -702,6 +842,25 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
     delete_normals_impl(rgbd_normals_impl_, method_, depth_);
   }
 
+  /** The per-pixel tables only depend on the parameters checked by RgbdNormalsImpl::validate(): the last
+   * initialized implementations are kept here and cloned by any instance using the same parameters
+   */
+  static const size_t NORMALS_CACHE_SIZE = 8;
+
+  static Mutex&
+  getNormalsCacheMutex()
+  {
+    static Mutex mutex;
+    return mutex;
+  }
+
+  static std::list<Ptr<RgbdNormalsImpl> >&
+  getNormalsCache()
+  {
+    static std::list<Ptr<RgbdNormalsImpl> > cache;
+    return cache;
+  }
+
   void
   RgbdNormals::initialize_normals_impl(int rows, int cols, int depth, const Mat & K, int window_size,
                                        int method_in) const
@@ -712,6 +871,21 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
     CV_Assert(
         method_in == RGBD_NORMALS_METHOD_FALS || method_in == RGBD_NORMALS_METHOD_LINEMOD
         || method_in == RGBD_NORMALS_METHOD_SRI);
+    {
+      AutoLock lock(getNormalsCacheMutex());
+      std::list<Ptr<RgbdNormalsImpl> >& cache = getNormalsCache();
+      for (std::list<Ptr<RgbdNormalsImpl> >::iterator it = cache.begin(); it != cache.end(); ++it)
+      {
+        if ((*it)->validate(rows, cols, depth, K, window_size, method_in))
+        {
+          rgbd_normals_impl_ = (*it)->clone();
+          // Keep the most recently used tables at the front
+          cache.splice(cache.begin(), cache, it);
+          return;
+        }
+      }
+    }
+
     switch (method_in)
     {
       case (RGBD_NORMALS_METHOD_FALS):
@@ -740,7 +914,15 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
       }
     }
 
-    reinterpret_cast<RgbdNormalsImpl *>(rgbd_normals_impl_)->cache();
+    RgbdNormalsImpl * impl = reinterpret_cast<RgbdNormalsImpl *>(rgbd_normals_impl_);
+    impl->cache();
+    impl->cacheRayNorm();
+
+    AutoLock lock(getNormalsCacheMutex());
+    std::list<Ptr<RgbdNormalsImpl> >& cache = getNormalsCache();
+    cache.push_front(Ptr<RgbdNormalsImpl>(impl->clone()));
+    if (cache.size() > NORMALS_CACHE_SIZE)
+      cache.pop_back();
   }
 
   /** Initializes some data that is cached for later computation
@@ -772,42 +954,29 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
     switch (method_)
     {
       case (RGBD_NORMALS_METHOD_FALS):
-      {
-        CV_Assert(points3d_ori.channels() == 3);
-        CV_Assert(points3d_ori.depth() == CV_32F || points3d_ori.depth() == CV_64F);
-        break;
-      }
       case RGBD_NORMALS_METHOD_LINEMOD:
+      case RGBD_NORMALS_METHOD_SRI:
       {
         CV_Assert(
             ((points3d_ori.channels() == 3) && (points3d_ori.depth() == CV_32F || points3d_ori.depth() == CV_64F)) || ((points3d_ori.channels() == 1) && (points3d_ori.depth() == CV_16U || points3d_ori.depth() == CV_32F || points3d_ori.depth() == CV_64F)));
         break;
       }
-      case RGBD_NORMALS_METHOD_SRI:
-      {
-        CV_Assert( ((points3d_ori.channels() == 3) && (points3d_ori.depth() == CV_32F || points3d_ori.depth() == CV_64F)));
-        break;
-      }
     }
 
     // Initialize the pimpl
     initialize();
 
-    // Precompute something for RGBD_NORMALS_METHOD_SRI and RGBD_NORMALS_METHOD_FALS
-    Mat points3d, radius;
+    // Precompute something for RGBD_NORMALS_METHOD_SRI and RGBD_NORMALS_METHOD_FALS: they only need the
+    // distance to the points, which is computed straight from the input without converting it first
+    Mat radius;
     if ((method_ == RGBD_NORMALS_METHOD_SRI) || (method_ == RGBD_NORMALS_METHOD_FALS))
     {
-      // Make the points have the right depth
-      if (points3d_ori.depth() == depth_)
-        points3d = points3d_ori;
-      else
-        points3d_ori.convertTo(points3d, depth_);
-
-      // Compute the distance to the points
-      if (depth_ == CV_32F)
-        radius = computeRadius<float>(points3d);
+      if (points3d_ori.channels() == 1)
+        reinterpret_cast<const RgbdNormalsImpl *>(rgbd_normals_impl_)->computeRadiusFromDepth(points3d_ori, radius);
+      else if (depth_ == CV_32F)
+        radius = computeRadius<float>(points3d_ori);
       else
-        radius = computeRadius<double>(points3d);
+        radius = computeRadius<double>(points3d_ori);
     }
 
     // Get the normals
@@ -821,9 +990,9 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
       case (RGBD_NORMALS_METHOD_FALS):
       {
         if (depth_ == CV_32F)
-          reinterpret_cast<const FALS<float> *>(rgbd_normals_impl_)->compute(points3d, radius, normals);
+          reinterpret_cast<const FALS<float> *>(rgbd_normals_impl_)->compute(Mat(), radius, normals);
         else
-          reinterpret_cast<const FALS<double> *>(rgbd_normals_impl_)->compute(points3d, radius, normals);
+          reinterpret_cast<const FALS<double> *>(rgbd_normals_impl_)->compute(Mat(), radius, normals);
         break;
       }
       case RGBD_NORMALS_METHOD_LINEMOD:
@@ -831,11 +1000,7 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
         // Only focus on the depth image for LINEMOD
         Mat depth;
         if (points3d_ori.channels() == 3)
-        {
-          std::vector<Mat> channels;
-          split(points3d, channels);
-          depth = channels[2];
-        }
+          extractChannel(points3d_ori, depth, 2);
         else
           depth = points3d_ori;
 
@@ -848,9 +1013,9 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
       case RGBD_NORMALS_METHOD_SRI:
       {
         if (depth_ == CV_32F)
-          reinterpret_cast<const SRI<float> *>(rgbd_normals_impl_)->compute(points3d, radius, normals);
+          reinterpret_cast<const SRI<float> *>(rgbd_normals_impl_)->compute(Mat(), radius, normals);
         else
-          reinterpret_cast<const SRI<double> *>(rgbd_normals_impl_)->compute(points3d, radius, normals);
+          reinterpret_cast<const SRI<double> *>(rgbd_normals_impl_)->compute(Mat(), radius, normals);
         break;
       }
     }
@@ -91,10 +91,10 @@ public:
   /** Update the different sum of point and sum of point*point.t()
    */
   void
-  UpdateStatistics(const Vec3f & point, const Matx33f & Q_local)
+  UpdateStatistics(const Vec3f & point)
   {
     m_sum_ += point;
-    Q_ += Q_local;
+    Q_ += point * point.t();
     ++K_;
   }
 
@@ -203,79 +203,127 @@ public:
         block_size_(block_size)
   {
     // Figure out some dimensions
-    int mini_rows = points3d.rows / block_size;
-    if (points3d.rows % block_size != 0)
-      ++mini_rows;
+    int mini_rows = divUp(points3d.rows, block_size);
+    int mini_cols = divUp(points3d.cols, block_size);
 
-    int mini_cols = points3d.cols / block_size;
-    if (points3d.cols % block_size != 0)
-      ++mini_cols;
-
-    // Compute all the interesting quantities
+    // Compute all the interesting quantities. The tiles are independent so they are
+    // processed in parallel, one row of tiles at a time
     m_.create(mini_rows, mini_cols);
     n_.create(mini_rows, mini_cols);
-    Q_.create(points3d.rows, points3d.cols);
     mse_.create(mini_rows, mini_cols);
-    for (int y = 0; y < mini_rows; ++y)
-      for (int x = 0; x < mini_cols; ++x)
-      {
-        // Update the tiles
-        Matx33f Q = Matx33f::zeros();
-        Vec3f m = Vec3f(0, 0, 0);
-        int K = 0;
-        for (int j = y * block_size; j < std::min((y + 1) * block_size, points3d.rows); ++j)
-        {
-          const Vec3f * vec = points3d.ptr < Vec3f > (j, x * block_size), *vec_end;
-          float * pointpointt = reinterpret_cast<float*>(Q_.ptr < Vec<float, 9> > (j, x * block_size));
-          if (x == mini_cols - 1)
-            vec_end = points3d.ptr < Vec3f > (j, points3d.cols - 1) + 1;
-          else
-            vec_end = vec + block_size;
-          for (; vec != vec_end; ++vec, pointpointt += 9)
-          {
-            if (cvIsNaN(vec->val[0]))
-              continue;
-            // Fill point*point.t()
-            *pointpointt = vec->val[0] * vec->val[0];
-            *(pointpointt + 1) = vec->val[0] * vec->val[1];
-            *(pointpointt + 2) = vec->val[0] * vec->val[2];
-            *(pointpointt + 3) = *(pointpointt + 1);
-            *(pointpointt + 4) = vec->val[1] * vec->val[1];
-            *(pointpointt + 5) = vec->val[1] * vec->val[2];
-            *(pointpointt + 6) = *(pointpointt + 2);
-            *(pointpointt + 7) = *(pointpointt + 5);
-            *(pointpointt + 8) = vec->val[2] * vec->val[2];
-
-            Q += *reinterpret_cast<Matx33f*>(pointpointt);
-            m += (*vec);
-            ++K;
-          }
-        }
-        if (K == 0)
-        {
-          mse_(y, x) = std::numeric_limits<float>::max();
-          continue;
-        }
-
-        m /= K;
-        m_(y, x) = m;
-
-        // Compute C
-        Matx33f C = Q - K * m * m.t();
-
-        // Compute n
-        SVD svd(C);
-        n_(y, x) = Vec3f(svd.vt.at<float>(2, 0), svd.vt.at<float>(2, 1), svd.vt.at<float>(2, 2));
-        mse_(y, x) = svd.w.at<float>(2) / K;
-      }
+    parallel_for_(Range(0, mini_rows), [&](const Range& range)
+    {
+      for (int y = range.start; y < range.end; ++y)
+        for (int x = 0; x < mini_cols; ++x)
+          ComputeTile(points3d, y, x);
+    });
   }
 
   /** The size of the block */
   int block_size_;
   Mat_<Vec3f> m_;
   Mat_<Vec3f> n_;
-  Mat_<Vec<float, 9> > Q_;
   Mat_<float> mse_;
+
+private:
+  /** Fit a plane to the valid points of a tile from their first and second order moments
+   */
+  void
+  ComputeTile(const Mat_<Vec3f> & points3d, int y, int x)
+  {
+    // Sums of x, y, z, xx, xy, xz, yy, yz, zz over the valid points
+    float s[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    int K = 0;
+
+    int x_start = x * block_size_;
+    int n_cols = std::min(block_size_, points3d.cols - x_start);
+    int y_end = std::min((y + 1) * block_size_, points3d.rows);
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vlanes = VTraits<v_float32>::vlanes();
+    const v_float32 v_one = vx_setall_f32(1.f);
+    v_float32 v_sx = vx_setzero_f32(), v_sy = vx_setzero_f32(), v_sz = vx_setzero_f32();
+    v_float32 v_sxx = vx_setzero_f32(), v_sxy = vx_setzero_f32(), v_sxz = vx_setzero_f32();
+    v_float32 v_syy = vx_setzero_f32(), v_syz = vx_setzero_f32(), v_szz = vx_setzero_f32();
+    v_float32 v_k = vx_setzero_f32();
+#endif
+    for (int j = y * block_size_; j < y_end; ++j)
+    {
+      const float * vec = reinterpret_cast<const float*>(points3d.ptr < Vec3f > (j, x_start));
+      int i = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+      for (; i <= n_cols - vlanes; i += vlanes)
+      {
+        v_float32 px, py, pz;
+        v_load_deinterleave(vec + 3 * i, px, py, pz);
+        // Invalid points are NaN: zero them out so that they do not contribute
+        v_float32 valid = v_eq(px, px);
+        px = v_and(px, valid);
+        py = v_and(py, valid);
+        pz = v_and(pz, valid);
+        v_k = v_add(v_k, v_and(v_one, valid));
+
+        v_sx = v_add(v_sx, px);
+        v_sy = v_add(v_sy, py);
+        v_sz = v_add(v_sz, pz);
+        v_sxx = v_fma(px, px, v_sxx);
+        v_sxy = v_fma(px, py, v_sxy);
+        v_sxz = v_fma(px, pz, v_sxz);
+        v_syy = v_fma(py, py, v_syy);
+        v_syz = v_fma(py, pz, v_syz);
+        v_szz = v_fma(pz, pz, v_szz);
+      }
+#endif
+      for (; i < n_cols; ++i)
+      {
+        const float * p = vec + 3 * i;
+        if (cvIsNaN(p[0]))
+          continue;
+        s[0] += p[0];
+        s[1] += p[1];
+        s[2] += p[2];
+        s[3] += p[0] * p[0];
+        s[4] += p[0] * p[1];
+        s[5] += p[0] * p[2];
+        s[6] += p[1] * p[1];
+        s[7] += p[1] * p[2];
+        s[8] += p[2] * p[2];
+        ++K;
+      }
+    }
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    s[0] += v_reduce_sum(v_sx);
+    s[1] += v_reduce_sum(v_sy);
+    s[2] += v_reduce_sum(v_sz);
+    s[3] += v_reduce_sum(v_sxx);
+    s[4] += v_reduce_sum(v_sxy);
+    s[5] += v_reduce_sum(v_sxz);
+    s[6] += v_reduce_sum(v_syy);
+    s[7] += v_reduce_sum(v_syz);
+    s[8] += v_reduce_sum(v_szz);
+    K += cvRound(v_reduce_sum(v_k));
+#endif
+
+    if (K == 0)
+    {
+      mse_(y, x) = std::numeric_limits<float>::max();
+      return;
+    }
+
+    Vec3f m = Vec3f(s[0], s[1], s[2]) / K;
+    m_(y, x) = m;
+
+    // Compute C
+    Matx33f Q(s[3], s[4], s[5],
+              s[4], s[6], s[7],
+              s[5], s[7], s[8]);
+    Matx33f C = Q - K * m * m.t();
+
+    // Compute n
+    SVD svd(C);
+    n_(y, x) = Vec3f(svd.vt.at<float>(2, 0), svd.vt.at<float>(2, 1), svd.vt.at<float>(2, 2));
+    mse_(y, x) = svd.w.at<float>(2) / K;
+  }
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -392,14 +440,12 @@ public:
     {
       uchar* data = overall_mask.ptr(yy, range_x.start), *data_end = data + range_x.size();
       const Vec3f* point = points3d_.ptr < Vec3f > (yy, range_x.start);
-      const Matx33f* Q_local = reinterpret_cast<const Matx33f *>(plane_grid.Q_.ptr < Vec<float, 9>
-          > (yy, range_x.start));
 
       // Depending on whether you have a normal, check it
       if (!normals_.empty())
       {
         const Vec3f* normal = normals_.ptr < Vec3f > (yy, range_x.start);
-        for (; data != data_end; ++data, ++point, ++normal, ++Q_local)
+        for (; data != data_end; ++data, ++point, ++normal)
         {
           // Don't do anything if the point already belongs to another plane
           if (cvIsNaN(point->val[0]) || ((*data) != 255))
@@ -412,7 +458,7 @@ public:
             if (std::abs(plane->n().dot(*normal)) > 0.3)
             {
               // The point now belongs to the plane
-              plane->UpdateStatistics(*point, *Q_local);
+              plane->UpdateStatistics(*point);
               *data = plane_index_;
               ++n_valid_points;
             }
@@ -421,7 +467,7 @@ public:
       }
       else
       {
-        for (; data != data_end; ++data, ++point, ++Q_local)
+        for (; data != data_end; ++data, ++point)
         {
           // Don't do anything if the point already belongs to another plane
           if (cvIsNaN(point->val[0]) || ((*data) != 255))
@@ -431,7 +477,7 @@ public:
           if (plane->distance(*point) < err_)
           {
             // The point now belongs to the plane
-            plane->UpdateStatistics(*point, *Q_local);
+            plane->UpdateStatistics(*point);
             *data = plane_index_;
             ++n_valid_points;
           }
@@ -301,14 +301,16 @@ Point3f WarpField::applyWarp(Point3f p, const nodeNeighboursType neighbours, int
 
     for(int i = 0; i < n; i++)
     {
-        Ptr<WarpNode> neigh = nodes[neighbours[i]];
-        float w = neigh->weight(p);
+        // Avoid copying the Ptr: this runs for every voxel from several threads,
+        // and the reference count updates would make them contend
+        WarpNode& neigh = *nodes[neighbours[i]];
+        float w = neigh.weight(p);
         if(w < 0.01)
         {
             continue;
         }
 
-        Matx33f R = neigh->transform.rotation();
+        Matx33f R = neigh.transform.rotation();
         Point3f newPt(0, 0, 0);
 
         if(normal)
@@ -317,8 +319,8 @@ Point3f WarpField::applyWarp(Point3f p, const nodeNeighboursType neighbours, int
         }
         else
         {
-            newPt = R * (p - neigh->pos) + neigh->pos;
-            Vec3f T = neigh->transform.translation();
+            newPt = R * (p - neigh.pos) + neigh.pos;
+            Vec3f T = neigh.transform.translation();
             newPt.x += T[0];
             newPt.y += T[1];
             newPt.z += T[2];
@@ -98,6 +98,40 @@ void flyTest(bool hiDense, bool inequal)
     }
 }
 
+static void runFrames(const std::vector<String>& depths, int nFrames, Mat& rendered, Affine3f& pose)
+{
+    Ptr<dynafu::DynaFu> df = dynafu::DynaFu::create(kinfu::Params::coarseParams());
+    for(int i = 0; i < nFrames; i++)
+    {
+        Mat depth = cv::imread(depths[i], IMREAD_ANYDEPTH);
+        ASSERT_TRUE(df->update(depth));
+    }
+    df->renderSurface(rendered, noArray(), noArray());
+    pose = df->getPose();
+}
+
+// The non-rigid ICP accumulates its data term per thread. The partial sums are added
+// in a different order than in a single-threaded run, hence the small tolerances.
+TEST(DynamicFusion, threads_match_single_threaded)
+{
+    std::vector<String> depths = readDepth(cvtest::TS::ptr()->get_data_path() + "dynafu/depth.txt");
+    ASSERT_GE(depths.size(), (size_t)3);
+
+    Mat renderedRef, rendered;
+    Affine3f poseRef, pose;
+    const int nthreads = getNumThreads();
+    setNumThreads(1);
+    runFrames(depths, 3, renderedRef, poseRef);
+    setNumThreads(nthreads);
+    runFrames(depths, 3, rendered, pose);
+
+    EXPECT_LE(cvtest::norm(poseRef.matrix, pose.matrix, NORM_INF), 1e-4);
+    // Compare the rendered surfaces where both runs see it
+    Mat valid = (renderedRef > 0) & (rendered > 0);
+    EXPECT_GT(countNonZero(valid), 0);
+    EXPECT_LE(cvtest::norm(renderedRef, rendered, NORM_INF, valid), 1e-3);
+}
+
 /*
 #ifdef OPENCV_ENABLE_NONFREE
 TEST( DynamicFusion, lowDense )
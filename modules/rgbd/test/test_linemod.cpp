@@ -0,0 +1,82 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html
+
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+static void drawObject(Mat& img, Point origin)
+{
+    rectangle(img, Rect(origin.x, origin.y, 60, 40), Scalar(40, 180, 220), FILLED);
+    circle(img, origin + Point(30, 60), 18, Scalar(220, 60, 40), FILLED);
+    line(img, origin + Point(-10, 90), origin + Point(70, 80), Scalar(20, 240, 20), 4);
+}
+
+static Mat makeScene(Point origin)
+{
+    Mat img(240, 320, CV_8UC3, Scalar::all(90));
+    drawObject(img, origin);
+    // Distractors with gradients different from the object
+    circle(img, Point(40, 200), 25, Scalar(250, 250, 250), FILLED);
+    rectangle(img, Rect(250, 20, 50, 30), Scalar(10, 10, 10), FILLED);
+    return img;
+}
+
+static void checkMatchesEqual(const std::vector<linemod::Match>& ref, const std::vector<linemod::Match>& res)
+{
+    ASSERT_EQ(ref.size(), res.size());
+    for (size_t i = 0; i < ref.size(); ++i)
+    {
+        EXPECT_EQ(ref[i].x, res[i].x) << "i=" << i;
+        EXPECT_EQ(ref[i].y, res[i].y) << "i=" << i;
+        EXPECT_EQ(ref[i].similarity, res[i].similarity) << "i=" << i;
+        EXPECT_EQ(ref[i].class_id, res[i].class_id) << "i=" << i;
+        EXPECT_EQ(ref[i].template_id, res[i].template_id) << "i=" << i;
+    }
+}
+
+TEST(Rgbd_Linemod, match_finds_template_and_does_not_depend_on_threads)
+{
+    Ptr<linemod::Detector> detector = linemod::getDefaultLINE();
+
+    const Point templOrigin(100, 60);
+    Mat templ = makeScene(templOrigin);
+    Mat mask = Mat::zeros(templ.size(), CV_8U);
+    drawObject(mask, templOrigin);
+    mask.setTo(255, mask);
+
+    Rect bb;
+    std::vector<Mat> sources(1, templ);
+    ASSERT_EQ(0, detector->addTemplate(sources, "obj", mask, &bb));
+    // A few shifted copies so several jobs run concurrently
+    for (int k = 1; k <= 3; ++k)
+    {
+        Point o = templOrigin + Point(3 * k, 2 * k);
+        Mat t = makeScene(o), m = Mat::zeros(t.size(), CV_8U);
+        drawObject(m, o);
+        m.setTo(255, m);
+        sources[0] = t;
+        ASSERT_EQ(k, detector->addTemplate(sources, "obj", m));
+    }
+
+    const Point shift(60, 40);
+    sources[0] = makeScene(templOrigin + shift);
+
+    std::vector<linemod::Match> ref, res;
+    int nthreads = getNumThreads();
+    setNumThreads(1);
+    detector->match(sources, 80.f, ref);
+    setNumThreads(nthreads);
+    detector->match(sources, 80.f, res);
+
+    ASSERT_FALSE(ref.empty());
+    const linemod::Match& best = ref[0];
+    EXPECT_LE(std::abs(best.x - (bb.x + shift.x)), 2);
+    EXPECT_LE(std::abs(best.y - (bb.y + shift.y)), 2);
+    EXPECT_GT(best.similarity, 90.f);
+
+    checkMatchesEqual(ref, res);
+}
+
+}} // namespace
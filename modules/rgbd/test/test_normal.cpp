@@ -435,12 +435,67 @@ TEST(Rgbd_Normals, compute)
   test.safe_run();
 }
 
+TEST(Rgbd_Normals, compute_from_depth)
+{
+  std::vector<Plane> planes;
+  Mat points3d, ground_normals, depth;
+  Mat_<unsigned char> plane_mask;
+  gen_points_3d(planes, plane_mask, points3d, ground_normals, 1);
+  extractChannel(points3d, depth, 2);
+
+  const int methods[] = { RgbdNormals::RGBD_NORMALS_METHOD_FALS, RgbdNormals::RGBD_NORMALS_METHOD_SRI };
+  for (int i = 0; i < 2; ++i)
+  {
+    RgbdNormals normals_computer(H, W, CV_32F, K, 5, methods[i]);
+    Mat normals_points, normals_depth;
+    normals_computer(points3d, normals_points);
+    normals_computer(depth, normals_depth);
+    EXPECT_LE(cvtest::norm(normals_points, normals_depth, NORM_INF), 1e-2) << "method " << methods[i];
+
+    // A second instance with the same parameters reuses the cached tables
+    RgbdNormals normals_computer2(H, W, CV_32F, K, 5, methods[i]);
+    Mat normals_points2;
+    normals_computer2(points3d, normals_points2);
+    EXPECT_EQ(0.0, cvtest::norm(normals_points, normals_points2, NORM_INF)) << "method " << methods[i];
+  }
+}
+
 TEST(Rgbd_Plane, compute)
 {
   CV_RgbdPlaneTest test;
   test.safe_run();
 }
 
+TEST(Rgbd_Plane, block_statistics_do_not_depend_on_threads)
+{
+  std::vector<Plane> planes;
+  Mat points3d, ground_normals;
+  Mat_<unsigned char> plane_mask;
+  gen_points_3d(planes, plane_mask, points3d, ground_normals, 3);
+
+  // Invalid points must be skipped by the vectorized block sums
+  RNG& rng = theRNG();
+  for (int i = 0; i < 2000; ++i)
+    points3d.at<Vec3f>(rng.uniform(0, H), rng.uniform(0, W)) = Vec3f::all(std::numeric_limits<float>::quiet_NaN());
+
+  RgbdPlane plane_computer;
+  plane_computer.setBlockSize(37); // leaves partial blocks on both borders
+
+  Mat mask_ref, mask;
+  std::vector<Vec4f> coeffs_ref, coeffs;
+  int nthreads = getNumThreads();
+  setNumThreads(1);
+  plane_computer(points3d, mask_ref, coeffs_ref);
+  setNumThreads(nthreads);
+  plane_computer(points3d, mask, coeffs);
+
+  ASSERT_FALSE(coeffs_ref.empty());
+  EXPECT_EQ(0, cvtest::norm(mask_ref, mask, NORM_INF));
+  ASSERT_EQ(coeffs_ref.size(), coeffs.size());
+  for (size_t i = 0; i < coeffs.size(); ++i)
+    EXPECT_EQ(0, cvtest::norm(coeffs_ref[i], coeffs[i], NORM_INF)) << "plane " << i;
+}
+
 TEST(Rgbd_Plane, regression_2309_valgrind_check)
 {
     Mat points(640, 480, CV_32FC3, Scalar::all(0));
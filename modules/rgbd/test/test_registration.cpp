@@ -135,4 +135,60 @@ TEST(Rgbd_DepthRegistration, issue_2234)
 }
 
 
+static Mat makeSceneDepth(Size size)
+{
+    Mat_<unsigned short> depth(size);
+    for (int y = 0; y < size.height; y++)
+        for (int x = 0; x < size.width; x++)
+            depth(y, x) = (unsigned short)(1500 + x + y / 2);
+    // Boxes in front of the plane, so occlusions in the z-buffer are exercised
+    for (int k = 0; k < 8; k++)
+        depth(Rect(size.width * k / 8, size.height / 4, size.width / 16, size.height / 2)).setTo(800 + 50 * k);
+    depth(Rect(0, 0, size.width / 10, size.height / 10)).setTo(0);
+    return depth;
+}
+
+TEST(Rgbd_DepthRegistration, does_not_depend_on_threads)
+{
+    Matx33f depthIntrinsics(525.f, 0, 319.5f, 0, 525.f, 239.5f, 0, 0, 1);
+    Matx33f colorIntrinsics(1050.f, 0, 639.5f, 0, 1050.f, 479.5f, 0, 0, 1);
+    Matx44f rt = Matx44f::eye();
+    rt(0, 3) = 0.025f;
+    Mat depth = makeSceneDepth(Size(640, 480));
+
+    const int nthreads = getNumThreads();
+    for (int withDistortion = 0; withDistortion < 2; withDistortion++)
+    {
+        Mat distCoeffs = Mat::zeros(1, 5, CV_32F);
+        if (withDistortion)
+            distCoeffs = (Mat_<float>(1, 5) << 0.1f, -0.05f, 0.001f, 0.001f, 0.f);
+        for (int dilation = 0; dilation < 2; dilation++)
+        {
+            Mat ref, res;
+            setNumThreads(1);
+            registerDepth(depthIntrinsics, colorIntrinsics, distCoeffs, rt, depth, Size(1280, 960), ref, dilation != 0);
+            setNumThreads(nthreads);
+            registerDepth(depthIntrinsics, colorIntrinsics, distCoeffs, rt, depth, Size(1280, 960), res, dilation != 0);
+
+            ASSERT_GT(countNonZero(ref), 0);
+            EXPECT_EQ(0, cvtest::norm(ref, res, NORM_INF)) << "distortion=" << withDistortion << " dilation=" << dilation;
+        }
+    }
+}
+
+TEST(Rgbd_DepthCleaner, does_not_depend_on_threads)
+{
+    Mat depth = makeSceneDepth(Size(640, 480));
+    DepthCleaner cleaner(CV_16U, 5);
+
+    Mat ref, res;
+    const int nthreads = getNumThreads();
+    setNumThreads(1);
+    cleaner(depth, ref);
+    setNumThreads(nthreads);
+    cleaner(depth, res);
+
+    EXPECT_EQ(0, cvtest::norm(ref, res, NORM_INF));
+}
+
 }} // namespace
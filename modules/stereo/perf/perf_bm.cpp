@@ -76,6 +76,41 @@ PERF_TEST_P( s_bm, sgm_perf,
     }
     SANITY_CHECK_NOTHING();
 }
+
+typedef tuple<Size, int, int> s_sgbm_mode_test_t;
+typedef perf::TestBaseWithParam<s_sgbm_mode_test_t> s_sgbm_mode;
+
+PERF_TEST_P( s_sgbm_mode, sgbm_mode_perf,
+            testing::Combine(
+            testing::Values( cv::Size(640, 480), cv::Size(1280, 960) ),
+            testing::Values( 64, 128 ),
+            testing::Values( (int)StereoBinarySGBM::MODE_SGBM, (int)StereoBinarySGBM::MODE_HH )
+            )
+            )
+{
+    Size sz = get<0>(GetParam());
+    int numDisparities = get<1>(GetParam());
+    int mode = get<2>(GetParam());
+
+    Mat left(sz, CV_8U);
+    Mat right(sz, CV_8U);
+    Mat out1(sz, CV_16S);
+    Ptr<StereoBinarySGBM> sgbm = StereoBinarySGBM::create(0, numDisparities, 5);
+    sgbm->setBinaryKernelType(CV_MODIFIED_CENSUS_TRANSFORM);
+    sgbm->setMode(mode);
+    declare
+        .in(left, WARMUP_RNG)
+        .in(right, WARMUP_RNG)
+        .out(out1)
+        .time(0.5)
+        .iterations(10);
+    TEST_CYCLE()
+    {
+        sgbm->compute(left, right, out1);
+    }
+    SANITY_CHECK_NOTHING();
+}
+
 PERF_TEST_P( s_bm, bm_perf,
             testing::Combine(
             testing::Values( cv::Size(512, 383),  cv::Size(320, 240) ),
@@ -49,6 +49,7 @@
 
 #include <stdint.h>
 #include "opencv2/core.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -128,6 +129,47 @@ namespace cv
                     p = winDisp + p;
                 return p;
             }
+            //enum used to notify wether we are searching on the vertical ie (lr) or diagonal (rl)
+            enum {CV_VERTICAL_SEARCH, CV_DIAGONAL_SEARCH};
+            //!generates one row of the disparity map, c points to the cost of the first pixel of the row
+            //!the diagonal search reads up to maxDisp pixels of the previous and the next row around it
+            static void makeMapRow(short *c, int width, int disparity, double confCheck, int th, int scallingFact, uint8_t *map)
+            {
+                int lr;
+                int v = -1;
+                double p1, p2;
+                for (int j = 0; j < width; j++)
+                {
+                    lr = Matching:: minim(c, j, disparity + 1, confCheck,CV_VERTICAL_SEARCH);
+                    if (lr != -1)
+                    {
+                        v = Matching::minim(c, j - lr, disparity + 1, confCheck,CV_DIAGONAL_SEARCH);
+                        if (v != -1)
+                        {
+                            p1 = Matching::symetricVInterpolation(c, j - lr, disparity + 1, v,CV_DIAGONAL_SEARCH);
+                            p2 = Matching::symetricVInterpolation(c, j, disparity + 1, lr,CV_VERTICAL_SEARCH);
+                            if (abs(p1 - p2) <= th)
+                                map[j] = (uint8_t)((p2)* scallingFact);
+                            else
+                            {
+                                map[j] = 0;
+                            }
+                        }
+                        else
+                        {
+                            if (width - j <= disparity)
+                            {
+                                p2 = Matching::symetricVInterpolation(c, j, disparity + 1, lr,CV_VERTICAL_SEARCH);
+                                map[j] = (uint8_t)(p2* scallingFact);
+                            }
+                        }
+                    }
+                    else
+                    {
+                        map[j] = 0;
+                    }
+                }
+            }
             //!a pre processing function that generates the Hamming LUT in case the algorithm will ever be used on platform where SSE is not available
             void hammingLut()
             {
@@ -182,111 +224,120 @@ namespace cv
                     }
                 }
             };
-            //!cost aggregation
-            class agregateCost:public ParallelLoopBody
+            //!block matching on stripes of rows: the hamming cost, its aggregation and the selection of the disparity
+            //!are done row by row, so that only a few rows of the cost volume are kept in memory at any time
+            class blockMatchingStripe : public ParallelLoopBody
             {
             private:
-                int win;
-                short *c, *parSum;
-                int maxDisp,width, height;
-            public:
-                agregateCost(const Mat &partialSums, int windowSize, int maxDispa, Mat &cost)
+                const int *left, *right;
+                int width, height, maxDisp, kernelSize, win;
+                int th, scallingFact;
+                double confCheck;
+                uint8_t *map;
+                const int *hammLut;
+#if CV_POPCNT
+                bool usePopcnt;
+#endif
+
+                inline int hamming(int x) const
                 {
-                    win = windowSize / 2;
-                    c = (short *)cost.data;
-                    maxDisp = maxDispa;
-                    width = cost.cols / ( maxDisp + 1) - 1;
-                    height = cost.rows - 1;
-                    parSum = (short *)partialSums.data;
+#if CV_POPCNT
+                    if (usePopcnt)
+                        return _mm_popcnt_u32(x);
+#endif
+                    return hammLut[x & 65535] + hammLut[(x >> 16) & 65535];
                 }
-                void operator()(const cv::Range &r) const CV_OVERRIDE {
-                    for (int i = r.start; i < r.end; i++)
+                //!adds (sign = 1) or subtracts (sign = -1) the hamming costs of the given row to the vertical sums
+                void accumulateHamming(short *vsum, int i, int sign) const
+                {
+                    if (i < kernelSize || i >= height - kernelSize)
+                        return;
+                    const int nd = maxDisp + 1;
+                    const int *l = left + i * width, *r = right + i * width;
+                    for (int j = kernelSize; j < width - kernelSize; j++)
                     {
-                        int iwi = i * width;
-                        for (int j = 0; j <= width; j++)
-                        {
-                            int w = (iwi + j) * (maxDisp + 1);
-                            if (i < win + 1 || i >= height - win - 1 || j < win + 1 || j >= width - win - 1)
-                            {
-                                for (int d = 0; d <= maxDisp; d++)
-                                {
-                                    c[w + d] = 0;
-                                }
-                                continue;
-                            }
-
-                            int w1 = ((i + win + 1) * width + j + win) * (maxDisp + 1);
-                            int w2 = ((i - win) * width + j - win - 1) * (maxDisp + 1);
-                            int w3 = ((i + win + 1) * width + j - win - 1) * (maxDisp + 1);
-                            int w4 = ((i - win) * width + j + win) * (maxDisp + 1);
-                            for (int d = 0; d <= maxDisp; d++)
-                            {
-                                c[w + d] = parSum[w1 + d] + parSum[w2 + d]
-                                - parSum[w3 + d] - parSum[w4 + d];
-                            }
-                        }
+                        short *vs = vsum + j * nd;
+                        for (int d = 0; d <= maxDisp; d++)
+                            vs[d] = (short)(vs[d] + sign * hamming(l[j] ^ r[std::max(0, j - d)]));
+                    }
+                }
+                //!aggregates the vertical sums of row i on the horizontal window. the costs of the border are 0
+                void agregateRow(const short *vsum, int i, short *c) const
+                {
+                    const int nd = maxDisp + 1;
+                    const int j0 = win + 1, j1 = std::max(width - win - 1, j0);
+                    if (i < win + 1 || i >= height - win - 1 || j0 >= width - win - 1)
+                    {
+                        memset(c, 0, sizeof(c[0]) * width * nd);
+                        return;
+                    }
+                    memset(c, 0, sizeof(c[0]) * j0 * nd);
+                    memset(c + j1 * nd, 0, sizeof(c[0]) * (width - j1) * nd);
+                    // the window of column j covers the vertical sums of the columns j - win - 1 ... j + win - 1
+                    short *a = c + j0 * nd;
+                    for (int d = 0; d <= maxDisp; d++)
+                    {
+                        int sum = 0;
+                        for (int jj = 0; jj <= 2 * win; jj++)
+                            sum += vsum[jj * nd + d];
+                        a[d] = (short)sum;
+                    }
+                    for (int j = j0 + 1; j < j1; j++)
+                    {
+                        a = c + j * nd;
+                        const short *prev = a - nd;
+                        const short *add = vsum + (j + win - 1) * nd;
+                        const short *sub = vsum + (j - win - 2) * nd;
+                        int d = 0;
+#if CV_SIMD128
+                        for (; d <= maxDisp + 1 - 8; d += 8)
+                            v_store(a + d, v_sub_wrap(v_add_wrap(v_load(prev + d), v_load(add + d)), v_load(sub + d)));
+#endif
+                        for (; d <= maxDisp; d++)
+                            a[d] = (short)(prev[d] + add[d] - sub[d]);
                     }
                 }
-            };
-            //!class that is responsable for generating the disparity map
-            class makeMap:public ParallelLoopBody
-            {
-            private:
-                //enum used to notify wether we are searching on the vertical ie (lr) or diagonal (rl)
-                enum {CV_VERTICAL_SEARCH, CV_DIAGONAL_SEARCH};
-                int width,disparity,scallingFact,th;
-                double confCheck;
-                uint8_t *map;
-                short *c;
             public:
-                makeMap(const Mat &costVolume, int threshold, int maxDisp, double confidence,int scale, Mat &mapFinal)
+                blockMatchingStripe(const Mat &leftImage, const Mat &rightImage, int maxDisparity, int kerSize, int windowSize,
+                    int threshold, double confidence, int scale, const int *hammingLUT, Mat &mapFinal):
+                    left((const int *)leftImage.data), right((const int *)rightImage.data), width(leftImage.cols), height(leftImage.rows),
+                    maxDisp(maxDisparity), kernelSize(kerSize), win(windowSize), th(threshold), scallingFact(scale), confCheck(confidence),
+                    map(mapFinal.data), hammLut(hammingLUT)
                 {
-                    c = (short *)costVolume.data;
-                    map = mapFinal.data;
-                    disparity = maxDisp;
-                    width = costVolume.cols / ( disparity + 1) - 1;
-                    th = threshold;
-                    scallingFact = scale;
-                    confCheck = confidence;
+#if CV_POPCNT
+                    usePopcnt = checkHardwareSupport(CV_CPU_POPCNT);
+#endif
                 }
                 void operator()(const cv::Range &r) const CV_OVERRIDE {
-                    for (int i = r.start; i < r.end ; i++)
+                    const int nd = maxDisp + 1;
+                    const int rowLen = width * nd;
+                    // the diagonal search of a row continues maxDisp pixels into the previous and the next rows,
+                    // so each aggregated row is kept with copies of these pixels around it
+                    const int pre = std::min(nd, width), post = std::min(nd + 1, width);
+                    const int bufRowLen = (nd + width + nd + 1) * nd;
+                    AutoBuffer<short> _buf(rowLen + 2 * bufRowLen);
+                    short *vsum = _buf.data();
+                    short *cur = vsum + rowLen + nd * nd, *nxt = cur + bufRowLen;
+                    memset(vsum, 0, sizeof(vsum[0]) * (rowLen + 2 * bufRowLen));
+
+                    // vertical sums and aggregated costs of the row above the stripe
+                    for (int i = r.start - 1 - win; i <= r.start - 1 + win; i++)
+                        accumulateHamming(vsum, i, 1);
+                    agregateRow(vsum, r.start - 1, nxt);
+                    accumulateHamming(vsum, r.start + win, 1);
+                    accumulateHamming(vsum, r.start - 1 - win, -1);
+                    agregateRow(vsum, r.start, cur);
+                    memcpy(cur - pre * nd, nxt + (width - pre) * nd, sizeof(cur[0]) * pre * nd);
+
+                    for (int i = r.start; i < r.end; i++)
                     {
-                        int lr;
-                        int v = -1;
-                        double p1, p2;
-                        int iw = i * width;
-                        for (int j = 0; j < width; j++)
-                        {
-                            lr = Matching:: minim(c, iw + j, disparity + 1, confCheck,CV_VERTICAL_SEARCH);
-                            if (lr != -1)
-                            {
-                                v = Matching::minim(c, iw + j - lr, disparity + 1, confCheck,CV_DIAGONAL_SEARCH);
-                                if (v != -1)
-                                {
-                                    p1 = Matching::symetricVInterpolation(c, iw + j - lr, disparity + 1, v,CV_DIAGONAL_SEARCH);
-                                    p2 = Matching::symetricVInterpolation(c, iw + j, disparity + 1, lr,CV_VERTICAL_SEARCH);
-                                    if (abs(p1 - p2) <= th)
-                                        map[iw + j] = (uint8_t)((p2)* scallingFact);
-                                    else
-                                    {
-                                        map[iw + j] = 0;
-                                    }
-                                }
-                                else
-                                {
-                                    if (width - j <= disparity)
-                                    {
-                                        p2 = Matching::symetricVInterpolation(c, iw + j, disparity + 1, lr,CV_VERTICAL_SEARCH);
-                                        map[iw + j] = (uint8_t)(p2* scallingFact);
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                map[iw + j] = 0;
-                            }
-                        }
+                        accumulateHamming(vsum, i + 1 + win, 1);
+                        accumulateHamming(vsum, i - win, -1);
+                        agregateRow(vsum, i + 1, nxt);
+                        memcpy(cur + rowLen, nxt, sizeof(cur[0]) * post * nd);
+                        memcpy(nxt - pre * nd, cur + (width - pre) * nd, sizeof(cur[0]) * pre * nd);
+                        makeMapRow(cur, width, maxDisp, confCheck, th, scallingFact, map + i * width);
+                        std::swap(cur, nxt);
                     }
                 }
             };
@@ -437,57 +488,28 @@ namespace cv
                 memset(c, 0, sizeof(c[0]) * leftImage.cols * leftImage.rows * (maxDisparity + 1));
                 parallel_for_(cv::Range(kernelSize / 2,leftImage.rows - kernelSize / 2), hammingDistance(leftImage,rightImage,(short *)cost.data,maxDisparity,kernelSize / 2,hamLut));
             }
-            //preprocessing the cost volume in order to get it ready for aggregation
-            void costGathering(const Mat &hammingDistanceCost, Mat &cost)
-            {
-                CV_Assert(hammingDistanceCost.type() == CV_16S);
-                CV_Assert(cost.type() == CV_16S);
-                int maxDisp = maxDisparity;
-                int width = cost.cols / ( maxDisp + 1) - 1;
-                int height = cost.rows - 1;
-                short *c = (short *)cost.data;
-                short *ham = (short *)hammingDistanceCost.data;
-                memset(c, 0, sizeof(c[0]) * (width + 1) * (height + 1) * (maxDisp + 1));
-                for (int i = 1; i < height; i++)
-                {
-                    int iw = i * width;
-                    int iwi = (i - 1) * width;
-                    for (int j = 1; j < width; j++)
-                    {
-                        int iwj = (iw + j) * (maxDisp + 1);
-                        int iwjmu = (iw + j - 1) * (maxDisp + 1);
-                        int iwijmu = (iwi + j - 1) * (maxDisp + 1);
-                        for (int d = 0; d <= maxDisp; d++)
-                        {
-                            c[iwj + d] = ham[iwijmu + d] + c[iwjmu + d];
-                        }
-                    }
-                }
-                for (int i = 1; i < height; i++)
-                {
-                    for (int j = 1; j < width; j++)
-                    {
-                        int iwj = (i * width + j) * (maxDisp + 1);
-                        int iwjmu = ((i - 1)  * width + j) * (maxDisp + 1);
-                        for (int d = 0; d <= maxDisp; d++)
-                        {
-                            c[iwj + d] += c[iwjmu + d];
-                        }
-                    }
-                }
-            }
-            //!The aggregation on the cost volume
-            void blockAgregation(const Mat &partialSums, int windowSize, Mat &cost)
+            //! Block matching method
+            //! leftImage and rightImage are the two transformed images, kernelSize is the size of the matching window,
+            //! windowSize is the size of the aggregation window and th is the LR threshold
+            //! the hamming cost is aggregated and turned into the disparity map on stripes of rows,
+            //! so the cost volume is never stored for the whole image
+            void blockMatching(const Mat &leftImage, const Mat &rightImage, Mat &mapFinal, const int kernelSize, const int windowSize, int th)
             {
+                CV_Assert(leftImage.cols == rightImage.cols);
+                CV_Assert(leftImage.rows == rightImage.rows);
+                CV_Assert(kernelSize % 2 != 0);
                 CV_Assert(windowSize % 2 != 0);
-                CV_Assert(partialSums.rows == cost.rows);
-                CV_Assert(partialSums.cols == cost.cols);
-                short *c = (short *)cost.data;
-                int maxDisp = maxDisparity;
-                int width = cost.cols / ( maxDisp + 1) - 1;
-                int height = cost.rows - 1;
-                memset(c, 0, sizeof(c[0]) * width * height * (maxDisp + 1));
-                parallel_for_(cv::Range(0, height), agregateCost(partialSums,windowSize, maxDisp, cost));
+                int width = leftImage.cols;
+                int height = leftImage.rows;
+                int win = windowSize / 2;
+                uint8_t *map = mapFinal.data;
+                memset(map, 0, sizeof(map[0]) * width * height);
+                // the rows outside of this range are on the border of the aggregation and have no disparity
+                Range rows(win + 1, height - win - 1);
+                if (rows.start >= rows.end)
+                    return;
+                parallel_for_(rows, blockMatchingStripe(leftImage, rightImage, maxDisparity, kernelSize / 2, win,
+                    th, confidenceCheck, scallingFactor, hamLut, mapFinal), std::max(1, (rows.end - rows.start) / (8 * (win + 1))));
             }
             //!remove small regions that have an area smaller than t, we fill the region with the average of the good pixels around it
             template <typename T>
@@ -580,23 +602,6 @@ namespace cv
                     }
                 }
             }
-            //!Method responsible for generating the disparity map
-            //!function for generating disparity maps at sub pixel level
-            /* costVolume - represents the cost volume
-            * width, height - represent the width and height of the iage
-            *disparity - represents the maximum disparity
-            *map - is the disparity map that will result
-            *th - is the LR threshold
-            */
-            void dispartyMapFormation(const Mat &costVolume, Mat &mapFinal, int th)
-            {
-                uint8_t *map = mapFinal.data;
-                int disparity = maxDisparity;
-                int width = costVolume.cols / ( disparity + 1) - 1;
-                int height = costVolume.rows - 1;
-                memset(map, 0, sizeof(map[0]) * width * height);
-                parallel_for_(Range(0, height), makeMap(costVolume,th,disparity,confidenceCheck,scallingFactor,mapFinal));
-            }
         public:
             //!a median filter of 1x9 and 9x1
             //!1x9 median filter
@@ -5,6 +5,7 @@
 #include "precomp.hpp"
 #include <opencv2/video/tracking.hpp>
 #include <opencv2/stereo/quasi_dense_stereo.hpp>
+#include "opencv2/core/hal/intrin.hpp"
 #include <queue>
 
 
@@ -52,6 +53,10 @@ public:
         sum1.release();
         ssum0.release();
         ssum1.release();
+        mean0.release();
+        mean1.release();
+        stddev0.release();
+        stddev1.release();
         // the disparity image.
         disparity.release();
         // texture images.
@@ -150,6 +155,9 @@ public:
         // generate the intergal images for fast variable window correlation calculations
         cv::integral(grayLeft, sum0, ssum0);
         cv::integral(grayRight, sum1, ssum1);
+        // and the per patch statistics, so that a correlation only needs the cross term.
+        buildPatchStatistics(sum0, ssum0, mean0, stddev0, Param.corrWinSizeX, Param.corrWinSizeY);
+        buildPatchStatistics(sum1, ssum1, mean1, stddev1, Param.corrWinSizeX, Param.corrWinSizeY);
 
         // Seed priority queue. The algorithm wants to pop the best seed available in order to densify
         //the sparse set.
@@ -157,6 +165,9 @@ public:
         refMap, mtcMap);
 
 
+        // Candidate matches of the current seed.
+        std::vector<MatchQuasiDense> candidates;
+
         // Do the propagation part
         while(!seeds.empty())
         {
@@ -201,23 +212,35 @@ public:
                             if(textureDescRight.at<int>(p1.y, p1.x) > Param.textrureThreshold)
                                 continue;
 
-                            // Calculate ZNCC and store local match.
-                            float corr = iZNCC_c1(p0,p1,Param.corrWinSizeX,Param.corrWinSizeY);
-
-                            // push back if this is valid match
-                            if( corr > Param.correlationThreshold )
-                            {
-                                MatchQuasiDense nm;
-                                nm.p0 = p0;
-                                nm.p1 = p1;
-                                nm.corr = corr;
-                                Local.push(nm);
-                            }
+                            MatchQuasiDense nm;
+                            nm.p0 = p0;
+                            nm.p1 = p1;
+                            candidates.push_back(nm);
                         }
                     }
                 }
             }
 
+            // Calculate ZNCC of the candidates. The maps are not modified until all of them are
+            // evaluated, so this can be done in parallel.
+            parallel_for_(Range(0, (int)candidates.size()), [&](const Range& range)
+            {
+                for(int i=range.start; i<range.end; i++)
+                {
+                    candidates[i].corr = iZNCC_c1(candidates[i].p0, candidates[i].p1,
+                                                  Param.corrWinSizeX, Param.corrWinSizeY);
+                }
+            }, std::max(1., candidates.size()/256.));
+
+            // store local matches, in the same order they were found.
+            for(size_t i=0; i<candidates.size(); i++)
+            {
+                // push back if this is valid match
+                if( candidates[i].corr > Param.correlationThreshold )
+                    Local.push(candidates[i]);
+            }
+            candidates.clear();
+
             // Get seeds from the local
             while( !Local.empty() )
             {
@@ -251,25 +274,28 @@ public:
     void computeDisparity(const cv::Mat_<cv::Point2i> &matchMap,
                             cv::Mat_<float> &dispMat)
     {
-        for(int row=0; row< height; row++)
+        parallel_for_(Range(0, height), [&](const Range& range)
         {
-            for(int col=0; col<width; col++)
+            for(int row=range.start; row<range.end; row++)
             {
-                cv::Point2d tmpPoint(col, row);
-
-                if (matchMap.at<cv::Point2i>(tmpPoint) == NO_MATCH)
+                for(int col=0; col<width; col++)
                 {
-                    dispMat.at<float>(tmpPoint) = NAN;
-                    continue;
+                    cv::Point2d tmpPoint(col, row);
+
+                    if (matchMap.at<cv::Point2i>(tmpPoint) == NO_MATCH)
+                    {
+                        dispMat.at<float>(tmpPoint) = NAN;
+                        continue;
+                    }
+                    //if a match is found, compute the difference in location of the match and current
+                    //pixel.
+                    int dx = col-matchMap.at<cv::Point2i>(tmpPoint).x;
+                    int dy = row-matchMap.at<cv::Point2i>(tmpPoint).y;
+                    //calculate disparity of current pixel.
+                    dispMat.at<float>(tmpPoint) = sqrt(float(dx*dx+dy*dy));
                 }
-                //if a match is found, compute the difference in location of the match and current
-                //pixel.
-                int dx = col-matchMap.at<cv::Point2i>(tmpPoint).x;
-                int dy = row-matchMap.at<cv::Point2i>(tmpPoint).y;
-                //calculate disparity of current pixel.
-                dispMat.at<float>(tmpPoint) = sqrt(float(dx*dx+dy*dy));
             }
-        }
+        });
     }
 
 
@@ -285,6 +311,8 @@ public:
      * @param [in] wy The distance from the center of the patch to the border in the y direction.
      * @return The value of the the zero-mean normalized cross correlation.
      * @note Default value for wx, wy is 1. in this case the patch is 3x3.
+     * @note The means and standard deviations are taken from the maps built by
+     * buildPatchStatistics when available, so only the cross term is computed here.
      */
     float iZNCC_c1(const cv::Point2i p0, const cv::Point2i p1, const int wx=1, const int wy=1)
     {
@@ -292,31 +320,93 @@ public:
         float wa = (float)(2*wy+1)*(2*wx+1);
         float zncc=0.0;
 
+        if (statsWindow == cv::Size(wx, wy) && statsRect.contains(p0) && statsRect.contains(p1))
+        {
+            m0 = mean0(p0);
+            m1 = mean1(p1);
+            s0 = stddev0(p0);
+            s1 = stddev1(p1);
+        }
+        else
+        {
+            patchSumSum2(p0, sum0, ssum0, m0, s0, wx, wy);
+            patchSumSum2(p1, sum1, ssum1, m1, s1, wx, wy);
 
-        patchSumSum2(p0, sum0, ssum0, m0, s0, wx, wy);
-        patchSumSum2(p1, sum1, ssum1, m1, s1, wx, wy);
-
-        m0 /= wa;
-        m1 /= wa;
-
-        // standard deviations
-        s0 = sqrt(s0-wa*m0*m0);
-        s1 = sqrt(s1-wa*m1*m1);
+            m0 /= wa;
+            m1 /= wa;
 
+            // standard deviations
+            s0 = sqrt(s0-wa*m0*m0);
+            s1 = sqrt(s1-wa*m1*m1);
+        }
 
-        for (int col=-wy; col<=wy; col++)
+        // the products of 8-bit pixels are summed exactly in integers.
+        const int n = 2*wy+1;
+        int dot = 0;
+#if CV_SIMD128
+        v_int32x4 vdot = v_setzero_s32();
+#endif
+        for (int row=-wx; row<=wx; row++)
         {
-            for (int row=-wx; row<=wx; row++)
+            const uchar* l = grayLeft.ptr<uchar>(p0.y+row) + p0.x - wy;
+            const uchar* r = grayRight.ptr<uchar>(p1.y+row) + p1.x - wy;
+            int col = 0;
+#if CV_SIMD128
+            for (; col <= n - 8; col += 8)
             {
-                zncc += (float)grayLeft.at<uchar>(p0.y+row, p0.x+col) *
-                (float)grayRight.at<uchar>(p1.y+row, p1.x+col);
+                vdot = v_add(vdot, v_dotprod(v_reinterpret_as_s16(v_load_expand(l + col)),
+                                             v_reinterpret_as_s16(v_load_expand(r + col))));
             }
+#endif
+            for (; col < n; col++)
+                dot += l[col]*r[col];
         }
-        zncc = (zncc-wa*m0*m1)/(s0*s1);
+#if CV_SIMD128
+        dot += v_reduce_sum(vdot);
+#endif
+        zncc = ((float)dot-wa*m0*m1)/(s0*s1);
         return zncc;
     }
 
 
+    /**
+     * @brief Compute the mean and the standard deviation term used by iZNCC_c1 for every patch
+     * that fits in the image.
+     * @param[in] sum The integral image
+     * @param[in] ssum The integral image of squared values.
+     * @param[out] mean The mean value of the patch centered in each pixel.
+     * @param[out] stddev The square root of the centered sum of squares of each patch.
+     * @param [in] wx The distance from the center of the patch to the border in the x direction.
+     * @param [in] wy The distance from the center of the patch to the border in the y direction.
+     * @note The values are computed the same way as in iZNCC_c1, patches crossing the image
+     * border are left to it.
+     */
+    void buildPatchStatistics(const cv::Mat &sum, const cv::Mat &ssum, cv::Mat_<float> &mean,
+                              cv::Mat_<float> &stddev, const int wx=1, const int wy=1)
+    {
+        const float wa = (float)(2*wy+1)*(2*wx+1);
+        statsWindow = cv::Size(wx, wy);
+        statsRect = cv::Rect(wx, wy, std::max(width-2*wx, 0), std::max(height-2*wy, 0));
+        mean.create(height, width);
+        stddev.create(height, width);
+
+        parallel_for_(Range(statsRect.y, statsRect.y + statsRect.height), [&](const Range& range)
+        {
+            for(int row=range.start; row<range.end; row++)
+            {
+                for(int col=statsRect.x; col<statsRect.x + statsRect.width; col++)
+                {
+                    float m=0.0, s=0.0;
+                    patchSumSum2(cv::Point2i(col, row), sum, ssum, m, s, wx, wy);
+                    m /= wa;
+                    mean(row, col) = m;
+                    stddev(row, col) = sqrt(s-wa*m*m);
+                }
+            }
+        });
+    }
+
+
     /**
      * @brief Compute the sum of values and the sum of squared values of a patch with dimensions
      * 2*xWindow+1 by 2*yWindow+1 and centered in point p, using the integral image and integral
@@ -427,32 +517,34 @@ public:
      */
     void buildTextureDescriptor(cv::Mat &img,cv::Mat &descriptor)
     {
-        float a, b, c, d;
-
-        uint8_t center, top, bottom, right, left;
-        //reset descriptors
-
         // traverse every pixel.
-        for(int row=1; row<height-1; row++)
+        parallel_for_(Range(1, std::max(height-1, 1)), [&](const Range& range)
         {
-            for(int col=1; col<width-1; col++)
+            float a, b, c, d;
+
+            uint8_t center, top, bottom, right, left;
+
+            for(int row=range.start; row<range.end; row++)
             {
-                // the values of the current pixel.
-                center = img.at<uchar>(row,col);
-                top = img.at<uchar>(row-1,col);
-                bottom = img.at<uchar>(row+1,col);
-                left = img.at<uchar>(row,col-1);
-                right = img.at<uchar>(row,col+1);
-
-                a = (float)abs(center - top);
-                b = (float)abs(center - bottom);
-                c = (float)abs(center - left);
-                d = (float)abs(center - right);
-                //choose the biggest of them.
-                int val = (int) std::max(a, std::max(b, std::max(c, d)));
-                descriptor.at<int>(row, col) = val;
+                for(int col=1; col<width-1; col++)
+                {
+                    // the values of the current pixel.
+                    center = img.at<uchar>(row,col);
+                    top = img.at<uchar>(row-1,col);
+                    bottom = img.at<uchar>(row+1,col);
+                    left = img.at<uchar>(row,col-1);
+                    right = img.at<uchar>(row,col+1);
+
+                    a = (float)abs(center - top);
+                    b = (float)abs(center - bottom);
+                    c = (float)abs(center - left);
+                    d = (float)abs(center - right);
+                    //choose the biggest of them.
+                    int val = (int) std::max(a, std::max(b, std::max(c, d)));
+                    descriptor.at<int>(row, col) = val;
+                }
             }
-        }
+        });
     }
 
     //-------------------------------------------------------------------------
@@ -627,6 +719,13 @@ public:
     cv::Mat_<int32_t> sum1;
     cv::Mat_<double> ssum0;
     cv::Mat_<double> ssum1;
+    // Per patch means and standard deviations, valid inside statsRect for patches of statsWindow.
+    cv::Mat_<float> mean0;
+    cv::Mat_<float> mean1;
+    cv::Mat_<float> stddev0;
+    cv::Mat_<float> stddev1;
+    cv::Rect statsRect;
+    cv::Size statsWindow;
     // Container to store the disparity un-normalized
     cv::Mat_<float> disparity;
     // Containers to store textures descriptors.
@@ -330,10 +330,6 @@ namespace cv
                     censusImage[0].create(left0.rows,left0.cols,CV_32SC4);
                     censusImage[1].create(left0.rows,left0.cols,CV_32SC4);
 
-                    partialSumsLR.create(left0.rows + 1,(left0.cols + 1) * (params.numDisparities + 1),CV_16S);
-                    agregatedHammingLRCost.create(left0.rows + 1,(left0.cols + 1) * (params.numDisparities + 1),CV_16S);
-                    hammingDistance.create(left0.rows, left0.cols * (params.numDisparities + 1),CV_16S);
-
                     preFilteredImg0.create(left0.size(), CV_8U);
                     preFilteredImg1.create(left0.size(), CV_8U);
 
@@ -384,10 +380,7 @@ namespace cv
                 {
                     starCensusTransform(left,right,params.kernelSize,censusImage[0],censusImage[1]);
                 }
-                hammingDistanceBlockMatching(censusImage[0], censusImage[1], hammingDistance, params.kernelSize);
-                costGathering(hammingDistance, partialSumsLR);
-                blockAgregation(partialSumsLR, params.agregationWindowSize, agregatedHammingLRCost);
-                dispartyMapFormation(agregatedHammingLRCost, disp0, 3);
+                blockMatching(censusImage[0], censusImage[1], disp0, params.kernelSize, params.agregationWindowSize, 3);
                 Median1x9Filter<uint8_t>(disp0, aux);
                 Median9x1Filter<uint8_t>(aux,disp0);
 
@@ -489,9 +482,6 @@ namespace cv
             Mat preFilteredImg0, preFilteredImg1, cost, dispbuf;
             Mat slidingSumBuf;
             Mat censusImage[2];
-            Mat hammingDistance;
-            Mat partialSumsLR;
-            Mat agregatedHammingLRCost;
             Mat aux;
             static const char* name_;
         };
@@ -49,6 +49,7 @@ SGBM (Semi-global block matching)
 */
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <limits.h>
 
 namespace cv
@@ -110,6 +111,128 @@ namespace cv
             int subpixelInterpolationMethod;
         };
 
+        /*
+        computes L_r(p, d) along the row, i.e. for r=(-dx, 0), at x = x1, x1 + dx, ..., x2 - dx.
+        Lr and minLr point to the current row, the costs are kept in the given slot of each pixel.
+        The path is sequential in x, but it does not depend on the other paths or on the other rows.
+        */
+        static void aggregateRowPath( const CostType* C, CostType* Lr, CostType* minLr,
+            int slot, int x1, int x2, int dx, int D, int P1, int P2 )
+        {
+            const CostType MAX_COST = SHRT_MAX;
+            const int D2 = D+16, NRD2 = NR2*D2;
+            for( int x = x1; x != x2; x += dx )
+            {
+                const int xm = x*NR2 + slot;
+                const int xd = x*NRD2 + slot*D2;
+                const int delta0 = minLr[xm - dx*NR2] + P2;
+                CostType* Lr_p0 = Lr + xd - dx*NRD2;
+                Lr_p0[-1] = Lr_p0[D] = MAX_COST;
+                CostType* Lr_p = Lr + xd;
+                const CostType* Cp = C + x*D;
+                int d = 0, minL0 = MAX_COST;
+#if CV_SIMD128
+                v_int16x8 _P1 = v_setall_s16((short)P1);
+                v_int16x8 _delta0 = v_setall_s16((short)delta0);
+                v_int16x8 _minL0 = v_setall_s16(MAX_COST);
+                for( ; d <= D - 8; d += 8 )
+                {
+                    v_int16x8 L0 = v_load(Lr_p0 + d);
+                    L0 = v_min(L0, v_add(v_load(Lr_p0 + d - 1), _P1));
+                    L0 = v_min(L0, v_add(v_load(Lr_p0 + d + 1), _P1));
+                    L0 = v_min(L0, _delta0);
+                    L0 = v_add(v_sub(L0, _delta0), v_load(Cp + d));
+                    v_store(Lr_p + d, L0);
+                    _minL0 = v_min(_minL0, L0);
+                }
+                minL0 = v_reduce_min(_minL0);
+#endif
+                for( ; d < D; d++ )
+                {
+                    const int L0 = Cp[d] + std::min((int)Lr_p0[d], std::min(Lr_p0[d-1] + P1, std::min(Lr_p0[d+1] + P1, delta0))) - delta0;
+                    Lr_p[d] = (CostType)L0;
+                    minL0 = std::min(minL0, L0);
+                }
+                minLr[xm] = (CostType)minL0;
+            }
+        }
+
+        /*
+        computes L_r(p, d) for r=(-1, -dy), r=(0, -dy) and r=(1, -dy) at x1 <= x < x2.
+        These paths only depend on the previous row (LrPrev and minLrPrev), so any range of x
+        can be processed independently of the others. The costs are kept in the slots 1, 2 and 3.
+        */
+        static void aggregateDiagonalPaths( const CostType* C, CostType* LrPrev, const CostType* minLrPrev,
+            CostType* Lr, CostType* minLr, int x1, int x2, int D, int P1, int P2 )
+        {
+            const CostType MAX_COST = SHRT_MAX;
+            const int D2 = D+16, NRD2 = NR2*D2;
+            for( int x = x1; x < x2; x++ )
+            {
+                const int xm = x*NR2;
+                const int xd = xm*D2;
+                const int delta1 = minLrPrev[xm - NR2 + 1] + P2;
+                const int delta2 = minLrPrev[xm + 2] + P2;
+                const int delta3 = minLrPrev[xm + NR2 + 3] + P2;
+                CostType* Lr_p1 = LrPrev + xd - NRD2 + D2;
+                CostType* Lr_p2 = LrPrev + xd + D2*2;
+                CostType* Lr_p3 = LrPrev + xd + NRD2 + D2*3;
+                Lr_p1[-1] = Lr_p1[D] = Lr_p2[-1] = Lr_p2[D] = Lr_p3[-1] = Lr_p3[D] = MAX_COST;
+                CostType* Lr_p = Lr + xd;
+                const CostType* Cp = C + x*D;
+                int d = 0, minL1 = MAX_COST, minL2 = MAX_COST, minL3 = MAX_COST;
+#if CV_SIMD128
+                v_int16x8 _P1 = v_setall_s16((short)P1);
+                v_int16x8 _delta1 = v_setall_s16((short)delta1);
+                v_int16x8 _delta2 = v_setall_s16((short)delta2);
+                v_int16x8 _delta3 = v_setall_s16((short)delta3);
+                v_int16x8 _minL1 = v_setall_s16(MAX_COST), _minL2 = _minL1, _minL3 = _minL1;
+                for( ; d <= D - 8; d += 8 )
+                {
+                    v_int16x8 Cpd = v_load(Cp + d);
+                    v_int16x8 L1 = v_load(Lr_p1 + d), L2 = v_load(Lr_p2 + d), L3 = v_load(Lr_p3 + d);
+                    L1 = v_min(L1, v_add(v_load(Lr_p1 + d - 1), _P1));
+                    L1 = v_min(L1, v_add(v_load(Lr_p1 + d + 1), _P1));
+                    L2 = v_min(L2, v_add(v_load(Lr_p2 + d - 1), _P1));
+                    L2 = v_min(L2, v_add(v_load(Lr_p2 + d + 1), _P1));
+                    L3 = v_min(L3, v_add(v_load(Lr_p3 + d - 1), _P1));
+                    L3 = v_min(L3, v_add(v_load(Lr_p3 + d + 1), _P1));
+                    L1 = v_add(v_sub(v_min(L1, _delta1), _delta1), Cpd);
+                    L2 = v_add(v_sub(v_min(L2, _delta2), _delta2), Cpd);
+                    L3 = v_add(v_sub(v_min(L3, _delta3), _delta3), Cpd);
+                    v_store(Lr_p + d + D2, L1);
+                    v_store(Lr_p + d + D2*2, L2);
+                    v_store(Lr_p + d + D2*3, L3);
+                    _minL1 = v_min(_minL1, L1);
+                    _minL2 = v_min(_minL2, L2);
+                    _minL3 = v_min(_minL3, L3);
+                }
+                minL1 = v_reduce_min(_minL1);
+                minL2 = v_reduce_min(_minL2);
+                minL3 = v_reduce_min(_minL3);
+#endif
+                for( ; d < D; d++ )
+                {
+                    const int Cpd = Cp[d];
+                    const int L1 = Cpd + std::min((int)Lr_p1[d], std::min(Lr_p1[d-1] + P1, std::min(Lr_p1[d+1] + P1, delta1))) - delta1;
+                    const int L2 = Cpd + std::min((int)Lr_p2[d], std::min(Lr_p2[d-1] + P1, std::min(Lr_p2[d+1] + P1, delta2))) - delta2;
+                    const int L3 = Cpd + std::min((int)Lr_p3[d], std::min(Lr_p3[d-1] + P1, std::min(Lr_p3[d+1] + P1, delta3))) - delta3;
+
+                    Lr_p[d + D2] = (CostType)L1;
+                    minL1 = std::min(minL1, L1);
+
+                    Lr_p[d + D2*2] = (CostType)L2;
+                    minL2 = std::min(minL2, L2);
+
+                    Lr_p[d + D2*3] = (CostType)L3;
+                    minL3 = std::min(minL3, L3);
+                }
+                minLr[xm + 1] = (CostType)minL1;
+                minLr[xm + 2] = (CostType)minL2;
+                minLr[xm + 3] = (CostType)minL3;
+            }
+        }
+
         /*
         computes disparity for "roi" in img1 w.r.t. img2 and write it to disp1buf.
         that is, disp1buf(x, y)=d means that img1(x+roi.x, y+roi.y) ~ img2(x+roi.x-d, y+roi.y).
@@ -131,22 +254,6 @@ namespace cv
             Mat& disp1, const StereoBinarySGBMParams& params,
             Mat& buffer,const Mat& hamDist)
         {
-#if CV_SSE2
-            static const uchar LSBTab[] =
-            {
-                0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
-            };
-
-            volatile bool useSIMD = checkHardwareSupport(CV_CPU_SSE2);
-#endif
-
             const int ALIGN = 16;
             const int DISP_SHIFT = StereoMatcher::DISP_SHIFT;
             const int DISP_SCALE = (1 << DISP_SHIFT);
@@ -209,6 +316,16 @@ namespace cv
             CostType* disp2cost = pixDiff + costBufSize + (LrSize + minLrSize)*NLR;
             DispType* disp2ptr = (DispType*)(disp2cost + width);
             //            PixType* tempBuf = (PixType*)(disp2ptr + width);
+            // the paths going to the previous row are computed in parallel by blocks of XBLOCK pixels,
+            // while each path along the row (two of them in the single-pass mode) is a separate task
+            const int XBLOCK = 64;
+            const int nblocks = (width1 + XBLOCK - 1)/XBLOCK;
+            const int nRowPaths = npasses == 1 ? 2 : 1;
+            // the best disparity and its cost for each x of the current row,
+            // INT_MIN marks the pixels rejected by the uniqueness check
+            AutoBuffer<int> selBuf(width1*2);
+            int* bestDispBuf = selBuf.data();
+            int* minSBuf = bestDispBuf + width1;
             // add P2 to every C(x,y). it saves a few operations in the inner loops
             for(int k = 0; k < width1*D; k++ )
                 Cbuf[k] = (CostType)P2;
@@ -240,12 +357,12 @@ namespace cv
                 }
                 for( int y = y1; y != y2; y += dy )
                 {
-                    int x, d;
                     DispType* disp1ptr = disp1.ptr<DispType>(y);
                     CostType* C = Cbuf + (!fullDP ? 0 : y*costBufSize);
                     CostType* S = Sbuf + (!fullDP ? 0 : y*costBufSize);
                     if( pass == 1 ) // compute C on the first pass, and reuse it on the second pass, if any.
                     {
+                        int x, d;
                         int dy1 = y == 0 ? 0 : y + SH2, dy2 = y == 0 ? SH2 : dy1;
                         for(int k = dy1; k <= dy2; k++ )
                         {
@@ -278,31 +395,22 @@ namespace cv
                                         const CostType* pixAdd = pixDiff + std::min(x + SW2*D, (width1-1)*D);
                                         const CostType* pixSub = pixDiff + std::max(x - (SW2+1)*D, 0);
 
-#if CV_SSE2
-                                        if( useSIMD )
+                                        d = 0;
+#if CV_SIMD128
+                                        for( ; d <= D - 8; d += 8 )
                                         {
-                                            for( d = 0; d < D; d += 8 )
-                                            {
-                                                __m128i hv = _mm_load_si128((const __m128i*)(hsumAdd + x - D + d));
-                                                __m128i Cx = _mm_load_si128((__m128i*)(Cprev + x + d));
-                                                hv = _mm_adds_epi16(_mm_subs_epi16(hv,
-                                                    _mm_load_si128((const __m128i*)(pixSub + d))),
-                                                    _mm_load_si128((const __m128i*)(pixAdd + d)));
-                                                Cx = _mm_adds_epi16(_mm_subs_epi16(Cx,
-                                                    _mm_load_si128((const __m128i*)(hsumSub + x + d))),
-                                                    hv);
-                                                _mm_store_si128((__m128i*)(hsumAdd + x + d), hv);
-                                                _mm_store_si128((__m128i*)(C + x + d), Cx);
-                                            }
+                                            v_int16x8 hv = v_load(hsumAdd + x - D + d);
+                                            v_int16x8 Cx = v_load(Cprev + x + d);
+                                            hv = v_add(v_sub(hv, v_load(pixSub + d)), v_load(pixAdd + d));
+                                            Cx = v_add(v_sub(Cx, v_load(hsumSub + x + d)), hv);
+                                            v_store(hsumAdd + x + d, hv);
+                                            v_store(C + x + d, Cx);
                                         }
-                                        else
 #endif
+                                        for( ; d < D; d++ )
                                         {
-                                            for( d = 0; d < D; d++ )
-                                            {
-                                                const int hv = hsumAdd[x + d] = (CostType)(hsumAdd[x - D + d] + pixAdd[d] - pixSub[d]);
-                                                C[x + d] = (CostType)(Cprev[x + d] + hv - hsumSub[x + d]);
-                                            }
+                                            const int hv = hsumAdd[x + d] = (CostType)(hsumAdd[x - D + d] + pixAdd[d] - pixSub[d]);
+                                            C[x + d] = (CostType)(Cprev[x + d] + hv - hsumSub[x + d]);
                                         }
                                     }
                                 }
@@ -350,202 +458,90 @@ namespace cv
                     5: r=(-1, -dy*2)
                     6: r=(1, -dy*2)
                     7: r=(2, -dy)
+                    in the single-pass mode the slot 4 keeps the path r=(dx, 0) instead.
                     */
-                    for( x = x1; x != x2; x += dx )
+                    parallel_for_(Range(0, nRowPaths + nblocks), [&](const Range& range)
                     {
-                        const int xm = x*NR2;
-                        const int xd = xm*D2;
-                        const int delta0 = minLr[0][xm - dx*NR2] + P2;
-                        const int delta1 = minLr[1][xm - NR2 + 1] + P2;
-                        const int delta2 = minLr[1][xm + 2] + P2;
-                        const int delta3 = minLr[1][xm + NR2 + 3] + P2;
-                        CostType* Lr_p0 = Lr[0] + xd - dx*NRD2;
-                        CostType* Lr_p1 = Lr[1] + xd - NRD2 + D2;
-                        CostType* Lr_p2 = Lr[1] + xd + D2*2;
-                        CostType* Lr_p3 = Lr[1] + xd + NRD2 + D2*3;
-                        Lr_p0[-1] = Lr_p0[D] = Lr_p1[-1] = Lr_p1[D] =
-                            Lr_p2[-1] = Lr_p2[D] = Lr_p3[-1] = Lr_p3[D] = MAX_COST;
-                        CostType* Lr_p = Lr[0] + xd;
-                        const CostType* Cp = C + x*D;
-                        CostType* Sp = S + x*D;
-#if CV_SSE2
-                        if( useSIMD )
+                        for( int task = range.start; task < range.end; task++ )
                         {
-                            __m128i _P1 = _mm_set1_epi16((short)P1);
-                            __m128i _delta0 = _mm_set1_epi16((short)delta0);
-                            __m128i _delta1 = _mm_set1_epi16((short)delta1);
-                            __m128i _delta2 = _mm_set1_epi16((short)delta2);
-                            __m128i _delta3 = _mm_set1_epi16((short)delta3);
-                            __m128i _minL0 = _mm_set1_epi16((short)MAX_COST);
-                            for( d = 0; d < D; d += 8 )
+                            if( task == 0 )
+                                aggregateRowPath( C, Lr[0], minLr[0], 0, x1, x2, dx, D, P1, P2 );
+                            else if( task < nRowPaths )
+                                aggregateRowPath( C, Lr[0], minLr[0], 4, x2 - dx, x1 - dx, -dx, D, P1, P2 );
+                            else
                             {
-                                __m128i Cpd = _mm_load_si128((const __m128i*)(Cp + d));
-                                __m128i L0, L1, L2, L3;
-                                L0 = _mm_load_si128((const __m128i*)(Lr_p0 + d));
-                                L1 = _mm_load_si128((const __m128i*)(Lr_p1 + d));
-                                L2 = _mm_load_si128((const __m128i*)(Lr_p2 + d));
-                                L3 = _mm_load_si128((const __m128i*)(Lr_p3 + d));
-                                L0 = _mm_min_epi16(L0, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p0 + d - 1)), _P1));
-                                L0 = _mm_min_epi16(L0, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p0 + d + 1)), _P1));
-                                L1 = _mm_min_epi16(L1, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p1 + d - 1)), _P1));
-                                L1 = _mm_min_epi16(L1, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p1 + d + 1)), _P1));
-                                L2 = _mm_min_epi16(L2, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p2 + d - 1)), _P1));
-                                L2 = _mm_min_epi16(L2, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p2 + d + 1)), _P1));
-                                L3 = _mm_min_epi16(L3, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p3 + d - 1)), _P1));
-                                L3 = _mm_min_epi16(L3, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p3 + d + 1)), _P1));
-                                L0 = _mm_min_epi16(L0, _delta0);
-                                L0 = _mm_adds_epi16(_mm_subs_epi16(L0, _delta0), Cpd);
-                                L1 = _mm_min_epi16(L1, _delta1);
-                                L1 = _mm_adds_epi16(_mm_subs_epi16(L1, _delta1), Cpd);
-                                L2 = _mm_min_epi16(L2, _delta2);
-                                L2 = _mm_adds_epi16(_mm_subs_epi16(L2, _delta2), Cpd);
-                                L3 = _mm_min_epi16(L3, _delta3);
-                                L3 = _mm_adds_epi16(_mm_subs_epi16(L3, _delta3), Cpd);
-                                _mm_store_si128( (__m128i*)(Lr_p + d), L0);
-                                _mm_store_si128( (__m128i*)(Lr_p + d + D2), L1);
-                                _mm_store_si128( (__m128i*)(Lr_p + d + D2*2), L2);
-                                _mm_store_si128( (__m128i*)(Lr_p + d + D2*3), L3);
-                                __m128i t0 = _mm_min_epi16(_mm_unpacklo_epi16(L0, L2), _mm_unpackhi_epi16(L0, L2));
-                                __m128i t1 = _mm_min_epi16(_mm_unpacklo_epi16(L1, L3), _mm_unpackhi_epi16(L1, L3));
-                                t0 = _mm_min_epi16(_mm_unpacklo_epi16(t0, t1), _mm_unpackhi_epi16(t0, t1));
-                                _minL0 = _mm_min_epi16(_minL0, t0);
-                                __m128i Sval = _mm_load_si128((const __m128i*)(Sp + d));
-                                L0 = _mm_adds_epi16(L0, L1);
-                                L2 = _mm_adds_epi16(L2, L3);
-                                Sval = _mm_adds_epi16(Sval, L0);
-                                Sval = _mm_adds_epi16(Sval, L2);
-                                _mm_store_si128((__m128i*)(Sp + d), Sval);
+                                const int xb = (task - nRowPaths)*XBLOCK;
+                                aggregateDiagonalPaths( C, Lr[1], minLr[1], Lr[0], minLr[0],
+                                    xb, std::min(xb + XBLOCK, width1), D, P1, P2 );
                             }
-                            _minL0 = _mm_min_epi16(_minL0, _mm_srli_si128(_minL0, 8));
-                            _mm_storel_epi64((__m128i*)&minLr[0][xm], _minL0);
                         }
-                        else
-#endif
-                        {
-                            int minL0 = MAX_COST, minL1 = MAX_COST, minL2 = MAX_COST, minL3 = MAX_COST;
-
-                            for( d = 0; d < D; d++ )
-                            {
-                                const int Cpd = Cp[d];
-                                const int L0 = Cpd + std::min((int)Lr_p0[d], std::min(Lr_p0[d-1] + P1, std::min(Lr_p0[d+1] + P1, delta0))) - delta0;
-                                const int L1 = Cpd + std::min((int)Lr_p1[d], std::min(Lr_p1[d-1] + P1, std::min(Lr_p1[d+1] + P1, delta1))) - delta1;
-                                const int L2 = Cpd + std::min((int)Lr_p2[d], std::min(Lr_p2[d-1] + P1, std::min(Lr_p2[d+1] + P1, delta2))) - delta2;
-                                const int L3 = Cpd + std::min((int)Lr_p3[d], std::min(Lr_p3[d-1] + P1, std::min(Lr_p3[d+1] + P1, delta3))) - delta3;
-
-                                Lr_p[d] = (CostType)L0;
-                                minL0 = std::min(minL0, L0);
-
-                                Lr_p[d + D2] = (CostType)L1;
-                                minL1 = std::min(minL1, L1);
-
-                                Lr_p[d + D2*2] = (CostType)L2;
-                                minL2 = std::min(minL2, L2);
-
-                                Lr_p[d + D2*3] = (CostType)L3;
-                                minL3 = std::min(minL3, L3);
-
-                                Sp[d] = saturate_cast<CostType>(Sp[d] + L0 + L1 + L2 + L3);
-                            }
-                            minLr[0][xm] = (CostType)minL0;
-                            minLr[0][xm+1] = (CostType)minL1;
-                            minLr[0][xm+2] = (CostType)minL2;
-                            minLr[0][xm+3] = (CostType)minL3;
-                        }
-                    }
+                    }, nRowPaths + nblocks);
 
                     if( pass == npasses )
                     {
-                        for( x = 0; x < width; x++ )
+                        for( int x = 0; x < width; x++ )
                         {
                             disp1ptr[x] = disp2ptr[x] = (DispType)INVALID_DISP_SCALED;
                             disp2cost[x] = MAX_COST;
                         }
+                    }
 
-                        for( x = width1 - 1; x >= 0; x-- )
+                    // accumulate S(p, d) = sum_r L_r(p, d) and, on the last pass, select the disparity
+                    parallel_for_(Range(0, width1), [&](const Range& range)
+                    {
+                        for( int x = range.start; x < range.end; x++ )
                         {
                             CostType* Sp = S + x*D;
+                            const CostType* Lr_p = Lr[0] + x*NRD2;
+                            int d = 0;
+#if CV_SIMD128
+                            for( ; d <= D - 8; d += 8 )
+                            {
+                                v_int16x8 L0 = v_load(Lr_p + d), L1 = v_load(Lr_p + d + D2);
+                                v_int16x8 L2 = v_load(Lr_p + d + D2*2), L3 = v_load(Lr_p + d + D2*3);
+                                v_int16x8 Sval = v_add(v_add(v_load(Sp + d), v_add(L0, L1)), v_add(L2, L3));
+                                if( nRowPaths > 1 )
+                                    Sval = v_add(Sval, v_load(Lr_p + d + D2*4));
+                                v_store(Sp + d, Sval);
+                            }
+#endif
+                            for( ; d < D; d++ )
+                            {
+                                CostType Sval = saturate_cast<CostType>(Sp[d] + Lr_p[d] + Lr_p[d + D2] + Lr_p[d + D2*2] + Lr_p[d + D2*3]);
+                                if( nRowPaths > 1 )
+                                    Sval = saturate_cast<CostType>(Sval + Lr_p[d + D2*4]);
+                                Sp[d] = Sval;
+                            }
+
+                            if( pass < npasses )
+                                continue;
+
                             int minS = MAX_COST;
                             int bestDisp = -1;
-
-                            if( npasses == 1 )
+                            d = 0;
+#if CV_SIMD128
+                            v_int16x8 _minS = v_setall_s16(MAX_COST), _bestDisp = v_setall_s16(-1);
+                            v_int16x8 _d8(0, 1, 2, 3, 4, 5, 6, 7), _8 = v_setall_s16(8);
+                            for( ; d <= D - 8; d += 8 )
                             {
-                                const int xm = x*NR2;
-                                const int xd = xm*D2;
-
-                                int minL0 = MAX_COST;
-                                const int delta0 = minLr[0][xm + NR2] + P2;
-                                CostType* Lr_p0 = Lr[0] + xd + NRD2;
-                                Lr_p0[-1] = Lr_p0[D] = MAX_COST;
-                                CostType* Lr_p = Lr[0] + xd;
-                                const CostType* Cp = C + x*D;
-#if CV_SSE2
-                                if( useSIMD )
-                                {
-                                    __m128i _P1 = _mm_set1_epi16((short)P1);
-                                    __m128i _delta0 = _mm_set1_epi16((short)delta0);
-                                    __m128i _minL0 = _mm_set1_epi16((short)minL0);
-                                    __m128i _minS = _mm_set1_epi16(MAX_COST), _bestDisp = _mm_set1_epi16(-1);
-                                    __m128i _d8 = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7), _8 = _mm_set1_epi16(8);
-                                    for( d = 0; d < D; d += 8 )
-                                    {
-                                        __m128i Cpd = _mm_load_si128((const __m128i*)(Cp + d)), L0;
-                                        L0 = _mm_load_si128((const __m128i*)(Lr_p0 + d));
-                                        L0 = _mm_min_epi16(L0, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p0 + d - 1)), _P1));
-                                        L0 = _mm_min_epi16(L0, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p0 + d + 1)), _P1));
-                                        L0 = _mm_min_epi16(L0, _delta0);
-                                        L0 = _mm_adds_epi16(_mm_subs_epi16(L0, _delta0), Cpd);
-                                        _mm_store_si128((__m128i*)(Lr_p + d), L0);
-                                        _minL0 = _mm_min_epi16(_minL0, L0);
-                                        L0 = _mm_adds_epi16(L0, *(__m128i*)(Sp + d));
-                                        _mm_store_si128((__m128i*)(Sp + d), L0);
-                                        __m128i mask = _mm_cmpgt_epi16(_minS, L0);
-                                        _minS = _mm_min_epi16(_minS, L0);
-                                        _bestDisp = _mm_xor_si128(_bestDisp, _mm_and_si128(_mm_xor_si128(_bestDisp,_d8), mask));
-                                        _d8 = _mm_adds_epi16(_d8, _8);
-                                    }
-                                    short CV_DECL_ALIGNED(16) bestDispBuf[8];
-                                    _mm_store_si128((__m128i*)bestDispBuf, _bestDisp);
-                                    _minL0 = _mm_min_epi16(_minL0, _mm_srli_si128(_minL0, 8));
-                                    _minL0 = _mm_min_epi16(_minL0, _mm_srli_si128(_minL0, 4));
-                                    _minL0 = _mm_min_epi16(_minL0, _mm_srli_si128(_minL0, 2));
-                                    __m128i qS = _mm_min_epi16(_minS, _mm_srli_si128(_minS, 8));
-                                    qS = _mm_min_epi16(qS, _mm_srli_si128(qS, 4));
-                                    qS = _mm_min_epi16(qS, _mm_srli_si128(qS, 2));
-                                    minLr[0][xm] = (CostType)_mm_cvtsi128_si32(_minL0);
-                                    minS = (CostType)_mm_cvtsi128_si32(qS);
-                                    qS = _mm_shuffle_epi32(_mm_unpacklo_epi16(qS, qS), 0);
-                                    qS = _mm_cmpeq_epi16(_minS, qS);
-                                    int idx = _mm_movemask_epi8(_mm_packs_epi16(qS, qS)) & 255;
-                                    bestDisp = bestDispBuf[LSBTab[idx]];
-                                }
-                                else
-#endif
-                                {
-                                    for( d = 0; d < D; d++ )
-                                    {
-                                        const int L0 = Cp[d] + std::min((int)Lr_p0[d], std::min(Lr_p0[d-1] + P1, std::min(Lr_p0[d+1] + P1, delta0))) - delta0;
-                                        Lr_p[d] = (CostType)L0;
-                                        minL0 = std::min(minL0, L0);
-                                        const int Sval = Sp[d] = saturate_cast<CostType>(Sp[d] + L0);
-                                        if( Sval < minS )
-                                        {
-                                            minS = Sval;
-                                            bestDisp = d;
-                                        }
-                                    }
-                                    minLr[0][xm] = (CostType)minL0;
-                                }
+                                v_int16x8 Sval = v_load(Sp + d);
+                                _bestDisp = v_select(v_gt(_minS, Sval), _d8, _bestDisp);
+                                _minS = v_min(_minS, Sval);
+                                _d8 = v_add(_d8, _8);
                             }
-                            else
+                            // each lane keeps the first minimum among its disparities,
+                            // so the first minimum overall is the smallest one of the lanes reaching minS
+                            minS = v_reduce_min(_minS);
+                            bestDisp = v_reduce_min(v_select(v_eq(_minS, v_setall_s16((short)minS)),
+                                _bestDisp, v_setall_s16(SHRT_MAX)));
+#endif
+                            for( ; d < D; d++ )
                             {
-                                for( d = 0; d < D; d++ )
+                                const int Sval = Sp[d];
+                                if( Sval < minS )
                                 {
-                                    const int Sval = Sp[d];
-                                    if( Sval < minS )
-                                    {
-                                        minS = Sval;
-                                        bestDisp = d;
-                                    }
+                                    minS = Sval;
+                                    bestDisp = d;
                                 }
                             }
                             for( d = 0; d < D; d++ )
@@ -554,14 +550,13 @@ namespace cv
                                     break;
                             }
                             if( d < D )
-                                continue;
-                            d = bestDisp;
-                            const int _x2 = x + minX1 - d - minD;
-                            if( disp2cost[_x2] > minS )
                             {
-                                disp2cost[_x2] = (CostType)minS;
-                                disp2ptr[_x2] = (DispType)(d + minD);
+                                bestDispBuf[x] = INT_MIN;
+                                continue;
                             }
+                            d = bestDisp;
+                            bestDispBuf[x] = bestDisp;
+                            minSBuf[x] = minS;
                             if( 0 < d && d < D-1 )
                             {
                                 if(params.subpixelInterpolationMethod == CV_SIMETRICV_INTERPOLATION)
@@ -603,7 +598,25 @@ namespace cv
                                 d *= DISP_SCALE;
                             disp1ptr[x + minX1] = (DispType)(d + minD*DISP_SCALE);
                         }
-                        for( x = minX1; x < maxX1; x++ )
+                    }, nblocks);
+
+                    if( pass == npasses )
+                    {
+                        // the reverse disparity keeps the match of the largest x among the equal costs,
+                        // thus it is updated sequentially, in the same order as before
+                        for( int x = width1 - 1; x >= 0; x-- )
+                        {
+                            const int d = bestDispBuf[x];
+                            if( d == INT_MIN )
+                                continue;
+                            const int _x2 = x + minX1 - d - minD;
+                            if( disp2cost[_x2] > minSBuf[x] )
+                            {
+                                disp2cost[_x2] = (CostType)minSBuf[x];
+                                disp2ptr[_x2] = (DispType)(d + minD);
+                            }
+                        }
+                        for( int x = minX1; x < maxX1; x++ )
                         {
                             // we round the computed disparity both towards -inf and +inf and check
                             // if either of the corresponding disparities in disp2 is consistent.
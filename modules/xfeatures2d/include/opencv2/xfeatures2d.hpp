@@ -445,6 +445,17 @@ public:
      */
     virtual bool GetUnnormalizedDescriptor( double y, double x, int orientation, float* descriptor , double *H ) const = 0;
 
+    /** @brief Sets the memory budget of the dense extraction.
+
+    When the gradient layers of the whole image would take more than this many bytes, the dense
+    compute() builds them band by band instead (256 MB by default). The descriptors are the same,
+    but the layers are not kept, so GetDescriptor() rebuilds them for the whole image on first use.
+
+    The default implementation only reports the built-in budget and does not support changing it.
+     */
+    CV_WRAP virtual void setDenseMemoryBudget(size_t bytes);
+    CV_WRAP virtual size_t getDenseMemoryBudget() const;
+
 };
 
 /** @brief Class implementing the MSD (*Maximal Self-Dissimilarity*) keypoint detector, described in @cite Tombari14.
@@ -1255,6 +1266,17 @@ CV_EXPORTS_W void matchGMS(const Size& size1, const Size& size2, const std::vect
                            const std::vector<DMatch>& matches1to2, CV_OUT std::vector<DMatch>& matchesGMS, const bool withRotation = false,
                            const bool withScale = false, const double thresholdFactor = 6.0);
 
+/** @brief Batched version of matchGMS.
+
+Filters the matches of several image pairs in one call. Pair i is described by sizes1[i], sizes2[i],
+keypoints1[i], keypoints2[i] and matches1to2[i]; its filtered matches are returned in matchesGMS[i].
+The grids are set up once for the whole batch and the pairs are processed in parallel.
+ */
+CV_EXPORTS void matchGMS(const std::vector<Size>& sizes1, const std::vector<Size>& sizes2,
+                         const std::vector<std::vector<KeyPoint> >& keypoints1, const std::vector<std::vector<KeyPoint> >& keypoints2,
+                         const std::vector<std::vector<DMatch> >& matches1to2, std::vector<std::vector<DMatch> >& matchesGMS,
+                         const bool withRotation = false, const bool withScale = false, const double thresholdFactor = 6.0);
+
 /** @brief LOGOS (Local geometric support for high-outlier spatial verification) feature matching strategy described in @cite Lowry2018LOGOSLG .
     @param keypoints1 Input keypoints of image1.
     @param keypoints2 Input keypoints of image2.
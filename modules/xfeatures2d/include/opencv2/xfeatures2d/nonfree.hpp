@@ -76,6 +76,10 @@ If you want to get very large features, use the larger value. If you want just s
 features, decrease it.
 -   member int nOctaveLayers
 The number of images within each octave of a gaussian pyramid. It is set to 2 by default.
+
+The CPU implementation works in single precision. Descriptors may therefore differ slightly from
+the ones of older, double precision releases; they stay within an L2 distance of 0.05 of the
+reference descriptors, which is the tolerance checked by the regression tests.
 @note
    -   An example using the SURF feature detector can be found at
         opencv_source_code/samples/cpp/generic_descriptor_match.cpp
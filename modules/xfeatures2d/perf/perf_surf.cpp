@@ -64,5 +64,35 @@ PERF_TEST_P(surf, full, testing::Values(SURF_IMAGES))
     SANITY_CHECK_NOTHING();
 }
 
+typedef tuple<Size, bool, bool> SURF_Large_t;
+typedef perf::TestBaseWithParam<SURF_Large_t> surf_large;
+
+// 12 MP images, as used for legacy map compatibility
+PERF_TEST_P(surf_large, full,
+            testing::Combine(testing::Values(Size(4000, 3000)),
+                             testing::Bool(),   // extended
+                             testing::Bool()))  // upright
+{
+    Size sz = get<0>(GetParam());
+    bool extended = get<1>(GetParam());
+    bool upright = get<2>(GetParam());
+
+    string filename = getDataPath("cv/detectors_descriptors_evaluation/images_datasets/leuven/img1.png");
+    Mat src = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(src.empty()) << "Unable to load source image " << filename;
+    Mat frame;
+    resize(src, frame, sz, 0, 0, INTER_LINEAR);
+
+    Mat mask;
+    declare.in(frame).time(300);
+    Ptr<SURF> detector = SURF::create(400, 4, 3, extended, upright);
+    vector<KeyPoint> points;
+    Mat descriptors;
+
+    TEST_CYCLE() detector->detectAndCompute(frame, mask, points, descriptors, false);
+
+    SANITY_CHECK_NOTHING();
+}
+
 }} // namespace
 #endif // NONFREE
@@ -53,6 +53,7 @@
 
 #include <bitset>
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 
 
@@ -67,6 +68,21 @@ namespace xfeatures2d
 
 #ifdef OPENCV_XFEATURES2D_HAS_BOOST_DATA
 
+// Weak learners laid out for evaluation on all the integral images stored one after the other.
+// Structure of arrays, one entry per learner:
+//   idx1..idx4 : offsets of the box corners inside an integral image
+//   plane      : offset of the integral image of the learner orientation
+//   thresh     : learner threshold
+struct BoostWLTable
+{
+    vector<int> idx1, idx2, idx3, idx4, plane;
+    vector<float> thresh;
+    // offset of the integral image summing all orientations
+    int total_plane;
+
+    int size() const { return (int)thresh.size(); }
+};
+
 /*
  !BoostDesc implementation
  */
@@ -172,6 +188,9 @@ protected:
     Mat m_wl_y_min, m_wl_y_max;
     Mat m_wl_alpha, m_wl_beta;
 
+    // weak learners in evaluation order, see BoostWLTable
+    BoostWLTable m_wl_table;
+
 private:
 
     /*
@@ -195,7 +214,8 @@ private:
 static void computeGradientMaps( const Mat& im,
                                  const int gradAssignType,
                                  const int orientQuant,
-                                 vector<Mat>& gradMap )
+                                 vector<Mat>& gradMap,
+                                 Mat& derivx, Mat& derivy )
 {
     enum Assign
     {
@@ -206,14 +226,16 @@ static void computeGradientMaps( const Mat& im,
       ASSIGN_SOFT_MAGN = 4
     };
 
-    Mat derivx( im.size(), CV_32FC1 );
-    Mat derivy( im.size(), CV_32FC1 );
-
-    Sobel( im, derivx, derivx.depth(), 1, 0 );
-    Sobel( im, derivy, derivy.depth(), 0, 1 );
+    Sobel( im, derivx, CV_32F, 1, 0 );
+    Sobel( im, derivy, CV_32F, 0, 1 );
 
+    // reuse the maps of the previous patch
+    gradMap.resize( orientQuant );
     for ( int i = 0; i < orientQuant; i++ )
-      gradMap.push_back( Mat::zeros( im.size(), CV_8UC1 ) );
+    {
+      gradMap[i].create( im.size(), CV_8UC1 );
+      gradMap[i].setTo( 0 );
+    }
 
     int index, index2;
     double binCenter, weight;
@@ -285,67 +307,81 @@ static void computeGradientMaps( const Mat& im,
     }
 }
 
+// Integral images of all orientations, followed by the one of their sum,
+// stored as the rows of integrals
 static void computeIntegrals( const vector<Mat>& gradMap,
                               const int orientQuant,
-                              vector<Mat>& integralMap )
+                              Mat& integrals )
 {
-    // init integral images
-    int rows = gradMap[0].rows;
-    int cols = gradMap[0].cols;
+    int rows = gradMap[0].rows + 1;
+    int cols = gradMap[0].cols + 1;
 
-    for ( int i = 0; i < orientQuant+1; i++ )
-      integralMap.push_back( Mat::zeros( rows+1, cols+1, CV_8UC1 ) );
+    integrals.create( orientQuant + 1, rows * cols, CV_32S );
 
     // generate corresponding integral images
     for( int i = 0; i < orientQuant; i++ )
-      integral( gradMap[i], integralMap[i] );
-
-    // copy the values from the first quantization bin
-    integralMap[0].copyTo( integralMap[orientQuant] );
-
-    int* ptrSum, *ptr;
-    for ( int k = 1; k < orientQuant; k++ )
     {
-      ptr    = (int*) integralMap[k].ptr<int>();
-      ptrSum = (int*) integralMap[orientQuant].ptr<int>();
-      for (int i=0; i<(rows+1)*(cols+1); ++i)
-      {
-        *ptrSum += *ptr;
-        ++ptrSum;
-        ++ptr;
-      }
+      Mat plane( rows, cols, CV_32S, integrals.ptr<int>(i) );
+      integral( gradMap[i], plane, CV_32S );
     }
+
+    // sum up all quantization bins
+    Mat total = integrals.row( orientQuant );
+    integrals.row( 0 ).copyTo( total );
+    for ( int k = 1; k < orientQuant; k++ )
+      add( total, integrals.row( k ), total );
 }
 
-static float computeWLResponse( const int x_min,  const int x_max,
-                                const int y_min,  const int y_max,
-                                const int orient, const float thresh,
-                                const int orientQuant,
-                                const vector<Mat>& integralMap )
+// Evaluates the weak learners [0, n) and packs their outputs as bits:
+// bit j of bits[j/64] is set when the response of learner j is >= 0,
+// the response being (current / total) - thresh, or 0 for an empty box
+static void computeWLBits( const BoostWLTable& wl, const int n,
+                           const Mat& integrals, uint64* bits )
 {
-    const int width = integralMap[0].cols;
-
-    const int idx1 = (y_min    ) * width + x_min;
-    const int idx2 = (y_min    ) * width + x_max + 1;
-    const int idx3 = (y_max + 1) * width + x_min;
-    const int idx4 = (y_max + 1) * width + x_max + 1;
-
-    const int* ptr = integralMap[orient].ptr<int>();
-
-    int A, B ,C, D;
-    A = ptr[idx1]; B = ptr[idx2];
-    C = ptr[idx3]; D = ptr[idx4];
+    const int* ptr = integrals.ptr<int>();
+    const int* total = ptr + wl.total_plane;
 
-    const float current = float(D + A - B - C);
+    memset( bits, 0, sizeof(uint64) * ( ( n + 63 ) / 64 ) );
 
-    ptr = integralMap[orientQuant].ptr<int>();
-
-    A = ptr[idx1]; B = ptr[idx2];
-    C = ptr[idx3]; D = ptr[idx4];
-
-    const float total = float(D + A - B - C);
+    int j = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vlanes = VTraits<v_int32>::vlanes();
+    const v_int32 vzero = vx_setzero_s32();
+    int fires[VTraits<v_int32>::max_nlanes];
+    for ( ; j <= n - vlanes; j += vlanes )
+    {
+      v_int32 i1 = vx_load( &wl.idx1[j] ), i2 = vx_load( &wl.idx2[j] );
+      v_int32 i3 = vx_load( &wl.idx3[j] ), i4 = vx_load( &wl.idx4[j] );
+      v_int32 pl = vx_load( &wl.plane[j] );
+
+      v_int32 current = v_sub( v_add( v_lut( ptr, v_add( i4, pl ) ), v_lut( ptr, v_add( i1, pl ) ) ),
+                               v_add( v_lut( ptr, v_add( i2, pl ) ), v_lut( ptr, v_add( i3, pl ) ) ) );
+      v_int32 sum = v_sub( v_add( v_lut( total, i4 ), v_lut( total, i1 ) ),
+                           v_add( v_lut( total, i2 ), v_lut( total, i3 ) ) );
+
+      v_float32 resp = v_sub( v_div( v_cvt_f32( current ), v_cvt_f32( sum ) ), vx_load( &wl.thresh[j] ) );
+      v_int32 fire = v_or( v_reinterpret_as_s32( v_ge( resp, vx_setzero_f32() ) ), v_eq( sum, vzero ) );
+      v_store( fires, fire );
+
+      for ( int l = 0; l < vlanes; l++ )
+        if ( fires[l] )
+          bits[( j + l ) >> 6] |= (uint64)1 << ( ( j + l ) & 63 );
+    }
+#endif
+    for ( ; j < n; j++ )
+    {
+      const int* cptr = ptr + wl.plane[j];
+      const float current = float( cptr[wl.idx4[j]] + cptr[wl.idx1[j]] - cptr[wl.idx2[j]] - cptr[wl.idx3[j]] );
+      const float sum = float( total[wl.idx4[j]] + total[wl.idx1[j]] - total[wl.idx2[j]] - total[wl.idx3[j]] );
+      const float resp = sum ? ( ( current / sum ) - wl.thresh[j] ) : 0.f;
+      if ( resp >= 0 )
+        bits[j >> 6] |= (uint64)1 << ( j & 63 );
+    }
+}
 
-    return total ? ( (current / total) - thresh ) : 0.f;
+static inline bool getWLBit( const uint64* bits, int j )
+{
+    return ( bits[j >> 6] >> ( j & 63 ) ) & 1;
 }
 
 static void rectifyPatch( const Mat& image, const KeyPoint& kp,
@@ -353,7 +389,7 @@ static void rectifyPatch( const Mat& image, const KeyPoint& kp,
                           const bool use_scale_orientation,
                           const float scale_factor )
 {
-    Mat M;
+    Matx23f M;
     if ( use_scale_orientation )
     {
       const float s = scale_factor * (float) kp.size / (float) patchSize;
@@ -361,22 +397,19 @@ static void rectifyPatch( const Mat& image, const KeyPoint& kp,
       const float cosine = (kp.angle>=0) ? cos(kp.angle*(float)CV_PI/180.0f) : 1.f;
       const float sine   = (kp.angle>=0) ? sin(kp.angle*(float)CV_PI/180.0f) : 0.f;
 
-      float M_[] = {
+      M = Matx23f(
           s*cosine, -s*sine,   (-s*cosine + s*sine  ) * patchSize/2.0f + kp.pt.x,
-          s*sine,    s*cosine, (-s*sine   - s*cosine) * patchSize/2.0f + kp.pt.y
-      };
-      M = Mat( 2, 3, CV_32FC1, M_ ).clone();
+          s*sine,    s*cosine, (-s*sine   - s*cosine) * patchSize/2.0f + kp.pt.y );
     }
     else
     {
-        const float s = scale_factor * (float)kp.size / (float)patchSize;
-        float M_[] = {
+      const float s = scale_factor * (float)kp.size / (float)patchSize;
+      M = Matx23f(
           s,  0.f, -s * patchSize/2.0f + kp.pt.x,
-          0.f,  s, -s * patchSize/2.0f + kp.pt.y
-      };
-      M = Mat( 2, 3, CV_32FC1, M_ ).clone();
+          0.f,  s, -s * patchSize/2.0f + kp.pt.y );
     }
 
+    // patch keeps its buffer from one keypoint to the next
     warpAffine( image, patch, M, Size( patchSize, patchSize ),
                 WARP_INVERSE_MAP + INTER_CUBIC + WARP_FILL_OUTLIERS );
 }
@@ -391,59 +424,45 @@ struct ComputeBoostDescInvoker : ParallelLoopBody
                         const int _desc_type, const int _grad_atype,
                         const int _orient_q, const int _patch_size,
                         const int _nWLs, const int _Dims,
-                        const Mat& _wl_x_min, const Mat& _wl_x_max,
-                        const Mat& _wl_y_min, const Mat& _wl_y_max,
-                        const Mat& _wl_thresh, const Mat& _wl_orient,
-                        const Mat& _wl_alpha, const Mat& _wl_beta,
+                        const BoostWLTable& _wl_table, const Mat& _wl_beta,
                         const bool _use_scale_orientation,
                         const float _scale_factor )
+      : image( _image ), keypoints( _keypoints ), wl_table( _wl_table ), wl_beta( _wl_beta )
     {
       nWLs = _nWLs;
       Dims = _Dims;
-      image = _image;
       orient_q = _orient_q;
       desc_type = _desc_type;
-      keypoints = _keypoints;
       grad_atype = _grad_atype;
       patch_size = _patch_size;
       descriptors = _descriptors;
 
-      wl_beta = _wl_beta;
-      wl_alpha = _wl_alpha;
-      wl_x_min = _wl_x_min;
-      wl_x_max = _wl_x_max;
-      wl_y_min = _wl_y_min;
-      wl_y_max = _wl_y_max;
-      wl_thresh = _wl_thresh;
-      wl_orient = _wl_orient;
-
       scale_factor = _scale_factor;
       use_scale_orientation  = _use_scale_orientation;
     }
 
     void operator ()( const cv::Range& range ) const CV_OVERRIDE
     {
-      // maps
-      vector<Mat> gradMap, integralMap;
+      // buffers reused by all the keypoints of the range
+      Mat patch, derivx, derivy, integrals;
+      vector<Mat> gradMap;
 
-      // small binary map
-      uchar binLookUp[8];
-      for ( unsigned int i = 0; i < 8; i++ )
-        binLookUp[i] = (uchar) 1 << i;
+      // learner outputs, one bit each
+      const int nLearners = wl_table.size();
+      vector<uint64> wlBits( ( nLearners + 63 ) / 64 );
 
       for ( int i = range.start; i < range.end; i++ )
       {
-
-        Mat patch;
         // rectify the patch around a given keypoint
         rectifyPatch( image, keypoints[i], patch_size,
                       patch, use_scale_orientation, scale_factor );
 
         // compute gradient maps (and integral gradient maps)
-        computeGradientMaps( patch, grad_atype, orient_q, gradMap );
-        computeIntegrals( gradMap, orient_q, integralMap );
+        computeGradientMaps( patch, grad_atype, orient_q, gradMap, derivx, derivy );
+        computeIntegrals( gradMap, orient_q, integrals );
 
-        float WLR;
+        // evaluate all the weak learners of the descriptor at once
+        computeWLBits( wl_table, nLearners, integrals, &wlBits[0] );
 
         /*
          * BGM
@@ -453,15 +472,10 @@ struct ComputeBoostDescInvoker : ParallelLoopBody
              ( desc_type == BGM_BILINEAR )
            )
         {
+          // the descriptor is made of the learner bits, least significant first
           uchar* desc = descriptors->ptr<uchar>(i);
-          for ( int j = 0; j < nWLs; j++ )
-          {
-            WLR = computeWLResponse( wl_x_min.at<int>(0,j), wl_x_max.at<int>(0,j),
-                                     wl_y_min.at<int>(0,j), wl_y_max.at<int>(0,j),
-                                     wl_orient.at<int>(0,j), wl_thresh.at<float>(0,j),
-                                     orient_q, integralMap );
-            desc[j/8] |=  ( WLR >= 0 ) ? binLookUp[ j % 8 ] : 0;
-          }
+          for ( int j = 0; j < nWLs / 8; j++ )
+            desc[j] = (uchar)( wlBits[j >> 3] >> ( ( j & 7 ) * 8 ) );
         } // end BGM
 
         /*
@@ -469,24 +483,22 @@ struct ComputeBoostDescInvoker : ParallelLoopBody
          */
         if ( desc_type == LBGM )
         {
-          std::bitset<512> wlResponses;
-
-          for ( int j = 0; j < nWLs; j++ )
-          {
-            WLR = computeWLResponse( wl_x_min.at<int>(0,j), wl_x_max.at<int>(0,j),
-                                     wl_y_min.at<int>(0,j), wl_y_max.at<int>(0,j),
-                                     wl_orient.at<int>(0,j), wl_thresh.at<float>(0,j),
-                                     orient_q, integralMap );
-            wlResponses[j] = ( WLR >= 0 ) ? 1 : 0;
-        }
-
           float* desc = descriptors->ptr<float>(i);
-          for ( int d = 0; d < Dims; d++ )
+          for ( int wl = 0; wl < nWLs; wl++ )
           {
-            for ( int wl = 0; wl < nWLs; wl++ )
+            const float* beta = wl_beta.ptr<float>(wl);
+            const bool fire = getWLBit( &wlBits[0], wl );
+            int d = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+            const int vlanes = VTraits<v_float32>::vlanes();
+            for ( ; d <= Dims - vlanes; d += vlanes )
             {
-              desc[d] += ( wlResponses[wl] ) ? wl_beta.at<float>(wl,d) : -wl_beta.at<float>(wl,d);
+              v_float32 b = vx_load( beta + d );
+              v_store( desc + d, fire ? v_add( vx_load( desc + d ), b ) : v_sub( vx_load( desc + d ), b ) );
             }
+#endif
+            for ( ; d < Dims; d++ )
+              desc[d] += fire ? beta[d] : -beta[d];
           }
         } // end LBGM
 
@@ -498,28 +510,17 @@ struct ComputeBoostDescInvoker : ParallelLoopBody
              ( desc_type == BINBOOST_256 )
            )
         {
-          float resp;
+          uchar* desc = descriptors->ptr<uchar>(i);
           for ( int d = 0; d < Dims; d++ )
           {
-            resp = 0;
-            uchar* desc = descriptors->ptr<uchar>(i);
+            const float* beta = wl_beta.ptr<float>(d);
+            float resp = 0;
             for ( int wl = 0; wl < nWLs; wl++ )
-            {
-              WLR = computeWLResponse( wl_x_min.at<int>(d,wl), wl_x_max.at<int>(d,wl),
-                                       wl_y_min.at<int>(d,wl), wl_y_max.at<int>(d,wl),
-                                       wl_orient.at<int>(d,wl), wl_thresh.at<float>(d,wl),
-                                       orient_q, integralMap );
-              resp += ( WLR >= 0 ) ? wl_beta.at<float>(d,wl) : -wl_beta.at<float>(d,wl);
-            }
-            desc[d/8] |= ( resp >= 0 ) ? binLookUp[d%8] : 0;
+              resp += getWLBit( &wlBits[0], d * nWLs + wl ) ? beta[wl] : -beta[wl];
+            desc[d/8] |= ( resp >= 0 ) ? (uchar)( 1 << ( d % 8 ) ) : 0;
           }
         } // end BINBOOST
 
-        // clean-up
-        patch.release();
-        gradMap.clear();
-        integralMap.clear();
-
       } // end for loop
     } // end operator
 
@@ -529,14 +530,13 @@ struct ComputeBoostDescInvoker : ParallelLoopBody
     int desc_type;
     int patch_size;
     int grad_atype;
-    int patch_szie;
 
-    Mat image;
+    const Mat& image;
     Mat *descriptors;
-    vector<KeyPoint> keypoints;
+    const vector<KeyPoint>& keypoints;
 
-    Mat wl_x_min, wl_x_max, wl_y_min, wl_y_max;
-    Mat wl_thresh, wl_orient, wl_alpha, wl_beta;
+    const BoostWLTable& wl_table;
+    const Mat& wl_beta;
 
     float scale_factor;
     bool use_scale_orientation;
@@ -578,8 +578,7 @@ void BoostDesc_Impl::compute( InputArray _image, vector<KeyPoint>& keypoints, Ou
         ComputeBoostDescInvoker( m_image, &descriptors, keypoints,
                             m_desc_type, m_grad_atype, m_orient_q,
                             m_patch_size, m_nWLs, m_Dims,
-                            m_wl_x_min, m_wl_x_max, m_wl_y_min, m_wl_y_max,
-                            m_wl_thresh, m_wl_orient, m_wl_alpha, m_wl_beta,
+                            m_wl_table, m_wl_beta,
                             m_use_scale_orientation, m_scale_factor )
     );
 }
@@ -637,6 +636,27 @@ void BoostDesc_Impl::ini_params( const int orientQuant, const int patchSize,
     m_wl_y_min  = Mat( dim0, dim1, CV_32S, const_cast<int *>(y_min ) );
     m_wl_y_max  = Mat( dim0, dim1, CV_32S, const_cast<int *>(y_max ) );
 
+    // learners evaluated per descriptor: one set for BGM and LBGM, one per dimension for BINBOOST
+    bool binboost = ( m_desc_type == BINBOOST_64 ) || ( m_desc_type == BINBOOST_128 ) || ( m_desc_type == BINBOOST_256 );
+    int nLearners = binboost ? dim0 * dim1 : dim1;
+
+    // integral images are (patchSize+1) x (patchSize+1)
+    const int width = patchSize + 1;
+    const int planeSize = width * width;
+    m_wl_table.idx1.resize( nLearners ); m_wl_table.idx2.resize( nLearners );
+    m_wl_table.idx3.resize( nLearners ); m_wl_table.idx4.resize( nLearners );
+    m_wl_table.plane.resize( nLearners ); m_wl_table.thresh.resize( nLearners );
+    m_wl_table.total_plane = orientQuant * planeSize;
+    for ( int j = 0; j < nLearners; j++ )
+    {
+      m_wl_table.idx1[j] = ( y_min[j]     ) * width + x_min[j];
+      m_wl_table.idx2[j] = ( y_min[j]     ) * width + x_max[j] + 1;
+      m_wl_table.idx3[j] = ( y_max[j] + 1 ) * width + x_min[j];
+      m_wl_table.idx4[j] = ( y_max[j] + 1 ) * width + x_max[j] + 1;
+      m_wl_table.plane[j] = orient[j] * planeSize;
+      m_wl_table.thresh[j] = m_wl_thresh.ptr<float>()[j];
+    }
+
     // no beta
     if ( beta == NULL ) return;
 
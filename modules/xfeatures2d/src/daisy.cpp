@@ -49,6 +49,7 @@
  */
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 #include <fstream>
 #include <stdlib.h>
@@ -71,6 +72,10 @@ const static int g_grid_orientation_resolution = 360;
 static const int MAX_CUBE_NO = 64;
 static const int MAX_NORMALIZATION_ITER = 5;
 
+// default memory budget of the dense extraction: the gradient layers of the whole image
+// are kept only below this size, larger images are processed in bands of rows
+static const size_t DENSE_LAYERS_MEMORY_BUDGET = (size_t)256 << 20;
+
 int g_selected_cubes[MAX_CUBE_NO]; // m_rad_q_no < MAX_CUBE_NO
 
 void DAISY::compute( InputArrayOfArrays images,
@@ -143,6 +148,9 @@ public:
     void setUseOrientation(bool use_orientation) CV_OVERRIDE { m_use_orientation = use_orientation; }
     bool getUseOrientation() const CV_OVERRIDE { return m_use_orientation; }
 
+    void setDenseMemoryBudget(size_t bytes) CV_OVERRIDE { m_dense_memory_budget = bytes; }
+    size_t getDenseMemoryBudget() const CV_OVERRIDE { return m_dense_memory_budget; }
+
     /** returns the descriptor length in bytes */
     virtual int descriptorSize() const CV_OVERRIDE {
         // +1 is for center pixel
@@ -258,6 +266,9 @@ protected:
     // switch to enable sample by keypoints orientation
     bool m_use_orientation;
 
+    // size of the gradient layers above which dense extraction works in bands of rows
+    size_t m_dense_memory_budget;
+
     /*
      * DAISY arrays
      */
@@ -274,7 +285,11 @@ protected:
     // stores the layered gradients in successively smoothed form :
     // layer[n] = m_gradient_layers * gaussian( sigma_n );
     // n>= 1; layer[0] is the layered_gradient
-    std::vector<Mat> m_smoothed_gradient_layers;
+    // a banded dense compute leaves them empty, the Get* accessors then build them
+    mutable std::vector<Mat> m_smoothed_gradient_layers;
+
+    // guards the on demand build of m_smoothed_gradient_layers
+    mutable Mutex m_layers_mutex;
 
     // hold the scales of the pixels
     Mat m_scale_map;
@@ -295,6 +310,13 @@ protected:
     // holds the amount of shift that's required for histogram computation
     double m_orientation_shift_table[360];
 
+    // copy of the image and of the parameters the current layers were computed for,
+    // so that successive compute calls on the same image reuse them
+    Mat m_cached_image;
+    float m_cached_rad;
+    int m_cached_rad_q_no;
+    int m_cached_hist_th_q_no;
+
 
 private:
 
@@ -303,7 +325,14 @@ private:
      */
 
     // initializes the class: computes gradient and structure-points
-    inline void initialize();
+    inline void initialize( const Mat& image, std::vector<Mat>& layers ) const;
+
+    // computes the smoothed gradient layers of the given image
+    inline void build_layers( const Mat& image, std::vector<Mat>& layers ) const;
+
+    // layers of the whole image for the single descriptor accessors,
+    // built here if the last dense compute worked in bands
+    inline const std::vector<Mat>* whole_image_layers() const;
 
     // initializes for get_descriptor(double, double, int) mode: pre-computes
     // convolutions of gradient layers in m_smoothed_gradient_layers
@@ -315,6 +344,16 @@ private:
     // image set image as working
     inline void set_image( InputArray image );
 
+    // sets the image and the parameters; returns true if the layers computed
+    // by the previous call are still valid for them
+    inline bool set_image_cached( InputArray image );
+
+    // remembers the image the current layers were computed for
+    inline void cache_layers( const Mat& image );
+
+    // number of rows around a band which influence the descriptors of the band
+    inline int band_halo() const;
+
     // releases all the used memory; call this if you want to process
     // multiple images within a loop.
     inline void reset();
@@ -325,13 +364,19 @@ private:
     // computes the descriptors for every pixel in the image.
     inline void compute_descriptors( Mat* m_dense_descriptors );
 
+    // same, computing the layers band by band to bound the memory use
+    inline void compute_descriptors_banded( Mat* m_dense_descriptors, int band_rows );
+
+    // computes the dense descriptors of the roi, reusing or building the layers
+    inline void compute_dense( InputArray image, OutputArray descriptors );
+
     // computes scales for every pixel and scales the structure grid so that the
     // resulting descriptors are scale invariant.  you must set
     // m_scale_invariant flag to 1 for the program to call this function
     inline void compute_scales();
 
     // compute the smoothed gradient layers.
-    inline void compute_smoothed_gradient_layers();
+    inline void compute_smoothed_gradient_layers( std::vector<Mat>& layers ) const;
 
     // computes pixel orientations and rotates the structure grid so that
     // resulting descriptors are rotation invariant. If the scales is also
@@ -343,7 +388,7 @@ private:
     inline void compute_histogram( float* hcube, int y, int x, float* histogram );
 
     // reorganizes the cube data so that histograms are sequential in memory.
-    inline void compute_histograms();
+    inline void compute_histograms( std::vector<Mat>& layers ) const;
 
     // computes the sigma's of layers from descriptor parameters if the user did
     // not sets it. these define the size of the petals of the descriptor.
@@ -378,6 +423,8 @@ inline void DAISY_Impl::reset()
     for (size_t i=0; i<m_smoothed_gradient_layers.size(); i++)
       m_smoothed_gradient_layers[i].release();
     m_smoothed_gradient_layers.clear();
+
+    m_cached_image.release();
 }
 
 inline void DAISY_Impl::release_auxiliary()
@@ -629,6 +676,28 @@ static void ni_get_histogram( float* histogram, const int y, const int x, const
     }
 }
 
+// histogram[h] = w0*A[h] + w1*C[h] + w2*B[h] + w3*D[h] for n consecutive bins
+static inline void bi_interpolate_bins( float* histogram, const float* A, const float* B, const float* C, const float* D,
+                                        const float w0, const float w1, const float w2, const float w3, const int n )
+{
+    int h = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vlanes = VTraits<v_float32>::vlanes();
+    const v_float32 v_w0 = vx_setall_f32(w0), v_w1 = vx_setall_f32(w1);
+    const v_float32 v_w2 = vx_setall_f32(w2), v_w3 = vx_setall_f32(w3);
+    for( ; h <= n - vlanes; h += vlanes )
+    {
+      v_float32 v = v_mul(v_w0, vx_load(A + h));
+      v = v_add(v, v_mul(v_w1, vx_load(C + h)));
+      v = v_add(v, v_mul(v_w2, vx_load(B + h)));
+      v = v_add(v, v_mul(v_w3, vx_load(D + h)));
+      v_store(histogram + h, v);
+    }
+#endif
+    for( ; h < n; h++ )
+      histogram[h] = w0 * A[h] + w1 * C[h] + w2 * B[h] + w3 * D[h];
+}
+
 static void bi_get_histogram( float* histogram, const double y, const double x, const int shift, const Mat* hcube )
 {
     int mnx = int( x );
@@ -655,24 +724,10 @@ static void bi_get_histogram( float* histogram, const double y, const double x,
     float w2 = (float) ( alpha - w0   );         // (1-beta)*alpha;
     float w3 = (float) ( 1 + w0 - alpha - beta); // (1-beta)*(1-alpha);
 
-    int h;
-
-    for( h=0; h<_hist_th_q_no; h++ ) {
-      if( h+shift < _hist_th_q_no ) histogram[h] = w0 * A[h+shift];
-      else                          histogram[h] = w0 * A[h+shift-_hist_th_q_no];
-    }
-    for( h=0; h<_hist_th_q_no; h++ ) {
-      if( h+shift < _hist_th_q_no ) histogram[h] += w1 * C[h+shift];
-      else                          histogram[h] += w1 * C[h+shift-_hist_th_q_no];
-    }
-    for( h=0; h<_hist_th_q_no; h++ ) {
-      if( h+shift < _hist_th_q_no ) histogram[h] += w2 * B[h+shift];
-      else                          histogram[h] += w2 * B[h+shift-_hist_th_q_no];
-    }
-    for( h=0; h<_hist_th_q_no; h++ ) {
-      if( h+shift < _hist_th_q_no ) histogram[h] += w3 * D[h+shift];
-      else                          histogram[h] += w3 * D[h+shift-_hist_th_q_no];
-    }
+    // the shift rotates the bins: [shift, hist_th_q_no) then [0, shift)
+    int n = _hist_th_q_no - shift;
+    bi_interpolate_bins( histogram, A + shift, B + shift, C + shift, D + shift, w0, w1, w2, w3, n );
+    bi_interpolate_bins( histogram + n, A, B, C, D, w0, w1, w2, w3, shift );
 }
 
 static void ti_get_histogram( float* histogram, const double y, const double x, const double shift, const Mat* hcube )
@@ -967,7 +1022,7 @@ static bool get_descriptor_h( const double y, const double x, const int orientat
 
 void DAISY_Impl::GetDescriptor( double y, double x, int orientation, float* descriptor ) const
 {
-    get_descriptor( y, x, orientation, descriptor, &m_smoothed_gradient_layers,
+    get_descriptor( y, x, orientation, descriptor, whole_image_layers(),
                     &m_oriented_grid_points, m_orientation_shift_table, m_th_q_no,
                     m_hist_th_q_no, m_grid_point_number, m_descriptor_size, m_enable_interpolation,
                     m_nrm_type );
@@ -976,7 +1031,7 @@ void DAISY_Impl::GetDescriptor( double y, double x, int orientation, float* desc
 bool DAISY_Impl::GetDescriptor( double y, double x, int orientation, float* descriptor, double* H ) const
 {
   return
-  get_descriptor_h( y, x, orientation, descriptor, H, &m_smoothed_gradient_layers,
+  get_descriptor_h( y, x, orientation, descriptor, H, whole_image_layers(),
                     m_cube_sigmas, &m_grid_points, m_orientation_shift_table, m_th_q_no,
                     m_hist_th_q_no, m_grid_point_number, m_descriptor_size, m_enable_interpolation,
                     m_nrm_type );
@@ -984,7 +1039,7 @@ bool DAISY_Impl::GetDescriptor( double y, double x, int orientation, float* desc
 
 void DAISY_Impl::GetUnnormalizedDescriptor( double y, double x, int orientation, float* descriptor ) const
 {
-    get_unnormalized_descriptor( y, x, orientation, descriptor, &m_smoothed_gradient_layers,
+    get_unnormalized_descriptor( y, x, orientation, descriptor, whole_image_layers(),
                                  &m_oriented_grid_points, m_orientation_shift_table, m_th_q_no,
                                  m_enable_interpolation );
 }
@@ -992,7 +1047,7 @@ void DAISY_Impl::GetUnnormalizedDescriptor( double y, double x, int orientation,
 bool DAISY_Impl::GetUnnormalizedDescriptor( double y, double x, int orientation, float* descriptor, double* H ) const
 {
   return
-  get_unnormalized_descriptor_h( y, x, orientation, descriptor, H, &m_smoothed_gradient_layers,
+  get_unnormalized_descriptor_h( y, x, orientation, descriptor, H, whole_image_layers(),
                                  m_cube_sigmas, &m_grid_points, m_orientation_shift_table, m_th_q_no,
                                  m_enable_interpolation );
 }
@@ -1026,15 +1081,15 @@ inline void DAISY_Impl::compute_grid_points()
 
 struct ComputeDescriptorsInvoker : ParallelLoopBody
 {
-    ComputeDescriptorsInvoker( Mat* _descriptors, Mat* _image, Rect* _roi,
-                               std::vector<Mat>* _layers, Mat* _orientation_map,
+    // _layers_y is the image row of the first row of _layers
+    ComputeDescriptorsInvoker( Mat* _descriptors, Rect* _roi,
+                               std::vector<Mat>* _layers, int _layers_y, Mat* _orientation_map,
                                Mat* _oriented_grid_points, double* _orientation_shift_table,
                                int _th_q_no, bool _enable_interpolation )
     {
-      x_off = _roi->x;
-      x_end = _roi->x + _roi->width;
-      image = _image;
+      roi = *_roi;
       layers = _layers;
+      layers_y = _layers_y;
       th_q_no = _th_q_no;
       descriptors = _descriptors;
       orientation_map = _orientation_map;
@@ -1048,15 +1103,15 @@ struct ComputeDescriptorsInvoker : ParallelLoopBody
       int index, orientation;
       for (int y = range.start; y < range.end; ++y)
       {
-        for( int x = x_off; x < x_end; x++ )
+        for( int x = roi.x; x < roi.x + roi.width; x++ )
         {
-          index = y*image->cols + x;
+          index = (y - roi.y)*roi.width + (x - roi.x);
           orientation = 0;
           if( !orientation_map->empty() )
               orientation = (int) orientation_map->at<ushort>( y, x );
           if( !( orientation >= 0 && orientation < g_grid_orientation_resolution ) )
               orientation = 0;
-          get_unnormalized_descriptor( y, x, orientation, descriptors->ptr<float>( index ),
+          get_unnormalized_descriptor( y - layers_y, x, orientation, descriptors->ptr<float>( index ),
                                        layers, oriented_grid_points, orientation_shift_table,
                                        th_q_no, enable_interpolation );
         }
@@ -1064,13 +1119,14 @@ struct ComputeDescriptorsInvoker : ParallelLoopBody
     }
 
     int th_q_no;
-    int x_off, x_end;
+    Rect roi;
+    int layers_y;
     std::vector<Mat>* layers;
     Mat *descriptors;
     Mat *orientation_map;
     bool enable_interpolation;
     double* orientation_shift_table;
-    Mat *image, *oriented_grid_points;
+    Mat *oriented_grid_points;
 };
 
 // Computes the descriptor by sampling convoluted orientation maps.
@@ -1085,13 +1141,59 @@ inline void DAISY_Impl::compute_descriptors( Mat* m_dense_descriptors )
     m_dense_descriptors->setTo( Scalar(0) );
 
     parallel_for_( Range(y_off, y_end),
-        ComputeDescriptorsInvoker( m_dense_descriptors, &m_image, &m_roi, &m_smoothed_gradient_layers,
+        ComputeDescriptorsInvoker( m_dense_descriptors, &m_roi, &m_smoothed_gradient_layers, 0,
                                    &m_orientation_map, &m_oriented_grid_points, m_orientation_shift_table,
                                    m_th_q_no, m_enable_interpolation )
     );
 
 }
 
+inline int DAISY_Impl::band_halo() const
+{
+    // support of the gradient filters and of the initial smoothing
+    int halo = 2 + 1 + filter_size( (float)sqrt(g_sigma_init*g_sigma_init-0.25f), 5.0f ) / 2;
+
+    // support of every incremental smoothing
+    for( int r=0; r<m_rad_q_no; r++ )
+    {
+      double sigma = r == 0 ? m_cube_sigmas.at<double>(0)
+                            : sqrt( m_cube_sigmas.at<double>(r  ) * m_cube_sigmas.at<double>(r  )
+                                  - m_cube_sigmas.at<double>(r-1) * m_cube_sigmas.at<double>(r-1) );
+      halo += filter_size( sigma, 5.0f ) / 2;
+    }
+
+    // farthest petal, its interpolation neighbours and the border checks
+    return halo + cvCeil( m_rad ) + 4;
+}
+
+// Computes the descriptors band by band. The layers of a band are computed on the band
+// rows extended by band_halo() rows, so that the descriptors are the same as the ones
+// computed on the layers of the whole image.
+inline void DAISY_Impl::compute_descriptors_banded( Mat* m_dense_descriptors, int band_rows )
+{
+    CV_Assert( !m_scale_invariant && !m_rotation_invariant );
+
+    m_dense_descriptors->setTo( Scalar(0) );
+
+    const int halo = band_halo();
+    const int y_end = m_roi.y + m_roi.height;
+    std::vector<Mat> layers;
+    for( int y0 = m_roi.y; y0 < y_end; y0 += band_rows )
+    {
+      int y1 = std::min( y0 + band_rows, y_end );
+      int layers_y0 = std::max( y0 - halo, 0 );
+      int layers_y1 = std::min( y1 + halo, m_image.rows );
+
+      build_layers( m_image.rowRange( layers_y0, layers_y1 ), layers );
+
+      parallel_for_( Range(y0, y1),
+          ComputeDescriptorsInvoker( m_dense_descriptors, &m_roi, &layers, layers_y0,
+                                     &m_orientation_map, &m_oriented_grid_points, m_orientation_shift_table,
+                                     m_th_q_no, m_enable_interpolation )
+      );
+    }
+}
+
 struct NormalizeDescriptorsInvoker : ParallelLoopBody
 {
     NormalizeDescriptorsInvoker( Mat* _descriptors, DAISY::NormalizationType _nrm_type, int _grid_point_number,
@@ -1130,27 +1232,45 @@ inline void DAISY_Impl::normalize_descriptors( Mat* m_dense_descriptors )
     );
 }
 
-inline void DAISY_Impl::initialize()
+inline void DAISY_Impl::initialize( const Mat& image, std::vector<Mat>& layers ) const
 {
     // no image ?
-    CV_Assert(m_image.rows != 0);
-    CV_Assert(m_image.cols != 0);
+    CV_Assert(image.rows != 0);
+    CV_Assert(image.cols != 0);
 
     // (m_rad_q_no + 1) cubes
     // 3 dims tensor (idhist, img_y, img_x);
-    m_smoothed_gradient_layers.resize( m_rad_q_no + 1 );
+    layers.resize( m_rad_q_no + 1 );
 
-    int dims[3] = { m_hist_th_q_no, m_image.rows, m_image.cols };
+    int dims[3] = { m_hist_th_q_no, image.rows, image.cols };
     for ( int c=0; c<=m_rad_q_no; c++)
-      m_smoothed_gradient_layers[c] = Mat( 3, dims, CV_32F );
+      layers[c].create( 3, dims, CV_32F );
 
-    layered_gradient( m_image, &m_smoothed_gradient_layers[0] );
+    Mat data = image;
+    layered_gradient( data, &layers[0] );
 
     // assuming a 0.5 image smoothness, we pull this to 1.6 as in sift
-    smooth_layers( &m_smoothed_gradient_layers[0], (float)sqrt(g_sigma_init*g_sigma_init-0.25f) );
+    smooth_layers( &layers[0], (float)sqrt(g_sigma_init*g_sigma_init-0.25f) );
 
 }
 
+inline void DAISY_Impl::build_layers( const Mat& image, std::vector<Mat>& layers ) const
+{
+    initialize( image, layers );
+    compute_smoothed_gradient_layers( layers );
+}
+
+inline const std::vector<Mat>* DAISY_Impl::whole_image_layers() const
+{
+    AutoLock lock( m_layers_mutex );
+    if( m_smoothed_gradient_layers.empty() )
+    {
+      CV_Assert( !m_image.empty() && "DAISY: compute() must be called before GetDescriptor()" );
+      build_layers( m_image, m_smoothed_gradient_layers );
+    }
+    return &m_smoothed_gradient_layers;
+}
+
 inline void DAISY_Impl::compute_cube_sigmas()
 {
     if( m_cube_sigmas.empty() )
@@ -1205,33 +1325,35 @@ struct ComputeHistogramsInvoker : ParallelLoopBody
     std::vector<Mat> *layers;
 };
 
-inline void DAISY_Impl::compute_histograms()
+inline void DAISY_Impl::compute_histograms( std::vector<Mat>& layers ) const
 {
     for( int r=0; r<m_rad_q_no; r++ )
     {
       // remap cubes from Mat(h,y,x) -> Mat(y,x,h)
       // final sampling is speeded up by aligned h dim
-      int m_h = m_smoothed_gradient_layers.at(r).size[0];
-      int m_y = m_smoothed_gradient_layers.at(r).size[1];
-      int m_x = m_smoothed_gradient_layers.at(r).size[2];
+      int m_h = layers.at(r).size[0];
+      int m_y = layers.at(r).size[1];
+      int m_x = layers.at(r).size[2];
 
       // empty targeted cube
-      m_smoothed_gradient_layers.at(r).release();
+      layers.at(r).release();
 
       // recreate cube space
       int dims[3] = { m_y, m_x, m_h };
-      m_smoothed_gradient_layers.at(r) = Mat( 3, dims, CV_32F );
+      layers.at(r) = Mat( 3, dims, CV_32F );
 
       // copy backward all cubes and realign structure
-      parallel_for_( Range(0, m_image.rows), ComputeHistogramsInvoker( &m_smoothed_gradient_layers, r ) );
+      parallel_for_( Range(0, m_y), ComputeHistogramsInvoker( &layers, r ) );
     }
     // trim unused region from collection of cubes
-    m_smoothed_gradient_layers[m_rad_q_no].release();
-    m_smoothed_gradient_layers.pop_back();
+    layers[m_rad_q_no].release();
+    layers.pop_back();
 }
 
-inline void DAISY_Impl::compute_smoothed_gradient_layers()
+inline void DAISY_Impl::compute_smoothed_gradient_layers( std::vector<Mat>& layers ) const
 {
+    const int rows = layers[0].size[1], cols = layers[0].size[2];
+
     double sigma;
     for( int r=0; r<m_rad_q_no; r++ )
     {
@@ -1246,12 +1368,12 @@ inline void DAISY_Impl::compute_smoothed_gradient_layers()
 
       for( int th=0; th<m_hist_th_q_no; th++ )
       {
-        Mat cvI( m_image.rows, m_image.cols, CV_32F, m_smoothed_gradient_layers[r  ].ptr<float>(th,0,0) );
-        Mat cvO( m_image.rows, m_image.cols, CV_32F, m_smoothed_gradient_layers[r+1].ptr<float>(th,0,0) );
+        Mat cvI( rows, cols, CV_32F, layers[r  ].ptr<float>(th,0,0) );
+        Mat cvO( rows, cols, CV_32F, layers[r+1].ptr<float>(th,0,0) );
         GaussianBlur( cvI, cvO, Size(ks, ks), sigma, sigma, BORDER_REPLICATE );
       }
     }
-    compute_histograms();
+    compute_histograms( layers );
 }
 
 inline void DAISY_Impl::compute_oriented_grid_points()
@@ -1471,8 +1593,7 @@ inline void DAISY_Impl::compute_orientations()
 
 inline void DAISY_Impl::initialize_single_descriptor_mode( )
 {
-    initialize();
-    compute_smoothed_gradient_layers();
+    build_layers( m_image, m_smoothed_gradient_layers );
 }
 
 inline void DAISY_Impl::set_parameters( )
@@ -1516,6 +1637,67 @@ inline void DAISY_Impl::set_image( InputArray _image )
       m_image = image;
 }
 
+inline bool DAISY_Impl::set_image_cached( InputArray _image )
+{
+    Mat image = _image.getMat();
+
+    bool cached = !m_smoothed_gradient_layers.empty() && !m_cached_image.empty() &&
+                  m_cached_rad == m_rad && m_cached_rad_q_no == m_rad_q_no &&
+                  m_cached_hist_th_q_no == m_hist_th_q_no &&
+                  image.size() == m_cached_image.size() && image.type() == m_cached_image.type() &&
+                  norm( image, m_cached_image, NORM_INF ) == 0;
+
+    if( !cached )
+    {
+      set_image( image );
+      // the layer sigmas follow the current parameters
+      m_cube_sigmas.release();
+    }
+    set_parameters();
+
+    return cached;
+}
+
+inline void DAISY_Impl::cache_layers( const Mat& image )
+{
+    m_cached_image = image.clone();
+    m_cached_rad = m_rad;
+    m_cached_rad_q_no = m_rad_q_no;
+    m_cached_hist_th_q_no = m_hist_th_q_no;
+}
+
+inline void DAISY_Impl::compute_dense( InputArray _image, OutputArray _descriptors )
+{
+    _descriptors.create( m_roi.width*m_roi.height, m_descriptor_size, CV_32F );
+
+    Mat descriptors = _descriptors.getMat();
+
+    // compute full desc
+    if( !m_smoothed_gradient_layers.empty() )
+      compute_descriptors( &descriptors );
+    else
+    {
+      size_t row_bytes = (size_t)(m_rad_q_no + 1) * m_hist_th_q_no * m_image.cols * sizeof(float);
+      if( row_bytes * m_image.rows <= m_dense_memory_budget )
+      {
+        initialize_single_descriptor_mode();
+        compute_descriptors( &descriptors );
+      }
+      else
+      {
+        // the layers of every band are dropped once its descriptors are done, so the
+        // banded path keeps no layers for the next call: holding them is what the
+        // budget forbids. Only the image is remembered, a later GetDescriptor() call
+        // builds the whole image layers and compute() then reuses them.
+        int band_rows = std::max( (int)std::min( m_dense_memory_budget / row_bytes, (size_t)INT_MAX )
+                                  - 2*band_halo(), 32 );
+        compute_descriptors_banded( &descriptors, band_rows );
+      }
+      cache_layers( _image.getMat() );
+    }
+    normalize_descriptors( &descriptors );
+}
+
 
 // -------------------------------------------------
 /* DAISY interface implementation */
@@ -1527,7 +1709,11 @@ void DAISY_Impl::compute( InputArray _image, std::vector<KeyPoint>& keypoints, O
     if( _image.getMat().empty() )
       return;
 
-    set_image( _image );
+    if( !set_image_cached( _image ) )
+    {
+      initialize_single_descriptor_mode();
+      cache_layers( _image.getMat() );
+    }
 
     // whole image
     m_roi = Rect( 0, 0, m_image.cols, m_image.rows );
@@ -1539,10 +1725,6 @@ void DAISY_Impl::compute( InputArray _image, std::vector<KeyPoint>& keypoints, O
     if ( H.depth() != CV_64F )
         H.convertTo( H, CV_64F );
 
-    set_parameters();
-
-    initialize_single_descriptor_mode();
-
     // allocate array
     _descriptors.create( (int) keypoints.size(), m_descriptor_size, CV_32F );
 
@@ -1585,20 +1767,11 @@ void DAISY_Impl::compute( InputArray _image, Rect roi, OutputArray _descriptors
     CV_Assert( m_h_matrix.empty() );
     CV_Assert( ! m_use_orientation );
 
-    set_image( _image );
+    set_image_cached( _image );
 
     m_roi = roi;
 
-    set_parameters();
-    initialize_single_descriptor_mode();
-
-    _descriptors.create( m_roi.width*m_roi.height, m_descriptor_size, CV_32F );
-
-    Mat descriptors = _descriptors.getMat();
-
-    // compute full desc
-    compute_descriptors( &descriptors );
-    normalize_descriptors( &descriptors );
+    compute_dense( _image, _descriptors );
 }
 
 // full scope
@@ -1611,21 +1784,12 @@ void DAISY_Impl::compute( InputArray _image, OutputArray _descriptors )
     CV_Assert( m_h_matrix.empty() );
     CV_Assert( ! m_use_orientation );
 
-    set_image( _image );
+    set_image_cached( _image );
 
     // whole image
     m_roi = Rect( 0, 0, m_image.cols, m_image.rows );
 
-    set_parameters();
-    initialize_single_descriptor_mode();
-
-    _descriptors.create( m_roi.width*m_roi.height, m_descriptor_size, CV_32F );
-
-    Mat descriptors = _descriptors.getMat();
-
-    // compute full desc
-    compute_descriptors( &descriptors );
-    normalize_descriptors( &descriptors );
+    compute_dense( _image, _descriptors );
 }
 
 // constructor
@@ -1638,6 +1802,12 @@ DAISY_Impl::DAISY_Impl( float _radius, int _q_radius, int _q_theta, int _q_hist,
     m_descriptor_size = 0;
     m_grid_point_number = 0;
 
+    m_cached_rad = 0;
+    m_cached_rad_q_no = 0;
+    m_cached_hist_th_q_no = 0;
+
+    m_dense_memory_budget = DENSE_LAYERS_MEMORY_BUDGET;
+
     m_scale_invariant = false;
     m_rotation_invariant = false;
     m_orientation_resolution = 36;
@@ -1684,6 +1854,17 @@ Ptr<DAISY> DAISY::create( float radius, int q_radius, int q_theta, int q_hist,
     return makePtr<DAISY_Impl>(radius, q_radius, q_theta, q_hist, norm, H, interpolation, use_orientation);
 }
 
+void DAISY::setDenseMemoryBudget(size_t bytes)
+{
+    CV_UNUSED(bytes);
+    CV_Error(Error::StsNotImplemented, "This DAISY implementation does not support a dense memory budget");
+}
+
+size_t DAISY::getDenseMemoryBudget() const
+{
+    return DENSE_LAYERS_MEMORY_BUDGET;
+}
+
 String DAISY::getDefaultName() const
 {
   return (Feature2D::getDefaultName() + ".DAISY");
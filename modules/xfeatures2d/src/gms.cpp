@@ -65,26 +65,100 @@ const int mRotationPatterns[8][9] = {
 // 5 level scales
 const double mScaleRatios[5] = { 1.0, 1.0 / 2, 1.0 / std::sqrt(2.0), std::sqrt(2.0), 2.0 };
 
+// Grid sizes and neighbour tables.
+// They do not depend on the images, so they are built once and shared by all the matchers
+struct GMSGrids
+{
+    GMSGrids();
+
+    Size sizeLeft;
+    int numberLeft;
+    Mat neighborLeft;
+
+    // one right grid per scale hypothesis
+    Size sizeRight[5];
+    int numberRight[5];
+    Mat neighborRight[5];
+
+private:
+    static vector<int> getNB9(const int idx, const Size& gridSize);
+    static void initalizeNeighbors(Mat &neighbor, const Size& gridSize);
+};
+
+GMSGrids::GMSGrids()
+{
+    sizeLeft = Size(20, 20);
+    numberLeft = sizeLeft.width * sizeLeft.height;
+
+    // Initialize the neighbor of left grid
+    neighborLeft = Mat::zeros(numberLeft, 9, CV_32SC1);
+    initalizeNeighbors(neighborLeft, sizeLeft);
+
+    for (int scale = 0; scale < 5; scale++)
+    {
+        sizeRight[scale].width = cvRound(sizeLeft.width  * mScaleRatios[scale]);
+        sizeRight[scale].height = cvRound(sizeLeft.height * mScaleRatios[scale]);
+        numberRight[scale] = sizeRight[scale].width * sizeRight[scale].height;
+
+        // Initialize the neighbor of right grid
+        neighborRight[scale] = Mat::zeros(numberRight[scale], 9, CV_32SC1);
+        initalizeNeighbors(neighborRight[scale], sizeRight[scale]);
+    }
+}
+
+// Get Neighbor 9
+vector<int> GMSGrids::getNB9(const int idx, const Size& gridSize)
+{
+    vector<int> NB9(9, -1);
+
+    int idx_x = idx % gridSize.width;
+    int idx_y = idx / gridSize.width;
+
+    for (int yi = -1; yi <= 1; yi++)
+    {
+        for (int xi = -1; xi <= 1; xi++)
+        {
+            int idx_xx = idx_x + xi;
+            int idx_yy = idx_y + yi;
+
+            if (idx_xx < 0 || idx_xx >= gridSize.width || idx_yy < 0 || idx_yy >= gridSize.height)
+                continue;
+
+            NB9[xi + 4 + yi * 3] = idx_xx + idx_yy * gridSize.width;
+        }
+    }
+    return NB9;
+}
+
+void GMSGrids::initalizeNeighbors(Mat &neighbor, const Size& gridSize)
+{
+    for (int i = 0; i < neighbor.rows; i++)
+    {
+        vector<int> NB9 = getNB9(i, gridSize);
+        int *data = neighbor.ptr<int>(i);
+        memcpy(data, &NB9[0], sizeof(int) * 9);
+    }
+}
+
+static const GMSGrids& getGMSGrids()
+{
+    static GMSGrids grids;
+    return grids;
+}
+
 class GMSMatcher
 {
 public:
     // OpenCV Keypoints & Correspond Image Size & Nearest Neighbor Matches
     GMSMatcher(const vector<KeyPoint>& vkp1, const Size& size1, const vector<KeyPoint>& vkp2, const Size& size2,
-               const vector<DMatch>& vDMatches, const double thresholdFactor) : mThresholdFactor(thresholdFactor)
+               const vector<DMatch>& vDMatches, const double thresholdFactor, const GMSGrids& grids) :
+        mGrids(grids), mThresholdFactor(thresholdFactor)
     {
         // Input initialize
         normalizePoints(vkp1, size1, mvP1);
         normalizePoints(vkp2, size2, mvP2);
         mNumberMatches = vDMatches.size();
         convertMatches(vDMatches, mvMatches);
-
-        // Grid initialize
-        mGridSizeLeft = Size(20, 20);
-        mGridNumberLeft = mGridSizeLeft.width * mGridSizeLeft.height;
-
-        // Initialize the neighbor of left grid
-        mGridNeighborLeft = Mat::zeros(mGridNumberLeft, 9, CV_32SC1);
-        initalizeNeighbors(mGridNeighborLeft, mGridSizeLeft);
     }
 
     ~GMSMatcher() {}
@@ -95,6 +169,8 @@ public:
 
 
 private:
+    const GMSGrids& mGrids;
+
     // Normalized Points
     vector<Point2f> mvP1, mvP2;
 
@@ -104,88 +180,23 @@ private:
     // Number of Matches
     size_t mNumberMatches;
 
-    // Grid Size
-    Size mGridSizeLeft, mGridSizeRight;
-    int mGridNumberLeft;
-    int mGridNumberRight;
-
-    // x      : left grid idx
-    // y      : right grid idx
-    // value  : how many matches from idx_left to idx_right
-    Mat mMotionStatistics;
-
-    //
-    vector<int> mNumberPointsInPerCellLeft;
-
-    // Inldex  : grid_idx_left
-    // Value   : grid_idx_right
-    vector<int> mCellPairs;
-
-    // Every Matches has a cell-pair
-    // first  : grid_idx_left
-    // second : grid_idx_right
-    vector<pair<int, int> > mvMatchPairs;
-
-    // Inlier Mask for output
-    vector<bool> mvbInlierMask;
-
-    //
-    Mat mGridNeighborLeft;
-    Mat mGridNeighborRight;
-
     double mThresholdFactor;
 
-
-    // Assign Matches to Cell Pairs
-    void assignMatchPairs(const int GridType);
-
     void convertMatches(const vector<DMatch> &vDMatches, vector<pair<int, int> > &vMatches);
 
-    int getGridIndexLeft(const Point2f &pt, const int type);
-
-    int getGridIndexRight(const Point2f &pt);
+    int getGridIndexLeft(const Point2f &pt, const int type) const;
 
-    vector<int> getNB9(const int idx, const Size& GridSize);
-
-    void initalizeNeighbors(Mat &neighbor, const Size& GridSize);
+    int getGridIndexRight(const Point2f &pt, const int scale) const;
 
     void normalizePoints(const vector<KeyPoint> &kp, const Size &size, vector<Point2f> &npts);
 
-    // Run
-    int run(const int rotationType);
-
-    void setScale(const int scale);
-
-    // Verify Cell Pairs
-    void verifyCellPairs(const int rotationType);
+    // Vote the matches into the cell-pair histogram of one scale and one left grid shift,
+    // then verify the cell pairs for every rotation hypothesis.
+    // masks[r][i] is set when match i is an inlier for rotation r
+    void runGridType(const int scale, const int gridType, const vector<int> &rightIdx,
+                     const int numRotations, vector<vector<uchar> > &masks) const;
 };
 
-void GMSMatcher::assignMatchPairs(const int gridType)
-{
-    for (size_t i = 0; i < mNumberMatches; i++)
-    {
-        Point2f &lp = mvP1[mvMatches[i].first];
-        Point2f &rp = mvP2[mvMatches[i].second];
-
-        int lgidx = mvMatchPairs[i].first = getGridIndexLeft(lp, gridType);
-        int rgidx = -1;
-
-        if (gridType == 1)
-        {
-            rgidx = mvMatchPairs[i].second = getGridIndexRight(rp);
-        }
-        else
-        {
-            rgidx = mvMatchPairs[i].second;
-        }
-
-        if (lgidx < 0 || rgidx < 0) continue;
-
-        mMotionStatistics.at<int>(lgidx, rgidx)++;
-        mNumberPointsInPerCellLeft[lgidx]++;
-    }
-}
-
 // Convert OpenCV DMatch to Match (pair<int, int>)
 void GMSMatcher::convertMatches(const vector<DMatch> &vDMatches, vector<pair<int, int> > &vMatches)
 {
@@ -194,146 +205,108 @@ void GMSMatcher::convertMatches(const vector<DMatch> &vDMatches, vector<pair<int
         vMatches[i] = pair<int, int>(vDMatches[i].queryIdx, vDMatches[i].trainIdx);
 }
 
-int GMSMatcher::getGridIndexLeft(const Point2f &pt, const int type)
+int GMSMatcher::getGridIndexLeft(const Point2f &pt, const int type) const
 {
+    const Size& gridSize = mGrids.sizeLeft;
     int x = 0, y = 0;
 
     if (type == 1) {
-        x = cvFloor(pt.x * mGridSizeLeft.width);
-        y = cvFloor(pt.y * mGridSizeLeft.height);
+        x = cvFloor(pt.x * gridSize.width);
+        y = cvFloor(pt.y * gridSize.height);
     }
 
     if (type == 2) {
-        x = cvFloor(pt.x * mGridSizeLeft.width + 0.5);
-        y = cvFloor(pt.y * mGridSizeLeft.height);
+        x = cvFloor(pt.x * gridSize.width + 0.5);
+        y = cvFloor(pt.y * gridSize.height);
     }
 
     if (type == 3) {
-        x = cvFloor(pt.x * mGridSizeLeft.width);
-        y = cvFloor(pt.y * mGridSizeLeft.height + 0.5);
+        x = cvFloor(pt.x * gridSize.width);
+        y = cvFloor(pt.y * gridSize.height + 0.5);
     }
 
     if (type == 4) {
-        x = cvFloor(pt.x * mGridSizeLeft.width + 0.5);
-        y = cvFloor(pt.y * mGridSizeLeft.height + 0.5);
+        x = cvFloor(pt.x * gridSize.width + 0.5);
+        y = cvFloor(pt.y * gridSize.height + 0.5);
     }
 
 
-    if (x >= mGridSizeLeft.width || y >= mGridSizeLeft.height)
+    if (x >= gridSize.width || y >= gridSize.height)
         return -1;
 
-    return x + y * mGridSizeLeft.width;
+    return x + y * gridSize.width;
 }
 
-int GMSMatcher::getGridIndexRight(const Point2f &pt)
+int GMSMatcher::getGridIndexRight(const Point2f &pt, const int scale) const
 {
-    int x = cvFloor(pt.x * mGridSizeRight.width);
-    int y = cvFloor(pt.y * mGridSizeRight.height);
+    const Size& gridSize = mGrids.sizeRight[scale];
+    int x = cvFloor(pt.x * gridSize.width);
+    int y = cvFloor(pt.y * gridSize.height);
 
-    return x + y * mGridSizeRight.width;
+    int idx = x + y * gridSize.width;
+    return idx < mGrids.numberRight[scale] ? idx : -1;
 }
 
 int GMSMatcher::getInlierMask(vector<bool> &vbInliers, const bool withRotation, const bool withScale)
 {
-    int max_inlier = 0;
-
-    if (!withScale && !withRotation)
-    {
-        setScale(0);
-        max_inlier = run(1);
-        vbInliers = mvbInlierMask;
-        return max_inlier;
-    }
-
-    if (withRotation && withScale)
+    const int numScales = withScale ? 5 : 1;
+    const int numRotations = withRotation ? 8 : 1;
+    const int numGridTypes = 4;
+    const int N = (int)mNumberMatches;
+
+    vbInliers.clear();
+    if (N == 0)
+        return 0;
+
+    // The right cell of a match only depends on the scale
+    vector<vector<int> > rightIdx(numScales, vector<int>(N));
+    for (int scale = 0; scale < numScales; scale++)
+        for (int i = 0; i < N; i++)
+            rightIdx[scale][i] = getGridIndexRight(mvP2[mvMatches[i].second], scale);
+
+    // The histogram of a (scale, grid type) pair is shared by all the rotation hypotheses,
+    // and the pairs are independent of each other
+    vector<vector<vector<uchar> > > masks(numScales * numGridTypes);
+    parallel_for_(Range(0, numScales * numGridTypes), [&](const Range& range)
     {
-        for (int scale = 0; scale < 5; scale++)
+        for (int task = range.start; task < range.end; task++)
         {
-            setScale(scale);
-            for (int rotationType = 1; rotationType <= 8; rotationType++)
-            {
-                int num_inlier = run(rotationType);
-
-                if (num_inlier > max_inlier)
-                {
-                    vbInliers = mvbInlierMask;
-                    max_inlier = num_inlier;
-                }
-            }
+            int scale = task / numGridTypes;
+            masks[task].assign(numRotations, vector<uchar>(N, 0));
+            runGridType(scale, task % numGridTypes + 1, rightIdx[scale], numRotations, masks[task]);
         }
-        return max_inlier;
-    }
-
-    if (withRotation && !withScale)
+    });
+
+    // A match is an inlier of a hypothesis if it is one for any of the grid types.
+    // Hypotheses are compared in the same order as the sequential search,
+    // so that ties are resolved the same way
+    int max_inlier = -1;
+    vector<bool> mask(N);
+    for (int scale = 0; scale < numScales; scale++)
     {
-        setScale(0);
-        for (int rotationType = 1; rotationType <= 8; rotationType++)
+        for (int r = 0; r < numRotations; r++)
         {
-            int num_inlier = run(rotationType);
-
-            if (num_inlier > max_inlier)
+            int num_inlier = 0;
+            for (int i = 0; i < N; i++)
             {
-                vbInliers = mvbInlierMask;
-                max_inlier = num_inlier;
+                bool inlier = false;
+                for (int g = 0; g < numGridTypes; g++)
+                    inlier = inlier || masks[scale * numGridTypes + g][r][i] != 0;
+                mask[i] = inlier;
+                num_inlier += inlier;
             }
-        }
-        return max_inlier;
-    }
-
-    if (!withRotation && withScale)
-    {
-        for (int scale = 0; scale < 5; scale++)
-        {
-            setScale(scale);
-            int num_inlier = run(1);
 
             if (num_inlier > max_inlier)
             {
-                vbInliers = mvbInlierMask;
+                vbInliers = mask;
                 max_inlier = num_inlier;
             }
-
         }
-        return max_inlier;
     }
 
     return max_inlier;
 }
 
-// Get Neighbor 9
-vector<int> GMSMatcher::getNB9(const int idx, const Size& gridSize)
-{
-    vector<int> NB9(9, -1);
-
-    int idx_x = idx % gridSize.width;
-    int idx_y = idx / gridSize.width;
-
-    for (int yi = -1; yi <= 1; yi++)
-    {
-        for (int xi = -1; xi <= 1; xi++)
-        {
-            int idx_xx = idx_x + xi;
-            int idx_yy = idx_y + yi;
-
-            if (idx_xx < 0 || idx_xx >= gridSize.width || idx_yy < 0 || idx_yy >= gridSize.height)
-                continue;
-
-            NB9[xi + 4 + yi * 3] = idx_xx + idx_yy * gridSize.width;
-        }
-    }
-    return NB9;
-}
-
-void GMSMatcher::initalizeNeighbors(Mat &neighbor, const Size& gridSize)
-{
-    for (int i = 0; i < neighbor.rows; i++)
-    {
-        vector<int> NB9 = getNB9(i, gridSize);
-        int *data = neighbor.ptr<int>(i);
-        memcpy(data, &NB9[0], sizeof(int) * 9);
-    }
-}
-
 // Normalize Key Points to Range(0 - 1)
 void GMSMatcher::normalizePoints(const vector<KeyPoint> &kp, const Size &size, vector<Point2f> &npts)
 {
@@ -349,103 +322,100 @@ void GMSMatcher::normalizePoints(const vector<KeyPoint> &kp, const Size &size, v
     }
 }
 
-int GMSMatcher::run(const int rotationType)
+void GMSMatcher::runGridType(const int scale, const int gridType, const vector<int> &rightIdx,
+                             const int numRotations, vector<vector<uchar> > &masks) const
 {
-    mvbInlierMask.assign(mNumberMatches, false);
+    const int numberLeft = mGrids.numberLeft;
+    const int numberRight = mGrids.numberRight[scale];
+    const int N = (int)mNumberMatches;
+
+    // x      : left grid idx
+    // y      : right grid idx
+    // value  : how many matches from idx_left to idx_right
+    vector<int> motionStatistics((size_t)numberLeft * numberRight, 0);
+    vector<int> numberPointsInPerCellLeft(numberLeft, 0);
 
-    // Initialize Motion Statisctics
-    mMotionStatistics = Mat::zeros(mGridNumberLeft, mGridNumberRight, CV_32SC1);
-    mvMatchPairs.assign(mNumberMatches, pair<int, int>(0, 0));
+    // Most voted right cell of every left cell. Ties go to the lowest right index
+    vector<int> bestNumber(numberLeft, 0), bestRight(numberLeft, -1);
 
-    for (int gridType = 1; gridType <= 4; gridType++)
+    // Assign Matches to Cell Pairs
+    vector<int> leftIdx(N);
+    for (int i = 0; i < N; i++)
     {
-        // initialize
-        mMotionStatistics.setTo(0);
-        mCellPairs.assign(mGridNumberLeft, -1);
-        mNumberPointsInPerCellLeft.assign(mGridNumberLeft, 0);
+        int lgidx = leftIdx[i] = getGridIndexLeft(mvP1[mvMatches[i].first], gridType);
+        int rgidx = rightIdx[i];
 
-        assignMatchPairs(gridType);
-        verifyCellPairs(rotationType);
+        if (lgidx < 0 || rgidx < 0) continue;
 
-        // Mark inliers
-        for (size_t i = 0; i < mNumberMatches; i++)
+        int votes = ++motionStatistics[(size_t)lgidx * numberRight + rgidx];
+        numberPointsInPerCellLeft[lgidx]++;
+
+        if (votes > bestNumber[lgidx] || (votes == bestNumber[lgidx] && rgidx < bestRight[lgidx]))
         {
-            if (mvMatchPairs[i].first >= 0 && mCellPairs[mvMatchPairs[i].first] == mvMatchPairs[i].second)
-                mvbInlierMask[i] = true;
+            bestNumber[lgidx] = votes;
+            bestRight[lgidx] = rgidx;
         }
     }
 
-    return (int) count(mvbInlierMask.begin(), mvbInlierMask.end(), true); //number of inliers
-}
-
-void GMSMatcher::setScale(const int scale)
-{
-    // Set Scale
-    mGridSizeRight.width = cvRound(mGridSizeLeft.width  * mScaleRatios[scale]);
-    mGridSizeRight.height = cvRound(mGridSizeLeft.height * mScaleRatios[scale]);
-    mGridNumberRight = mGridSizeRight.width * mGridSizeRight.height;
-
-    // Initialize the neighbor of right grid
-    mGridNeighborRight = Mat::zeros(mGridNumberRight, 9, CV_32SC1);
-    initalizeNeighbors(mGridNeighborRight, mGridSizeRight);
-}
-
-void GMSMatcher::verifyCellPairs(const int rotationType)
-{
-    const int *CurrentRP = mRotationPatterns[rotationType - 1];
-
-    for (int i = 0; i < mGridNumberLeft; i++)
+    // Inldex  : grid_idx_left
+    // Value   : grid_idx_right
+    vector<int> cellPairs(numberLeft);
+    for (int r = 0; r < numRotations; r++)
     {
-        if (sum(mMotionStatistics.row(i))[0] == 0)
-        {
-            mCellPairs[i] = -1;
-            continue;
-        }
+        // Verify Cell Pairs
+        const int *CurrentRP = mRotationPatterns[r];
 
-        int max_number = 0;
-        for (int j = 0; j < mGridNumberRight; j++)
+        for (int i = 0; i < numberLeft; i++)
         {
-            int *value = mMotionStatistics.ptr<int>(i);
-            if (value[j] > max_number)
+            if (numberPointsInPerCellLeft[i] == 0)
             {
-                mCellPairs[i] = j;
-                max_number = value[j];
+                cellPairs[i] = -1;
+                continue;
             }
-        }
 
-        int idx_grid_rt = mCellPairs[i];
+            int idx_grid_rt = cellPairs[i] = bestRight[i];
 
-        const int *NB9_lt = mGridNeighborLeft.ptr<int>(i);
-        const int *NB9_rt = mGridNeighborRight.ptr<int>(idx_grid_rt);
+            const int *NB9_lt = mGrids.neighborLeft.ptr<int>(i);
+            const int *NB9_rt = mGrids.neighborRight[scale].ptr<int>(idx_grid_rt);
 
-        int score = 0;
-        double thresh = 0;
-        int numpair = 0;
+            int score = 0;
+            double thresh = 0;
+            int numpair = 0;
 
-        for (size_t j = 0; j < 9; j++)
-        {
-            int ll = NB9_lt[j];
-            int rr = NB9_rt[CurrentRP[j] - 1];
-            if (ll == -1 || rr == -1)
-                continue;
+            for (size_t j = 0; j < 9; j++)
+            {
+                int ll = NB9_lt[j];
+                int rr = NB9_rt[CurrentRP[j] - 1];
+                if (ll == -1 || rr == -1)
+                    continue;
+
+                score += motionStatistics[(size_t)ll * numberRight + rr];
+                thresh += numberPointsInPerCellLeft[ll];
+                numpair++;
+            }
 
-            score += mMotionStatistics.at<int>(ll, rr);
-            thresh += mNumberPointsInPerCellLeft[ll];
-            numpair++;
-        }
+            thresh = mThresholdFactor * std::sqrt(thresh / numpair);
 
-        thresh = mThresholdFactor * std::sqrt(thresh / numpair);
+            if (score < thresh)
+                cellPairs[i] = -2;
+        }
 
-        if (score < thresh)
-            mCellPairs[i] = -2;
+        // Mark inliers
+        uchar* mask = &masks[r][0];
+        for (int i = 0; i < N; i++)
+        {
+            if (leftIdx[i] >= 0 && cellPairs[leftIdx[i]] == rightIdx[i])
+                mask[i] = 1;
+        }
     }
 }
 
-void matchGMS( const Size& size1, const Size& size2, const vector<KeyPoint>& keypoints1, const vector<KeyPoint>& keypoints2,
-               const vector<DMatch>& matches1to2, vector<DMatch>& matchesGMS, const bool withRotation, const bool withScale,
-               const double thresholdFactor )
+static void filterGMS(const GMSGrids& grids, const Size& size1, const Size& size2,
+                      const vector<KeyPoint>& keypoints1, const vector<KeyPoint>& keypoints2,
+                      const vector<DMatch>& matches1to2, vector<DMatch>& matchesGMS,
+                      const bool withRotation, const bool withScale, const double thresholdFactor)
 {
-    GMSMatcher gms(keypoints1, size1, keypoints2, size2, matches1to2, thresholdFactor);
+    GMSMatcher gms(keypoints1, size1, keypoints2, size2, matches1to2, thresholdFactor, grids);
     vector<bool> inlierMask;
     gms.getInlierMask(inlierMask, withRotation, withScale);
 
@@ -456,5 +426,32 @@ void matchGMS( const Size& size1, const Size& size2, const vector<KeyPoint>& key
     }
 }
 
+void matchGMS( const Size& size1, const Size& size2, const vector<KeyPoint>& keypoints1, const vector<KeyPoint>& keypoints2,
+               const vector<DMatch>& matches1to2, vector<DMatch>& matchesGMS, const bool withRotation, const bool withScale,
+               const double thresholdFactor )
+{
+    filterGMS(getGMSGrids(), size1, size2, keypoints1, keypoints2, matches1to2, matchesGMS,
+              withRotation, withScale, thresholdFactor);
+}
+
+void matchGMS( const vector<Size>& sizes1, const vector<Size>& sizes2,
+               const vector<vector<KeyPoint> >& keypoints1, const vector<vector<KeyPoint> >& keypoints2,
+               const vector<vector<DMatch> >& matches1to2, vector<vector<DMatch> >& matchesGMS,
+               const bool withRotation, const bool withScale, const double thresholdFactor )
+{
+    const size_t numPairs = matches1to2.size();
+    CV_Assert(sizes1.size() == numPairs && sizes2.size() == numPairs);
+    CV_Assert(keypoints1.size() == numPairs && keypoints2.size() == numPairs);
+
+    const GMSGrids& grids = getGMSGrids();
+    matchesGMS.resize(numPairs);
+    parallel_for_(Range(0, (int)numPairs), [&](const Range& range)
+    {
+        for (int i = range.start; i < range.end; i++)
+            filterGMS(grids, sizes1[i], sizes2[i], keypoints1[i], keypoints2[i], matches1to2[i], matchesGMS[i],
+                      withRotation, withScale, thresholdFactor);
+    });
+}
+
 } //namespace xfeatures2d
 } //namespace cv
@@ -56,6 +56,7 @@ University of Bologna, Open Perception
 
 #include "precomp.hpp"
 #include "msd_pyramid.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <limits>
 
 namespace cv
@@ -83,11 +84,12 @@ namespace cv
                     split = _split;
                     level = _level;
                     border = _border;
-                    int w = img->cols - border * 2;
-                    chunkSize = w / split;
-                    remains = w - chunkSize*split;
+                    int h = img->rows - border * 2;
+                    chunkSize = h / split;
+                    remains = h - chunkSize*split;
                 }
 
+                // every chunk is a band of rows
                 void operator()(const Range& range) const CV_OVERRIDE
                 {
                     for (int i = range.start; i < range.end; i++)
@@ -97,7 +99,7 @@ namespace cv
                         if (remains > 0)
                             if (i == split - 1)
                             {
-                                end = img->cols - border;
+                                end = img->rows - border;
                             }
                         detector->contextualSelfDissimilarity(*img, start, end, &saliency->at(level)[0]);
                     }
@@ -281,29 +283,13 @@ namespace cv
             cv::Mat m_mask;
 
             /**
-             * Computes the normalized average value of input vector
-             * @param minVals input vector
-             * @param den normalization factor (pre-multiplied by the number of elements of the input vector, assumed constant)
-             * @return normalized average value
-             */
-            inline float computeAvgDistance(std::vector<int> &minVals, int den)
-            {
-                float avg_dist = 0.0f;
-                for (unsigned int i = 0; i < minVals.size(); i++)
-                    avg_dist += minVals[i];
-
-                avg_dist /= den;
-                return avg_dist;
-            }
-
-            /**
-             * Computer the Contextual Self-Dissimilarity (CSD, [1]) for a specific range of image pixels (row-wise)
+             * Computer the Contextual Self-Dissimilarity (CSD, [1]) for a specific range of image rows
              * @param img input image
-             * @param xmin left-most range limit for the image pixels being processed
-             * @param xmax right-most range limit for the image pixels being processed
+             * @param ymin top-most range limit for the image rows being processed
+             * @param ymax bottom-most range limit for the image rows being processed
              * @param saliency output array being filled with the CSD value computed at each input pixel
              */
-            void contextualSelfDissimilarity(cv::Mat &img, int xmin, int xmax, float* saliency);
+            void contextualSelfDissimilarity(const cv::Mat &img, int ymin, int ymax, float* saliency);
 
             /**
              * Associates a canonical orientation (computed as in [1]) to each extracted key-point
@@ -385,206 +371,151 @@ namespace cv
             return true;
         }
 
-        void MSDDetector_Impl::contextualSelfDissimilarity(cv::Mat &img, int xmin, int xmax, float* saliency)
+        /**
+         * Adds (or subtracts) to colSum[c] the squared difference between the pixel (row, cmin + c)
+         * and the one displaced by d, for c in [0, n)
+         */
+        static void accumulateSquaredDiff(const cv::Mat &img, int row, const cv::Point &d, int cmin, int n, int* colSum, bool add)
+        {
+            const uchar* p = img.ptr<uchar>(row) + cmin;
+            const uchar* q = img.ptr<uchar>(row + d.y) + cmin + d.x;
+
+            int c = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+            const int vlanes = VTraits<v_int32>::vlanes();
+            for (; c <= n - vlanes; c += vlanes)
+            {
+                v_int32 diff = v_sub(v_reinterpret_as_s32(vx_load_expand_q(q + c)), v_reinterpret_as_s32(vx_load_expand_q(p + c)));
+                v_int32 sq = v_mul(diff, diff);
+                v_int32 sum = vx_load(colSum + c);
+                v_store(colSum + c, add ? v_add(sum, sq) : v_sub(sum, sq));
+            }
+#endif
+            for (; c < n; c++)
+            {
+                int diff = q[c] - p[c];
+                colSum[c] += add ? diff * diff : -diff * diff;
+            }
+        }
+
+        /**
+         * Sums the column sums over the patch width for each of the n pixels of a row, and inserts the
+         * result in the k smallest dissimilarities of the pixel (minVals[kk * n + x], in ascending order)
+         */
+        static void insertPatchDissimilarities(const int* colSum, int side_s, int n, int k, int* minVals)
+        {
+            int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+            const int vlanes = VTraits<v_int32>::vlanes();
+            for (; x <= n - vlanes; x += vlanes)
+            {
+                v_int32 val = vx_load(colSum + x);
+                for (int u = 1; u < side_s; u++)
+                    val = v_add(val, vx_load(colSum + x + u));
+
+                for (int kk = 0; kk < k; kk++)
+                {
+                    v_int32 m = vx_load(minVals + kk * n + x);
+                    v_store(minVals + kk * n + x, v_min(m, val));
+                    val = v_max(m, val);
+                }
+            }
+#endif
+            for (; x < n; x++)
+            {
+                int val = 0;
+                for (int u = 0; u < side_s; u++)
+                    val += colSum[x + u];
+
+                for (int kk = 0; kk < k; kk++)
+                {
+                    int m = minVals[kk * n + x];
+                    minVals[kk * n + x] = std::min(m, val);
+                    val = std::max(m, val);
+                }
+            }
+        }
+
+        void MSDDetector_Impl::contextualSelfDissimilarity(const cv::Mat &img, int ymin, int ymax, float* saliency)
         {
             int r_s = m_patch_radius;
             int r_b = m_search_area_radius;
             int k = m_kNN;
 
             int w = img.cols;
-            int h = img.rows;
 
             int side_s = 2 * r_s + 1;
-            int side_b = 2 * r_b + 1;
             int border = r_s + r_b;
-            int temp;
             int den = side_s * side_s * k;
 
-            std::vector<int> minVals(k);
-            int *acc = new int[side_b * side_b];
-            int **vCol = new int *[w];
-            for (int i = 0; i < w; i++)
-                vCol[i] = new int[side_b * side_b];
-
-            //first position
-            int x = xmin;
-            int y = border;
-
-            int ctrInd = 0;
-            for (int kk = 0; kk < k; kk++)
-                minVals[kk] = std::numeric_limits<int>::max();
-
-            for (int j = y - r_b; j <= y + r_b; j++)
+            // pixels of a row having a complete search area, and the columns covered by their patches
+            int xmin = border;
+            int ncols = w - 2 * border;
+            int cmin = xmin - r_s;
+            int ccols = ncols + 2 * r_s;
+
+            if (ncols <= 0 || ymin >= ymax)
+                return;
+
+            // displacements within the search area
+            std::vector<cv::Point> disp;
+            for (int dy = -r_b; dy <= r_b; dy++)
+                for (int dx = -r_b; dx <= r_b; dx++)
+                    if (dx != 0 || dy != 0)
+                        disp.push_back(cv::Point(dx, dy));
+            int ndisp = (int)disp.size();
+
+            // for each displacement, the squared differences summed over the patch height,
+            // slid down one row at a time
+            AutoBuffer<int> colSumsBuf((size_t)ndisp * ccols);
+            // k smallest patch dissimilarities of each pixel of the current row
+            AutoBuffer<int> minValsBuf((size_t)k * ncols);
+            int* minVals = minValsBuf.data();
+
+            for (int y = ymin; y < ymax; y++)
             {
+                std::fill(minVals, minVals + k * ncols, std::numeric_limits<int>::max());
 
-                for (int i = x - r_b; i <= x + r_b; i++)
+                for (int d = 0; d < ndisp; d++)
                 {
-                    if (j == y && i == x)
-                        continue;
-
-                    acc[ctrInd] = 0;
-                    for (int u = -r_s; u <= r_s; u++)
+                    int* colSum = colSumsBuf.data() + (size_t)d * ccols;
+                    if (y == ymin)
                     {
-                        vCol[x + u][ctrInd] = 0;
+                        std::fill(colSum, colSum + ccols, 0);
                         for (int v = -r_s; v <= r_s; v++)
-                        {
-
-                            temp = img.at<unsigned char>(j + v, i + u) - img.at<unsigned char>(y + v, x + u);
-                            vCol[x + u][ctrInd] += (temp * temp);
-                        }
-                        acc[ctrInd] += vCol[x + u][ctrInd];
+                            accumulateSquaredDiff(img, y + v, disp[d], cmin, ccols, colSum, true);
                     }
-
-                    if (acc[ctrInd] < minVals[k - 1])
+                    else
                     {
-                        minVals[k - 1] = acc[ctrInd];
-
-                        for (int kk = k - 2; kk >= 0; kk--)
-                        {
-                            if (minVals[kk] > minVals[kk + 1])
-                            {
-                                std::swap(minVals[kk], minVals[kk + 1]);
-                            } else
-                                break;
-                        }
+                        accumulateSquaredDiff(img, y + r_s, disp[d], cmin, ccols, colSum, true);
+                        accumulateSquaredDiff(img, y - r_s - 1, disp[d], cmin, ccols, colSum, false);
                     }
 
-                    ctrInd++;
+                    insertPatchDissimilarities(colSum, side_s, ncols, k, minVals);
                 }
-            }
-            saliency[y * w + x] = computeAvgDistance(minVals, den);
 
-            for (x = xmin + 1; x < xmax; x++)
-            {
-                ctrInd = 0;
-                for (int kk = 0; kk < k; kk++)
-                    minVals[kk] = std::numeric_limits<int>::max();
-
-                for (int j = y - r_b; j <= y + r_b; j++)
+                // normalized average of the k smallest dissimilarities
+                float* sal = saliency + y * w + xmin;
+                int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                const int vlanes = VTraits<v_float32>::vlanes();
+                const v_float32 vden = vx_setall_f32((float)den);
+                for (; x <= ncols - vlanes; x += vlanes)
                 {
-                    for (int i = x - r_b; i <= x + r_b; i++)
-                    {
-                        if (j == y && i == x)
-                            continue;
-
-                        vCol[x + r_s][ctrInd] = 0;
-                        for (int v = -r_s; v <= r_s; v++)
-                        {
-                            temp = img.at<unsigned char>(j + v, i + r_s) - img.at<unsigned char>(y + v, x + r_s);
-                            vCol[x + r_s][ctrInd] += (temp * temp);
-                        }
-
-                        acc[ctrInd] = acc[ctrInd] + vCol[x + r_s][ctrInd] - vCol[x - r_s - 1][ctrInd];
-
-                        if (acc[ctrInd] < minVals[k - 1])
-                        {
-                            minVals[k - 1] = acc[ctrInd];
-                            for (int kk = k - 2; kk >= 0; kk--)
-                            {
-                                if (minVals[kk] > minVals[kk + 1])
-                                {
-                                    std::swap(minVals[kk], minVals[kk + 1]);
-                                } else
-                                    break;
-                            }
-                        }
-
-                        ctrInd++;
-                    }
-                }
-                saliency[y * w + x] = computeAvgDistance(minVals, den);
-            }
-
-            for (y = border + 1; y < h - border; y++)
-            {
-                ctrInd = 0;
-                for (int kk = 0; kk < k; kk++)
-                    minVals[kk] = std::numeric_limits<int>::max();
-                x = xmin;
-
-                for (int j = y - r_b; j <= y + r_b; j++)
-                {
-                    for (int i = x - r_b; i <= x + r_b; i++)
-                    {
-                        if (j == y && i == x)
-                            continue;
-
-                        acc[ctrInd] = 0;
-                        for (int u = -r_s; u <= r_s; u++)
-                        {
-                            temp = img.at<unsigned char>(j + r_s, i + u) - img.at<unsigned char>(y + r_s, x + u);
-                            vCol[x + u][ctrInd] += (temp * temp);
-
-                            temp = img.at<unsigned char>(j - r_s - 1, i + u) - img.at<unsigned char>(y - r_s - 1, x + u);
-                            vCol[x + u][ctrInd] -= (temp * temp);
-
-                            acc[ctrInd] += vCol[x + u][ctrInd];
-                        }
-
-                        if (acc[ctrInd] < minVals[k - 1])
-                        {
-                            minVals[k - 1] = acc[ctrInd];
-
-                            for (int kk = k - 2; kk >= 0; kk--)
-                            {
-                                if (minVals[kk] > minVals[kk + 1])
-                                {
-                                    std::swap(minVals[kk], minVals[kk + 1]);
-                                } else
-                                    break;
-                            }
-                        }
-
-                        ctrInd++;
-                    }
+                    v_float32 avg_dist = vx_setzero_f32();
+                    for (int kk = 0; kk < k; kk++)
+                        avg_dist = v_add(avg_dist, v_cvt_f32(vx_load(minVals + kk * ncols + x)));
+                    v_store(sal + x, v_div(avg_dist, vden));
                 }
-                saliency[y * w + x] = computeAvgDistance(minVals, den);
-
-                for (x = xmin + 1; x < xmax; x++)
+#endif
+                for (; x < ncols; x++)
                 {
-                    ctrInd = 0;
+                    float avg_dist = 0.0f;
                     for (int kk = 0; kk < k; kk++)
-                        minVals[kk] = std::numeric_limits<int>::max();
-
-                    for (int j = y - r_b; j <= y + r_b; j++)
-                    {
-                        for (int i = x - r_b; i <= x + r_b; i++)
-                        {
-                            if (j == y && i == x)
-                                continue;
-
-                            temp = img.at<unsigned char>(j + r_s, i + r_s) - img.at<unsigned char>(y + r_s, x + r_s);
-                            vCol[x + r_s][ctrInd] += (temp * temp);
-
-                            temp = img.at<unsigned char>(j - r_s - 1, i + r_s) - img.at<unsigned char>(y - r_s - 1, x + r_s);
-                            vCol[x + r_s][ctrInd] -= (temp * temp);
-
-                            acc[ctrInd] = acc[ctrInd] + vCol[x + r_s][ctrInd] - vCol[x - r_s - 1][ctrInd];
-
-                            if (acc[ctrInd] < minVals[k - 1])
-                            {
-                                minVals[k - 1] = acc[ctrInd];
-
-                                for (int kk = k - 2; kk >= 0; kk--)
-                                {
-                                    if (minVals[kk] > minVals[kk + 1])
-                                    {
-                                        std::swap(minVals[kk], minVals[kk + 1]);
-                                    } else
-                                        break;
-                                }
-                            }
-                            ctrInd++;
-                        }
-                    }
-                    saliency[y * w + x] = computeAvgDistance(minVals, den);
+                        avg_dist += minVals[kk * ncols + x];
+                    sal[x] = avg_dist / den;
                 }
             }
-
-            for (int i = 0; i < w; i++)
-                delete[] vCol[i];
-            delete[] vCol;
-            delete[] acc;
         }
 
         float MSDDetector_Impl::computeOrientation(cv::Mat &img, int x, int y, std::vector<cv::Point2f> circle)
@@ -63,6 +63,7 @@ References:
 
 #ifdef __cplusplus
 #include "constants.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -207,6 +208,88 @@ namespace cv
                 }
                 CV_Error(Error::StsBadArg, "Distance function not implemented!");
             }
+
+
+            /**
+            * @brief Computes distances between all centroids of a signature and one point,
+            *       several centroids at a time. Each distance is the one computeDistance returns.
+            * @param distanceFunction Distance function selector.
+            * @param points1 Signature matrix - one centroid in each row.
+            * @param points1T Transposition of points1 - one dimension in each row.
+            * @param points2 The second signature matrix - one centroid in each row.
+            * @param idx2 ID of centroid in the second signature
+            * @param distances Output distances, one for each centroid of points1.
+            */
+            static inline void computeDistances(
+                const int distanceFunction,
+                const Mat& points1, const Mat& points1T,
+                const Mat& points2, int idx2,
+                float* distances)
+            {
+                const int count = points1.rows;
+                int i = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                const float* point = points2.ptr<float>(idx2);
+                const int vlanes = VTraits<v_float32>::vlanes();
+                for (; i <= count - vlanes; i += vlanes)
+                {
+                    v_float32 result = vx_setzero_f32();
+                    for (int d = 1; d < SIGNATURE_DIMENSION; ++d)
+                    {
+                        v_float32 difference = v_sub(vx_load(points1T.ptr<float>(d) + i), vx_setall_f32(point[d]));
+                        switch (distanceFunction)
+                        {
+                        case PCTSignatures::L0_25:
+                            result = v_add(result, v_sqrt(v_sqrt(v_abs(difference))));
+                            break;
+                        case PCTSignatures::L0_5:
+                            result = v_add(result, v_sqrt(v_abs(difference)));
+                            break;
+                        case PCTSignatures::L1:
+                            result = v_add(result, v_abs(difference));
+                            break;
+                        case PCTSignatures::L2:
+                        case PCTSignatures::L2SQUARED:
+                            result = v_add(result, v_mul(difference, difference));
+                            break;
+                        case PCTSignatures::L5:
+                            result = v_add(result, v_mul(v_mul(v_mul(v_mul(v_abs(difference), difference), difference), difference), difference));
+                            break;
+                        case PCTSignatures::L_INFINITY:
+                            result = v_max(result, difference);
+                            break;
+                        default:
+                            CV_Error(Error::StsBadArg, "Distance function not implemented!");
+                        }
+                    }
+                    switch (distanceFunction)
+                    {
+                    case PCTSignatures::L0_25:
+                        result = v_mul(result, result);
+                        result = v_mul(result, result);
+                        break;
+                    case PCTSignatures::L0_5:
+                        result = v_mul(result, result);
+                        break;
+                    case PCTSignatures::L2:
+                        result = v_sqrt(result);
+                        break;
+                    }
+                    v_store(distances + i, result);
+                    if (distanceFunction == PCTSignatures::L5)
+                    {
+                        for (int k = 0; k < vlanes; k++)
+                        {
+                            distances[i + k] = std::pow(distances[i + k], (float)0.2);
+                        }
+                    }
+                }
+#endif
+                for (; i < count; i++)
+                {
+                    distances[i] = computeDistance(distanceFunction, points1, i, points2, idx2);
+                }
+            }
         }
     }
 }
@@ -117,6 +117,16 @@ namespace cv
             // HOT PATH 30%
             void GrayscaleBitmap::getContrastEntropy(int x, int y, float& contrast, float& entropy, int radius)
             {
+                getContrastEntropy(x, y, contrast, entropy, radius, mCoOccurrenceMatrix);
+            }
+
+
+            void GrayscaleBitmap::getContrastEntropy(int x, int y, float& contrast, float& entropy, int radius,
+                std::vector<uint>& coOccurrenceMatrix) const
+            {
+                coOccurrenceMatrix.resize((size_t)1 << (mBitsPerPixel * 2));
+                uint* coOccurrence = coOccurrenceMatrix.data();
+
                 int fromX = (x > radius) ? x - radius : 0;
                 int fromY = (y > radius) ? y - radius : 0;
                 int toX = std::min<int>(mWidth - 1, x + radius + 1);
@@ -125,10 +135,10 @@ namespace cv
                 {
                     for (int i = fromX; i < toX; ++i)                               // for each pixel in the window
                     {
-                        updateCoOccurrenceMatrix(getPixel(i, j), getPixel(i, j + 1));        // match every pixel with all 8 its neighbours
-                        updateCoOccurrenceMatrix(getPixel(i, j), getPixel(i + 1, j));
-                        updateCoOccurrenceMatrix(getPixel(i, j), getPixel(i + 1, j + 1));
-                        updateCoOccurrenceMatrix(getPixel(i + 1, j), getPixel(i, j + 1));    // 4 updates per pixel in the window
+                        updateCoOccurrenceMatrix(getPixel(i, j), getPixel(i, j + 1), coOccurrence);        // match every pixel with all 8 its neighbours
+                        updateCoOccurrenceMatrix(getPixel(i, j), getPixel(i + 1, j), coOccurrence);
+                        updateCoOccurrenceMatrix(getPixel(i, j), getPixel(i + 1, j + 1), coOccurrence);
+                        updateCoOccurrenceMatrix(getPixel(i + 1, j), getPixel(i, j + 1), coOccurrence);    // 4 updates per pixel in the window
                     }
                 }
 
@@ -141,12 +151,12 @@ namespace cv
                 {
                     for (int i = 0; i <= j; ++i)                                        // iterate column up to the diagonal in 2D histogram
                     {
-                        if (mCoOccurrenceMatrix[j*pixelsScale + i] != 0)                // consider only non-zero values
+                        if (coOccurrence[j*pixelsScale + i] != 0)                // consider only non-zero values
                         {
-                            float value = (float)mCoOccurrenceMatrix[j*pixelsScale + i] / normalizer; // normalize value by number of histogram updates
+                            float value = (float)coOccurrence[j*pixelsScale + i] / normalizer; // normalize value by number of histogram updates
                             contrast += (i - j) * (i - j) * value;          // compute contrast
                             entropy -= value * std::log(value);             // compute entropy
-                            mCoOccurrenceMatrix[j*pixelsScale + i] = 0;     // clear the histogram array for the next computation
+                            coOccurrence[j*pixelsScale + i] = 0;     // clear the histogram array for the next computation
                         }
                     }
                 }
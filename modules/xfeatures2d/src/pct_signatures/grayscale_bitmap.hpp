@@ -127,6 +127,19 @@ namespace cv
                     float& entropy,
                     int windowRadius = 3);
 
+                /**
+                * @brief Compute contrast and entropy at selected coordinates, see above.
+                *       The co-occurrence matrix is provided by the caller, so that several
+                *       threads can share one bitmap. It is left cleared.
+                */
+                void getContrastEntropy(
+                    int x,
+                    int y,
+                    float& contrast,
+                    float& entropy,
+                    int windowRadius,
+                    std::vector<uint>& coOccurrenceMatrix) const;
+
                 /**
                 * @brief Converts to OpenCV CV_8U Mat for debug and visualization purposes.
                 * @param bitmap OutputArray proxy where Mat will be written.
@@ -198,13 +211,13 @@ namespace cv
                 /**
                 * @brief Perform an update of contrast matrix.
                 */
-                void inline updateCoOccurrenceMatrix(uint a, uint b)
+                void inline updateCoOccurrenceMatrix(uint a, uint b, uint* coOccurrenceMatrix) const
                 {
                     // co-occurrence matrix is symmetric
                     // merge to a variable with greater higher bits
                     // to accumulate just in upper triangle in co-occurrence matrix for efficiency
                     int offset = (int)((a > b) ? (a << mBitsPerPixel) + b : a + (b << mBitsPerPixel));
-                    mCoOccurrenceMatrix[offset]++;
+                    coOccurrenceMatrix[offset]++;
                 }
 
 
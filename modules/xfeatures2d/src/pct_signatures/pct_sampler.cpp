@@ -196,41 +196,52 @@ namespace cv
                 {
                     // prepare matrices
                     Mat image = _image.getMat();
-                    _samples.create((int)(mInitSamplingPoints.size()), SIGNATURE_DIMENSION, CV_32F);
+                    const int sampleCount = (int)(mInitSamplingPoints.size());
+                    _samples.create(sampleCount, SIGNATURE_DIMENSION, CV_32F);
                     Mat samples = _samples.getMat();
                     GrayscaleBitmap grayscaleBitmap(image, mGrayscaleBits);
 
-                    // sample each sample point
-                    for (int iSample = 0; iSample < (int)(mInitSamplingPoints.size()); iSample++)
+                    // gather the sampled pixels to convert them to Lab with a single call
+                    Mat rgbPixels(sampleCount, 1, image.type());
+                    for (int iSample = 0; iSample < sampleCount; iSample++)
                     {
                         // sampling points are in range [0..1)
                         int x = (int)(mInitSamplingPoints[iSample].x * (image.cols));
                         int y = (int)(mInitSamplingPoints[iSample].y * (image.rows));
-
-                        // x, y normalized
-                        samples.at<float>(iSample, X_IDX) = (float)((float)x / (float)image.cols * mWeights[X_IDX] + mTranslations[X_IDX]);
-                        samples.at<float>(iSample, Y_IDX) = (float)((float)y / (float)image.rows * mWeights[Y_IDX] + mTranslations[Y_IDX]);
-
-                        // get Lab pixel color
-                        Mat rgbPixel(image, Rect(x, y, 1, 1));
-                        Mat labPixel;
-                        rgbPixel.convertTo(rgbPixel, CV_32FC3, 1.0 / 255);
-                        cvtColor(rgbPixel, labPixel, COLOR_BGR2Lab);
-                        Vec3f labColor = labPixel.at<Vec3f>(0, 0);
-
-                        // Lab color normalized
-                        samples.at<float>(iSample, L_IDX) = (float)(std::floor(labColor[0] + 0.5) / L_COLOR_RANGE * mWeights[L_IDX] + mTranslations[L_IDX]);
-                        samples.at<float>(iSample, A_IDX) = (float)(std::floor(labColor[1] + 0.5) / A_COLOR_RANGE * mWeights[A_IDX] + mTranslations[A_IDX]);
-                        samples.at<float>(iSample, B_IDX) = (float)(std::floor(labColor[2] + 0.5) / B_COLOR_RANGE * mWeights[B_IDX] + mTranslations[B_IDX]);
-
-                        // contrast and entropy
-                        float contrast = 0.0, entropy = 0.0;
-                        grayscaleBitmap.getContrastEntropy(x, y, contrast, entropy, mWindowRadius);     // HOT PATH: 30%
-                        samples.at<float>(iSample, CONTRAST_IDX)
-                            = (float)(contrast / SAMPLER_CONTRAST_NORMALIZER * mWeights[CONTRAST_IDX] + mTranslations[CONTRAST_IDX]);
-                        samples.at<float>(iSample, ENTROPY_IDX)
-                            = (float)(entropy / SAMPLER_ENTROPY_NORMALIZER * mWeights[ENTROPY_IDX] + mTranslations[ENTROPY_IDX]);
+                        memcpy(rgbPixels.ptr(iSample), image.ptr(y, x), image.elemSize());
                     }
+                    Mat labPixels;
+                    rgbPixels.convertTo(rgbPixels, CV_32FC(image.channels()), 1.0 / 255);
+                    cvtColor(rgbPixels, labPixels, COLOR_BGR2Lab);
+
+                    // sample each sample point, each thread with its own co-occurrence matrix
+                    parallel_for_(Range(0, sampleCount), [&](const Range& range)
+                    {
+                        std::vector<uint> coOccurrenceMatrix;
+                        for (int iSample = range.start; iSample < range.end; iSample++)
+                        {
+                            int x = (int)(mInitSamplingPoints[iSample].x * (image.cols));
+                            int y = (int)(mInitSamplingPoints[iSample].y * (image.rows));
+
+                            // x, y normalized
+                            samples.at<float>(iSample, X_IDX) = (float)((float)x / (float)image.cols * mWeights[X_IDX] + mTranslations[X_IDX]);
+                            samples.at<float>(iSample, Y_IDX) = (float)((float)y / (float)image.rows * mWeights[Y_IDX] + mTranslations[Y_IDX]);
+
+                            // Lab color normalized
+                            Vec3f labColor = labPixels.at<Vec3f>(iSample, 0);
+                            samples.at<float>(iSample, L_IDX) = (float)(std::floor(labColor[0] + 0.5) / L_COLOR_RANGE * mWeights[L_IDX] + mTranslations[L_IDX]);
+                            samples.at<float>(iSample, A_IDX) = (float)(std::floor(labColor[1] + 0.5) / A_COLOR_RANGE * mWeights[A_IDX] + mTranslations[A_IDX]);
+                            samples.at<float>(iSample, B_IDX) = (float)(std::floor(labColor[2] + 0.5) / B_COLOR_RANGE * mWeights[B_IDX] + mTranslations[B_IDX]);
+
+                            // contrast and entropy
+                            float contrast = 0.0, entropy = 0.0;
+                            grayscaleBitmap.getContrastEntropy(x, y, contrast, entropy, mWindowRadius, coOccurrenceMatrix);     // HOT PATH: 30%
+                            samples.at<float>(iSample, CONTRAST_IDX)
+                                = (float)(contrast / SAMPLER_CONTRAST_NORMALIZER * mWeights[CONTRAST_IDX] + mTranslations[CONTRAST_IDX]);
+                            samples.at<float>(iSample, ENTROPY_IDX)
+                                = (float)(entropy / SAMPLER_ENTROPY_NORMALIZER * mWeights[ENTROPY_IDX] + mTranslations[ENTROPY_IDX]);
+                        }
+                    });
                 }
 
             };
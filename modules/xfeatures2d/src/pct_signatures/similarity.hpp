@@ -120,6 +120,40 @@ namespace cv
                 }
                 CV_Error(Error::StsNotImplemented, "Similarity function not implemented!");
             }
+
+
+            /**
+            * @brief Computes similarities between all centroids of a signature and one point,
+            *       see computeDistances. Each similarity is the one computeSimilarity returns.
+            */
+            static inline void computeSimilarities(
+                const int distancefunction,
+                const int similarity,
+                const float similarityParameter,
+                const Mat& points1, const Mat& points1T,
+                const Mat& points2, int idx2,
+                float* similarities)
+            {
+                computeDistances(distancefunction, points1, points1T, points2, idx2, similarities);
+                for (int i = 0; i < points1.rows; i++)
+                {
+                    float distance = similarities[i];
+                    switch (similarity)
+                    {
+                    case PCTSignatures::MINUS:
+                        similarities[i] = -distance;
+                        break;
+                    case PCTSignatures::GAUSSIAN:
+                        similarities[i] = exp(-similarityParameter * distance * distance);
+                        break;
+                    case PCTSignatures::HEURISTIC:
+                        similarities[i] = 1 / (similarityParameter + distance);
+                        break;
+                    default:
+                        CV_Error(Error::StsNotImplemented, "Similarity function not implemented!");
+                    }
+                }
+            }
         }
     }
 }
@@ -91,33 +91,57 @@ namespace cv
                     const std::vector<Mat>& imageSignatures,
                     std::vector<float>& distances) const CV_OVERRIDE;
 
+                /**
+                * @brief Sum of weighted similarities of all the centroid pairs of two signatures.
+                * @param signature0 The first signature.
+                * @param signature0T Transposition of the first signature.
+                * @param signature1 The second signature.
+                */
+                float computePartialSQFD(
+                    const Mat& signature0,
+                    const Mat& signature0T,
+                    const Mat& signature1) const;
+
 
             private:
                 int mDistanceFunction;
                 int mSimilarityFunction;
                 float mSimilarityParameter;
 
-                float computePartialSQFD(
-                    const Mat& signature0,
-                    const Mat& signature1) const;
-
             };
 
 
+            static void checkSignature(const Mat& signature)
+            {
+                if (signature.cols != SIGNATURE_DIMENSION)
+                {
+                    CV_Error_(Error::StsBadArg, ("Signature dimension must be %d!", SIGNATURE_DIMENSION));
+                }
+
+                if (signature.rows <= 0)
+                {
+                    CV_Error(Error::StsBadArg, "Signature count must be greater than 0!");
+                }
+            }
+
+
             /**
             * @brief Class implementing parallel computing of SQFD distance for multiple images.
+            *       The source signature is prepared once for all images.
             */
             class Parallel_computeSQFDs : public ParallelLoopBody
             {
             private:
-                const PCTSignaturesSQFD* mPctSignaturesSQFDAlgorithm;
+                const PCTSignaturesSQFD_Impl* mPctSignaturesSQFDAlgorithm;
                 const Mat* mSourceSignature;
                 const std::vector<Mat>* mImageSignatures;
                 std::vector<float>* mDistances;
+                Mat mSourceSignatureT;
+                float mSourcePartialSQFD;
 
             public:
                 Parallel_computeSQFDs(
-                    const PCTSignaturesSQFD* pctSignaturesSQFDAlgorithm,
+                    const PCTSignaturesSQFD_Impl* pctSignaturesSQFDAlgorithm,
                     const Mat* sourceSignature,
                     const std::vector<Mat>* imageSignatures,
                     std::vector<float>* distances)
@@ -125,26 +149,40 @@ namespace cv
                     mSourceSignature(sourceSignature),
                     mImageSignatures(imageSignatures),
                     mDistances(distances)
-                {
-                    mDistances->resize(imageSignatures->size());
-                }
-
-                void operator()(const Range& range) const CV_OVERRIDE
                 {
                     if (mSourceSignature->empty())
                     {
                         CV_Error(Error::StsBadArg, "Source signature is empty!");
                     }
+                    checkSignature(*mSourceSignature);
+
+                    mSourceSignatureT = mSourceSignature->t();
+                    mSourcePartialSQFD = mPctSignaturesSQFDAlgorithm->computePartialSQFD(
+                        *mSourceSignature, mSourceSignatureT, *mSourceSignature);
+
+                    mDistances->resize(imageSignatures->size());
+                }
 
+                void operator()(const Range& range) const CV_OVERRIDE
+                {
+                    Mat imageSignatureT;
                     for (int i = range.start; i < range.end; i++)
                     {
-                        if (mImageSignatures[i].empty())
+                        const Mat& imageSignature = (*mImageSignatures)[i];
+                        if (imageSignature.empty())
                         {
                             CV_Error_(Error::StsBadArg, ("Signature ID: %d is empty!", i));
                         }
+                        checkSignature(imageSignature);
+
+                        transpose(imageSignature, imageSignatureT);
+
+                        float result = 0;
+                        result += mSourcePartialSQFD;
+                        result += mPctSignaturesSQFDAlgorithm->computePartialSQFD(imageSignature, imageSignatureT, imageSignature);
+                        result -= mPctSignaturesSQFDAlgorithm->computePartialSQFD(*mSourceSignature, mSourceSignatureT, imageSignature) * 2;
 
-                        (*mDistances)[i] = mPctSignaturesSQFDAlgorithm->computeQuadraticFormDistance(
-                            *mSourceSignature, (*mImageSignatures)[i]);
+                        (*mDistances)[i] = sqrt(result);
                     }
                 }
             };
@@ -163,21 +201,17 @@ namespace cv
                 Mat signature0 = _signature0.getMat();
                 Mat signature1 = _signature1.getMat();
 
-                if (signature0.cols != SIGNATURE_DIMENSION || signature1.cols != SIGNATURE_DIMENSION)
-                {
-                    CV_Error_(Error::StsBadArg, ("Signature dimension must be %d!", SIGNATURE_DIMENSION));
-                }
+                checkSignature(signature0);
+                checkSignature(signature1);
 
-                if (signature0.rows <= 0 || signature1.rows <= 0)
-                {
-                    CV_Error(Error::StsBadArg, "Signature count must be greater than 0!");
-                }
+                Mat signature0T = signature0.t();
+                Mat signature1T = signature1.t();
 
                 // compute sqfd
                 float result = 0;
-                result += computePartialSQFD(signature0, signature0);
-                result += computePartialSQFD(signature1, signature1);
-                result -= computePartialSQFD(signature0, signature1) * 2;
+                result += computePartialSQFD(signature0, signature0T, signature0);
+                result += computePartialSQFD(signature1, signature1T, signature1);
+                result -= computePartialSQFD(signature0, signature0T, signature1) * 2;
 
                 return sqrt(result);
             }
@@ -187,21 +221,43 @@ namespace cv
                       const std::vector<Mat>& imageSignatures,
                       std::vector<float>& distances) const
             {
+                if (imageSignatures.empty())
+                {
+                    distances.clear();
+                    return;
+                }
+
                 parallel_for_(Range(0, (int)imageSignatures.size()),
                     Parallel_computeSQFDs(this, &sourceSignature, &imageSignatures, &distances));
             }
 
             float PCTSignaturesSQFD_Impl::computePartialSQFD(
                       const Mat& signature0,
+                      const Mat& signature0T,
                       const Mat& signature1) const
             {
+                // similarities of all the pairs, computed for all the centroids of signature0 at once
+                AutoBuffer<float> similaritiesBuf((size_t)signature0.rows * signature1.rows);
+                float* similarities = similaritiesBuf.data();
+                AutoBuffer<float> columnBuf(signature0.rows);
+                for (int j = 0; j < signature1.rows; j++)
+                {
+                    computeSimilarities(mDistanceFunction, mSimilarityFunction, mSimilarityParameter,
+                        signature0, signature0T, signature1, j, columnBuf.data());
+                    for (int i = 0; i < signature0.rows; i++)
+                    {
+                        similarities[i * signature1.rows + j] = columnBuf[i];
+                    }
+                }
+
+                // sum them in the same order as the pairs are enumerated
                 float result = 0;
                 for (int i = 0; i < signature0.rows; i++)
                 {
                     for (int j = 0; j < signature1.rows; j++)
                     {
                         result += signature0.at<float>(i, WEIGHT_IDX) * signature1.at<float>(j, WEIGHT_IDX)
-                            * computeSimilarity(mDistanceFunction, mSimilarityFunction, mSimilarityParameter, signature0, i, signature1, j);
+                            * similarities[i * signature1.rows + j];
                     }
                 }
                 return result;
@@ -109,6 +109,7 @@ Modifications by Ian Mahon
 */
 #include "precomp.hpp"
 #include "surf.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -141,12 +142,27 @@ struct SurfHF
 
 inline float calcHaarPattern( const int* origin, const SurfHF* f, int n )
 {
-    double d = 0;
+    float d = 0;
     for( int k = 0; k < n; k++ )
         d += (origin[f[k].p0] + origin[f[k].p3] - origin[f[k].p1] - origin[f[k].p2])*f[k].w;
-    return (float)d;
+    return d;
 }
 
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+// Same as calcHaarPattern, for VTraits<v_float32>::vlanes() consecutive positions
+inline v_float32 v_calcHaarPattern( const int* origin, const SurfHF* f, int n )
+{
+    v_float32 d = vx_setzero_f32();
+    for( int k = 0; k < n; k++ )
+    {
+        v_int32 box = v_sub(v_add(vx_load(origin + f[k].p0), vx_load(origin + f[k].p3)),
+                            v_add(vx_load(origin + f[k].p1), vx_load(origin + f[k].p2)));
+        d = v_add(d, v_mul(v_cvt_f32(box), vx_setall_f32(f[k].w)));
+    }
+    return d;
+}
+#endif
+
 static void
 resizeHaarPattern( const int src[][5], SurfHF* dst, int n, int oldSize, int newSize, int widthStep )
 {
@@ -198,7 +214,24 @@ static void calcLayerDetAndTrace( const Mat& sum, int size, int sampleStep,
         const int* sum_ptr = sum.ptr<int>(i*sampleStep);
         float* det_ptr = &det.at<float>(i+margin, margin);
         float* trace_ptr = &trace.at<float>(i+margin, margin);
-        for( int j = 0; j < samples_j; j++ )
+        int j = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+        // The first octave is sampled densely and dominates the detector cost
+        if( sampleStep == 1 )
+        {
+            const int vlanes = VTraits<v_float32>::vlanes();
+            const v_float32 v_081 = vx_setall_f32(0.81f);
+            for( ; j <= samples_j - vlanes; j += vlanes, sum_ptr += vlanes )
+            {
+                v_float32 dx  = v_calcHaarPattern( sum_ptr, Dx , 3 );
+                v_float32 dy  = v_calcHaarPattern( sum_ptr, Dy , 3 );
+                v_float32 dxy = v_calcHaarPattern( sum_ptr, Dxy, 4 );
+                v_store(det_ptr + j, v_sub(v_mul(dx, dy), v_mul(v_mul(v_081, dxy), dxy)));
+                v_store(trace_ptr + j, v_add(dx, dy));
+            }
+        }
+#endif
+        for( ; j < samples_j; j++ )
         {
             float dx  = calcHaarPattern( sum_ptr, Dx , 3 );
             float dy  = calcHaarPattern( sum_ptr, Dy , 3 );
@@ -577,6 +610,7 @@ struct SURFInvoker : ParallelLoopBody
         const int nOriSampleBound =(2*ORI_RADIUS+1)*(2*ORI_RADIUS+1);
 
         float X[nOriSampleBound], Y[nOriSampleBound], angle[nOriSampleBound];
+        int iangle[nOriSampleBound];
         uchar PATCH[PATCH_SZ+1][PATCH_SZ+1];
         float DX[PATCH_SZ][PATCH_SZ], DY[PATCH_SZ][PATCH_SZ];
         Mat _patch(PATCH_SZ+1, PATCH_SZ+1, CV_8U, PATCH);
@@ -647,14 +681,34 @@ struct SURFInvoker : ParallelLoopBody
                 }
 
                 phase( Mat(1, nangle, CV_32F, X), Mat(1, nangle, CV_32F, Y), Mat(1, nangle, CV_32F, angle), true );
+                for( j = 0; j < nangle; j++ )
+                    iangle[j] = cvRound(angle[j]);
 
                 float bestx = 0, besty = 0, descriptor_mod = 0;
                 for( i = 0; i < 360; i += SURF_ORI_SEARCH_INC )
                 {
                     float sumx = 0, sumy = 0, temp_mod;
-                    for( j = 0; j < nangle; j++ )
+                    j = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
                     {
-                        int d = std::abs(cvRound(angle[j]) - i);
+                        const int vlanes = VTraits<v_float32>::vlanes();
+                        const v_int32 v_i = vx_setall_s32(i);
+                        const v_int32 v_lo = vx_setall_s32(ORI_WIN/2), v_hi = vx_setall_s32(360-ORI_WIN/2);
+                        v_float32 v_sumx = vx_setzero_f32(), v_sumy = vx_setzero_f32();
+                        for( ; j <= nangle - vlanes; j += vlanes )
+                        {
+                            v_int32 d = v_reinterpret_as_s32(v_abs(v_sub(vx_load(iangle + j), v_i)));
+                            v_float32 inWin = v_reinterpret_as_f32(v_or(v_lt(d, v_lo), v_gt(d, v_hi)));
+                            v_sumx = v_add(v_sumx, v_and(vx_load(X + j), inWin));
+                            v_sumy = v_add(v_sumy, v_and(vx_load(Y + j), inWin));
+                        }
+                        sumx = v_reduce_sum(v_sumx);
+                        sumy = v_reduce_sum(v_sumy);
+                    }
+#endif
+                    for( ; j < nangle; j++ )
+                    {
+                        int d = std::abs(iangle[j] - i);
                         if( d < ORI_WIN/2 || d > 360-ORI_WIN/2 )
                         {
                             sumx += X[j];
@@ -717,15 +771,17 @@ struct SURFInvoker : ParallelLoopBody
                 size_t imgstep = img->step;
                 for( i = 0; i < win_size; i++, start_x += sin_dir, start_y += cos_dir )
                 {
-                    double pixel_x = start_x;
-                    double pixel_y = start_y;
-                    for( j = 0; j < win_size; j++, pixel_x += cos_dir, pixel_y -= sin_dir )
+                    for( j = 0; j < win_size; j++ )
                     {
+                        // Computed from the row start rather than accumulated,
+                        // so that single precision does not drift along the row
+                        float pixel_x = start_x + j*cos_dir;
+                        float pixel_y = start_y - j*sin_dir;
                         int ix = cvFloor(pixel_x), iy = cvFloor(pixel_y);
                         if( (unsigned)ix < (unsigned)ncols1 &&
                             (unsigned)iy < (unsigned)nrows1 )
                         {
-                            float a = (float)(pixel_x - ix), b = (float)(pixel_y - iy);
+                            float a = pixel_x - ix, b = pixel_y - iy;
                             const uchar* imgptr = &img->at<uchar>(iy, ix);
                             WIN[i*win_size + j] = (uchar)
                                 cvRound(imgptr[0]*(1.f - a)*(1.f - b) +
@@ -776,7 +832,21 @@ struct SURFInvoker : ParallelLoopBody
 
             // Calculate gradients in x and y with wavelets of size 2s
             for( i = 0; i < PATCH_SZ; i++ )
-                for( j = 0; j < PATCH_SZ; j++ )
+            {
+                j = 0;
+#if CV_SIMD128
+                for( ; j <= PATCH_SZ - 4; j += 4 )
+                {
+                    v_float32x4 p00 = v_cvt_f32(v_reinterpret_as_s32(v_load_expand_q(&PATCH[i][j])));
+                    v_float32x4 p01 = v_cvt_f32(v_reinterpret_as_s32(v_load_expand_q(&PATCH[i][j+1])));
+                    v_float32x4 p10 = v_cvt_f32(v_reinterpret_as_s32(v_load_expand_q(&PATCH[i+1][j])));
+                    v_float32x4 p11 = v_cvt_f32(v_reinterpret_as_s32(v_load_expand_q(&PATCH[i+1][j+1])));
+                    v_float32x4 dw = v_load(&DW[i*PATCH_SZ + j]);
+                    v_store(&DX[i][j], v_mul(v_sub(v_add(p01, p11), v_add(p00, p10)), dw));
+                    v_store(&DY[i][j], v_mul(v_sub(v_add(p10, p11), v_add(p00, p01)), dw));
+                }
+#endif
+                for( ; j < PATCH_SZ; j++ )
                 {
                     float dw = DW[i*PATCH_SZ + j];
                     float vx = (PATCH[i][j+1] - PATCH[i][j] + PATCH[i+1][j+1] - PATCH[i+1][j])*dw;
@@ -784,12 +854,13 @@ struct SURFInvoker : ParallelLoopBody
                     DX[i][j] = vx;
                     DY[i][j] = vy;
                 }
+            }
 
             // Construct the descriptor
             vec = descriptors->ptr<float>(k);
             for( kk = 0; kk < dsize; kk++ )
                 vec[kk] = 0;
-            double square_mag = 0;
+            float square_mag = 0;
             if( extended )
             {
                 // 128-bin descriptor
@@ -847,7 +918,7 @@ struct SURFInvoker : ParallelLoopBody
 
             // unit vector is essential for contrast invariance
             vec = descriptors->ptr<float>(k);
-            float scale = (float)(1./(std::sqrt(square_mag) + FLT_EPSILON));
+            float scale = 1.f/(std::sqrt(square_mag) + FLT_EPSILON);
             for( kk = 0; kk < dsize; kk++ )
                 vec[kk] *= scale;
         }
@@ -946,16 +1017,15 @@ void SURF_Impl::detectAndCompute(InputArray _img, InputArray _mask,
         fastHessianDetector( sum, msum, keypoints, nOctaves, nOctaveLayers, (float)hessianThreshold );
         if (!mask.empty())
         {
-            for (size_t i = 0; i < keypoints.size(); )
+            // compact in place: erasing one by one is quadratic on large images
+            size_t nkept = 0;
+            for (size_t i = 0; i < keypoints.size(); i++)
             {
                 Point pt(keypoints[i].pt);
-                if (mask.at<uchar>(pt.y, pt.x) == 0)
-                {
-                    keypoints.erase(keypoints.begin() + i);
-                    continue; // keep "i"
-                }
-                i++;
+                if (mask.at<uchar>(pt.y, pt.x) != 0)
+                    keypoints[nkept++] = keypoints[i];
             }
+            keypoints.resize(nkept);
         }
     }
 
@@ -78,17 +78,84 @@ class TBMR_Impl CV_FINAL : public TBMR
                      OutputArray descriptors,
                      bool useProvidedKeypoints = false) CV_OVERRIDE;
 
-    CV_INLINE uint zfindroot(uint *parent, uint p)
+    // component tree representation (parent,S): see
+    // https://ieeexplore.ieee.org/document/6850018
+    struct ComponentTree
     {
-        if (parent[p] == p)
-            return p;
-        else
-            return parent[p] = zfindroot(parent, parent[p]);
+        Mat parent;
+        Mat S;
+        // moments: compound type of: (area, x, y, xy, xx, yy)
+        Mat imaAttributes;
+    };
+
+    static inline uint zfindroot(uint *parent, uint p)
+    {
+        uint r = p;
+        while (parent[r] != r)
+            r = parent[r];
+
+        // path compression
+        while (parent[p] != r)
+        {
+            uint next = parent[p];
+            parent[p] = r;
+            p = next;
+        }
+        return r;
+    }
+
+    // Sort the pixel indices by gray level with a stable counting sort (a
+    // single 8-bit radix pass), histograms and scattering being done in
+    // parallel over stripes of the image.
+    static void sortPixels(const Mat &ima, Mat &S, bool descending)
+    {
+        const int imSize = (int)ima.total();
+        S.create(1, imSize, CV_32S);
+
+        const uchar *ima_ptr = ima.ptr<uchar>();
+        uint *S_ptr = S.ptr<uint>();
+
+        const int nStripes = std::max(1, std::min(imSize >> 16, 64));
+        std::vector<int> offsets(nStripes * 256, 0);
+        int *offsets_ptr = offsets.data();
+
+        parallel_for_(Range(0, nStripes), [&](const Range &range) {
+            for (int k = range.start; k < range.end; k++)
+            {
+                int *hist = offsets_ptr + k * 256;
+                const int end = (int)((int64)imSize * (k + 1) / nStripes);
+                for (int i = (int)((int64)imSize * k / nStripes); i < end; i++)
+                    hist[ima_ptr[i]]++;
+            }
+        });
+
+        // first position of every (level, stripe) bucket
+        int pos = 0;
+        for (int l = 0; l < 256; l++)
+        {
+            const int level = descending ? 255 - l : l;
+            for (int k = 0; k < nStripes; k++)
+            {
+                const int count = offsets_ptr[k * 256 + level];
+                offsets_ptr[k * 256 + level] = pos;
+                pos += count;
+            }
+        }
+
+        parallel_for_(Range(0, nStripes), [&](const Range &range) {
+            for (int k = range.start; k < range.end; k++)
+            {
+                int *next = offsets_ptr + k * 256;
+                const int end = (int)((int64)imSize * (k + 1) / nStripes);
+                for (int i = (int)((int64)imSize * k / nStripes); i < end; i++)
+                    S_ptr[next[ima_ptr[i]]++] = (uint)i;
+            }
+        });
     }
 
     // Calculate the Component tree. Based on the order of S, it will be a
     // min or max tree.
-    void calcMinMaxTree(Mat ima)
+    static void calcMinMaxTree(const Mat &ima, ComponentTree &tree)
     {
         int rs = ima.rows;
         int cs = ima.cols;
@@ -106,14 +173,13 @@ class TBMR_Impl CV_FINAL : public TBMR
         uint* zpar = zparb.data();
         uint *root = rootb.data();
         uint *rank = rankb.data();
-        parent = Mat(rs, cs, CV_32S); // unsigned
         AutoBuffer<bool> dejaVub(imSize);
         memset(dejaVub.data(), 0, imSize * sizeof(bool));
         bool* dejaVu = dejaVub.data();
 
-        const uint *S_ptr = S.ptr<const uint>();
-        uint *parent_ptr = parent.ptr<uint>();
-        Vec<uint, 6> *imaAttribute = imaAttributes.ptr<Vec<uint, 6>>();
+        const uint *S_ptr = tree.S.ptr<const uint>();
+        uint *parent_ptr = tree.parent.ptr<uint>();
+        Vec<uint, 6> *imaAttribute = tree.imaAttributes.ptr<Vec<uint, 6>>();
 
         for (int i = imSize - 1; i >= 0; --i)
         {
@@ -186,27 +252,27 @@ class TBMR_Impl CV_FINAL : public TBMR
         }
     }
 
-    void calculateTBMRs(const Mat &image, std::vector<Elliptic_KeyPoint> &tbmrs,
-                        const Mat &mask, float scale, int octave)
+    // Extract the TBMRs of the max tree (or of the min tree if descending)
+    void calculateTBMRs(const Mat &image, ComponentTree &tree, bool descending,
+                        std::vector<Elliptic_KeyPoint> &tbmrs,
+                        const Mat &mask, float scale, int octave) const
     {
         uint imSize = image.cols * image.rows;
         uint maxArea =
             static_cast<uint>(params.maxAreaRelative * imSize * scale);
         uint minArea = static_cast<uint>(params.minArea * scale);
 
-        if (parent.empty() || parent.size != image.size)
-            parent = Mat(image.rows, image.cols, CV_32S);
+        tree.parent.create(image.rows, image.cols, CV_32S); // unsigned
+        tree.imaAttributes.create(image.rows, image.cols, CV_32SC(6));
 
-        if (imaAttributes.empty() || imaAttributes.size != image.size)
-            imaAttributes = Mat(image.rows, image.cols, CV_32SC(6));
-
-        calcMinMaxTree(image);
+        sortPixels(image, tree.S, descending);
+        calcMinMaxTree(image, tree);
 
         const Vec<uint, 6> *imaAttribute =
-            imaAttributes.ptr<const Vec<uint, 6>>();
+            tree.imaAttributes.ptr<const Vec<uint, 6>>();
         const uint8_t *ima_ptr = image.ptr<const uint8_t>();
-        const uint *S_ptr = S.ptr<const uint>();
-        uint *parent_ptr = parent.ptr<uint>();
+        const uint *S_ptr = tree.S.ptr<const uint>();
+        uint *parent_ptr = tree.parent.ptr<uint>();
 
         // canonization
         for (uint i = 0; i < imSize; ++i)
@@ -453,12 +519,8 @@ class TBMR_Impl CV_FINAL : public TBMR
 
     Mat tempsrc;
 
-    // component tree representation (parent,S): see
-    // https://ieeexplore.ieee.org/document/6850018
-    Mat parent;
-    Mat S;
-    // moments: compound type of: (area, x, y, xy, xx, yy)
-    Mat imaAttributes;
+    // max and min trees of every pyramid level, built concurrently
+    std::vector<ComponentTree> trees;
 
     Params params;
 };
@@ -517,20 +579,28 @@ void TBMR_Impl::detect(InputArray _image,
     MSDImagePyramid scaleSpacer(src, m_cur_n_scales, m_scale_factor);
     pyr = scaleSpacer.getImPyr();
 
+    // the max tree and the min tree of every level are independent, each
+    // one is built by its own task: max tree tbmrs go first, then min tree
+    // tbmrs
+    const int nTrees = 2 * (int)pyr.size();
+    trees.resize(nTrees);
+    std::vector<std::vector<Elliptic_KeyPoint>> treeKpts(nTrees);
+    parallel_for_(Range(0, nTrees), [&](const Range &range) {
+        for (int t = range.start; t < range.end; t++)
+        {
+            const Mat &s = pyr[t / 2];
+            float scale = ((float)s.cols) / pyr.begin()->cols;
+            calculateTBMRs(s, trees[t], (t % 2) != 0, treeKpts[t], mask,
+                           scale, t / 2);
+        }
+    });
+
     int oct = 0;
-    for (auto &s : pyr)
+    for (size_t l = 0; l < pyr.size(); l++)
     {
-        float scale = ((float)s.cols) / pyr.begin()->cols;
-        std::vector<Elliptic_KeyPoint> kpts;
-
-        // append max tree tbmrs
-        sortIdx(s.reshape(1, 1), S,
-                SortFlags::SORT_ASCENDING | SortFlags::SORT_EVERY_ROW);
-        calculateTBMRs(s, kpts, mask, scale, oct);
-
-        // reverse instead of sort
-        flip(S, S, -1);
-        calculateTBMRs(s, kpts, mask, scale, oct);
+        std::vector<Elliptic_KeyPoint> &kpts = treeKpts[2 * l];
+        kpts.insert(kpts.end(), treeKpts[2 * l + 1].begin(),
+                    treeKpts[2 * l + 1].end());
 
         if (oct == 0)
         {
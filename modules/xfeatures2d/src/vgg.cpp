@@ -54,6 +54,7 @@
  */
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 
 
@@ -152,8 +153,12 @@ protected:
     // image
     Mat m_image;
 
-    // pool regions & proj
-    Mat m_PRFilters, m_Proj;
+    // pool regions, sparse in compressed row form
+    vector<int> m_PRRowStart, m_PRCols;
+    vector<float> m_PRVals;
+
+    // projection
+    Mat m_Proj;
 
 private:
 
@@ -189,98 +194,93 @@ static inline void get_patch( const KeyPoint kp, Mat& Patch, const Mat& image,
   const float half_rows = (float)Patch.rows / 2.0f;
 
   // sample form original image
-  for ( int x = 0; x < Patch.cols; x++ )
+  for ( int y = 0; y < Patch.rows; y++ )
   {
-    for ( int y = 0; y < Patch.rows; y++ )
+    float* dst = Patch.ptr<float>( y );
+    const float yoff = y - half_rows;
+    for ( int x = 0; x < Patch.cols; x++ )
     {
+      const float xoff = x - half_cols;
+      int img_x, img_y;
       if ( use_scale_orientation )
       {
-        const float xoff = x - half_cols;
-        const float yoff = y - half_rows;
         // the rotation shifts & scale
-        int img_x = int( (kp.pt.x + 0.5f) + xoff*tcos - yoff*tsin );
-        int img_y = int( (kp.pt.y + 0.5f) + xoff*tsin + yoff*tcos );
-        // sample only within image
-        if ( ( img_x < image.cols ) && ( img_x >= 0 )
-          && ( img_y < image.rows ) && ( img_y >= 0 ) )
-          Patch.at<float>( y, x ) = image.at<float>( img_y, img_x );
-        else
-          Patch.at<float>( y, x ) = 0.0f;
+        img_x = int( (kp.pt.x + 0.5f) + xoff*tcos - yoff*tsin );
+        img_y = int( (kp.pt.y + 0.5f) + xoff*tsin + yoff*tcos );
       }
       else
       {
-        const float xoff = x - half_cols;
-        const float yoff = y - half_rows;
         // the samples from image
-        int img_x = int( kp.pt.x + 0.5f + xoff );
-        int img_y = int( kp.pt.y + 0.5f + yoff );
-        // sample only within image
-        if ( ( img_x < image.cols ) && ( img_x >= 0 )
-          && ( img_y < image.rows ) && ( img_y >= 0 ) )
-          Patch.at<float>( y, x ) = image.at<float>( img_y, img_x );
-        else
-          Patch.at<float>( y, x ) = 0.0f;
+        img_x = int( kp.pt.x + 0.5f + xoff );
+        img_y = int( kp.pt.y + 0.5f + yoff );
       }
+      // sample only within image
+      if ( ( img_x < image.cols ) && ( img_x >= 0 )
+        && ( img_y < image.rows ) && ( img_y >= 0 ) )
+        dst[x] = image.at<float>( img_y, img_x );
+      else
+        dst[x] = 0.0f;
     }
   }
 }
 
+// per-thread buffers used by get_desc() and the pooling
+struct VGGScratch
+{
+    VGGScratch( int npixels, int anglebins, int npools )
+      : PatchTrans( (size_t)npixels * anglebins ), GMag( npixels ), GMagSorted( npixels ),
+        Offset1( npixels ), Bin1( npixels ), Desc( (size_t)npools * anglebins ) {}
+
+    vector<float> PatchTrans;
+    vector<float> GMag, GMagSorted, Offset1;
+    vector<uchar> Bin1;
+    vector<float> Desc;
+};
+
 // get descriptor given 64x64 image patch
-static void get_desc( const Mat Patch, Mat& PatchTrans, int anglebins, bool img_normalize )
+// the feature channels are stored in scratch.PatchTrans, anglebins values per pixel,
+// pixels in column-major order as in the reference Matlab code
+static void get_desc( const Mat& Patch, VGGScratch& scratch, int anglebins, bool img_normalize )
 {
-    Mat Ix, Iy;
-    // % compute gradient
-    float kparam[3] = { -1,  0,  1 };
-    Mat Kernel( 1, 3, CV_32F, &kparam );
-    filter2D( Patch, Ix, CV_32F, Kernel,     Point( -1, -1 ), 0, BORDER_REPLICATE );
-    filter2D( Patch, Iy, CV_32F, Kernel.t(), Point( -1, -1 ), 0, BORDER_REPLICATE );
-
-    Mat GMag, GAngle;
-
-    // % gradient magnitude
-    // % GMag = sqrt(Ix .^ 2 + Iy .^ 2);
-    magnitude( Ix, Iy, GMag );
-
-    // % gradient orientation: [0; 2 * pi]
-    // % GAngle = atan2(Iy, Ix) + pi;
-    //phase( Ix, Iy, GAngle, false ); //<- opencv is buggy
-    GAngle = Mat( GMag.rows, GMag.cols, CV_32F );
-    for ( int i = 0; i < (int)GAngle.total(); i++ )
-      GAngle.at<float>(i) = atan2( Iy.at<float>(i), Ix.at<float>(i) ) + (float)CV_PI;
+    const int rows = Patch.rows, cols = Patch.cols;
+    const int n = rows * cols;
+    float* GMag = &scratch.GMag[0];
+    float* Offset1 = &scratch.Offset1[0];
+    uchar* Bin1 = &scratch.Bin1[0];
 
     // % soft-assignment of gradients to the orientation histogram
     float AngleStep = 2.0f * (float) CV_PI / (float) anglebins;
-    Mat GAngleRatio = GAngle / AngleStep - 0.5f;
 
-    // % Offset1 = mod(GAngleRatio, 1);
-    Mat Offset1( GAngleRatio.rows, GAngleRatio.cols, CV_32F );
-    for ( int i = 0; i < (int)GAngleRatio.total(); i++ )
-      Offset1.at<float>(i) = GAngleRatio.at<float>(i) - floor( GAngleRatio.at<float>(i) );
+    for ( int y = 0; y < rows; y++ )
+    {
+      const float* prev = Patch.ptr<float>( std::max( y - 1, 0 ) );
+      const float* curr = Patch.ptr<float>( y );
+      const float* next = Patch.ptr<float>( std::min( y + 1, rows - 1 ) );
+      for ( int x = 0; x < cols; x++ )
+      {
+        const int p = x * rows + y;
 
-    Mat w1 = 1.0f - Offset1.t();
-    Mat w2 = Offset1.t();
+        // % compute gradient, [-1 0 1] kernels with replicated border
+        float Ix = curr[std::min( x + 1, cols - 1 )] - curr[std::max( x - 1, 0 )];
+        float Iy = next[x] - prev[x];
 
-    Mat Bin1( GAngleRatio.rows, GAngleRatio.cols, CV_8U );
-    Mat Bin2( GAngleRatio.rows, GAngleRatio.cols, CV_8U );
+        // % gradient magnitude
+        // % GMag = sqrt(Ix .^ 2 + Iy .^ 2);
+        GMag[p] = std::sqrt( Ix * Ix + Iy * Iy );
 
-    // % Bin1 = ceil(GAngleRatio);
-    // % Bin1(Bin1 == 0) = Params.nAngleBins;
-    for ( int i = 0; i < (int)GAngleRatio.total(); i++ )
-    {
-      if ( ceil( GAngleRatio.at<float>(i) - 1.0f) == -1.0f )
-        Bin1.at<uchar>(i) = (uchar) anglebins - 1;
-      else
-        Bin1.at<uchar>(i) = (uchar) ceil( GAngleRatio.at<float>(i) - 1.0f );
-    }
+        // % gradient orientation: [0; 2 * pi]
+        // % GAngle = atan2(Iy, Ix) + pi;
+        float GAngle = atan2( Iy, Ix ) + (float)CV_PI;
+        float GAngleRatio = GAngle / AngleStep - 0.5f;
 
-    // % Bin2 = Bin1 + 1;
-    // % Bin2(Bin2 > Params.nAngleBins) = 1;
-    for ( int i = 0; i < (int)GAngleRatio.total(); i++ )
-    {
-      if ( ( Bin1.at<uchar>(i) + 1 ) > anglebins - 1 )
-        Bin2.at<uchar>(i) = 0;
-      else
-        Bin2.at<uchar>(i) = Bin1.at<uchar>(i) + 1;
+        // % Offset1 = mod(GAngleRatio, 1);
+        Offset1[p] = GAngleRatio - floor( GAngleRatio );
+
+        // % Bin1 = ceil(GAngleRatio);
+        // % Bin1(Bin1 == 0) = Params.nAngleBins;
+        float bin = ceil( GAngleRatio - 1.0f );
+        Bin1[p] = ( bin == -1.0f ) ? (uchar) anglebins - 1 : (uchar) bin;
+      }
     }
 
     // normalize
@@ -289,11 +289,6 @@ static void get_desc( const Mat Patch, Mat& PatchTrans, int anglebins, bool img_
       // % Quantile = 0.8;
       float q = 0.8f;
 
-      // % T = quantile(GMag(:), Quantile);
-      Mat GMagSorted;
-      sort( GMag.reshape( 0, 1 ), GMagSorted, SORT_ASCENDING );
-
-      int n = GMagSorted.cols;
       // scipy/stats/mstats_basic.py#L1718 mquantiles()
       // m = alphap + p*(1.-alphap-betap)
       // alphap = 0.5 betap = 0.5 => (m = 0.5)
@@ -306,33 +301,91 @@ static void get_desc( const Mat Patch, Mat& PatchTrans, int anglebins, bool img_
       float gamma = aleph - k;
       if ( gamma >= 1.0f ) gamma = 1.0f;
       if ( gamma <= 0.0f ) gamma = 0.0f;
+
+      // % T = quantile(GMag(:), Quantile);
+      // only the (k-1)-th and k-th order statistics are needed, no full sort
+      float* GMagSorted = &scratch.GMagSorted[0];
+      std::copy( GMag, GMag + n, GMagSorted );
+      std::nth_element( GMagSorted, GMagSorted + k, GMagSorted + n );
+      float gk = GMagSorted[k];
+      float gk1 = *std::max_element( GMagSorted, GMagSorted + k );
+
       // quantile out from distribution
-      float T = ( 1.0f - gamma ) * GMagSorted.at<float>( k - 1 )
-              + gamma * GMagSorted.at<float>( k );
+      float T = ( 1.0f - gamma ) * gk1 + gamma * gk;
 
       // avoid NaN
-      if ( T != 0.0f ) GMag /= ( T / anglebins );
+      if ( T != 0.0f )
+      {
+        const float s = 1.0f / ( T / anglebins );
+        for ( int p = 0; p < n; p++ )
+          GMag[p] *= s;
+      }
     }
 
-    Mat Bin1T = Bin1.t();
-    Mat Bin2T = Bin2.t();
-    Mat GMagT = GMag.t();
-
     // % feature channels
-    PatchTrans = Mat( (int)Patch.total(), anglebins, CV_32F, Scalar::all(0) );
+    // % Bin2 = Bin1 + 1;
+    // % Bin2(Bin2 > Params.nAngleBins) = 1;
+    float* PatchTrans = &scratch.PatchTrans[0];
+    std::fill( PatchTrans, PatchTrans + (size_t)n * anglebins, 0.0f );
+    for ( int p = 0; p < n; p++ )
+    {
+      int b1 = Bin1[p];
+      int b2 = ( b1 + 1 > anglebins - 1 ) ? 0 : b1 + 1;
+      PatchTrans[p * anglebins + b1] = ( 1.0f - Offset1[p] ) * GMag[p];
+      PatchTrans[p * anglebins + b2] = Offset1[p] * GMag[p];
+    }
+}
 
-    for ( int i = 0; i < anglebins; i++ )
+// Desc = min(PRFilters * PatchTrans, 1), PRFilters given in compressed row form
+static void pool_regions( const float* PatchTrans, float* Desc, int anglebins, int npools,
+                          const int* RowStart, const int* Cols, const float* Vals )
+{
+    for ( int r = 0; r < npools; r++ )
     {
-      for ( int p = 0; p < (int)Patch.total(); p++ )
+      float* d = Desc + r * anglebins;
+      std::fill( d, d + anglebins, 0.0f );
+      int e = RowStart[r];
+#if CV_SIMD128
+      if ( anglebins % 4 == 0 )
       {
-        if ( Bin1T.at<uchar>(p) == i )
-          PatchTrans.at<float>(p,i) = w1.at<float>(p) * GMagT.at<float>(p);
-        if ( Bin2T.at<uchar>(p) == i )
-          PatchTrans.at<float>(p,i) = w2.at<float>(p) * GMagT.at<float>(p);
+        for ( ; e < RowStart[r+1]; e++ )
+        {
+          v_float32x4 w = v_setall_f32( Vals[e] );
+          const float* t = PatchTrans + Cols[e] * anglebins;
+          for ( int b = 0; b < anglebins; b += 4 )
+            v_store( d + b, v_add( v_load( d + b ), v_mul( w, v_load( t + b ) ) ) );
+        }
       }
+#endif
+      for ( ; e < RowStart[r+1]; e++ )
+      {
+        const float w = Vals[e];
+        const float* t = PatchTrans + Cols[e] * anglebins;
+        for ( int b = 0; b < anglebins; b++ )
+          d[b] += w * t[b];
+      }
+      // crop
+      for ( int b = 0; b < anglebins; b++ )
+        d[b] = std::min( d[b], 1.0f );
     }
 }
 
+static inline float dot_product( const float* a, const float* b, int n )
+{
+    int i = 0;
+    float sum = 0.0f;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vlanes = VTraits<v_float32>::vlanes();
+    v_float32 vsum = vx_setzero_f32();
+    for ( ; i <= n - vlanes; i += vlanes )
+      vsum = v_fma( vx_load( a + i ), vx_load( b + i ), vsum );
+    sum = v_reduce_sum( vsum );
+#endif
+    for ( ; i < n; i++ )
+      sum += a[i] * b[i];
+    return sum;
+}
+
 // -------------------------------------------------
 /* VGG interface implementation */
 
@@ -340,17 +393,13 @@ struct ComputeVGGInvoker : ParallelLoopBody
 {
     ComputeVGGInvoker( const Mat& _image, Mat* _descriptors,
                         const vector<KeyPoint>& _keypoints,
-                        const Mat& _PRFilters, const Mat& _Proj,
+                        const vector<int>& _PRRowStart, const vector<int>& _PRCols,
+                        const vector<float>& _PRVals, const Mat& _Proj,
                         const int _anglebins, const bool _img_normalize,
                         const bool _use_scale_orientation, const float _scale_factor )
+      : image( _image ), descriptors( _descriptors ), keypoints( _keypoints ),
+        PRRowStart( _PRRowStart ), PRCols( _PRCols ), PRVals( _PRVals ), Proj( _Proj )
     {
-      image = _image;
-      keypoints = _keypoints;
-      descriptors = _descriptors;
-
-      Proj = _Proj;
-      PRFilters = _PRFilters;
-
       anglebins = _anglebins;
       scale_factor = _scale_factor;
       img_normalize = _img_normalize;
@@ -359,31 +408,38 @@ struct ComputeVGGInvoker : ParallelLoopBody
 
     void operator ()(const cv::Range& range) const CV_OVERRIDE
     {
-      Mat Desc, PatchTrans;
+      const int npools = (int)PRRowStart.size() - 1;
+      const int dsize = npools * anglebins;
+      CV_Assert( Proj.cols == dsize && Proj.isContinuous() );
+
+      // buffers reused by all the keypoints of the range
       Mat Patch( 64, 64, CV_32F );
+      VGGScratch scratch( (int)Patch.total(), anglebins, npools );
+
       for (int k = range.start; k < range.end; k++)
       {
         // sample patch from image
         get_patch( keypoints[k], Patch, image, use_scale_orientation, scale_factor );
         // compute transform
-        get_desc( Patch, PatchTrans, anglebins, img_normalize );
-        // pool features
-        Desc = PRFilters * PatchTrans;
-        // crop
-        min( Desc, 1.0f, Desc );
-        // reshape
-        Desc = Desc.reshape( 1, (int)Desc.total() );
+        get_desc( Patch, scratch, anglebins, img_normalize );
+        // pool features & crop
+        pool_regions( &scratch.PatchTrans[0], &scratch.Desc[0], anglebins, npools,
+                      &PRRowStart[0], &PRCols[0], &PRVals[0] );
         // project
-        descriptors->row( k ) = Desc.t() * Proj.t();
+        float* desc = descriptors->ptr<float>( k );
+        for ( int j = 0; j < Proj.rows; j++ )
+          desc[j] = dot_product( Proj.ptr<float>( j ), &scratch.Desc[0], dsize );
       }
     }
 
-    Mat image;
+    const Mat& image;
     Mat *descriptors;
-    vector<KeyPoint> keypoints;
+    const vector<KeyPoint>& keypoints;
 
-    Mat Proj;
-    Mat PRFilters;
+    const vector<int>& PRRowStart;
+    const vector<int>& PRCols;
+    const vector<float>& PRVals;
+    const Mat& Proj;
 
     int anglebins;
     float scale_factor;
@@ -424,7 +480,7 @@ void VGG_Impl::compute( InputArray _image, vector<KeyPoint>& keypoints, OutputAr
     descriptors.setTo( Scalar(0) );
 
     parallel_for_( Range( 0, (int) keypoints.size() ),
-        ComputeVGGInvoker( m_image, &descriptors, keypoints, m_PRFilters, m_Proj,
+        ComputeVGGInvoker( m_image, &descriptors, keypoints, m_PRRowStart, m_PRCols, m_PRVals, m_Proj,
                             m_anglebins, m_img_normalize, m_use_scale_orientation,
                             m_scale_factor )
     );
@@ -447,7 +503,7 @@ void VGG_Impl::ini_params( const int PRrows, const int PRcols,
     int idx;
 
     // initialize pool-region matrix
-    m_PRFilters = Mat::zeros( PRrows, PRcols, CV_32F );
+    Mat PRFilters = Mat::zeros( PRrows, PRcols, CV_32F );
     // initialize projection matrix
     m_Proj = Mat::zeros( PJrows, PJcols, CV_32F );
 
@@ -458,11 +514,30 @@ void VGG_Impl::ini_params( const int PRrows, const int PRcols,
       for ( size_t k = 0; k < PRidx[i+1]; k++ )
       {
         // expand floats from hex blobs
-        m_PRFilters.at<float>( PRidx[i] + (int)k ) = *(float *)&PR[idx];
+        PRFilters.at<float>( PRidx[i] + (int)k ) = *(float *)&PR[idx];
         idx++;
       }
     }
 
+    // pool regions only cover a small part of the patch each,
+    // keep the non-zero coefficients only
+    m_PRRowStart.assign( 1, 0 );
+    m_PRCols.clear();
+    m_PRVals.clear();
+    for ( int r = 0; r < PRrows; r++ )
+    {
+      const float* row = PRFilters.ptr<float>( r );
+      for ( int c = 0; c < PRcols; c++ )
+      {
+        if ( row[c] != 0.0f )
+        {
+          m_PRCols.push_back( c );
+          m_PRVals.push_back( row[c] );
+        }
+      }
+      m_PRRowStart.push_back( (int)m_PRCols.size() );
+    }
+
     idx = 0;
     // fill sparse projection matrix
     for ( size_t i = 0; i < PJidxSize; i=i+2 )
@@ -91,6 +91,42 @@ TEST(Features2d_Detector_TBMR_Affine, regression)
     test.safe_run();
 }
 
+static void checkKeypointsDoNotDependOnThreads(const Ptr<FeatureDetector>& detector)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename);
+    ASSERT_FALSE(image.empty()) << imageFilename;
+
+    vector<KeyPoint> kpRef, kp;
+    const int nthreads = getNumThreads();
+    setNumThreads(1);
+    detector->detect(image, kpRef);
+    setNumThreads(nthreads);
+    detector->detect(image, kp);
+
+    ASSERT_FALSE(kpRef.empty());
+    ASSERT_EQ(kpRef.size(), kp.size());
+    for (size_t i = 0; i < kp.size(); i++)
+    {
+        EXPECT_EQ(kpRef[i].pt, kp[i].pt) << "i=" << i;
+        EXPECT_EQ(kpRef[i].size, kp[i].size) << "i=" << i;
+        EXPECT_EQ(kpRef[i].angle, kp[i].angle) << "i=" << i;
+        EXPECT_EQ(kpRef[i].response, kp[i].response) << "i=" << i;
+    }
+}
+
+TEST(Features2d_Detector_TBMR, does_not_depend_on_threads)
+{
+    // the min and max trees of every level are built by separate tasks
+    checkKeypointsDoNotDependOnThreads(TBMR::create());
+}
+
+TEST(Features2d_Detector_MSD, does_not_depend_on_threads)
+{
+    // bands of rows with sliding column sums; the band seams must not change the saliency
+    checkKeypointsDoNotDependOnThreads(MSDDetector::create(3, 5, 5, 0, 250.0f, 4, 1.25f, -1, true));
+}
+
 /*
  * Descriptors
  */
@@ -135,6 +171,76 @@ TEST( Features2d_DescriptorExtractor_DAISY, regression )
     test.safe_run();
 }
 
+TEST( Features2d_DescriptorExtractor_DAISY, dense_roi_and_reuse )
+{
+    Mat img(60, 80, CV_8UC1);
+    RNG& rng = theRNG();
+    rng.fill(img, RNG::UNIFORM, 0, 256);
+    GaussianBlur(img, img, Size(5, 5), 1.5);
+
+    Ptr<DAISY> daisy = DAISY::create();
+    Mat full, roiDesc, again;
+    daisy->compute(img, full);
+    ASSERT_EQ(img.rows * img.cols, full.rows);
+
+    // roi descriptors are stored row by row for the roi pixels only
+    Rect roi(10, 12, 20, 15);
+    daisy->compute(img, roi, roiDesc);
+    ASSERT_EQ(roi.area(), roiDesc.rows);
+    for (int y = 0; y < roi.height; y++)
+        for (int x = 0; x < roi.width; x++)
+        {
+            int fullRow = (roi.y + y) * img.cols + roi.x + x;
+            ASSERT_EQ(0, cvtest::norm(full.row(fullRow), roiDesc.row(y * roi.width + x), NORM_INF));
+        }
+
+    // second call on the same image reuses the layers
+    daisy->compute(img, again);
+    EXPECT_EQ(0, cvtest::norm(full, again, NORM_INF));
+
+    // a modified image must not reuse them
+    Mat img2 = img.clone();
+    img2(Rect(30, 20, 10, 10)).setTo(Scalar(255));
+    daisy->compute(img2, again);
+    EXPECT_GT(cvtest::norm(full, again, NORM_INF), 0);
+}
+
+TEST( Features2d_DescriptorExtractor_DAISY, dense_banded )
+{
+    Mat img(240, 160, CV_8UC1);
+    RNG& rng = theRNG();
+    rng.fill(img, RNG::UNIFORM, 0, 256);
+    GaussianBlur(img, img, Size(5, 5), 1.5);
+
+    Ptr<DAISY> whole = DAISY::create(15, 3, 8, 8, DAISY::NRM_PARTIAL);
+    Ptr<DAISY> banded = DAISY::create(15, 3, 8, 8, DAISY::NRM_PARTIAL);
+    // the layers of this image take 4.9 MB, so this gives bands of a few dozen rows
+    banded->setDenseMemoryBudget((size_t)1 << 20);
+    ASSERT_EQ((size_t)1 << 20, banded->getDenseMemoryBudget());
+
+    Mat ref, desc;
+    whole->compute(img, ref);
+    banded->compute(img, desc);
+    ASSERT_EQ(ref.size(), desc.size());
+    EXPECT_EQ(0, cvtest::norm(ref, desc, NORM_INF));
+
+    Rect roi(20, 70, 100, 90);
+    Mat refRoi, descRoi;
+    whole->compute(img, roi, refRoi);
+    banded->compute(img, roi, descRoi);
+    EXPECT_EQ(0, cvtest::norm(refRoi, descRoi, NORM_INF));
+
+    // the single descriptor accessors work after a banded compute
+    std::vector<float> d0(whole->descriptorSize()), d1(banded->descriptorSize());
+    whole->GetDescriptor(100.5, 60.25, 0, &d0[0]);
+    banded->GetDescriptor(100.5, 60.25, 0, &d1[0]);
+    EXPECT_EQ(0, cvtest::norm(d0, d1, NORM_INF));
+
+    // and the layers they built are reused by the next dense compute
+    banded->compute(img, desc);
+    EXPECT_EQ(0, cvtest::norm(ref, desc, NORM_INF));
+}
+
 TEST( Features2d_DescriptorExtractor_FREAK, regression )
 {
     CV_DescriptorExtractorTest<Hamming> test("descriptor-freak", (CV_DescriptorExtractorTest<Hamming>::DistanceType)12.f,
@@ -199,6 +305,32 @@ TEST(Features2d_DescriptorExtractor_TEBLID, regression )
     test.safe_run();
 }
 
+#if defined(OPENCV_XFEATURES2D_HAS_VGG_DATA) || defined(OPENCV_XFEATURES2D_HAS_BOOST_DATA)
+// Keypoints are split between threads, and each range reuses its own scratch buffers
+static void checkDescriptorsDoNotDependOnThreads(const Ptr<Feature2D>& extractor)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + "/features2d/tsukuba.png";
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << imageFilename;
+
+    vector<KeyPoint> keypoints;
+    ORB::create(500)->detect(image, keypoints);
+    ASSERT_FALSE(keypoints.empty());
+
+    vector<KeyPoint> kpRef = keypoints, kp = keypoints;
+    Mat descRef, desc;
+    const int nthreads = getNumThreads();
+    setNumThreads(1);
+    extractor->compute(image, kpRef, descRef);
+    setNumThreads(nthreads);
+    extractor->compute(image, kp, desc);
+
+    ASSERT_EQ(kpRef.size(), kp.size());
+    ASSERT_EQ(descRef.size(), desc.size());
+    EXPECT_EQ(0, cvtest::norm(descRef, desc, NORM_INF));
+}
+#endif
+
 #ifdef OPENCV_XFEATURES2D_HAS_VGG_DATA
 TEST( Features2d_DescriptorExtractor_VGG, regression )
 {
@@ -206,6 +338,12 @@ TEST( Features2d_DescriptorExtractor_VGG, regression )
                                              VGG::create() );
     test.safe_run();
 }
+
+TEST( Features2d_DescriptorExtractor_VGG, does_not_depend_on_threads )
+{
+    checkDescriptorsDoNotDependOnThreads(VGG::create(VGG::VGG_120));
+    checkDescriptorsDoNotDependOnThreads(VGG::create(VGG::VGG_48, 1.4f, true, true, 5.f, false));
+}
 #endif // OPENCV_XFEATURES2D_HAS_VGG_DATA
 
 #ifdef OPENCV_XFEATURES2D_HAS_BOOST_DATA
@@ -264,6 +402,14 @@ TEST( Features2d_DescriptorExtractor_BINBOOST_256, regression )
                                             BoostDesc::create(BoostDesc::BINBOOST_256) );
     test.safe_run();
 }
+
+TEST( Features2d_DescriptorExtractor_BoostDesc, does_not_depend_on_threads )
+{
+    // one of each evaluation path: bit copy, weighted sum and binary boosting
+    checkDescriptorsDoNotDependOnThreads(BoostDesc::create(BoostDesc::BGM));
+    checkDescriptorsDoNotDependOnThreads(BoostDesc::create(BoostDesc::LBGM));
+    checkDescriptorsDoNotDependOnThreads(BoostDesc::create(BoostDesc::BINBOOST_256));
+}
 #endif  // OPENCV_XFEATURES2D_HAS_BOOST_DATA
 
 #ifdef OPENCV_ENABLE_NONFREE
@@ -390,8 +536,113 @@ TEST(Features2d_SIFTHomographyTest, regression) { CV_DetectPlanarTest test("SIFT
 
 #ifdef OPENCV_ENABLE_NONFREE
 TEST(Features2d_SURFHomographyTest, regression) { CV_DetectPlanarTest test("SURF", 80, SURF::create()); test.safe_run(); }
+
+TEST(Features2d_SURF, detectAndCompute_does_not_depend_on_threads)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + "/features2d/tsukuba.png";
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << imageFilename;
+
+    const int nthreads = getNumThreads();
+    for (int variant = 0; variant < 4; variant++)
+    {
+        const bool extended = (variant & 1) != 0, upright = (variant & 2) != 0;
+        Ptr<SURF> surf = SURF::create(100, 4, 3, extended, upright);
+
+        vector<KeyPoint> kpRef, kp;
+        Mat descRef, desc;
+        setNumThreads(1);
+        surf->detectAndCompute(image, noArray(), kpRef, descRef);
+        setNumThreads(nthreads);
+        surf->detectAndCompute(image, noArray(), kp, desc);
+
+        ASSERT_FALSE(kpRef.empty());
+        ASSERT_EQ(kpRef.size(), kp.size()) << "extended=" << extended << " upright=" << upright;
+        for (size_t i = 0; i < kp.size(); i++)
+        {
+            EXPECT_EQ(kpRef[i].pt, kp[i].pt) << "i=" << i;
+            EXPECT_EQ(kpRef[i].size, kp[i].size) << "i=" << i;
+            EXPECT_EQ(kpRef[i].angle, kp[i].angle) << "i=" << i;
+            EXPECT_EQ(kpRef[i].response, kp[i].response) << "i=" << i;
+        }
+        EXPECT_EQ(0, cvtest::norm(descRef, desc, NORM_INF)) << "extended=" << extended << " upright=" << upright;
+
+        // The vectorized descriptor path must still produce unit length descriptors
+        for (int i = 0; i < desc.rows; i++)
+            EXPECT_NEAR(1.0, cvtest::norm(desc.row(i), NORM_L2), 1e-4) << "i=" << i;
+    }
+}
 #endif
 
+TEST(Features2d_PCTSignatures, does_not_depend_on_threads)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename);
+    ASSERT_FALSE(image.empty()) << imageFilename;
+
+    Ptr<PCTSignatures> pct = PCTSignatures::create(2000, 400);
+    Mat ref, signature;
+    const int nthreads = getNumThreads();
+    setNumThreads(1);
+    pct->computeSignature(image, ref);
+    setNumThreads(nthreads);
+    pct->computeSignature(image, signature);
+
+    ASSERT_FALSE(ref.empty());
+    EXPECT_EQ(0, cvtest::norm(ref, signature, NORM_INF));
+}
+
+// SQFD with the default L2 distance and heuristic similarity (alpha = 1), pair by pair
+static float referencePartialSQFD(const Mat& signature0, const Mat& signature1)
+{
+    float result = 0;
+    for (int i = 0; i < signature0.rows; i++)
+    {
+        for (int j = 0; j < signature1.rows; j++)
+        {
+            float distance = 0;
+            for (int d = 1; d < signature0.cols; d++)
+            {
+                float difference = signature0.at<float>(i, d) - signature1.at<float>(j, d);
+                distance += difference * difference;
+            }
+            result += signature0.at<float>(i, 0) * signature1.at<float>(j, 0) * (1.f / (1.f + std::sqrt(distance)));
+        }
+    }
+    return result;
+}
+
+TEST(Features2d_PCTSignaturesSQFD, matches_reference)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename);
+    ASSERT_FALSE(image.empty()) << imageFilename;
+
+    std::vector<Mat> images(3);
+    images[0] = image;
+    flip(image, images[1], 1);
+    GaussianBlur(image, images[2], Size(7, 7), 2.0);
+
+    Ptr<PCTSignatures> pct = PCTSignatures::create(2000, 400);
+    std::vector<Mat> signatures;
+    pct->computeSignatures(images, signatures);
+    ASSERT_EQ(images.size(), signatures.size());
+
+    Ptr<PCTSignaturesSQFD> sqfd = PCTSignaturesSQFD::create(PCTSignatures::L2, PCTSignatures::HEURISTIC, 1.0f);
+    std::vector<float> distances;
+    sqfd->computeQuadraticFormDistances(signatures[0], signatures, distances);
+    ASSERT_EQ(signatures.size(), distances.size());
+    for (size_t i = 1; i < signatures.size(); i++)
+    {
+        float expected = std::sqrt(referencePartialSQFD(signatures[0], signatures[0])
+                                   + referencePartialSQFD(signatures[i], signatures[i])
+                                   - referencePartialSQFD(signatures[0], signatures[i]) * 2);
+        float single = sqfd->computeQuadraticFormDistance(signatures[0], signatures[i]);
+        EXPECT_NEAR(expected, single, 1e-3) << "i=" << i;
+        EXPECT_NEAR(expected, distances[i], 1e-3) << "i=" << i;
+    }
+}
+
 class FeatureDetectorUsingMaskTest : public cvtest::BaseTest
 {
 public:
@@ -113,4 +113,57 @@ void CV_GMSMatcherTest::run( int )
 
 TEST(XFeatures2d_GMSMatcher, gms_matcher_regression) { CV_GMSMatcherTest test; test.safe_run(); }
 
+TEST(XFeatures2d_GMSMatcher, batch_matches_single_calls)
+{
+    string dataPath = cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/";
+    Mat imgRef = imread(dataPath + "img1.png");
+    ASSERT_FALSE(imgRef.empty());
+
+    Ptr<Feature2D> orb = ORB::create(10000);
+    vector<KeyPoint> keypointsRef;
+    Mat descriptorsRef;
+    orb->detectAndCompute(imgRef, noArray(), keypointsRef, descriptorsRef);
+    Ptr<DescriptorMatcher> matcher = DescriptorMatcher::create("BruteForce-Hamming");
+
+    vector<Size> sizes1, sizes2;
+    vector<vector<KeyPoint> > keypoints1, keypoints2;
+    vector<vector<DMatch> > matches;
+    for (int num = 2; num <= 4; num++)
+    {
+        Mat imgCur = imread(dataPath + format("img%d.png", num));
+        ASSERT_FALSE(imgCur.empty());
+        vector<KeyPoint> keypointsCur;
+        Mat descriptorsCur;
+        orb->detectAndCompute(imgCur, noArray(), keypointsCur, descriptorsCur);
+        vector<DMatch> matchesAll;
+        matcher->match(descriptorsCur, descriptorsRef, matchesAll);
+
+        sizes1.push_back(imgCur.size());
+        sizes2.push_back(imgRef.size());
+        keypoints1.push_back(keypointsCur);
+        keypoints2.push_back(keypointsRef);
+        matches.push_back(matchesAll);
+    }
+
+    for (int comb = 0; comb < 4; comb++)
+    {
+        bool withRotation = (comb & 1) != 0, withScale = (comb & 2) != 0;
+        vector<vector<DMatch> > batched;
+        matchGMS(sizes1, sizes2, keypoints1, keypoints2, matches, batched, withRotation, withScale);
+        ASSERT_EQ(matches.size(), batched.size());
+
+        for (size_t i = 0; i < matches.size(); i++)
+        {
+            vector<DMatch> single;
+            matchGMS(sizes1[i], sizes2[i], keypoints1[i], keypoints2[i], matches[i], single, withRotation, withScale);
+            ASSERT_EQ(single.size(), batched[i].size());
+            for (size_t j = 0; j < single.size(); j++)
+            {
+                EXPECT_EQ(single[j].queryIdx, batched[i][j].queryIdx);
+                EXPECT_EQ(single[j].trainIdx, batched[i][j].trainIdx);
+            }
+        }
+    }
+}
+
 }} // namespace
@@ -32,6 +32,23 @@ CV_EXPORTS_W void findEllipses(
     float scoreThreshold = 0.7f, float reliabilityThreshold = 0.5f,
     float centerDistanceThreshold = 0.05f
 );
+
+/** @overload
+@param image input image, could be gray or color.
+@param ellipses output vector of found ellipses. each vector is encoded as five float $x, y, a, b, radius, score$.
+@param scoreThreshold float, the threshold of ellipse score.
+@param reliabilityThreshold float, the threshold of reliability.
+@param centerDistanceThreshold float, the threshold of center distance.
+@param maxCandidates int, the maximum number of candidate arc triplets that are validated, 0 for no limit.
+The search for candidates stops once this number is reached, so the limit also bounds the time spent
+on pairs of arcs, but not the time of the edge and arc extraction. The candidates are taken in a fixed
+order, so the result does not depend on the number of threads.
+*/
+CV_EXPORTS_W void findEllipses(
+    InputArray image, OutputArray ellipses,
+    float scoreThreshold, float reliabilityThreshold,
+    float centerDistanceThreshold, int maxCandidates
+);
 //! @} ximgproc
 }
 }
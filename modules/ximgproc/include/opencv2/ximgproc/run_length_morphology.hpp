@@ -27,6 +27,23 @@ namespace rl {
 */
 CV_EXPORTS void threshold(InputArray src, OutputArray rlDest, double thresh, int type);
 
+/**
+* @brief   Applies a fixed-level threshold to a horizontal strip of an image and appends the result
+*          to a run length encoded image.
+*
+* Large images (e.g. scanned documents) can be encoded strip by strip as they are read, without
+* ever holding the full image in memory. The strip is placed below the rows already contained in rlDest.
+* The runs are appended in place when rlDest is a Mat or a std::vector<cv::Point3i>; any other array
+* is rewritten as a whole on every call.
+*
+* @param   strip       input array (single-channel), all strips of an image must have the same width.
+* @param   rlDest      run length encoded image the strip is appended to; an empty array starts a new image.
+* @param   thresh      threshold value.
+* @param   type        thresholding type (only cv::THRESH_BINARY and cv::THRESH_BINARY_INV are supported)
+*
+*/
+CV_EXPORTS void thresholdStrip(InputArray strip, InputOutputArray rlDest, double thresh, int type);
+
 
 /**
 * @brief   Dilates an run-length encoded binary image by using a specific structuring element.
@@ -78,6 +95,19 @@ CV_EXPORTS cv::Mat getStructuringElement(int shape, Size ksize);
 */
 CV_EXPORTS void paint(InputOutputArray image, InputArray rlSrc, const cv::Scalar& value);
 
+/**
+* @brief   Paint the part of a run length encoded binary image which is covered by a tile into the tile.
+*
+* This allows to decode a large image tile by tile without creating the full-size mask.
+*
+* @param   tile        image to paint into (currently only single channel images).
+* @param   rlSrc       run length encoded image (runs sorted by rows, as produced by all functions of this module)
+* @param   value       all foreground pixel of the binary image are set to this value
+* @param   tileOrigin  position of the top-left pixel of the tile within the run length encoded image
+*
+*/
+CV_EXPORTS void paintTile(InputOutputArray tile, InputArray rlSrc, const cv::Scalar& value, Point tileOrigin);
+
 /**
 * @brief   Check whether a custom made structuring element can be used with run length morphological operations.
 *          (It must consist of a continuous array of single runs per row)
@@ -0,0 +1,64 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+typedef tuple<string, bool> EdgeDrawingTestParam;
+typedef TestBaseWithParam<EdgeDrawingTestParam> EdgeDrawingTest;
+
+#define ED_IMAGES Values("cv/imgproc/beads.jpg", "cv/shared/lena.png")
+
+static Ptr<EdgeDrawing> createDetector(const EdgeDrawingTestParam& params, Mat& src)
+{
+    src = imread(getDataPath(get<0>(params)), IMREAD_GRAYSCALE);
+    if (src.empty())
+        CV_Error(Error::StsBadArg, "Invalid test image: " + get<0>(params));
+
+    Ptr<EdgeDrawing> detector = createEdgeDrawing();
+    detector->params.PFmode = get<1>(params);
+    return detector;
+}
+
+PERF_TEST_P(EdgeDrawingTest, detectEdges, Combine(ED_IMAGES, Bool()))
+{
+    Mat src;
+    Ptr<EdgeDrawing> detector = createDetector(GetParam(), src);
+
+    declare.in(src);
+
+    TEST_CYCLE() detector->detectEdges(src);
+
+    SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(EdgeDrawingTest, detectLines, Combine(ED_IMAGES, Values(false)))
+{
+    Mat src;
+    Ptr<EdgeDrawing> detector = createDetector(GetParam(), src);
+    detector->detectEdges(src);
+    std::vector<Vec4f> lines;
+
+    declare.in(src);
+
+    TEST_CYCLE() detector->detectLines(lines);
+
+    SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(EdgeDrawingTest, detectEllipses, Combine(ED_IMAGES, Values(false)))
+{
+    Mat src;
+    Ptr<EdgeDrawing> detector = createDetector(GetParam(), src);
+    detector->detectEdges(src);
+    std::vector<Vec6d> ellipses;
+
+    declare.in(src);
+
+    TEST_CYCLE() detector->detectEllipses(ellipses);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
@@ -24,4 +24,23 @@ PERF_TEST_P(FindEllipsesTest, perf, Combine(SZ_TYPICAL, Values(CV_8U), Values(1,
 
     SANITY_CHECK_NOTHING();
 }
+
+typedef tuple<Size, int> FindEllipsesBoundedTestParam;
+typedef TestBaseWithParam<FindEllipsesBoundedTestParam> FindEllipsesBoundedTest;
+
+PERF_TEST_P(FindEllipsesBoundedTest, perf, Combine(SZ_TYPICAL, Values(100, 1000)))
+{
+    FindEllipsesBoundedTestParam params = GetParam();
+    Size sz = get<0>(params);
+    int maxCandidates = get<1>(params);
+
+    Mat src(sz, CV_8UC1);
+    Mat dst(sz, CV_32FC(6));
+
+    declare.in(src, WARMUP_RNG).out(dst);
+
+    TEST_CYCLE() findEllipses(src, dst, 0.7f, 0.5f, 0.05f, maxCandidates);
+
+    SANITY_CHECK_NOTHING();
+}
 }} // namespace
\ No newline at end of file
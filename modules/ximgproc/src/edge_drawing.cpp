@@ -4,6 +4,7 @@
 
 #include "precomp.hpp"
 #include "edge_drawing_common.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 using namespace std;
 
@@ -23,9 +24,63 @@ int gradThresh;
 int op;
 bool SumFlag;
 int* grads;
+Mutex* gradsMutex;
 bool PFmode;
 };
 
+#if CV_SIMD128
+// Computes the gradient and the edge direction of pixels [x, x + 8) of a row with |gx| + |gy| as magnitude
+static inline void computeGradientSum8(const uchar* srcPrevRow, const uchar* srcCurRow, const uchar* srcNextRow,
+                                       int x, int op, const v_uint16x8& v_gradThresh, ushort* gradRow, uchar* dirRow)
+{
+    v_int16x8 prevL = v_reinterpret_as_s16(v_load_expand(srcPrevRow + x - 1));
+    v_int16x8 prevC = v_reinterpret_as_s16(v_load_expand(srcPrevRow + x));
+    v_int16x8 prevR = v_reinterpret_as_s16(v_load_expand(srcPrevRow + x + 1));
+    v_int16x8 curL = v_reinterpret_as_s16(v_load_expand(srcCurRow + x - 1));
+    v_int16x8 curC = v_reinterpret_as_s16(v_load_expand(srcCurRow + x));
+    v_int16x8 curR = v_reinterpret_as_s16(v_load_expand(srcCurRow + x + 1));
+    v_int16x8 nextL = v_reinterpret_as_s16(v_load_expand(srcNextRow + x - 1));
+    v_int16x8 nextC = v_reinterpret_as_s16(v_load_expand(srcNextRow + x));
+    v_int16x8 nextR = v_reinterpret_as_s16(v_load_expand(srcNextRow + x + 1));
+
+    v_int16x8 com1 = v_sub(nextR, prevL);
+    v_int16x8 com2 = v_sub(prevR, nextL);
+    v_int16x8 dx = v_sub(curR, curL);
+    v_int16x8 dy = v_sub(nextC, prevC);
+    v_uint16x8 gx, gy;
+
+    switch (op)
+    {
+    case EdgeDrawing::PREWITT:
+        gx = v_abs(v_add(v_add(com1, com2), dx));
+        gy = v_abs(v_add(v_sub(com1, com2), dy));
+        break;
+    case EdgeDrawing::SOBEL:
+        gx = v_abs(v_add(v_add(com1, com2), v_add(dx, dx)));
+        gy = v_abs(v_add(v_sub(com1, com2), v_add(dy, dy)));
+        break;
+    case EdgeDrawing::SCHARR:
+        gx = v_abs(v_add(v_mul(v_setall_s16(3), v_add(com1, com2)), v_mul(v_setall_s16(10), dx)));
+        gy = v_abs(v_add(v_mul(v_setall_s16(3), v_sub(com1, com2)), v_mul(v_setall_s16(10), dy)));
+        break;
+    default: // EdgeDrawing::LSD
+        com1 = v_sub(nextR, curC);
+        com2 = v_sub(curR, nextC);
+        gx = v_abs(v_add(com1, com2));
+        gy = v_abs(v_sub(com1, com2));
+        break;
+    }
+
+    v_uint16x8 sum = v_add(gx, gy);
+    v_store(gradRow + x, sum);
+
+    // the direction is only set for pixels above the threshold
+    v_uint16x8 dir = v_select(v_ge(gx, gy), v_setall_u16(EDGE_VERTICAL), v_setall_u16(EDGE_HORIZONTAL));
+    dir = v_select(v_ge(sum, v_gradThresh), dir, v_load_expand(dirRow + x));
+    v_pack_store(dirRow + x, dir);
+}
+#endif
+
 void ComputeGradientBody::operator() (const Range& range) const
 {
     const int last_col = src.cols - 1;
@@ -33,6 +88,11 @@ void ComputeGradientBody::operator() (const Range& range) const
     int gy = 0;
     int sum;
 
+    // each range counts into a histogram of its own, which is merged into grads at the end
+    std::vector<int> localGrads;
+    if (PFmode)
+        localGrads.assign(MAX_GRAD_VALUE, 0);
+
     for (int y = range.start; y < range.end; ++y)
     {
         const uchar* srcPrevRow = src[y - 1];
@@ -42,7 +102,24 @@ void ComputeGradientBody::operator() (const Range& range) const
         ushort* gradRow = gradImage[y];
         uchar* dirRow = dirImage[y];
 
-        for (int x = 1; x < last_col; ++x)
+        int x = 1;
+#if CV_SIMD128
+        // all gradient sums fit into 16 bits (at most 2 * 4080 for Scharr)
+        if (SumFlag && gradThresh <= USHRT_MAX)
+        {
+            v_uint16x8 v_gradThresh = v_setall_u16((ushort)gradThresh);
+            for (; x <= last_col - v_uint16x8::nlanes; x += v_uint16x8::nlanes)
+                computeGradientSum8(srcPrevRow, srcCurRow, srcNextRow, x, op, v_gradThresh, gradRow, dirRow);
+
+            if (PFmode)
+            {
+                for (int k = 1; k < x; k++)
+                    localGrads[gradRow[k]]++;
+            }
+        }
+#endif
+
+        for (; x < last_col; ++x)
         {
             int com1 = srcNextRow[x + 1] - srcPrevRow[x - 1];
             int com2 = srcPrevRow[x + 1] - srcNextRow[x - 1];
@@ -79,7 +156,7 @@ void ComputeGradientBody::operator() (const Range& range) const
             gradRow[x] = (ushort)sum;
 
             if (PFmode)
-                grads[sum]++;
+                localGrads[sum]++;
 
             if (sum >= gradThresh)
             {
@@ -90,6 +167,120 @@ void ComputeGradientBody::operator() (const Range& range) const
             }
         }
     }
+
+    if (PFmode)
+    {
+        AutoLock lock(*gradsMutex);
+        for (int i = 0; i < MAX_GRAD_VALUE; i++)
+            grads[i] += localGrads[i];
+    }
+}
+
+struct ComputeAnchorPointsBody : ParallelLoopBody
+{
+void operator() (const Range& range) const CV_OVERRIDE;
+
+Mat_<ushort> gradImage;
+Mat_<uchar> dirImage;
+mutable Mat_<uchar> edgeImage;
+int gradThresh;
+int anchorThresh;
+int scanInterval;
+std::vector<std::vector<Point> >* stripeAnchors;
+};
+
+void ComputeAnchorPointsBody::operator() (const Range& range) const
+{
+    const int firstRow = 2, noRows = gradImage.rows - 4;
+    const int nstripes = (int)stripeAnchors->size();
+
+    for (int stripe = range.start; stripe < range.end; ++stripe)
+    {
+        std::vector<Point>& anchors = (*stripeAnchors)[stripe];
+        int rowStart = firstRow + (int)((int64)noRows * stripe / nstripes);
+        int rowEnd = firstRow + (int)((int64)noRows * (stripe + 1) / nstripes);
+
+        for (int i = rowStart; i < rowEnd; i++)
+        {
+            const ushort* gradRow = gradImage[i];
+            const ushort* gradPrevRow = gradImage[i - 1];
+            const ushort* gradNextRow = gradImage[i + 1];
+            const uchar* dirRow = dirImage[i];
+            uchar* edgeRow = edgeImage[i];
+
+            int start = 2;
+            int inc = 1;
+            if (i % scanInterval != 0)
+            {
+                start = scanInterval;
+                inc = scanInterval;
+            }
+
+            int j = start;
+#if CV_SIMD128
+            // gradients and thresholds fit into 16 bits, so the differences to the neighbors do not overflow
+            if (inc == 1 && gradThresh <= SHRT_MAX && anchorThresh <= SHRT_MAX)
+            {
+                const v_int16x8 v_gradThresh = v_setall_s16((short)gradThresh);
+                const v_int16x8 v_anchorThresh = v_setall_s16((short)anchorThresh);
+                const v_uint16x8 v_vertical = v_setall_u16(EDGE_VERTICAL);
+                short mask[v_int16x8::nlanes];
+                for (; j <= gradImage.cols - 2 - v_int16x8::nlanes; j += v_int16x8::nlanes)
+                {
+                    v_int16x8 g = v_reinterpret_as_s16(v_load(gradRow + j));
+                    v_int16x8 vertical = v_reinterpret_as_s16(v_eq(v_load_expand(dirRow + j), v_vertical));
+                    v_int16x8 n1 = v_select(vertical, v_reinterpret_as_s16(v_load(gradRow + j - 1)),
+                                            v_reinterpret_as_s16(v_load(gradPrevRow + j)));
+                    v_int16x8 n2 = v_select(vertical, v_reinterpret_as_s16(v_load(gradRow + j + 1)),
+                                            v_reinterpret_as_s16(v_load(gradNextRow + j)));
+                    v_int16x8 isAnchor = v_and(v_ge(g, v_gradThresh),
+                                               v_and(v_ge(v_sub(g, n1), v_anchorThresh), v_ge(v_sub(g, n2), v_anchorThresh)));
+                    if (!v_check_any(isAnchor))
+                        continue;
+
+                    v_store(mask, isAnchor);
+                    for (int k = 0; k < v_int16x8::nlanes; k++)
+                    {
+                        if (mask[k])
+                        {
+                            edgeRow[j + k] = ANCHOR_PIXEL;
+                            anchors.push_back(Point(j + k, i));
+                        }
+                    }
+                }
+            }
+#endif
+
+            for (; j < gradImage.cols - 2; j += inc)
+            {
+                if (gradRow[j] < gradThresh)
+                    continue;
+
+                if (dirRow[j] == EDGE_VERTICAL)
+                {
+                    // vertical edge
+                    int diff1 = gradRow[j] - gradRow[j - 1];
+                    int diff2 = gradRow[j] - gradRow[j + 1];
+                    if (diff1 >= anchorThresh && diff2 >= anchorThresh)
+                    {
+                        edgeRow[j] = ANCHOR_PIXEL;
+                        anchors.push_back(Point(j, i));
+                    }
+                }
+                else
+                {
+                    // horizontal edge
+                    int diff1 = gradRow[j] - gradPrevRow[j];
+                    int diff2 = gradRow[j] - gradNextRow[j];
+                    if (diff1 >= anchorThresh && diff2 >= anchorThresh)
+                    {
+                        edgeRow[j] = ANCHOR_PIXEL;
+                        anchors.push_back(Point(j, i));
+                    }
+                }
+            }
+        }
+    }
 }
 
 class EdgeDrawingImpl : public EdgeDrawing
@@ -167,7 +358,7 @@ private:
     NFALUT* nfa;
 
     int ComputeMinLineLength();
-    void SplitSegment2Lines(double* x, double* y, int noPixels, int segmentNo);
+    void SplitSegment2Lines(double* x, double* y, int noPixels, int segmentNo, std::vector<EDLineSegment>& segmentLines) const;
     void JoinCollinearLines();
 
     void ValidateLineSegments();
@@ -474,51 +665,34 @@ void EdgeDrawingImpl::ComputeGradient()
     body.SumFlag = params.SumFlag;
     body.op = op;
     body.grads = grads;
+    Mutex gradsMutex;
+    body.gradsMutex = &gradsMutex;
     body.PFmode = params.PFmode;
 
-    parallel_for_(Range(1, smoothImage.rows - 1), body);
+    // a few large stripes keep the cost of the per-stripe histograms low
+    parallel_for_(Range(1, smoothImage.rows - 1), body, params.PFmode ? getNumThreads() * 4 : -1);
 }
 
 void EdgeDrawingImpl::ComputeAnchorPoints()
 {
-    for (int i = 2; i < height - 2; i++)
+    if (height > 4)
     {
-        int start = 2;
-        int inc = 1;
-        if (i % params.ScanInterval != 0)
-        {
-            start = params.ScanInterval;
-            inc = params.ScanInterval;
-        }
-
-        for (int j = start; j < width - 2; j += inc)
-        {
-            if (gradImg[i * width + j] < gradThresh)
-                continue;
-
-            if (dirImg[i * width + j] == EDGE_VERTICAL)
-            {
-                // vertical edge
-                int diff1 = gradImg[i * width + j] - gradImg[i * width + j - 1];
-                int diff2 = gradImg[i * width + j] - gradImg[i * width + j + 1];
-                if (diff1 >= anchorThresh && diff2 >= anchorThresh)
-                {
-                    edgeImg[i * width + j] = ANCHOR_PIXEL;
-                    anchorPoints.push_back(Point(j, i));
-                }
-            }
-            else
-            {
-                // horizontal edge
-                int diff1 = gradImg[i * width + j] - gradImg[(i - 1) * width + j];
-                int diff2 = gradImg[i * width + j] - gradImg[(i + 1) * width + j];
-                if (diff1 >= anchorThresh && diff2 >= anchorThresh)
-                {
-                    edgeImg[i * width + j] = ANCHOR_PIXEL;
-                    anchorPoints.push_back(Point(j, i));
-                }
-            }
-        }
+        // the anchors of each stripe of rows are collected separately and concatenated in row order
+        std::vector<std::vector<Point> > stripeAnchors(std::min(height - 4, getNumThreads() * 4));
+
+        ComputeAnchorPointsBody body;
+        body.gradImage = gradImage;
+        body.dirImage = dirImage;
+        body.edgeImage = edgeImage;
+        body.gradThresh = gradThresh;
+        body.anchorThresh = anchorThresh;
+        body.scanInterval = params.ScanInterval;
+        body.stripeAnchors = &stripeAnchors;
+
+        parallel_for_(Range(0, (int)stripeAnchors.size()), body);
+
+        for (size_t k = 0; k < stripeAnchors.size(); k++)
+            anchorPoints.insert(anchorPoints.end(), stripeAnchors[k].begin(), stripeAnchors[k].end());
     }
 
     anchorNos = (int)anchorPoints.size(); // get the total number of anchor points
@@ -1193,17 +1367,13 @@ int* EdgeDrawingImpl::sortAnchorsByGradValue1()
     int* C = new int[SIZE];
     memset(C, 0, sizeof(int) * SIZE);
 
+    // anchorPoints holds the anchors in raster order, which is the order of the counting sort below
     // Count the number of grad values
-    for (int i = 1; i < height - 1; i++)
+    for (int k = 0; k < anchorNos; k++)
     {
-        for (int j = 1; j < width - 1; j++)
-        {
-            if (edgeImg[i * width + j] != ANCHOR_PIXEL)
-                continue;
-
-            int grad = gradImg[i * width + j];
-            C[grad]++;
-        }
+        const Point& anchor = anchorPoints[k];
+        int grad = gradImg[anchor.y * width + anchor.x];
+        C[grad]++;
     }
 
     // Compute indices
@@ -1213,17 +1383,12 @@ int* EdgeDrawingImpl::sortAnchorsByGradValue1()
     int noAnchors = C[SIZE - 1];
     int* A = new int[noAnchors];
 
-    for (int i = 1; i < height - 1; i++)
+    for (int k = 0; k < anchorNos; k++)
     {
-        for (int j = 1; j < width - 1; j++)
-        {
-            if (edgeImg[i * width + j] != ANCHOR_PIXEL)
-                continue;
-
-            int grad = gradImg[i * width + j];
-            int index = --C[grad];
-            A[index] = i * width + j;    // anchor's offset
-        }
+        const Point& anchor = anchorPoints[k];
+        int grad = gradImg[anchor.y * width + anchor.x];
+        int index = --C[grad];
+        A[index] = anchor.y * width + anchor.x;    // anchor's offset
     }
 
     delete[] C;
@@ -1297,24 +1462,36 @@ void EdgeDrawingImpl::detectLines(OutputArray _lines)
     if (min_line_len < 9) // avoids small line segments in the result. Might be deleted!
         min_line_len = 9;
 
-    // Temporary buffers used during line fitting
-    double* x = new double[(width + height) * 8];
-    double* y = new double[(width + height) * 8];
-
     lines.clear();
-    linesNo = 0;
 
-    // Use the whole segment
-    for (size_t segmentNumber = 0; segmentNumber < segmentPoints.size(); segmentNumber++)
+    // Use the whole segment. Each segment is split into lines independently,
+    // the lines are gathered in segment order afterwards
+    int noSegments = (int)segmentPoints.size();
+    std::vector<std::vector<EDLineSegment> > segmentLines(noSegments);
+    parallel_for_(Range(0, noSegments), [&](const Range& range)
     {
-        std::vector<Point> segment = segmentPoints[segmentNumber];
-        for (int k = 0; k < (int)segment.size(); k++)
+        // Temporary buffers used during line fitting
+        std::vector<double> x((width + height) * 8), y((width + height) * 8);
+        for (int segmentNumber = range.start; segmentNumber < range.end; segmentNumber++)
         {
-            x[k] = segment[k].x;
-            y[k] = segment[k].y;
+            const std::vector<Point>& segment = segmentPoints[segmentNumber];
+            if (segment.size() > x.size())
+            {
+                x.resize(segment.size());
+                y.resize(segment.size());
+            }
+            for (int k = 0; k < (int)segment.size(); k++)
+            {
+                x[k] = segment[k].x;
+                y[k] = segment[k].y;
+            }
+            SplitSegment2Lines(&x[0], &y[0], (int)segment.size(), segmentNumber, segmentLines[segmentNumber]);
         }
-        SplitSegment2Lines(x, y, (int)segment.size(), (int)segmentNumber);
-    }
+    }, getNumThreads() * 4);
+
+    for (int i = 0; i < noSegments; i++)
+        lines.insert(lines.end(), segmentLines[i].begin(), segmentLines[i].end());
+    linesNo = (int)lines.size();
 
     JoinCollinearLines();
 
@@ -1335,9 +1512,6 @@ void EdgeDrawingImpl::detectLines(OutputArray _lines)
         segmentIndicesOfLines.push_back(lines[i].segmentNo);
     }
     Mat(linePoints).copyTo(_lines);
-
-    delete[] x;
-    delete[] y;
 }
 
 // Computes the minimum line length using the NFA formula given width & height values
@@ -1357,7 +1531,7 @@ int EdgeDrawingImpl::ComputeMinLineLength()
 // Given a full segment of pixels, splits the chain to lines
 // This code is used when we use the whole segment of pixels
 //
-void EdgeDrawingImpl::SplitSegment2Lines(double* x, double* y, int noPixels, int segmentNo)
+void EdgeDrawingImpl::SplitSegment2Lines(double* x, double* y, int noPixels, int segmentNo, std::vector<EDLineSegment>& segmentLines) const
 {
     // First pixel of the line segment within the segment of points
     int firstPixelIndex = 0;
@@ -1444,8 +1618,7 @@ void EdgeDrawingImpl::SplitSegment2Lines(double* x, double* y, int noPixels, int
                     break;
 
                 // Add the line segment to lines
-                lines.push_back(EDLineSegment(lastA, lastB, lastInvert, sx, sy, ex, ey, segmentNo, firstPixelIndex + noSkippedPixels, index - noSkippedPixels + 1));
-                linesNo++;
+                segmentLines.push_back(EDLineSegment(lastA, lastB, lastInvert, sx, sy, ex, ey, segmentNo, firstPixelIndex + noSkippedPixels, index - noSkippedPixels + 1));
                 len = index + 1;
 
                 break;
@@ -1520,97 +1693,107 @@ void EdgeDrawingImpl::ValidateLineSegments()
         nfa = new NFALUT(lutSize, prob, width, height);
     }
 
-    int* x = new int[(width + height) * 4];
-    int* y = new int[(width + height) * 4];
-
-    int noValidLines = 0;
-
-    for (int i = 0; i < linesNo; i++)
+    // Each line is validated independently, the valid lines are compacted in order afterwards
+    std::vector<uchar> isValid(linesNo);
+    parallel_for_(Range(0, linesNo), [&](const Range& range)
     {
-        EDLineSegment* ls = &lines[i];
+        std::vector<int> xBuffer((width + height) * 4), yBuffer((width + height) * 4);
+        int* x = &xBuffer[0];
+        int* y = &yBuffer[0];
 
-        // Compute Line's angle
-        double lineAngle;
-
-        if (ls->invert == 0)
+        for (int i = range.start; i < range.end; i++)
         {
-            // y = a + bx
-            lineAngle = atan(ls->b);
-        }
-        else
-        {
-            // x = a + by
-            lineAngle = atan(1.0 / ls->b);
-        }
+            EDLineSegment* ls = &lines[i];
 
-        if (lineAngle < 0)
-            lineAngle += CV_PI;
+            // Compute Line's angle
+            double lineAngle;
 
-        Point* pixels = &(segmentPoints[ls->segmentNo][0]);
-        int noPixels = ls->len;
+            if (ls->invert == 0)
+            {
+                // y = a + bx
+                lineAngle = atan(ls->b);
+            }
+            else
+            {
+                // x = a + by
+                lineAngle = atan(1.0 / ls->b);
+            }
 
-        bool valid = false;
+            if (lineAngle < 0)
+                lineAngle += CV_PI;
 
-        // Accept very long lines without testing. They are almost never invalidated.
-        if (ls->len >= 80)
-        {
-            valid = true;
-            // Validate short line segments by a line support region rectangle having width=2
-        }
-        else if (ls->len <= 25)
-        {
-            valid = ValidateLineSegmentRect(x, y, ls);
-        }
-        else
-        {
-            // Longer line segments are first validated by a line support region rectangle having width=1 (for speed)
-            // If the line segment is still invalid, then a line support region rectangle having width=2 is tried
-            // If the line segment fails both tests, it is discarded
-            int aligned = 0;
-            int count = 0;
-            for (int j = 0; j < noPixels; j++)
+            Point* pixels = &(segmentPoints[ls->segmentNo][0]);
+            int noPixels = ls->len;
+
+            bool valid = false;
+
+            // Accept very long lines without testing. They are almost never invalidated.
+            if (ls->len >= 80)
+            {
+                valid = true;
+                // Validate short line segments by a line support region rectangle having width=2
+            }
+            else if (ls->len <= 25)
             {
-                int r = pixels[j].x;
-                int c = pixels[j].y;
+                valid = ValidateLineSegmentRect(x, y, ls);
+            }
+            else
+            {
+                // Longer line segments are first validated by a line support region rectangle having width=1 (for speed)
+                // If the line segment is still invalid, then a line support region rectangle having width=2 is tried
+                // If the line segment fails both tests, it is discarded
+                int aligned = 0;
+                int count = 0;
+                for (int j = 0; j < noPixels; j++)
+                {
+                    int r = pixels[j].x;
+                    int c = pixels[j].y;
 
-                if (r <= 0 || r >= height - 1 || c <= 0 || c >= width - 1)
-                    continue;
+                    if (r <= 0 || r >= height - 1 || c <= 0 || c >= width - 1)
+                        continue;
 
-                count++;
+                    count++;
 
-                // compute gx & gy using the simple [-1 -1 -1]
-                //                                  [ 1  1  1]  filter in both directions
-                // Faster method below
-                // A B C
-                // D x E
-                // F G H
-                // gx = (C-A) + (E-D) + (H-F)
-                // gy = (F-A) + (G-B) + (H-C)
-                //
-                // To make this faster:
-                // com1 = (H-A)
-                // com2 = (C-F)
-                // Then: gx = com1 + com2 + (E-D) = (H-A) + (C-F) + (E-D) = (C-A) + (E-D) + (H-F)
-                //       gy = com2 - com1 + (G-B) = (H-A) - (C-F) + (G-B) = (F-A) + (G-B) + (H-C)
-                //
-                int com1 = srcImg[(r + 1) * width + c + 1] - srcImg[(r - 1) * width + c - 1];
-                int com2 = srcImg[(r - 1) * width + c + 1] - srcImg[(r + 1) * width + c - 1];
+                    // compute gx & gy using the simple [-1 -1 -1]
+                    //                                  [ 1  1  1]  filter in both directions
+                    // Faster method below
+                    // A B C
+                    // D x E
+                    // F G H
+                    // gx = (C-A) + (E-D) + (H-F)
+                    // gy = (F-A) + (G-B) + (H-C)
+                    //
+                    // To make this faster:
+                    // com1 = (H-A)
+                    // com2 = (C-F)
+                    // Then: gx = com1 + com2 + (E-D) = (H-A) + (C-F) + (E-D) = (C-A) + (E-D) + (H-F)
+                    //       gy = com2 - com1 + (G-B) = (H-A) - (C-F) + (G-B) = (F-A) + (G-B) + (H-C)
+                    //
+                    int com1 = srcImg[(r + 1) * width + c + 1] - srcImg[(r - 1) * width + c - 1];
+                    int com2 = srcImg[(r - 1) * width + c + 1] - srcImg[(r + 1) * width + c - 1];
 
-                int gx = com1 + com2 + srcImg[r * width + c + 1] - srcImg[r * width + c - 1];
-                int gy = com1 - com2 + srcImg[(r + 1) * width + c] - srcImg[(r - 1) * width + c];
+                    int gx = com1 + com2 + srcImg[r * width + c + 1] - srcImg[r * width + c - 1];
+                    int gy = com1 - com2 + srcImg[(r + 1) * width + c] - srcImg[(r - 1) * width + c];
 
-                double pixelAngle = nfa->myAtan2((double)gx, (double)-gy);
-                double diff = fabs(lineAngle - pixelAngle);
+                    double pixelAngle = nfa->myAtan2((double)gx, (double)-gy);
+                    double diff = fabs(lineAngle - pixelAngle);
 
-                if (diff <= precision || diff >= CV_PI - precision)
-                    aligned++;
+                    if (diff <= precision || diff >= CV_PI - precision)
+                        aligned++;
+                }
+
+                // Check validation by NFA computation (fast due to LUT)
+                valid = nfa->checkValidationByNFA(count, aligned) || ValidateLineSegmentRect(x, y, ls);
             }
 
-            // Check validation by NFA computation (fast due to LUT)
-            valid = nfa->checkValidationByNFA(count, aligned) || ValidateLineSegmentRect(x, y, ls);
+            isValid[i] = valid;
         }
+    }, getNumThreads() * 4);
 
-        if (valid)
+    int noValidLines = 0;
+    for (int i = 0; i < linesNo; i++)
+    {
+        if (isValid[i])
         {
             if (i != noValidLines)
                 lines[noValidLines] = lines[i];
@@ -1619,9 +1802,6 @@ void EdgeDrawingImpl::ValidateLineSegments()
     }
 
     linesNo = noValidLines;
-
-    delete[] x;
-    delete[] y;
 }
 
 bool EdgeDrawingImpl::ValidateLineSegmentRect(int* x, int* y, EDLineSegment* ls)
@@ -2459,83 +2639,146 @@ void EdgeDrawingImpl::detectEllipses(OutputArray ellipses)
 
 #define CIRCLE_MIN_LINE_LEN 6
 
-    for (int i = 0; i < segmentNos; i++)
+    // Segments are fitted independently; the results are then collected in segment order
+    // so that circles and lines are numbered exactly as in a sequential pass
+    enum { SEGMENT_SKIPPED, SEGMENT_LINES, SEGMENT_CIRCLE, SEGMENT_ELLIPSE };
+    struct SegmentFit
     {
-        // Make note of the starting line number for this segment
-        segmentStartLines[i] = (int)lines.size();
-
-        int noPixels = (int)segmentPoints[i].size();
-
-        if (noPixels < 2 * CIRCLE_MIN_LINE_LEN)
-            continue;
+        int kind;
+        double xc, yc, r, circleFitError, ellipseFitError;
+        EllipseEquation eq;
+        std::vector<EDLineSegment> lines;
+    };
+    std::vector<SegmentFit> fits(segmentNos);
 
-        double* x = bm->getX();
-        double* y = bm->getY();
+    parallel_for_(Range(0, segmentNos), [&](const Range& range)
+    {
+        std::vector<double> xBuffer, yBuffer;
 
-        for (int j = 0; j < noPixels; j++)
+        for (int i = range.start; i < range.end; i++)
         {
-            x[j] = segmentPoints[i][j].x;
-            y[j] = segmentPoints[i][j].y;
-        }
+            SegmentFit& fit = fits[i];
+            fit.kind = SEGMENT_SKIPPED;
 
-        // If the segment is reasonably long, then see if the segment traverses the boundary of a closed shape
-        if (noPixels >= 4 * CIRCLE_MIN_LINE_LEN)
-        {
-            // If the end-points of the segment is close to each other, then assume a circular/elliptic structure
-            double dx = x[0] - x[noPixels - 1];
-            double dy = y[0] - y[noPixels - 1];
-            double d = sqrt(dx * dx + dy * dy);
-            double r = noPixels / CV_2PI;      // Assume a complete circle
+            int noPixels = (int)segmentPoints[i].size();
 
-            double maxDistanceBetweenEndPoints = std::max(3.0, r / 4.0);
+            if (noPixels < 2 * CIRCLE_MIN_LINE_LEN)
+                continue;
 
-            // If almost closed loop, then try to fit a circle/ellipse
-            if (d <= maxDistanceBetweenEndPoints)
+            if ((int)xBuffer.size() < noPixels)
             {
-                double xc, yc, circleFitError = 1e10;
+                xBuffer.resize(noPixels);
+                yBuffer.resize(noPixels);
+            }
+            double* x = &xBuffer[0];
+            double* y = &yBuffer[0];
 
-                CircleFit(x, y, noPixels, &xc, &yc, &r, &circleFitError);
+            for (int j = 0; j < noPixels; j++)
+            {
+                x[j] = segmentPoints[i][j].x;
+                y[j] = segmentPoints[i][j].y;
+            }
 
-                EllipseEquation eq;
-                double ellipseFitError = 1e10;
+            // If the segment is reasonably long, then see if the segment traverses the boundary of a closed shape
+            if (noPixels >= 4 * CIRCLE_MIN_LINE_LEN)
+            {
+                // If the end-points of the segment is close to each other, then assume a circular/elliptic structure
+                double dx = x[0] - x[noPixels - 1];
+                double dy = y[0] - y[noPixels - 1];
+                double d = sqrt(dx * dx + dy * dy);
+                double r = noPixels / CV_2PI;      // Assume a complete circle
 
-                if (circleFitError > LONG_ARC_ERROR)
-                {
-                    // Try fitting an ellipse
-                    if (EllipseFit(x, y, noPixels, &eq))
-                        ellipseFitError = ComputeEllipseError(&eq, x, y, noPixels);
-                }
+                double maxDistanceBetweenEndPoints = std::max(3.0, r / 4.0);
 
-                if (circleFitError <= LONG_ARC_ERROR)
-                {
-                    addCircle(circles1, noCircles1, xc, yc, r, circleFitError, x, y, noPixels);
-                    bm->move(noPixels);
-                    continue;
-                }
-                else if (ellipseFitError <= ELLIPSE_ERROR)
+                // If almost closed loop, then try to fit a circle/ellipse
+                if (d <= maxDistanceBetweenEndPoints)
                 {
-                    double major, minor;
-                    ComputeEllipseCenterAndAxisLengths(&eq, &xc, &yc, &major, &minor);
+                    double xc, yc, circleFitError = 1e10;
+
+                    CircleFit(x, y, noPixels, &xc, &yc, &r, &circleFitError);
+
+                    EllipseEquation eq;
+                    double ellipseFitError = 1e10;
 
-                    // Assume major is longer. Otherwise, swap
-                    if (minor > major)
+                    if (circleFitError > LONG_ARC_ERROR)
                     {
-                        double tmp = major;
-                        major = minor;
-                        minor = tmp;
+                        // Try fitting an ellipse
+                        if (EllipseFit(x, y, noPixels, &eq))
+                            ellipseFitError = ComputeEllipseError(&eq, x, y, noPixels);
                     }
 
-                    if (major < 8 * minor)
+                    if (circleFitError <= LONG_ARC_ERROR)
                     {
-                        addCircle(circles1, noCircles1, xc, yc, r, circleFitError, &eq, ellipseFitError, x, y, noPixels);
-                        bm->move(noPixels);
+                        fit.kind = SEGMENT_CIRCLE;
+                        fit.xc = xc;
+                        fit.yc = yc;
+                        fit.r = r;
+                        fit.circleFitError = circleFitError;
+                        continue;
+                    }
+                    else if (ellipseFitError <= ELLIPSE_ERROR)
+                    {
+                        double major, minor;
+                        ComputeEllipseCenterAndAxisLengths(&eq, &xc, &yc, &major, &minor);
+
+                        // Assume major is longer. Otherwise, swap
+                        if (minor > major)
+                        {
+                            double tmp = major;
+                            major = minor;
+                            minor = tmp;
+                        }
+
+                        if (major < 8 * minor)
+                        {
+                            fit.kind = SEGMENT_ELLIPSE;
+                            fit.xc = xc;
+                            fit.yc = yc;
+                            fit.r = r;
+                            fit.circleFitError = circleFitError;
+                            fit.eq = eq;
+                            fit.ellipseFitError = ellipseFitError;
+                        }
+                        continue;
                     }
-                    continue;
                 }
             }
+            // Otherwise, split to lines
+            fit.kind = SEGMENT_LINES;
+            SplitSegment2Lines(x, y, noPixels, i, fit.lines);
+        }
+    }, getNumThreads() * 4);
+
+    for (int i = 0; i < segmentNos; i++)
+    {
+        // Make note of the starting line number for this segment
+        segmentStartLines[i] = (int)lines.size();
+
+        SegmentFit& fit = fits[i];
+        if (fit.kind == SEGMENT_LINES)
+        {
+            lines.insert(lines.end(), fit.lines.begin(), fit.lines.end());
+            continue;
         }
-        // Otherwise, split to lines
-        SplitSegment2Lines(x, y, noPixels, i);
+        if (fit.kind == SEGMENT_SKIPPED)
+            continue;
+
+        // Circles keep pointers to their pixels, so these are stored in the buffer manager
+        int noPixels = (int)segmentPoints[i].size();
+        double* x = bm->getX();
+        double* y = bm->getY();
+
+        for (int j = 0; j < noPixels; j++)
+        {
+            x[j] = segmentPoints[i][j].x;
+            y[j] = segmentPoints[i][j].y;
+        }
+
+        if (fit.kind == SEGMENT_CIRCLE)
+            addCircle(circles1, noCircles1, fit.xc, fit.yc, fit.r, fit.circleFitError, x, y, noPixels);
+        else
+            addCircle(circles1, noCircles1, fit.xc, fit.yc, fit.r, fit.circleFitError, &fit.eq, fit.ellipseFitError, x, y, noPixels);
+        bm->move(noPixels);
     }
 
     min_line_len = params.MinLineLength;
@@ -3111,10 +3354,6 @@ void EdgeDrawingImpl::ValidateCircles(bool validate)
 {
     precision = CV_PI / 16;  // Alignment precision
 
-    int points_buffer_size = 8 * (width + height);
-    double *px = new double[points_buffer_size];
-    double *py = new double[points_buffer_size];
-
     if (nfa->LUTSize == 1 && params.NFAValidation)
     {
         int lutSize = (width + height) / 8;
@@ -3122,244 +3361,256 @@ void EdgeDrawingImpl::ValidateCircles(bool validate)
         nfa = new NFALUT(lutSize, prob, width, height); // create look up table
     }
 
-    // Validate circles & ellipses
-    bool validateAgain;
-    int count = 0;
-    for (int i = 0; i < noCircles1; )
+    // Validate circles & ellipses. Each candidate is validated independently, possibly
+    // refitted as an ellipse, and the valid ones are then collected in order
+    std::vector<uchar> isValidCircle(noCircles1, (uchar)0);
+    parallel_for_(Range(0, noCircles1), [&](const Range& range)
     {
-        Circle* circle = &circles1[i];
-        double xc = circle->xc;
-        double yc = circle->yc;
-        double radius = circle->r;
+        int points_buffer_size = 8 * (width + height);
+        std::vector<double> pxBuffer(points_buffer_size), pyBuffer(points_buffer_size);
+        double* px = &pxBuffer[0];
+        double* py = &pyBuffer[0];
 
-        // Skip potential invalid circles (sometimes these kinds of candidates get generated!)
-        if (radius > MAX(width, height))
+        for (int i = range.start; i < range.end; )
         {
-            i++;
-            continue;
-        }
+            Circle* circle = &circles1[i];
+            double xc = circle->xc;
+            double yc = circle->yc;
+            double radius = circle->r;
 
-        validateAgain = false;
+            // Skip potential invalid circles (sometimes these kinds of candidates get generated!)
+            if (radius > MAX(width, height))
+            {
+                i++;
+                continue;
+            }
 
-        int noPoints = (int)(computeEllipsePerimeter(&circle->eq));
+            bool validateAgain = false;
 
-        if (noPoints > points_buffer_size)
-        {
-            i++;
-            continue;
-        }
+            int noPoints = (int)(computeEllipsePerimeter(&circle->eq));
 
-        if (circle->isEllipse)
-        {
-            ComputeEllipsePoints(circle->eq.coeff, px, py, noPoints);
-        }
-        else
-        {
-            ComputeCirclePoints(xc, yc, radius, px, py, &noPoints);
-        }
+            if (noPoints > points_buffer_size)
+            {
+                i++;
+                continue;
+            }
 
-        int pr = -1;  // previous row
-        int pc = -1;  // previous column
+            if (circle->isEllipse)
+            {
+                ComputeEllipsePoints(circle->eq.coeff, px, py, noPoints);
+            }
+            else
+            {
+                ComputeCirclePoints(xc, yc, radius, px, py, &noPoints);
+            }
 
-        int tr = -100;
-        int tc = -100;
+            int pr = -1;  // previous row
+            int pc = -1;  // previous column
 
-        int noPeripheryPixels = 0;
-        int aligned = 0;
-        for (int j = 0; j < noPoints; j++)
-        {
-            int r = (int)(py[j] + 0.5);
-            int c = (int)(px[j] + 0.5);
+            int tr = -100;
+            int tc = -100;
 
-            if (r == pr && c == pc)
-                continue;
-            noPeripheryPixels++;
+            int noPeripheryPixels = 0;
+            int aligned = 0;
+            for (int j = 0; j < noPoints; j++)
+            {
+                int r = (int)(py[j] + 0.5);
+                int c = (int)(px[j] + 0.5);
 
-            if (r <= 0 || r >= height - 1)
-                continue;
-            if (c <= 0 || c >= width - 1)
-                continue;
+                if (r == pr && c == pc)
+                    continue;
+                noPeripheryPixels++;
 
-            pr = r;
-            pc = c;
+                if (r <= 0 || r >= height - 1)
+                    continue;
+                if (c <= 0 || c >= width - 1)
+                    continue;
 
-            int dr = abs(r - tr);
-            int dc = abs(c - tc);
-            if (dr + dc >= 2)
-            {
-                tr = r;
-                tc = c;
-            }
+                pr = r;
+                pc = c;
+
+                int dr = abs(r - tr);
+                int dc = abs(c - tc);
+                if (dr + dc >= 2)
+                {
+                    tr = r;
+                    tc = c;
+                }
 
-            //
-            // See if there is an edge pixel within 1 pixel vicinity
-            //
-            if (edgeImg[r * width + c] != 255)
-            {
-                //   y-cy=-x-cx    y-cy=x-cx
-                //         \       /
-                //          \ IV. /
-                //           \   /
-                //            \ /
-                //     III.    +   I. quadrant
-                //            / \
-                //           /   \
-                //          / II. \
-                //         /       \
                 //
-                // (x, y)-->(x-cx, y-cy)
+                // See if there is an edge pixel within 1 pixel vicinity
                 //
+                if (edgeImg[r * width + c] != 255)
+                {
+                    //   y-cy=-x-cx    y-cy=x-cx
+                    //         \       /
+                    //          \ IV. /
+                    //           \   /
+                    //            \ /
+                    //     III.    +   I. quadrant
+                    //            / \
+                    //           /   \
+                    //          / II. \
+                    //         /       \
+                    //
+                    // (x, y)-->(x-cx, y-cy)
+                    //
 
-                int x = c;
-                int y = r;
+                    int x = c;
+                    int y = r;
 
-                int diff1 = (int)(y - yc - x + xc);
-                int diff2 = (int)(y - yc + x - xc);
+                    int diff1 = (int)(y - yc - x + xc);
+                    int diff2 = (int)(y - yc + x - xc);
 
-                if (diff1 < 0)
-                {
-                    if (diff2 > 0)
+                    if (diff1 < 0)
                     {
-                        // I. quadrant
-                        c = x - 1;
-                        if (c >= 1 && edgeImg[r * width + c] == 255)
-                            goto out;
-                        c = x + 1;
-                        if (c < width - 1 && edgeImg[r * width + c] == 255)
-                            goto out;
-
-                        c = x - 2;
-                        if (c >= 2 && edgeImg[r * width + c] == 255)
-                            goto out;
-                        c = x + 2;
-                        if (c < width - 2 && edgeImg[r * width + c] == 255)
-                            goto out;
+                        if (diff2 > 0)
+                        {
+                            // I. quadrant
+                            c = x - 1;
+                            if (c >= 1 && edgeImg[r * width + c] == 255)
+                                goto out;
+                            c = x + 1;
+                            if (c < width - 1 && edgeImg[r * width + c] == 255)
+                                goto out;
+
+                            c = x - 2;
+                            if (c >= 2 && edgeImg[r * width + c] == 255)
+                                goto out;
+                            c = x + 2;
+                            if (c < width - 2 && edgeImg[r * width + c] == 255)
+                                goto out;
+                        }
+                        else
+                        {
+                            // IV. quadrant
+                            r = y - 1;
+                            if (r >= 1 && edgeImg[r * width + c] == 255)
+                                goto out;
+                            r = y + 1;
+                            if (r < height - 1 && edgeImg[r * width + c] == 255)
+                                goto out;
+
+                            r = y - 2;
+                            if (r >= 2 && edgeImg[r * width + c] == 255)
+                                goto out;
+                            r = y + 2;
+                            if (r < height - 2 && edgeImg[r * width + c] == 255)
+                                goto out;
+                        }
                     }
                     else
                     {
-                        // IV. quadrant
-                        r = y - 1;
-                        if (r >= 1 && edgeImg[r * width + c] == 255)
-                            goto out;
-                        r = y + 1;
-                        if (r < height - 1 && edgeImg[r * width + c] == 255)
-                            goto out;
-
-                        r = y - 2;
-                        if (r >= 2 && edgeImg[r * width + c] == 255)
-                            goto out;
-                        r = y + 2;
-                        if (r < height - 2 && edgeImg[r * width + c] == 255)
-                            goto out;
+                        if (diff2 > 0)
+                        {
+                            // II. quadrant
+                            r = y - 1;
+                            if (r >= 1 && edgeImg[r * width + c] == 255)
+                                goto out;
+                            r = y + 1;
+                            if (r < height - 1 && edgeImg[r * width + c] == 255)
+                                goto out;
+
+                            r = y - 2;
+                            if (r >= 2 && edgeImg[r * width + c] == 255)
+                                goto out;
+                            r = y + 2;
+                            if (r < height - 2 && edgeImg[r * width + c] == 255)
+                                goto out;
+                        }
+                        else
+                        {
+                            // III. quadrant
+                            c = x - 1;
+                            if (c >= 1 && edgeImg[r * width + c] == 255)
+                                goto out;
+                            c = x + 1;
+                            if (c < width - 1 && edgeImg[r * width + c] == 255)
+                                goto out;
+
+                            c = x - 2;
+                            if (c >= 2 && edgeImg[r * width + c] == 255)
+                                goto out;
+                            c = x + 2;
+                            if (c < width - 2 && edgeImg[r * width + c] == 255)
+                                goto out;
+                        }
                     }
+
+                    r = pr;
+                    c = pc;
+                    continue;  // Ignore non-edge pixels.
+                               // This produces less false positives, but occationally misses on some valid circles
+                }
+            out:
+                // compute gx & gy
+                int com1 = smoothImg[(r + 1) * width + c + 1] - smoothImg[(r - 1) * width + c - 1];
+                int com2 = smoothImg[(r - 1) * width + c + 1] - smoothImg[(r + 1) * width + c - 1];
+
+                int gx = com1 + com2 + smoothImg[r * width + c + 1] - smoothImg[r * width + c - 1];
+                int gy = com1 - com2 + smoothImg[(r + 1) * width + c] - smoothImg[(r - 1) * width + c];
+                double pixelAngle = nfa->myAtan2((double)gx, (double)-gy);
+
+                double derivX, derivY;
+                if (circle->isEllipse)
+                {
+                    // Ellipse
+                    derivX = 2 * circle->eq.A() * c + circle->eq.B() * r + circle->eq.D();
+                    derivY = circle->eq.B() * c + 2 * circle->eq.C() * r + circle->eq.E();
                 }
                 else
                 {
-                    if (diff2 > 0)
-                    {
-                        // II. quadrant
-                        r = y - 1;
-                        if (r >= 1 && edgeImg[r * width + c] == 255)
-                            goto out;
-                        r = y + 1;
-                        if (r < height - 1 && edgeImg[r * width + c] == 255)
-                            goto out;
-
-                        r = y - 2;
-                        if (r >= 2 && edgeImg[r * width + c] == 255)
-                            goto out;
-                        r = y + 2;
-                        if (r < height - 2 && edgeImg[r * width + c] == 255)
-                            goto out;
-                    }
-                    else
-                    {
-                        // III. quadrant
-                        c = x - 1;
-                        if (c >= 1 && edgeImg[r * width + c] == 255)
-                            goto out;
-                        c = x + 1;
-                        if (c < width - 1 && edgeImg[r * width + c] == 255)
-                            goto out;
-
-                        c = x - 2;
-                        if (c >= 2 && edgeImg[r * width + c] == 255)
-                            goto out;
-                        c = x + 2;
-                        if (c < width - 2 && edgeImg[r * width + c] == 255)
-                            goto out;
-                    }
+                    // circle
+                    derivX = c - xc;
+                    derivY = r - yc;
                 }
 
-                r = pr;
-                c = pc;
-                continue;  // Ignore non-edge pixels.
-                           // This produces less false positives, but occationally misses on some valid circles
+                double idealPixelAngle = nfa->myAtan2(derivX, -derivY);
+                double diff = fabs(pixelAngle - idealPixelAngle);
+                if (diff <= precision || diff >= CV_PI - precision)
+                    aligned++;
             }
-        out:
-            // compute gx & gy
-            int com1 = smoothImg[(r + 1) * width + c + 1] - smoothImg[(r - 1) * width + c - 1];
-            int com2 = smoothImg[(r - 1) * width + c + 1] - smoothImg[(r + 1) * width + c - 1];
 
-            int gx = com1 + com2 + smoothImg[r * width + c + 1] - smoothImg[r * width + c - 1];
-            int gy = com1 - com2 + smoothImg[(r + 1) * width + c] - smoothImg[(r - 1) * width + c];
-            double pixelAngle = nfa->myAtan2((double)gx, (double)-gy);
+            bool isValid = !validate || nfa->checkValidationByNFA(noPeripheryPixels, aligned);
 
-            double derivX, derivY;
-            if (circle->isEllipse)
+            if (isValid)
             {
-                // Ellipse
-                derivX = 2 * circle->eq.A() * c + circle->eq.B() * r + circle->eq.D();
-                derivY = circle->eq.B() * c + 2 * circle->eq.C() * r + circle->eq.E();
+                isValidCircle[i] = 1;
             }
-            else
+            else if (circle->isEllipse == false && circle->coverRatio >= CANDIDATE_ELLIPSE_RATIO)
             {
-                // circle
-                derivX = c - xc;
-                derivY = r - yc;
-            }
-
-            double idealPixelAngle = nfa->myAtan2(derivX, -derivY);
-            double diff = fabs(pixelAngle - idealPixelAngle);
-            if (diff <= precision || diff >= CV_PI - precision)
-                aligned++;
-        }
+                // Fit an ellipse to this circle, and try to revalidate
+                double ellipseFitError = 1e10;
+                EllipseEquation eq;
 
-        bool isValid = !validate || nfa->checkValidationByNFA(noPeripheryPixels, aligned);
+                if (EllipseFit(circle->x, circle->y, circle->noPixels, &eq))
+                {
+                    ellipseFitError = ComputeEllipseError(&eq, circle->x, circle->y, circle->noPixels);
+                }
 
-        if (isValid)
-        {
-            circles2[count++] = circles1[i];
-        }
-        else if (circle->isEllipse == false && circle->coverRatio >= CANDIDATE_ELLIPSE_RATIO)
-        {
-            // Fit an ellipse to this circle, and try to revalidate
-            double ellipseFitError = 1e10;
-            EllipseEquation eq;
+                if (ellipseFitError <= ELLIPSE_ERROR)
+                {
+                    circle->isEllipse = true;
+                    circle->ellipseFitError = ellipseFitError;
+                    circle->eq = eq;
 
-            if (EllipseFit(circle->x, circle->y, circle->noPixels, &eq))
-            {
-                ellipseFitError = ComputeEllipseError(&eq, circle->x, circle->y, circle->noPixels);
+                    validateAgain = true;
+                }
             }
 
-            if (ellipseFitError <= ELLIPSE_ERROR)
-            {
-                circle->isEllipse = true;
-                circle->ellipseFitError = ellipseFitError;
-                circle->eq = eq;
-
-                validateAgain = true;
-            }
+            if (validateAgain == false)
+                i++;
         }
+    }, getNumThreads() * 4);
 
-        if (validateAgain == false)
-            i++;
+    int count = 0;
+    for (int i = 0; i < noCircles1; i++)
+    {
+        if (isValidCircle[i])
+            circles2[count++] = circles1[i];
     }
 
     noCircles2 = count;
-
-    delete[] px;
-    delete[] py;
 }
 
 void EdgeDrawingImpl::JoinCircles()
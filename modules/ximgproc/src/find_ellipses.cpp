@@ -6,6 +6,7 @@
 #include <opencv2/core.hpp>
 #include <unordered_map>
 #include <numeric>
+#include <limits>
 
 namespace cv {
 namespace ximgproc {
@@ -48,6 +49,8 @@ struct Ellipse {
         radius = other.radius, score = other.score;
     };
 
+    Ellipse &operator=(const Ellipse &other) = default;
+
     bool operator<(const Ellipse &other) const {
         if (score == other.score) {
             float lhs_e = b / a;
@@ -181,6 +184,64 @@ struct EllipseData {
     std::vector<float> Sa, Sb;
 };
 
+// a candidate triplet of arcs, the keys locate the data of the pairs i-j and i-k
+struct Triplet {
+    ushort i, j, k;
+    uint key_ij, key_ik;
+};
+
+// sorted index over one coordinate of the first or the last point of a set of arcs.
+// The position constraints between arcs compare such a coordinate with a bound, so the arcs
+// satisfying a constraint are found by a binary search instead of being tested one by one.
+class ArcIndex {
+public:
+    ArcIndex(const VVP &arcs, bool lastPoint, bool xCoordinate) {
+        auto sz = ushort(arcs.size());
+        keys.reserve(sz);
+        for (ushort n = 0; n < sz; n++) {
+            const Point &p = lastPoint ? arcs[n][arcs[n].size() - 1] : arcs[n][0];
+            keys.push_back(std::make_pair(xCoordinate ? p.x : p.y, n));
+        }
+        std::sort(keys.begin(), keys.end());
+    }
+
+    // get the indices, in increasing order, of the arcs whose coordinate is not greater than bound
+    void selectAtMost(float bound, std::vector<ushort> &selected) const {
+        auto last = std::upper_bound(keys.begin(), keys.end(), bound,
+                                     [](float b, const std::pair<int, ushort> &key) { return b < float(key.first); });
+        select(keys.begin(), last, selected);
+    }
+
+    // get the indices, in increasing order, of the arcs whose coordinate is not less than bound
+    void selectAtLeast(float bound, std::vector<ushort> &selected) const {
+        auto first = std::lower_bound(keys.begin(), keys.end(), bound,
+                                      [](const std::pair<int, ushort> &key, float b) { return float(key.first) < b; });
+        select(first, keys.end(), selected);
+    }
+
+private:
+    typedef std::vector<std::pair<int, ushort> >::const_iterator KeyIterator;
+
+    static void select(KeyIterator first, KeyIterator last, std::vector<ushort> &selected) {
+        selected.clear();
+        for (; first != last; ++first)
+            selected.push_back(first->second);
+        std::sort(selected.begin(), selected.end());
+    }
+
+    std::vector<std::pair<int, ushort> > keys; // coordinate and index of each arc
+};
+
+// get the data of a pair of arcs computed by a previous group of triplets or by the current task
+static EllipseData *findPairData(std::unordered_map<uint, EllipseData> &data,
+                                 std::unordered_map<uint, EllipseData> &localData, uint key) {
+    auto it = data.find(key);
+    if (it != data.end())
+        return &it->second;
+    it = localData.find(key);
+    return it != localData.end() ? &it->second : nullptr;
+}
+
 // implement of ellipse detector
 class EllipseDetectorImpl {
 
@@ -209,11 +270,14 @@ class EllipseDetectorImpl {
     float _minScore; // minimum score to confirm a detection
     float _minReliability; // minimum auxiliary score to confirm a detection
 
+    // bounded-time mode - at most this number of candidate triplets is validated, 0 means no limit.
+    int _maxCandidates;
+    int _remainingCandidates; // candidates left for the remaining groups of triplets
+
     // auxiliary variables
     Size _imgSize; // input image size
 
     int ACC_N_SIZE, ACC_R_SIZE, ACC_A_SIZE; // size of accumulator
-    int *accN, *accR, *accA; // pointer to accumulator
 
 public:
     float countsOfFindEllipse;
@@ -227,7 +291,8 @@ public:
     void detect(Mat1b &image, std::vector<Ellipse> &ellipses);
 
     // set the parameters of the detector
-    void setParameters(float maxCenterDistance, float minScore, float minReliability);
+    void setParameters(float maxCenterDistance, float minScore, float minReliability,
+                       int maxCandidates = 0);
 
 private:
     // keys for hash table
@@ -245,15 +310,15 @@ private:
     static float
     getMedianSlope(std::vector<Point2f> &med, Point2f &centers, std::vector<float> &slopes);
 
-    void getFastCenter(std::vector<Point> &e1, std::vector<Point> &e2, EllipseData &data);
+    void getFastCenter(std::vector<Point> &e1, std::vector<Point> &e2, EllipseData &data) const;
 
-    void detectEdges13(Mat1b &DP, VVP &points_1, VVP &points_3);
+    void detectEdges13(VVP &contours, VVP &points_1, VVP &points_3);
 
-    void detectEdges24(Mat1b &DN, VVP &points_2, VVP &points_4);
+    void detectEdges24(VVP &contours, VVP &points_2, VVP &points_4);
 
-    void
+    bool
     findEllipses(Point2f &center, VP &edge_i, VP &edge_j, VP &edge_k, EllipseData &data_ij,
-                 EllipseData &data_ik, std::vector<Ellipse> &ellipses);
+                 EllipseData &data_ik, int *accN, int *accR, int *accA, Ellipse &ellipse) const;
 
     static Point2f getCenterCoordinates(EllipseData &data_ij, EllipseData &data_ik);
 
@@ -273,6 +338,14 @@ private:
     getTriplets413(VVP &pi, VVP &pj, VVP &pk, std::unordered_map<uint, EllipseData> &data,
                    std::vector<Ellipse> &ellipses);
 
+    template <typename Body>
+    void searchArcs(int sz_i, const std::vector<std::vector<Triplet> > &triplets, const Body &body) const;
+
+    void
+    validateTriplets(VVP &pi, VVP &pj, VVP &pk, std::vector<std::vector<Triplet> > &triplets,
+                     std::vector<std::unordered_map<uint, EllipseData> > &newData,
+                     std::unordered_map<uint, EllipseData> &data, std::vector<Ellipse> &ellipses);
+
     static void labeling(Mat1b &image, VVP &segments, int minLength);
 };
 
@@ -289,13 +362,16 @@ EllipseDetectorImpl::EllipseDetectorImpl() {
     _minScore = 0.7f;
     _minReliability = 0.5;
     _uNs = 16;
+    _maxCandidates = 0;
+    _remainingCandidates = 0;
 }
 
 void EllipseDetectorImpl::setParameters(float maxCenterDistance, float minScore,
-                                        float minReliability) {
+                                        float minReliability, int maxCandidates) {
     _maxCenterDistance = maxCenterDistance;
     _minScore = minScore;
     _minReliability = minReliability;
+    _maxCandidates = maxCandidates;
 
     _maxCenterDistance2 = _maxCenterDistance * _maxCenterDistance;
 }
@@ -348,8 +424,7 @@ float EllipseDetectorImpl::getMedianSlope(std::vector<Point2f> &med, Point2f &ce
 }
 
 void EllipseDetectorImpl::getFastCenter(std::vector<Point> &e1, std::vector<Point> &e2,
-                                        EllipseData &data) {
-    countsOfGetFastCenter++;
+                                        EllipseData &data) const {
     data.isValid = true;
 
     auto size_1 = unsigned(e1.size());
@@ -720,99 +795,137 @@ void EllipseDetectorImpl::labeling(Mat1b &image, VVP &segments, int minLength) {
     }
 }
 
-void EllipseDetectorImpl::detectEdges13(Mat1b &DP, VVP &points_1, VVP &points_3) {
-    // vector of connected edge points
-    VVP contours;
-    // labeling 8-connected edge points, discarding edge too small
-    labeling(DP, contours, _minEdgeLength); // label point on the same arc
+void EllipseDetectorImpl::detectEdges13(VVP &contours, VVP &points_1, VVP &points_3) {
     int contourSize = int(contours.size());
+    // convexity class of each edge, 0 for the discarded ones
+    std::vector<uchar> quadrant(contourSize, 0);
 
-    // for each edge
-    for (int i = 0; i < contourSize; i++) {
-        VP &edgeSegment = contours[i];
+    parallel_for_(Range(0, contourSize), [&](const Range &range) {
+        // for each edge
+        for (int i = range.start; i < range.end; i++) {
+            VP &edgeSegment = contours[i];
 
-        // selection strategy - constraint on axes aspect ratio
-        RotatedRect oriented = minAreaRect(edgeSegment);
-        float orMin = min(oriented.size.width, oriented.size.height);
+            // selection strategy - constraint on axes aspect ratio
+            RotatedRect oriented = minAreaRect(edgeSegment);
+            float orMin = min(oriented.size.width, oriented.size.height);
 
-        if (orMin < _minOrientedRectSide) {
-            continue;
-        }
+            if (orMin < _minOrientedRectSide) {
+                continue;
+            }
 
-        // order edge points of the same arc
-        std::sort(edgeSegment.begin(), edgeSegment.end(), sortPoint);
-        int edgeSegmentSize = unsigned(edgeSegment.size());
+            // order edge points of the same arc
+            std::sort(edgeSegment.begin(), edgeSegment.end(), sortPoint);
+            int edgeSegmentSize = unsigned(edgeSegment.size());
 
-        // get extrema of the arc
-        Point &left = edgeSegment[0];
-        Point &right = edgeSegment[edgeSegmentSize - 1];
+            // get extrema of the arc
+            Point &left = edgeSegment[0];
+            Point &right = edgeSegment[edgeSegmentSize - 1];
 
-        // find convexity
-        int countTop = 0;
-        int lx = left.x;
-        for (int k = 1; k < edgeSegmentSize; ++k) {
-            if (edgeSegment[k].x == lx)
-                continue;
-            countTop += (edgeSegment[k].y - left.y);
-            lx = edgeSegment[k].x;
-        }
+            // find convexity
+            int countTop = 0;
+            int lx = left.x;
+            for (int k = 1; k < edgeSegmentSize; ++k) {
+                if (edgeSegment[k].x == lx)
+                    continue;
+                countTop += (edgeSegment[k].y - left.y);
+                lx = edgeSegment[k].x;
+            }
 
-        int width = abs(right.x - left.x) + 1;
-        int height = abs(right.y - left.y) + 1;
-        int countBottom = (width * height) - edgeSegmentSize - countTop;
+            int width = abs(right.x - left.x) + 1;
+            int height = abs(right.y - left.y) + 1;
+            int countBottom = (width * height) - edgeSegmentSize - countTop;
 
-        if (countBottom > countTop)
-            points_1.push_back(edgeSegment);
-        else if (countBottom < countTop)
-            points_3.push_back(edgeSegment);
+            if (countBottom > countTop)
+                quadrant[i] = 1;
+            else if (countBottom < countTop)
+                quadrant[i] = 3;
+        }
+    });
+
+    // keep the order of the labeling
+    for (int i = 0; i < contourSize; i++) {
+        if (quadrant[i] == 1)
+            points_1.push_back(contours[i]);
+        else if (quadrant[i] == 3)
+            points_3.push_back(contours[i]);
     }
 }
 
-void EllipseDetectorImpl::detectEdges24(Mat1b &DN, VVP &points_2, VVP &points_4) {
-    // vector of connected edge points
-    VVP contours;
-    // labeling 8-connected edge points, discarding edge too small
-    labeling(DN, contours, _minEdgeLength); // label point on the same arc
+void EllipseDetectorImpl::detectEdges24(VVP &contours, VVP &points_2, VVP &points_4) {
     int contourSize = int(contours.size());
+    // convexity class of each edge, 0 for the discarded ones
+    std::vector<uchar> quadrant(contourSize, 0);
 
-    // for each edge
-    for (int i = 0; i < contourSize; i++) {
-        VP &edgeSegment = contours[i];
+    parallel_for_(Range(0, contourSize), [&](const Range &range) {
+        // for each edge
+        for (int i = range.start; i < range.end; i++) {
+            VP &edgeSegment = contours[i];
 
-        // selection strategy - constraint on axes aspect ratio
-        RotatedRect oriented = minAreaRect(edgeSegment);
-        float orMin = min(oriented.size.width, oriented.size.height);
+            // selection strategy - constraint on axes aspect ratio
+            RotatedRect oriented = minAreaRect(edgeSegment);
+            float orMin = min(oriented.size.width, oriented.size.height);
 
-        if (orMin < _minOrientedRectSide) {
-            continue;
-        }
+            if (orMin < _minOrientedRectSide) {
+                continue;
+            }
 
-        // order edge points of the same arc
-        std::sort(edgeSegment.begin(), edgeSegment.end(), sortPoint);
-        int edgeSegmentSize = unsigned(edgeSegment.size());
+            // order edge points of the same arc
+            std::sort(edgeSegment.begin(), edgeSegment.end(), sortPoint);
+            int edgeSegmentSize = unsigned(edgeSegment.size());
 
-        // get extrema of the arc
-        Point &left = edgeSegment[0];
-        Point &right = edgeSegment[edgeSegmentSize - 1];
+            // get extrema of the arc
+            Point &left = edgeSegment[0];
+            Point &right = edgeSegment[edgeSegmentSize - 1];
 
-        // find convexity
-        int countBottom = 0;
-        int lx = left.x;
-        for (int k = 0; k < edgeSegmentSize; ++k) {
-            if (edgeSegment[k].x == lx)
-                continue;
-            countBottom += (left.y - edgeSegment[k].y);
-            lx = edgeSegment[k].x;
+            // find convexity
+            int countBottom = 0;
+            int lx = left.x;
+            for (int k = 0; k < edgeSegmentSize; ++k) {
+                if (edgeSegment[k].x == lx)
+                    continue;
+                countBottom += (left.y - edgeSegment[k].y);
+                lx = edgeSegment[k].x;
+            }
+
+            int width = abs(right.x - left.x) + 1;
+            int height = abs(right.y - left.y) + 1;
+            int countTop = (width * height) - edgeSegmentSize - countBottom;
+
+            if (countBottom > countTop)
+                quadrant[i] = 2;
+            else if (countBottom < countTop)
+                quadrant[i] = 4;
         }
+    });
 
-        int width = abs(right.x - left.x) + 1;
-        int height = abs(right.y - left.y) + 1;
-        int countTop = (width * height) - edgeSegmentSize - countBottom;
+    // keep the order of the labeling
+    for (int i = 0; i < contourSize; i++) {
+        if (quadrant[i] == 2)
+            points_2.push_back(contours[i]);
+        else if (quadrant[i] == 4)
+            points_4.push_back(contours[i]);
+    }
+}
 
-        if (countBottom > countTop)
-            points_2.push_back(edgeSegment);
-        else if (countBottom < countTop)
-            points_4.push_back(edgeSegment);
+// run the search body of a group of triplets on the arcs i. In bounded-time mode the arcs are searched
+// in ordered chunks, and the search stops after the chunk in which the candidates found so far reach
+// the remaining budget, so that the enumeration of arcs and pairs is bounded too. The chunks do not
+// depend on the number of threads, so neither do the candidates and the pair data.
+template <typename Body>
+void EllipseDetectorImpl::searchArcs(int sz_i, const std::vector<std::vector<Triplet> > &triplets,
+                                     const Body &body) const {
+    if (_maxCandidates <= 0) {
+        parallel_for_(Range(0, sz_i), body);
+        return;
+    }
+
+    const int CHUNK_SIZE = 32;
+    size_t found = 0;
+    for (int start = 0; start < sz_i && found < size_t(_remainingCandidates); start += CHUNK_SIZE) {
+        int end = std::min(start + CHUNK_SIZE, sz_i);
+        parallel_for_(Range(start, end), body);
+        for (int i = start; i < end; i++)
+            found += triplets[i].size();
     }
 }
 
@@ -824,397 +937,502 @@ void EllipseDetectorImpl::detectEdges24(Mat1b &DN, VVP &points_2, VVP &points_4)
 void EllipseDetectorImpl::getTriplets124(VVP &pi, VVP &pj, VVP &pk,
                                          std::unordered_map<uint, EllipseData> &data,
                                          std::vector<Ellipse> &ellipses) {
+    if (_maxCandidates > 0 && _remainingCandidates <= 0)
+        return;
+
     // get arcs length
     auto sz_i = ushort(pi.size());
-    auto sz_j = ushort(pj.size());
-    auto sz_k = ushort(pk.size());
 
-    // for each edge i
-    for (ushort i = 0; i < sz_i; i++) {
-        VP &edge_i = pi[i];
-        auto sz_ei = ushort(edge_i.size());
+    // index the arcs j on pjl.x and the arcs k on pkl.y for the constraints on position
+    ArcIndex index_j(pj, true, true);
+    ArcIndex index_k(pk, true, false);
 
-        Point &pif = edge_i[0];
-        Point &pim = edge_i[sz_ei / 2];
-        Point &pil = edge_i[sz_ei - 1];
+    // a single edge i never yields more candidates than the remaining ones
+    size_t maxTriplets = _maxCandidates > 0 ? size_t(_remainingCandidates) : std::numeric_limits<size_t>::max();
+    std::vector<std::vector<Triplet> > triplets(sz_i);
+    std::vector<std::unordered_map<uint, EllipseData> > newData;
+    Mutex newDataMutex;
 
-        // 1 -> reverse 1
-        VP rev_i(edge_i.size());
-        std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
+    searchArcs(sz_i, triplets, [&](const Range &range) {
+        // data of the pairs computed by this task, the keys of the pairs always include i
+        std::unordered_map<uint, EllipseData> localData;
+        std::vector<ushort> js, ks;
 
-        // for each edge j
-        for (ushort j = 0; j < sz_j; ++j) {
-            VP &edge_j = pj[j];
-            auto sz_ej = ushort(edge_j.size());
+        // for each edge i
+        for (int idx = range.start; idx < range.end; idx++) {
+            auto i = ushort(idx);
+            VP &edge_i = pi[i];
+            auto sz_ei = ushort(edge_i.size());
 
-            Point &pjf = edge_j[0];
-            Point &pjm = edge_j[sz_ej / 2];
-            Point &pjl = edge_j[sz_ej - 1];
+            Point &pif = edge_i[0];
+            Point &pim = edge_i[sz_ei / 2];
+            Point &pil = edge_i[sz_ei - 1];
 
             // constraints on position
-            if (pjl.x > pif.x + _positionThreshold)
+            index_j.selectAtMost(pif.x + _positionThreshold, js);
+            index_k.selectAtLeast(pil.y - _positionThreshold, ks);
+            if (js.empty() || ks.empty())
                 continue;
 
-            // constraints on CNC
-            const float CNC_THRESHOLD = 0.3f;
-            if (fabs(valueOfPoints(T124) - 1) > CNC_THRESHOLD)
-                continue;
+            // 1 -> reverse 1
+            VP rev_i(edge_i.size());
+            std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
 
-            uint key_ij = generateKey(PAIR_12, i, j);
+            std::vector<Triplet> &candidates = triplets[i];
 
-            // for each edge k
-            for (ushort k = 0; k < sz_k; ++k) {
-                VP &edge_k = pk[k];
-                auto sz_ek = ushort(edge_k.size());
+            // for each edge j
+            for (ushort j : js) {
+                VP &edge_j = pj[j];
+                auto sz_ej = ushort(edge_j.size());
 
-                Point &pkl = edge_k[sz_ek - 1];
+                Point &pjf = edge_j[0];
+                Point &pjm = edge_j[sz_ej / 2];
+                Point &pjl = edge_j[sz_ej - 1];
 
-                // constraints on position
-                if (pkl.y < pil.y - _positionThreshold)
+                // constraints on CNC
+                const float CNC_THRESHOLD = 0.3f;
+                if (fabs(valueOfPoints(T124) - 1) > CNC_THRESHOLD)
                     continue;
 
-                uint key_ik = generateKey(PAIR_14, i, k);
+                uint key_ij = generateKey(PAIR_12, i, j);
 
-                // find centers
-                EllipseData data_ij, data_ik;
+                // for each edge k
+                for (ushort k : ks) {
+                    VP &edge_k = pk[k];
 
-                // if the data for the pair i-j have not been computed yet
-                if (data.count(key_ij) == 0) {
-                    getFastCenter(edge_j, rev_i, data_ij);
-                    // insert computed data in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ij, data_ij));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ij = data.at(key_ij);
-                }
+                    uint key_ik = generateKey(PAIR_14, i, k);
 
-                // if the data for the pair i-k have not been computed yet
-                if (data.count(key_ik) == 0) {
-                    getFastCenter(edge_i, edge_k, data_ik);
-                    // insert computed data in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ik, data_ik));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ik = data.at(key_ik);
-                }
+                    // find centers
+                    // if the data for the pair i-j have not been computed yet
+                    EllipseData *data_ij = findPairData(data, localData, key_ij);
+                    if (!data_ij) {
+                        data_ij = &localData[key_ij];
+                        getFastCenter(edge_j, rev_i, *data_ij);
+                    }
 
-                // invalid centers
-                if (!data_ij.isValid || !data_ik.isValid)
-                    continue;
+                    // if the data for the pair i-k have not been computed yet
+                    EllipseData *data_ik = findPairData(data, localData, key_ik);
+                    if (!data_ik) {
+                        data_ik = &localData[key_ik];
+                        getFastCenter(edge_i, edge_k, *data_ik);
+                    }
 
-                // selection strategy - Step 3.
-                // the computed centers are not close enough
-                if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
-                    continue;
+                    // invalid centers
+                    if (!data_ij->isValid || !data_ik->isValid)
+                        continue;
 
-                // find ellipse parameters
-                // get the coordinates of the center (xc, yc)
-                Point2f center = getCenterCoordinates(data_ij, data_ik);
-                // find remaining parameters (A, B, rho)
-                findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, ellipses);
+                    // selection strategy - Step 3.
+                    // the computed centers are not close enough
+                    if (pointDistance2(data_ij->Cab, data_ik->Cab) > _maxCenterDistance2)
+                        continue;
+
+                    // the ellipse parameters are found in validateTriplets
+                    candidates.push_back({i, j, k, key_ij, key_ik});
+                    if (candidates.size() >= maxTriplets)
+                        break;
+                }
+                if (candidates.size() >= maxTriplets)
+                    break;
             }
         }
-    }
+
+        AutoLock lock(newDataMutex);
+        newData.push_back(std::move(localData));
+    });
+
+    validateTriplets(pi, pj, pk, triplets, newData, data, ellipses);
 }
 
 void EllipseDetectorImpl::getTriplets231(VVP &pi, VVP &pj, VVP &pk,
                                          std::unordered_map<uint, EllipseData> &data,
                                          std::vector<Ellipse> &ellipses) {
+    if (_maxCandidates > 0 && _remainingCandidates <= 0)
+        return;
+
     // get arc length
     auto sz_i = ushort(pi.size());
-    auto sz_j = ushort(pj.size());
-    auto sz_k = ushort(pk.size());
 
-    // for each edge i
-    for (ushort i = 0; i < sz_i; i++) {
-        VP &edge_i = pi[i];
-        auto sz_ei = ushort(edge_i.size());
+    // index the arcs j on pjf.y and the arcs k on pkf.x for the constraints on position
+    ArcIndex index_j(pj, false, false);
+    ArcIndex index_k(pk, false, true);
 
-        Point &pif = edge_i[0];
-        Point &pim = edge_i[sz_ei / 2];
-        Point &pil = edge_i[sz_ei - 1];
+    // a single edge i never yields more candidates than the remaining ones
+    size_t maxTriplets = _maxCandidates > 0 ? size_t(_remainingCandidates) : std::numeric_limits<size_t>::max();
+    std::vector<std::vector<Triplet> > triplets(sz_i);
+    std::vector<std::unordered_map<uint, EllipseData> > newData;
+    Mutex newDataMutex;
 
-        // 2 -> reverse 2
-        VP rev_i(edge_i.size());
-        std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
+    searchArcs(sz_i, triplets, [&](const Range &range) {
+        // data of the pairs computed by this task, the keys of the pairs always include i
+        std::unordered_map<uint, EllipseData> localData;
+        std::vector<ushort> js, ks;
 
-        // for each edge j
-        for (ushort j = 0; j < sz_j; ++j) {
-            VP &edge_j = pj[j];
-            auto sz_ej = ushort(edge_j.size());
+        // for each edge i
+        for (int idx = range.start; idx < range.end; idx++) {
+            auto i = ushort(idx);
+            VP &edge_i = pi[i];
+            auto sz_ei = ushort(edge_i.size());
 
-            Point &pjf = edge_j[0];
-            Point &pjm = edge_j[sz_ej / 2];
-            Point &pjl = edge_j[sz_ej - 1];
+            Point &pif = edge_i[0];
+            Point &pim = edge_i[sz_ei / 2];
+            Point &pil = edge_i[sz_ei - 1];
 
             // constraints on position
-            if (pjf.y < pif.y - _positionThreshold)
-                continue;
-
-            // constraints on CNC
-            const float CNC_THRESHOLD = 0.3f;
-            if (fabs(valueOfPoints(T231) - 1) > CNC_THRESHOLD)
+            index_j.selectAtLeast(pif.y - _positionThreshold, js);
+            index_k.selectAtLeast(pil.x - _positionThreshold, ks);
+            if (js.empty() || ks.empty())
                 continue;
 
-            // 3 -> reverse 3
-            VP rev_j(edge_j.size());
-            std::reverse_copy(edge_j.begin(), edge_j.end(), rev_j.begin());
+            // 2 -> reverse 2
+            VP rev_i(edge_i.size());
+            std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
 
-            uint key_ij = generateKey(PAIR_23, i, j);
+            std::vector<Triplet> &candidates = triplets[i];
 
-            // for each edge k
-            for (ushort k = 0; k < sz_k; ++k) {
-                VP &edge_k = pk[k];
+            // for each edge j
+            for (ushort j : js) {
+                VP &edge_j = pj[j];
+                auto sz_ej = ushort(edge_j.size());
 
-                Point &pkf = edge_k[0];
+                Point &pjf = edge_j[0];
+                Point &pjm = edge_j[sz_ej / 2];
+                Point &pjl = edge_j[sz_ej - 1];
 
-                // constraints on position
-                if (pkf.x < pil.x - _positionThreshold)
+                // constraints on CNC
+                const float CNC_THRESHOLD = 0.3f;
+                if (fabs(valueOfPoints(T231) - 1) > CNC_THRESHOLD)
                     continue;
 
-                uint key_ik = generateKey(PAIR_12, k, i);
+                // 3 -> reverse 3
+                VP rev_j(edge_j.size());
+                std::reverse_copy(edge_j.begin(), edge_j.end(), rev_j.begin());
 
-                // find centers
-                EllipseData data_ij, data_ik;
+                uint key_ij = generateKey(PAIR_23, i, j);
 
-                // if the data for the pair i-j have not been computed yet
-                if (data.count(key_ij) == 0) {
-                    getFastCenter(rev_i, rev_j, data_ij);
-                    // insert computed date in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ij, data_ij));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ij = data.at(key_ij);
-                }
+                // for each edge k
+                for (ushort k : ks) {
+                    VP &edge_k = pk[k];
 
-                // if the data for the pair i-k have not been computed yet
-                if (data.count(key_ik) == 0) {
-                    // 1 -> reverse 1
-                    VP rev_k(edge_k.size());
-                    std::reverse_copy(edge_k.begin(), edge_k.end(), rev_k.begin());
+                    uint key_ik = generateKey(PAIR_12, k, i);
 
-                    getFastCenter(edge_i, rev_k, data_ik);
-                    data.insert(std::pair<uint, EllipseData>(key_ik, data_ik));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ik = data.at(key_ik);
-                }
+                    // find centers
+                    // if the data for the pair i-j have not been computed yet
+                    EllipseData *data_ij = findPairData(data, localData, key_ij);
+                    if (!data_ij) {
+                        data_ij = &localData[key_ij];
+                        getFastCenter(rev_i, rev_j, *data_ij);
+                    }
 
-                // invalid centers
-                if (!data_ij.isValid || !data_ik.isValid)
-                    continue;
+                    // if the data for the pair i-k have not been computed yet
+                    EllipseData *data_ik = findPairData(data, localData, key_ik);
+                    if (!data_ik) {
+                        // 1 -> reverse 1
+                        VP rev_k(edge_k.size());
+                        std::reverse_copy(edge_k.begin(), edge_k.end(), rev_k.begin());
 
-                // selection strategy - Step 3.
-                // the computed centers are not close enough
-                if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
-                    continue;
+                        data_ik = &localData[key_ik];
+                        getFastCenter(edge_i, rev_k, *data_ik);
+                    }
+
+                    // invalid centers
+                    if (!data_ij->isValid || !data_ik->isValid)
+                        continue;
 
-                // find ellipse parameters
-                // get the coordinates of the center (xc, yc)
-                Point2f center = getCenterCoordinates(data_ij, data_ik);
-                // find remaining parameters (A, B, rho)
-                findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, ellipses);
+                    // selection strategy - Step 3.
+                    // the computed centers are not close enough
+                    if (pointDistance2(data_ij->Cab, data_ik->Cab) > _maxCenterDistance2)
+                        continue;
+
+                    // the ellipse parameters are found in validateTriplets
+                    candidates.push_back({i, j, k, key_ij, key_ik});
+                    if (candidates.size() >= maxTriplets)
+                        break;
+                }
+                if (candidates.size() >= maxTriplets)
+                    break;
             }
         }
-    }
+
+        AutoLock lock(newDataMutex);
+        newData.push_back(std::move(localData));
+    });
+
+    validateTriplets(pi, pj, pk, triplets, newData, data, ellipses);
 }
 
 void EllipseDetectorImpl::getTriplets342(VVP &pi, VVP &pj, VVP &pk,
                                          std::unordered_map<uint, EllipseData> &data,
                                          std::vector<Ellipse> &ellipses) {
+    if (_maxCandidates > 0 && _remainingCandidates <= 0)
+        return;
+
     // get arcs length
     auto sz_i = ushort(pi.size());
-    auto sz_j = ushort(pj.size());
-    auto sz_k = ushort(pk.size());
 
-    // for each edge i
-    for (ushort i = 0; i < sz_i; i++) {
-        VP &edge_i = pi[i];
-        auto sz_ei = ushort(edge_i.size());
+    // index the arcs j on pjf.x and the arcs k on pkf.y for the constraints on position
+    ArcIndex index_j(pj, false, true);
+    ArcIndex index_k(pk, false, false);
 
-        Point &pif = edge_i[0];
-        Point &pim = edge_i[sz_ei / 2];
-        Point &pil = edge_i[sz_ei - 1];
+    // a single edge i never yields more candidates than the remaining ones
+    size_t maxTriplets = _maxCandidates > 0 ? size_t(_remainingCandidates) : std::numeric_limits<size_t>::max();
+    std::vector<std::vector<Triplet> > triplets(sz_i);
+    std::vector<std::unordered_map<uint, EllipseData> > newData;
+    Mutex newDataMutex;
 
-        // 3 -> reverse 3
-        VP rev_i(edge_i.size());
-        std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
+    searchArcs(sz_i, triplets, [&](const Range &range) {
+        // data of the pairs computed by this task, the keys of the pairs always include i
+        std::unordered_map<uint, EllipseData> localData;
+        std::vector<ushort> js, ks;
 
-        // for each edge j
-        for (ushort j = 0; j < sz_j; ++j) {
-            VP &edge_j = pj[j];
-            auto sz_ej = ushort(edge_j.size());
+        // for each edge i
+        for (int idx = range.start; idx < range.end; idx++) {
+            auto i = ushort(idx);
+            VP &edge_i = pi[i];
+            auto sz_ei = ushort(edge_i.size());
 
-            Point &pjf = edge_j[0];
-            Point &pjm = edge_j[sz_ej / 2];
-            Point &pjl = edge_j[sz_ej - 1];
+            Point &pif = edge_i[0];
+            Point &pim = edge_i[sz_ei / 2];
+            Point &pil = edge_i[sz_ei - 1];
 
             // constraints on position
-            if (pjf.x < pil.x - _positionThreshold)
+            index_j.selectAtLeast(pil.x - _positionThreshold, js);
+            index_k.selectAtMost(pif.y + _positionThreshold, ks);
+            if (js.empty() || ks.empty())
                 continue;
 
-            // constraints on CNC
-            const float CNC_THRESHOLD = 0.3f;
-            if (fabs(valueOfPoints(T342) - 1) > CNC_THRESHOLD)
-                continue;
-
-            // 4 -> reverse 4
-            VP rev_j(edge_j.size());
-            std::reverse_copy(edge_j.begin(), edge_j.end(), rev_j.begin());
+            // 3 -> reverse 3
+            VP rev_i(edge_i.size());
+            std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
 
-            uint key_ij = generateKey(PAIR_34, i, j);
+            std::vector<Triplet> &candidates = triplets[i];
 
-            // for each edge k
-            for (ushort k = 0; k < sz_k; ++k) {
-                VP &edge_k = pk[k];
+            // for each edge j
+            for (ushort j : js) {
+                VP &edge_j = pj[j];
+                auto sz_ej = ushort(edge_j.size());
 
-                Point &pkf = edge_k[0];
+                Point &pjf = edge_j[0];
+                Point &pjm = edge_j[sz_ej / 2];
+                Point &pjl = edge_j[sz_ej - 1];
 
-                // constraints on position
-                if (pkf.y > pif.y + _positionThreshold)
+                // constraints on CNC
+                const float CNC_THRESHOLD = 0.3f;
+                if (fabs(valueOfPoints(T342) - 1) > CNC_THRESHOLD)
                     continue;
 
-                uint key_ik = generateKey(PAIR_23, k, i);
+                // 4 -> reverse 4
+                VP rev_j(edge_j.size());
+                std::reverse_copy(edge_j.begin(), edge_j.end(), rev_j.begin());
 
-                // find centers
-                EllipseData data_ij, data_ik;
+                uint key_ij = generateKey(PAIR_34, i, j);
 
-                // if the data for the pair i-j have not been computed yet
-                if (data.count(key_ij) == 0) {
-                    getFastCenter(edge_i, rev_j, data_ij);
-                    // insert computed data in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ij, data_ij));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ij = data.at(key_ij);
-                }
+                // for each edge k
+                for (ushort k : ks) {
+                    VP &edge_k = pk[k];
 
-                // if the data for the pair i-k have not been computed yet
-                if (data.count(key_ik) == 0) {
-                    // 2 -> reverse 2
-                    VP rev_k(edge_k.size());
-                    std::reverse_copy(edge_k.begin(), edge_k.end(), rev_k.begin());
+                    uint key_ik = generateKey(PAIR_23, k, i);
 
-                    getFastCenter(rev_i, rev_k, data_ik);
-                    data.insert(std::pair<uint, EllipseData>(key_ik, data_ik));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ik = data.at(key_ik);
-                }
+                    // find centers
+                    // if the data for the pair i-j have not been computed yet
+                    EllipseData *data_ij = findPairData(data, localData, key_ij);
+                    if (!data_ij) {
+                        data_ij = &localData[key_ij];
+                        getFastCenter(edge_i, rev_j, *data_ij);
+                    }
 
-                // invalid centers
-                if (!data_ij.isValid || !data_ik.isValid)
-                    continue;
+                    // if the data for the pair i-k have not been computed yet
+                    EllipseData *data_ik = findPairData(data, localData, key_ik);
+                    if (!data_ik) {
+                        // 2 -> reverse 2
+                        VP rev_k(edge_k.size());
+                        std::reverse_copy(edge_k.begin(), edge_k.end(), rev_k.begin());
 
-                // selection strategy - Step 3.
-                // the computed centers are not close enough
-                if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
-                    continue;
+                        data_ik = &localData[key_ik];
+                        getFastCenter(rev_i, rev_k, *data_ik);
+                    }
 
-                // find ellipse parameters
-                // get the coordinates of the center (xc, yc)
-                Point2f center = getCenterCoordinates(data_ij, data_ik);
-                // find remaining parameters (A, B, rho)
-                findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, ellipses);
+                    // invalid centers
+                    if (!data_ij->isValid || !data_ik->isValid)
+                        continue;
+
+                    // selection strategy - Step 3.
+                    // the computed centers are not close enough
+                    if (pointDistance2(data_ij->Cab, data_ik->Cab) > _maxCenterDistance2)
+                        continue;
+
+                    // the ellipse parameters are found in validateTriplets
+                    candidates.push_back({i, j, k, key_ij, key_ik});
+                    if (candidates.size() >= maxTriplets)
+                        break;
+                }
+                if (candidates.size() >= maxTriplets)
+                    break;
             }
         }
 
-    }
+        AutoLock lock(newDataMutex);
+        newData.push_back(std::move(localData));
+    });
+
+    validateTriplets(pi, pj, pk, triplets, newData, data, ellipses);
 }
 
 void EllipseDetectorImpl::getTriplets413(VVP &pi, VVP &pj, VVP &pk,
                                          std::unordered_map<uint, EllipseData> &data,
                                          std::vector<Ellipse> &ellipses) {
+    if (_maxCandidates > 0 && _remainingCandidates <= 0)
+        return;
+
     // get arch length
     auto sz_i = ushort(pi.size());
-    auto sz_j = ushort(pj.size());
-    auto sz_k = ushort(pk.size());
 
-    // for each edge i
-    for (ushort i = 0; i < sz_i; i++) {
-        VP &edge_i = pi[i];
-        auto sz_ei = ushort(edge_i.size());
+    // index the arcs j on pjl.y and the arcs k on pkl.x for the constraints on position
+    ArcIndex index_j(pj, true, false);
+    ArcIndex index_k(pk, true, true);
 
-        Point &pif = edge_i[0];
-        Point &pim = edge_i[sz_ei / 2];
-        Point &pil = edge_i[sz_ei - 1];
+    // a single edge i never yields more candidates than the remaining ones
+    size_t maxTriplets = _maxCandidates > 0 ? size_t(_remainingCandidates) : std::numeric_limits<size_t>::max();
+    std::vector<std::vector<Triplet> > triplets(sz_i);
+    std::vector<std::unordered_map<uint, EllipseData> > newData;
+    Mutex newDataMutex;
 
-        // 4 -> reverse 4
-        VP rev_i(edge_i.size());
-        std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
+    searchArcs(sz_i, triplets, [&](const Range &range) {
+        // data of the pairs computed by this task, the keys of the pairs always include i
+        std::unordered_map<uint, EllipseData> localData;
+        std::vector<ushort> js, ks;
 
-        // for each edge j
-        for (ushort j = 0; j < sz_j; ++j) {
-            VP &edge_j = pj[j];
-            auto sz_ej = ushort(edge_j.size());
+        // for each edge i
+        for (int idx = range.start; idx < range.end; idx++) {
+            auto i = ushort(idx);
+            VP &edge_i = pi[i];
+            auto sz_ei = ushort(edge_i.size());
 
-            Point &pjf = edge_j[0];
-            Point &pjm = edge_j[sz_ej / 2];
-            Point &pjl = edge_j[sz_ej - 1];
+            Point &pif = edge_i[0];
+            Point &pim = edge_i[sz_ei / 2];
+            Point &pil = edge_i[sz_ei - 1];
 
             // constraints on position
-            if (pjl.y > pil.y + _positionThreshold)
+            index_j.selectAtMost(pil.y + _positionThreshold, js);
+            index_k.selectAtMost(pif.x + _positionThreshold, ks);
+            if (js.empty() || ks.empty())
                 continue;
 
-            // constraints on CNC
-            const float CNC_THRESHOLD = 0.3f;
-            if (fabs(valueOfPoints(T413) - 1) > CNC_THRESHOLD)
-                continue;
+            // 4 -> reverse 4
+            VP rev_i(edge_i.size());
+            std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
 
-            uint key_ij = generateKey(PAIR_14, j, i);
+            std::vector<Triplet> &candidates = triplets[i];
 
-            // for each edge k
-            for (ushort k = 0; k < sz_k; ++k) {
-                VP &edge_k = pk[k];
-                auto sz_ek = ushort(edge_k.size());
+            // for each edge j
+            for (ushort j : js) {
+                VP &edge_j = pj[j];
+                auto sz_ej = ushort(edge_j.size());
 
-                Point &pkl = edge_k[sz_ek - 1];
+                Point &pjf = edge_j[0];
+                Point &pjm = edge_j[sz_ej / 2];
+                Point &pjl = edge_j[sz_ej - 1];
 
-                // constraints on position
-                if (pkl.x > pif.x + _positionThreshold)
+                // constraints on CNC
+                const float CNC_THRESHOLD = 0.3f;
+                if (fabs(valueOfPoints(T413) - 1) > CNC_THRESHOLD)
                     continue;
 
-                uint key_ik = generateKey(PAIR_34, k, i);
+                uint key_ij = generateKey(PAIR_14, j, i);
 
-                // find centers
-                EllipseData data_ij, data_ik;
+                // for each edge k
+                for (ushort k : ks) {
+                    VP &edge_k = pk[k];
 
-                // if the data for the pair i-j have not been computed yet
-                if (data.count(key_ij) == 0) {
-                    getFastCenter(edge_i, edge_j, data_ij);
-                    // insert computed date in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ij, data_ij));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ij = data.at(key_ij);
-                }
+                    uint key_ik = generateKey(PAIR_34, k, i);
 
-                // if the data for the pair i-k have not been computed yet
-                if (data.count(key_ik) == 0) {
-                    getFastCenter(rev_i, edge_k, data_ik);
-                    data.insert(std::pair<uint, EllipseData>(key_ik, data_ik));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ik = data.at(key_ik);
-                }
+                    // find centers
+                    // if the data for the pair i-j have not been computed yet
+                    EllipseData *data_ij = findPairData(data, localData, key_ij);
+                    if (!data_ij) {
+                        data_ij = &localData[key_ij];
+                        getFastCenter(edge_i, edge_j, *data_ij);
+                    }
 
-                // invalid centers
-                if (!data_ij.isValid || !data_ik.isValid)
-                    continue;
+                    // if the data for the pair i-k have not been computed yet
+                    EllipseData *data_ik = findPairData(data, localData, key_ik);
+                    if (!data_ik) {
+                        data_ik = &localData[key_ik];
+                        getFastCenter(rev_i, edge_k, *data_ik);
+                    }
 
-                // selection strategy - Step 3.
-                // the computed centers are not close enough
-                if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
-                    continue;
+                    // invalid centers
+                    if (!data_ij->isValid || !data_ik->isValid)
+                        continue;
 
-                // find ellipse parameters
-                // get the coordinates of the center (xc, yc)
-                Point2f center = getCenterCoordinates(data_ij, data_ik);
-                // find remaining parameters (A, B, rho)
-                findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, ellipses);
+                    // selection strategy - Step 3.
+                    // the computed centers are not close enough
+                    if (pointDistance2(data_ij->Cab, data_ik->Cab) > _maxCenterDistance2)
+                        continue;
 
+                    // the ellipse parameters are found in validateTriplets
+                    candidates.push_back({i, j, k, key_ij, key_ik});
+                    if (candidates.size() >= maxTriplets)
+                        break;
+                }
+                if (candidates.size() >= maxTriplets)
+                    break;
             }
         }
+
+        AutoLock lock(newDataMutex);
+        newData.push_back(std::move(localData));
+    });
+
+    validateTriplets(pi, pj, pk, triplets, newData, data, ellipses);
+}
+
+void EllipseDetectorImpl::validateTriplets(VVP &pi, VVP &pj, VVP &pk,
+                                           std::vector<std::vector<Triplet> > &triplets,
+                                           std::vector<std::unordered_map<uint, EllipseData> > &newData,
+                                           std::unordered_map<uint, EllipseData> &data,
+                                           std::vector<Ellipse> &ellipses) {
+    // the pairs computed by the tasks are shared with the next groups of triplets only now,
+    // so that each pair is computed by the same group as in a sequential search
+    for (size_t n = 0; n < newData.size(); n++) {
+        countsOfGetFastCenter += float(newData[n].size());
+        data.insert(newData[n].begin(), newData[n].end());
+    }
+
+    // the candidates in the order of a sequential search, the first ones only in bounded-time mode
+    std::vector<Triplet> candidates;
+    for (size_t i = 0; i < triplets.size(); i++)
+        candidates.insert(candidates.end(), triplets[i].begin(), triplets[i].end());
+    if (_maxCandidates > 0) {
+        if (candidates.size() > size_t(_remainingCandidates))
+            candidates.resize(_remainingCandidates);
+        _remainingCandidates -= int(candidates.size());
+    }
+    countsOfFindEllipse += float(candidates.size());
+
+    int candidateCount = int(candidates.size());
+    std::vector<Ellipse> found(candidateCount);
+    std::vector<uchar> isFound(candidateCount, 0);
+
+    parallel_for_(Range(0, candidateCount), [&](const Range &range) {
+        std::vector<int> accN(ACC_N_SIZE), accR(ACC_R_SIZE), accA(ACC_A_SIZE);
+
+        for (int n = range.start; n < range.end; n++) {
+            const Triplet &t = candidates[n];
+            EllipseData &data_ij = data.at(t.key_ij);
+            EllipseData &data_ik = data.at(t.key_ik);
+
+            // find ellipse parameters
+            // get the coordinates of the center (xc, yc)
+            Point2f center = getCenterCoordinates(data_ij, data_ik);
+            // find remaining parameters (A, B, rho)
+            isFound[n] = findEllipses(center, pi[t.i], pj[t.j], pk[t.k], data_ij, data_ik,
+                                      accN.data(), accR.data(), accA.data(), found[n]);
+        }
+    });
+
+    for (int n = 0; n < candidateCount; n++) {
+        if (isFound[n])
+            ellipses.push_back(found[n]);
     }
 }
 
@@ -1475,6 +1693,7 @@ void EllipseDetectorImpl::preProcessing(Mat1b &image, Mat1b &dp, Mat1b &dn) {
 
 void EllipseDetectorImpl::detect(Mat1b &image, std::vector<Ellipse> &ellipses) {
     countsOfFindEllipse = 0, countsOfGetFastCenter = 0;
+    _remainingCandidates = _maxCandidates;
 
     // set the image size
     _imgSize = image.size();
@@ -1483,12 +1702,9 @@ void EllipseDetectorImpl::detect(Mat1b &image, std::vector<Ellipse> &ellipses) {
     Mat1b dp = Mat1b::zeros(_imgSize); // arcs along positive diagonal
     Mat1b dn = Mat1b::zeros(_imgSize); // arcs along negative diagonal
 
-    // initialize accumulator dimensions
+    // initialize accumulator dimensions, the accumulators are allocated by each task
     ACC_N_SIZE = 101, ACC_R_SIZE = 180, ACC_A_SIZE = max(_imgSize.height, _imgSize.width);
 
-    // allocate accumulators
-    accN = new int[ACC_N_SIZE], accR = new int[ACC_R_SIZE], accA = new int[ACC_A_SIZE];
-
     // other temporary
     VVP points_1, points_2, points_3, points_4; // vector of points, one for each convexity class
     std::unordered_map<uint, EllipseData> centers; // hash map for reusing already computed EllipseData
@@ -1497,9 +1713,20 @@ void EllipseDetectorImpl::detect(Mat1b &image, std::vector<Ellipse> &ellipses) {
     // find edge point with coarse convexity along positive (dp) or negative (dn) diagonal
     preProcessing(image, dp, dn);
 
+    // labeling 8-connected edge points of both diagonals, discarding edge too small
+    VVP contours_13, contours_24;
+    parallel_for_(Range(0, 2), [&](const Range &range) {
+        for (int n = range.start; n < range.end; n++) {
+            if (n == 0)
+                labeling(dp, contours_13, _minEdgeLength); // label point on the same arc
+            else
+                labeling(dn, contours_24, _minEdgeLength);
+        }
+    });
+
     // detect edge and find convexity
-    detectEdges13(dp, points_1, points_3);
-    detectEdges24(dn, points_2, points_4);
+    detectEdges13(contours_13, points_1, points_3);
+    detectEdges24(contours_24, points_2, points_4);
 
     // find triplets
     getTriplets124(points_1, points_2, points_4, centers, ellipses);
@@ -1510,19 +1737,13 @@ void EllipseDetectorImpl::detect(Mat1b &image, std::vector<Ellipse> &ellipses) {
     // std::sort by score
     std::sort(ellipses.begin(), ellipses.end());
 
-    // free accumulator memory
-    delete[]accN;
-    delete[]accR;
-    delete[]accA;
-
     // cluster detections
     clusterEllipses(ellipses);
 }
 
-void EllipseDetectorImpl::findEllipses(Point2f &center, VP &edge_i, VP &edge_j, VP &edge_k,
+bool EllipseDetectorImpl::findEllipses(Point2f &center, VP &edge_i, VP &edge_j, VP &edge_k,
                                        EllipseData &data_ij, EllipseData &data_ik,
-                                       std::vector<Ellipse> &ellipses) {
-    countsOfFindEllipse++;
+                                       int *accN, int *accR, int *accA, Ellipse &ellipse) const {
     // find ellipse parameters
 
     // 0-initialize accumulators
@@ -1819,12 +2040,12 @@ void EllipseDetectorImpl::findEllipses(Point2f &center, VP &edge_i, VP &edge_j,
 
     // no points found on the ellipse
     if (counter_on_perimeter <= 0)
-        return;
+        return false;
 
     // compute score
     float score = float(counter_on_perimeter) * invNofPoints;
     if (score < _minScore)
-        return;
+        return false;
 
     // compute reliability
     float di, dj, dk;
@@ -1866,13 +2087,14 @@ void EllipseDetectorImpl::findEllipses(Point2f &center, VP &edge_i, VP &edge_j,
     float rel = min(1.f, ((di + dj + dk) / (3 * (ell.a + ell.b))));
 
     if (rel < _minReliability)
-        return;
+        return false;
 
     // assign the new score
     ell.score = (score + rel) * 0.5f;
 
     // the tentative detection has been confirmed
-    ellipses.emplace_back(ell);
+    ellipse = ell;
+    return true;
 }
 
 void EllipseDetectorImpl::clusterEllipses(std::vector<Ellipse> &ellipses) {
@@ -1942,10 +2164,18 @@ void findEllipses(
         InputArray image, OutputArray ellipses,
         float scoreThreshold, float reliabilityThreshold,
         float centerDistanceThreshold) {
+    findEllipses(image, ellipses, scoreThreshold, reliabilityThreshold, centerDistanceThreshold, 0);
+}
+
+void findEllipses(
+        InputArray image, OutputArray ellipses,
+        float scoreThreshold, float reliabilityThreshold,
+        float centerDistanceThreshold, int maxCandidates) {
 
     // check image empty and type
     CV_Assert(
             !image.empty() && (image.isMat() || image.isUMat()));
+    CV_Assert(maxCandidates >= 0);
 
     // check ellipses type
     int type = CV_32FC(6);
@@ -1960,7 +2190,7 @@ void findEllipses(
             sqrt(float(imgSize.width * imgSize.width + imgSize.height * imgSize.height)) *
             centerDistanceThreshold;
     EllipseDetectorImpl edi;
-    edi.setParameters(maxCenterDistance, scoreThreshold, reliabilityThreshold);
+    edi.setParameters(maxCenterDistance, scoreThreshold, reliabilityThreshold, maxCandidates);
 
     // detect - ellipse format
     std::vector<Ellipse> ellipseResults;
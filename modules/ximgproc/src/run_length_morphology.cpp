@@ -34,6 +34,7 @@
  *  the use of this software, even if advised of the possibility of such damage.
  */
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <math.h>
 #include <vector>
 #include <iostream>
@@ -55,11 +56,10 @@ struct rlType
 typedef std::vector<rlType> rlVec;
 
 template <class T>
-void _thresholdLine(T* pData, int nWidth, int nRow, T threshold, int type, rlVec& res)
+static inline void _thresholdSpan(const T* pData, int nBegin, int nEnd, int nRow, T threshold, int type,
+    bool& bOn, int& nStartSegment, rlVec& res)
 {
-  bool bOn = false;
-  int nStartSegment = 0;
-  for (int j = 0; j < nWidth; j++)
+  for (int j = nBegin; j < nEnd; j++)
   {
     bool bAboveThreshold = (pData[j] > threshold);
     bool bCurOn = (bAboveThreshold == (THRESH_BINARY == type));
@@ -76,6 +76,14 @@ void _thresholdLine(T* pData, int nWidth, int nRow, T threshold, int type, rlVec
     }
 
   }
+}
+
+template <class T>
+void _thresholdLine(T* pData, int nWidth, int nRow, T threshold, int type, rlVec& res)
+{
+  bool bOn = false;
+  int nStartSegment = 0;
+  _thresholdSpan(pData, 0, nWidth, nRow, threshold, type, bOn, nStartSegment, res);
   if (bOn)
   {
     rlType chord(nStartSegment, nWidth - 1, nRow);
@@ -83,40 +91,72 @@ void _thresholdLine(T* pData, int nWidth, int nRow, T threshold, int type, rlVec
   }
 }
 
-static void _threshold(cv::Mat& img, rlVec& res, double threshold, int type)
+#if CV_SIMD128
+// binary scans consist mostly of long uniform stretches: whole blocks of pixels which do not
+// change the current state are skipped, only blocks containing a run boundary are scanned pixel by pixel
+template <>
+void _thresholdLine<uchar>(uchar* pData, int nWidth, int nRow, uchar threshold, int type, rlVec& res)
+{
+  const int nLanes = v_uint8x16::nlanes;
+  v_uint8x16 vThreshold = v_setall_u8(threshold);
+  bool bOn = false;
+  int nStartSegment = 0;
+  int j = 0;
+  while (j < nWidth)
+  {
+    // the state is kept as long as all pixels are above the threshold (or none is)
+    bool bAboveWhileOn = (bOn == (THRESH_BINARY == type));
+    for (; j <= nWidth - nLanes; j += nLanes)
+    {
+      v_uint8x16 vAbove = v_gt(v_load(pData + j), vThreshold);
+      if (bAboveWhileOn ? !v_check_all(vAbove) : v_check_any(vAbove))
+        break;
+    }
+    int nEnd = std::min(j + nLanes, nWidth);
+    _thresholdSpan(pData, j, nEnd, nRow, threshold, type, bOn, nStartSegment, res);
+    j = nEnd;
+  }
+  if (bOn)
+  {
+    rlType chord(nStartSegment, nWidth - 1, nRow);
+    res.push_back(chord);
+  }
+}
+#endif
+
+static void _thresholdRows(const cv::Mat& img, const Range& rows, double threshold, int type, rlVec& res)
 {
-  res.clear();
   switch (img.depth())
   {
   case CV_8U:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<uchar>(img.ptr(i), img.cols, i, (uchar) threshold, type, res);
+    for (int i = rows.start; i < rows.end; ++i)
+      _thresholdLine<uchar>((uchar*) img.ptr(i), img.cols, i, (uchar) threshold, type, res);
     break;
   case CV_8S:
-    for (int i = 0; i < img.rows; ++i)
+    for (int i = rows.start; i < rows.end; ++i)
       _thresholdLine<schar>((schar*) img.ptr(i), img.cols, i, (schar) threshold, type, res);
     break;
   case CV_16U:
-      for (int i = 0; i < img.rows; ++i)
+      for (int i = rows.start; i < rows.end; ++i)
       {
           _thresholdLine<unsigned short>((unsigned short*)img.ptr(i), img.cols, i,
               (unsigned short)threshold, type, res);
       }
     break;
   case CV_16S:
-    for (int i = 0; i < img.rows; ++i)
+    for (int i = rows.start; i < rows.end; ++i)
       _thresholdLine<short>((short*) img.ptr(i), img.cols, i, (short) threshold, type, res);
     break;
   case CV_32S:
-    for (int i = 0; i < img.rows; ++i)
+    for (int i = rows.start; i < rows.end; ++i)
       _thresholdLine<int>((int*) img.ptr(i), img.cols, i, (int) threshold, type, res);
     break;
   case CV_32F:
-    for (int i = 0; i < img.rows; ++i)
+    for (int i = rows.start; i < rows.end; ++i)
       _thresholdLine<float>((float*) img.ptr(i), img.cols, i, (float) threshold, type, res);
     break;
   case CV_64F:
-    for (int i = 0; i < img.rows; ++i)
+    for (int i = rows.start; i < rows.end; ++i)
       _thresholdLine<double>((double*) img.ptr(i), img.cols, i, threshold, type, res);
     break;
   default:
@@ -124,6 +164,71 @@ static void _threshold(cv::Mat& img, rlVec& res, double threshold, int type)
   }
 }
 
+// Row-partitioned operations write the runs of each stripe of rows into a buffer of its own.
+// Concatenating the buffers in stripe order gives exactly the runs of a serial pass.
+static int getNumRowStripes(int nRows, size_t nWork)
+{
+  const size_t nMinWorkPerStripe = 1 << 16;
+  size_t nStripes = std::min((size_t) getNumThreads() * 4, nWork / nMinWorkPerStripe);
+  return (int) std::max((size_t) 1, std::min(nStripes, (size_t) std::max(nRows, 1)));
+}
+
+static inline Range getStripeRows(int nFirstRow, int nRows, int nStripes, int nStripe)
+{
+  return Range(nFirstRow + (int) ((int64) nRows * nStripe / nStripes),
+      nFirstRow + (int) ((int64) nRows * (nStripe + 1) / nStripes));
+}
+
+static void concatStripes(std::vector<rlVec>& stripes, rlVec& res)
+{
+  size_t nRuns = 0;
+  for (size_t i = 0; i < stripes.size(); ++i)
+    nRuns += stripes[i].size();
+  res.reserve(res.size() + nRuns);
+  for (size_t i = 0; i < stripes.size(); ++i)
+    res.insert(res.end(), stripes[i].begin(), stripes[i].end());
+}
+
+class ThresholdInvoker : public ParallelLoopBody
+{
+public:
+  ThresholdInvoker(const cv::Mat& img, double threshold, int type, std::vector<rlVec>& stripes)
+    : img_(img), threshold_(threshold), type_(type), stripes_(stripes) { }
+
+  void operator()(const Range& range) const CV_OVERRIDE
+  {
+    for (int i = range.start; i < range.end; ++i)
+      _thresholdRows(img_, getStripeRows(0, img_.rows, (int) stripes_.size(), i), threshold_, type_, stripes_[i]);
+  }
+
+private:
+  const cv::Mat& img_;
+  double threshold_;
+  int type_;
+  std::vector<rlVec>& stripes_;
+};
+
+static void _threshold(cv::Mat& img, rlVec& res, double threshold, int type)
+{
+  res.clear();
+  int nStripes = getNumRowStripes(img.rows, img.total());
+  if (nStripes == 1)
+  {
+    _thresholdRows(img, Range(0, img.rows), threshold, type, res);
+    return;
+  }
+
+  // report an unsupported type before any work is started
+  int depth = img.depth();
+  if (depth != CV_8U && depth != CV_8S && depth != CV_16U && depth != CV_16S &&
+      depth != CV_32S && depth != CV_32F && depth != CV_64F)
+    CV_Error( Error::StsUnsupportedFormat, "unsupported image type" );
+
+  std::vector<rlVec> stripes(nStripes);
+  parallel_for_(Range(0, nStripes), ThresholdInvoker(img, threshold, type, stripes));
+  concatStripes(stripes, res);
+}
+
 
 static void convertToOutputArray(rlVec& runs, Size size, OutputArray& res)
 {
@@ -155,13 +260,13 @@ CV_EXPORTS void threshold(InputArray src, OutputArray rlDest, double thresh, int
 
 
 template <class T>
-void paint_impl(cv::Mat& img, rlType* pRuns, int nSize, T value)
+void paint_impl(cv::Mat& img, rlType* pRuns, int nSize, T value, Point origin)
 {
     int i;
     rlType* pCurRun;
     for (pCurRun = pRuns, i = 0; i< nSize; ++pCurRun, ++i)
     {
-        rlType& curRun = *pCurRun;
+        rlType curRun(pCurRun->cb - origin.x, pCurRun->ce - origin.x, pCurRun->r - origin.y);
         if (curRun.r < 0 || curRun.r >= img.rows || curRun.cb >= img.cols || curRun.ce < 0)
             continue;
 
@@ -170,46 +275,71 @@ void paint_impl(cv::Mat& img, rlType* pRuns, int nSize, T value)
     }
 }
 
-  CV_EXPORTS void paint(InputOutputArray image, InputArray rlSrc, const Scalar& value)
-  {
-    Mat _runs;
-    _runs = rlSrc.getMat();
-    int N = _runs.checkVector(3);
-    if (N <= 1)
-        return;
-
-    double dValue = value[0];
-
-    cv::Mat _image = image.getMat();
-
-    rlType* pRuns = (rlType*) &(_runs.at<Point3i>(1));
+static void paintRuns(cv::Mat& _image, rlType* pRuns, int nSize, double dValue, Point origin)
+{
     switch (_image.type())
     {
     case CV_8UC1:
-        paint_impl<uchar>(_image, pRuns, N - 1, (uchar)dValue);
+        paint_impl<uchar>(_image, pRuns, nSize, (uchar)dValue, origin);
         break;
     case CV_8SC1:
-        paint_impl<schar>(_image, pRuns, N - 1, (schar)dValue);
+        paint_impl<schar>(_image, pRuns, nSize, (schar)dValue, origin);
         break;
     case CV_16UC1:
-        paint_impl<unsigned short>(_image, pRuns, N - 1, (unsigned short)dValue);
+        paint_impl<unsigned short>(_image, pRuns, nSize, (unsigned short)dValue, origin);
         break;
     case CV_16SC1:
-        paint_impl<short>(_image, pRuns, N - 1, (short)dValue);
+        paint_impl<short>(_image, pRuns, nSize, (short)dValue, origin);
         break;
     case CV_32SC1:
-        paint_impl<int>(_image, pRuns, N - 1, (int)dValue);
+        paint_impl<int>(_image, pRuns, nSize, (int)dValue, origin);
         break;
     case CV_32FC1:
-        paint_impl<float>(_image, pRuns, N - 1, (float)dValue);
+        paint_impl<float>(_image, pRuns, nSize, (float)dValue, origin);
         break;
     case CV_64FC1:
-        paint_impl<double>(_image, pRuns, N - 1, dValue);
+        paint_impl<double>(_image, pRuns, nSize, dValue, origin);
         break;
     default:
         CV_Error(Error::StsUnsupportedFormat, "unsupported image type");
         break;
     }
+}
+
+  CV_EXPORTS void paint(InputOutputArray image, InputArray rlSrc, const Scalar& value)
+  {
+    Mat _runs;
+    _runs = rlSrc.getMat();
+    int N = _runs.checkVector(3);
+    if (N <= 1)
+        return;
+
+    cv::Mat _image = image.getMat();
+
+    rlType* pRuns = (rlType*) &(_runs.at<Point3i>(1));
+    paintRuns(_image, pRuns, N - 1, value[0], Point(0, 0));
+  }
+
+static bool compareRow(const rlType& run, int nRow)
+{
+    return run.r < nRow;
+}
+
+  CV_EXPORTS void paintTile(InputOutputArray tile, InputArray rlSrc, const Scalar& value, Point tileOrigin)
+  {
+    Mat _runs;
+    _runs = rlSrc.getMat();
+    int N = _runs.checkVector(3);
+    cv::Mat _image = tile.getMat();
+    if (N <= 1 || _image.empty())
+        return;
+
+    // the runs are sorted by rows, so only the runs of the rows covered by the tile are visited
+    rlType* pRuns = (rlType*) &(_runs.at<Point3i>(1));
+    rlType* pEnd = pRuns + (N - 1);
+    rlType* pFirst = std::lower_bound(pRuns, pEnd, tileOrigin.y, compareRow);
+    rlType* pLast = std::lower_bound(pFirst, pEnd, tileOrigin.y + _image.rows, compareRow);
+    paintRuns(_image, pFirst, (int) (pLast - pFirst), value[0], tileOrigin);
   }
 
 static void translateRegion(rlVec& reg, Point ptTrans)
@@ -237,6 +367,113 @@ CV_EXPORTS Mat getStructuringElement(int shape, Size ksize)
   return rlDest;
 }
 
+// computes all result chords of row i of the erosion
+static void erode_rle_row(const rlVec& regIn, const rlVec& se, const std::vector<int>& pIdxChord1,
+    const std::vector<int>& pIdxNextRow, int nMinRow, int i, std::vector<int>& pCurIdxRow, rlVec& regOut)
+{
+  using namespace std;
+
+    int nMinRowSE = se[0].r;
+    int nRowsSE = (int) se.size();
+    int j;
+
+    // check whether all relevant rows are available
+    bool bNextRow = false;
+
+    for (j=0; j < nRowsSE; j++)
+    {
+        // get idx of first chord in regIn for this row of the se
+        pCurIdxRow[j] = pIdxChord1[ j + nMinRowSE + i - nMinRow];
+        if (pCurIdxRow[j] == -1)
+            return;
+    }
+
+    while (!bNextRow)
+    {
+      int nPossibleStart = std::numeric_limits<int>::min();
+
+      // search for row with max( cb - se.cb) (the leftmost possible position of a result chord
+      for (j=0;j<nRowsSE;j++)
+          nPossibleStart = max(nPossibleStart, regIn[pCurIdxRow[j]].cb - se[j].cb);
+
+      // for all rows skip chords whose end is left from the point
+      // where it can contribute to a result
+      bool bHaveResult = true;
+      int nLimitingRow = 0;
+      int nChordEnd = std::numeric_limits<int>::max(); //INT_MAX;
+
+      for (j=0;j<nRowsSE;j++)
+      {
+          while (pCurIdxRow[j] != pIdxNextRow[j + nMinRowSE + i - nMinRow] &&
+              regIn[pCurIdxRow[j]].ce < nPossibleStart + se[j].ce)
+          {
+              pCurIdxRow[j]++;
+          }
+
+          // if all chords in this row skipped -> next row
+          if (pCurIdxRow[j] == pIdxNextRow[ j + nMinRowSE + i - nMinRow])
+          {
+              bNextRow = true;
+              bHaveResult = false;
+              break;
+          }
+          else if ( bHaveResult )
+          {
+          // can the found chord contribute to a result ?
+          if (regIn[ pCurIdxRow[j] ].cb - se[j].cb <= nPossibleStart)
+          {
+              int nCurPossibleEnd = regIn[ pCurIdxRow[j] ].ce - se[j].ce;
+              if (nCurPossibleEnd < nChordEnd)
+              {
+                  nChordEnd = nCurPossibleEnd;
+                  nLimitingRow = j;
+              }
+          }
+          else
+              bHaveResult = false;
+          }
+      }
+
+    if (bHaveResult)
+    {
+        regOut.push_back(rlType(nPossibleStart, nChordEnd, i));
+        pCurIdxRow[nLimitingRow]++;
+
+        if (pCurIdxRow[nLimitingRow] == pIdxNextRow[ nLimitingRow + nMinRowSE + i - nMinRow])
+              bNextRow = true;
+    }
+    } // end while (!bNextRow
+}
+
+class ErodeInvoker : public ParallelLoopBody
+{
+public:
+  ErodeInvoker(const rlVec& regIn, const rlVec& se, const std::vector<int>& pIdxChord1,
+      const std::vector<int>& pIdxNextRow, int nMinRow, Range rows, std::vector<rlVec>& stripes)
+    : regIn_(regIn), se_(se), pIdxChord1_(pIdxChord1), pIdxNextRow_(pIdxNextRow), nMinRow_(nMinRow),
+      rows_(rows), stripes_(stripes) { }
+
+  void operator()(const Range& range) const CV_OVERRIDE
+  {
+    std::vector<int> pCurIdxRow(se_.size());
+    for (int nStripe = range.start; nStripe < range.end; ++nStripe)
+    {
+      Range rows = getStripeRows(rows_.start, rows_.size(), (int) stripes_.size(), nStripe);
+      for (int i = rows.start; i < rows.end; ++i)
+        erode_rle_row(regIn_, se_, pIdxChord1_, pIdxNextRow_, nMinRow_, i, pCurIdxRow, stripes_[nStripe]);
+    }
+  }
+
+private:
+  const rlVec& regIn_;
+  const rlVec& se_;
+  const std::vector<int>& pIdxChord1_;
+  const std::vector<int>& pIdxNextRow_;
+  int nMinRow_;
+  Range rows_;
+  std::vector<rlVec>& stripes_;
+};
+
 static void erode_rle (rlVec& regIn, rlVec& regOut, rlVec& se)
 {
   using namespace std;
@@ -258,7 +495,7 @@ static void erode_rle (rlVec& regIn, rlVec& regOut, rlVec& se)
     vector<int> pIdxChord1(nRows);
     vector<int> pIdxNextRow(nRows);
 
-    int i,j;
+    int i;
 
     for (i=1;i<nRows;i++)
     {
@@ -283,85 +520,23 @@ static void erode_rle (rlVec& regIn, rlVec& regOut, rlVec& se)
 
     assert(nRowsSE == (int) se.size());
 
-    vector<int> pCurIdxRow(nRowsSE);
+    // all possible rows; each of them can be computed independently
+    Range rows(nMinRow - nMinRowSE, nMaxRow - nMaxRowSE + 1);
+    if (rows.size() <= 0)
+        return;
 
-    // loop through all possible rows
-    for (i=nMinRow - nMinRowSE; i<= nMaxRow - nMaxRowSE; i++)
+    int nStripes = getNumRowStripes(rows.size(), regIn.size() * nRowsSE);
+    if (nStripes == 1)
     {
-        // check whether all relevant rows are available
-        bool bNextRow = false;
-
-        for (j=0; j < nRowsSE; j++)
-        {
-            // get idx of first chord in regIn for this row of the se
-            pCurIdxRow[j] = pIdxChord1[ j + nMinRowSE + i - nMinRow];
-            if (pCurIdxRow[j] == -1)
-            {
-                bNextRow = true;
-                break;
-            }
-        }
-
-        if (bNextRow)
-            continue;
-
-        while (!bNextRow)
-        {
-          int nPossibleStart = std::numeric_limits<int>::min();
-
-          // search for row with max( cb - se.cb) (the leftmost possible position of a result chord
-          for (j=0;j<nRowsSE;j++)
-              nPossibleStart = max(nPossibleStart, regIn[pCurIdxRow[j]].cb - se[j].cb);
-
-          // for all rows skip chords whose end is left from the point
-          // where it can contribute to a result
-          bool bHaveResult = true;
-          int nLimitingRow = 0;
-          int nChordEnd = std::numeric_limits<int>::max(); //INT_MAX;
-
-          for (j=0;j<nRowsSE;j++)
-          {
-              while (regIn[pCurIdxRow[j]].ce < nPossibleStart + se[j].ce &&
-                  pCurIdxRow[j] != pIdxNextRow[j + nMinRowSE + i - nMinRow])
-              {
-                  pCurIdxRow[j]++;
-              }
-
-              // if all chords in this row skipped -> next row
-              if (pCurIdxRow[j] == pIdxNextRow[ j + nMinRowSE + i - nMinRow])
-              {
-                  bNextRow = true;
-                  bHaveResult = false;
-                  break;
-              }
-              else if ( bHaveResult )
-              {
-              // can the found chord contribute to a result ?
-              if (regIn[ pCurIdxRow[j] ].cb - se[j].cb <= nPossibleStart)
-              {
-                  int nCurPossibleEnd = regIn[ pCurIdxRow[j] ].ce - se[j].ce;
-                  if (nCurPossibleEnd < nChordEnd)
-                  {
-                      nChordEnd = nCurPossibleEnd;
-                      nLimitingRow = j;
-                  }
-              }
-              else
-                  bHaveResult = false;
-              }
-          }
-
-        if (bHaveResult)
-        {
-            regOut.push_back(rlType(nPossibleStart, nChordEnd, i));
-            pCurIdxRow[nLimitingRow]++;
-
-            if (pCurIdxRow[nLimitingRow] == pIdxNextRow[ nLimitingRow + nMinRowSE + i - nMinRow])
-                  bNextRow = true;
-        }
-        } // end while (!bNextRow
-    } // end for
+        vector<int> pCurIdxRow(nRowsSE);
+        for (i = rows.start; i < rows.end; i++)
+            erode_rle_row(regIn, se, pIdxChord1, pIdxNextRow, nMinRow, i, pCurIdxRow, regOut);
+        return;
+    }
 
+    vector<rlVec> stripes(nStripes);
+    parallel_for_(Range(0, nStripes), ErodeInvoker(regIn, se, pIdxChord1, pIdxNextRow, nMinRow, rows, stripes));
+    concatStripes(stripes, regOut);
 }
 
 static void convertInputArrayToRuns(InputArray& theArray, rlVec& runs, Size& theSize)
@@ -700,6 +875,66 @@ CV_EXPORTS bool isRLMorphologyPossible(InputArray rlStructuringElement)
   return true;
 }
 
+CV_EXPORTS void thresholdStrip(InputArray strip, InputOutputArray rlDest, double thresh, int type)
+{
+    CV_INSTRUMENT_REGION();
+
+    Mat image = strip.getMat();
+    CV_Assert(!image.empty() && image.channels() == 1);
+    CV_Assert(type == THRESH_BINARY || type == THRESH_BINARY_INV);
+
+    Size size(image.cols, 0);
+    bool bAppendToMat = (rlDest.kind() == _InputArray::MAT);
+    bool bAppendToVector = (rlDest.kind() == _InputArray::STD_VECTOR && rlDest.type() == CV_32SC3);
+    if (!rlDest.empty())
+    {
+        Mat header = rlDest.getMat();
+        CV_Assert(header.checkVector(3, CV_32S) > 0);
+        Point3i pt = header.at<Point3i>(0);
+        CV_Assert(pt.x == image.cols);
+        size.height = pt.y;
+        bAppendToMat = bAppendToMat && header.cols == 1 && header.type() == CV_32SC3;
+    }
+
+    rlVec runs;
+    _threshold(image, runs, thresh, type);
+    translateRegion(runs, Point(0, size.height));
+    size.height += image.rows;
+
+    if (bAppendToMat)
+    {
+        // appending to a Mat grows its buffer geometrically, so encoding an image strip by strip
+        // does not copy the runs of the previous strips again and again
+        Mat& dest = rlDest.getMatRef();
+        if (dest.empty())
+            dest.push_back(Point3i(size.width, size.height, 0));
+        else
+            dest.at<Point3i>(0) = Point3i(size.width, size.height, 0);
+        if (!runs.empty())
+            dest.push_back(Mat((int) runs.size(), 1, CV_32SC3, &runs[0]));
+    }
+    else if (bAppendToVector)
+    {
+        // same for std::vector<Point3i>, which would otherwise be converted and copied as a whole
+        std::vector<Point3i>& dest = *(std::vector<Point3i>*) rlDest.getObj();
+        if (dest.empty())
+            dest.push_back(Point3i(size.width, size.height, 0));
+        else
+            dest[0] = Point3i(size.width, size.height, 0);
+        for (size_t i = 0; i < runs.size(); ++i)
+            dest.push_back(Point3i(runs[i].cb, runs[i].ce, runs[i].r));
+    }
+    else
+    {
+        // other array kinds are rewritten as a whole, which is quadratic in the number of strips
+        rlVec allRuns;
+        Size sizeDest;
+        convertInputArrayToRuns(rlDest, allRuns, sizeDest);
+        allRuns.insert(allRuns.end(), runs.begin(), runs.end());
+        convertToOutputArray(allRuns, size, rlDest);
+    }
+}
+
 CV_EXPORTS void createRLEImage(const std::vector<cv::Point3i>& runs, OutputArray res, Size size)
 {
     size_t nRuns = runs.size();
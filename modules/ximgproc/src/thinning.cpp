@@ -1,4 +1,5 @@
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 using namespace std;
 
@@ -91,95 +92,152 @@ static uint8_t lut_guo_iter1[] = {
     1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1,
     1, 1, 1, 1};
 
-// Applies a thinning iteration to a binary image
-static void thinningIteration(Mat img, int iter, int thinningType){
-    Mat marker = Mat::zeros(img.size(), CV_8UC1);
-    int rows = img.rows;
-    int cols = img.cols;
-    marker.col(0).setTo(1);
-    marker.col(cols - 1).setTo(1);
-    marker.row(0).setTo(1);
-    marker.row(rows - 1).setTo(1);
-
-    if(thinningType == THINNING_ZHANGSUEN){
-        marker.forEach<uchar>([=](uchar& value, const int postion[]) {
-            int i = postion[0];
-            int j = postion[1];
-            if (i == 0 || j == 0 || i == rows - 1 || j == cols - 1)
-                return;
-
-            auto ptr = img.ptr(i, j); // p1
-
-            // p9 p2 p3
-            // p8 p1 p4
-            // p7 p6 p5
-            uchar p2 = ptr[-cols];
-            uchar p3 = ptr[-cols + 1];
-            uchar p4 = ptr[1];
-            uchar p5 = ptr[cols + 1];
-            uchar p6 = ptr[cols];
-            uchar p7 = ptr[cols - 1];
-            uchar p8 = ptr[-1];
-            uchar p9 = ptr[-cols - 1];
-
-            int neighbors = p9 | (p2 << 1) | (p3 << 2) | (p4 << 3) | (p5 << 4) | (p6 << 5) | (p7 << 6) | (p8 << 7);
-
-            if (iter == 0)
-                value = lut_zhang_iter0[neighbors];
-            else
-                value = lut_zhang_iter1[neighbors];
-
-            //int A  = (p2 == 0 && p3 == 1) + (p3 == 0 && p4 == 1) +
-            //         (p4 == 0 && p5 == 1) + (p5 == 0 && p6 == 1) +
-            //         (p6 == 0 && p7 == 1) + (p7 == 0 && p8 == 1) +
-            //         (p8 == 0 && p9 == 1) + (p9 == 0 && p2 == 1);
-            //int B  = p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9;
-            //int m1 = iter == 0 ? (p2 * p4 * p6) : (p2 * p4 * p8);
-            //int m2 = iter == 0 ? (p4 * p6 * p8) : (p2 * p6 * p8);
-            //if (A == 1 && (B >= 2 && B <= 6) && m1 == 0 && m2 == 0) value = 0;
-            // else value = 1;
-        });
+// Index into the look up tables for the neighbors of pixel p1 (all pixels are 0 or 1):
+// p9 p2 p3
+// p8 p1 p4
+// p7 p6 p5
+static inline int neighborhoodIndex(const uchar* prev, const uchar* cur, const uchar* next, int j)
+{
+    return prev[j - 1] | (prev[j] << 1) | (prev[j + 1] << 2) | (cur[j + 1] << 3) |
+           (next[j + 1] << 4) | (next[j] << 5) | (next[j - 1] << 6) | (cur[j - 1] << 7);
+}
+
+// Collects the pixels of one row which are removed by a thinning sub-iteration.
+//
+// Zhang-Suen:
+//   A  = (p2 == 0 && p3 == 1) + (p3 == 0 && p4 == 1) + (p4 == 0 && p5 == 1) + (p5 == 0 && p6 == 1) +
+//        (p6 == 0 && p7 == 1) + (p7 == 0 && p8 == 1) + (p8 == 0 && p9 == 1) + (p9 == 0 && p2 == 1);
+//   B  = p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9;
+//   m1 = iter == 0 ? (p2 * p4 * p6) : (p2 * p4 * p8);
+//   m2 = iter == 0 ? (p4 * p6 * p8) : (p2 * p6 * p8);
+//   p1 is removed if A == 1 && (B >= 2 && B <= 6) && m1 == 0 && m2 == 0
+// Guo-Hall:
+//   C  = ((!p2) & (p3 | p4)) + ((!p4) & (p5 | p6)) + ((!p6) & (p7 | p8)) + ((!p8) & (p9 | p2));
+//   N1 = (p9 | p2) + (p3 | p4) + (p5 | p6) + (p7 | p8);
+//   N2 = (p2 | p3) + (p4 | p5) + (p6 | p7) + (p8 | p9);
+//   N  = N1 < N2 ? N1 : N2;
+//   m  = iter == 0 ? ((p6 | p7 | (!p9)) & p8) : ((p2 | p3 | (!p5)) & p4);
+//   p1 is removed if C == 1 && (N >= 2 && N <= 3) && m == 0
+static void thinningRow(const uchar* prev, const uchar* cur, const uchar* next, int begin, int end,
+                        const uint8_t* lut, std::vector<int>& removed)
+{
+    int j = begin;
+#if CV_SIMD128
+    // Only pixels which are set and have at least one unset neighbor can be removed, so blocks
+    // without such pixels are skipped. The index is built with additions only, as the image is binary.
+    const v_uint8x16 v_zero = v_setzero_u8(), v_interior = v_setall_u8(255);
+    uchar indices[v_uint8x16::nlanes];
+    for (; j <= end - v_uint8x16::nlanes; j += v_uint8x16::nlanes)
+    {
+        v_uint8x16 p1 = v_load(cur + j);
+        if (!v_check_any(v_gt(p1, v_zero)))
+            continue;
+
+        v_uint8x16 index = v_load(cur + j - 1);
+        index = v_add(v_add(index, index), v_load(next + j - 1));
+        index = v_add(v_add(index, index), v_load(next + j));
+        index = v_add(v_add(index, index), v_load(next + j + 1));
+        index = v_add(v_add(index, index), v_load(cur + j + 1));
+        index = v_add(v_add(index, index), v_load(prev + j + 1));
+        index = v_add(v_add(index, index), v_load(prev + j));
+        index = v_add(v_add(index, index), v_load(prev + j - 1));
+        if (!v_check_any(v_and(v_gt(p1, v_zero), v_ne(index, v_interior))))
+            continue;
+
+        v_store(indices, index);
+        for (int k = 0; k < v_uint8x16::nlanes; k++)
+        {
+            if (cur[j + k] && !lut[indices[k]])
+                removed.push_back(j + k);
+        }
     }
-    if(thinningType == THINNING_GUOHALL){
-        marker.forEach<uchar>([=](uchar& value, const int postion[]) {
-            int i = postion[0];
-            int j = postion[1];
-            if (i == 0 || j == 0 || i == rows - 1 || j == cols - 1)
-                return;
-
-            auto ptr = img.ptr(i, j); // p1
-
-            // p9 p2 p3
-            // p8 p1 p4
-            // p7 p6 p5
-            uchar p2 = ptr[-cols];
-            uchar p3 = ptr[-cols + 1];
-            uchar p4 = ptr[1];
-            uchar p5 = ptr[cols + 1];
-            uchar p6 = ptr[cols];
-            uchar p7 = ptr[cols - 1];
-            uchar p8 = ptr[-1];
-            uchar p9 = ptr[-cols - 1];
-
-            int neighbors = p9 | (p2 << 1) | (p3 << 2) | (p4 << 3) | (p5 << 4) | (p6 << 5) | (p7 << 6) | (p8 << 7);
-
-            if (iter == 0)
-                value = lut_guo_iter0[neighbors];
-            else
-                value = lut_guo_iter1[neighbors];
-
-            //int C  = ((!p2) & (p3 | p4)) + ((!p4) & (p5 | p6)) +
-            //         ((!p6) & (p7 | p8)) + ((!p8) & (p9 | p2));
-            //int N1 = (p9 | p2) + (p3 | p4) + (p5 | p6) + (p7 | p8);
-            //int N2 = (p2 | p3) + (p4 | p5) + (p6 | p7) + (p8 | p9);
-            //int N  = N1 < N2 ? N1 : N2;
-            //int m  = iter == 0 ? ((p6 | p7 | (!p9)) & p8) : ((p2 | p3 | (!p5)) & p4);
-            //if ((C == 1) && ((N >= 2) && ((N <= 3)) & (m == 0))) value = 0;
-            // else value = 1;
-        });
+#endif
+    for (; j < end; j++)
+    {
+        if (cur[j] && !lut[neighborhoodIndex(prev, cur, next, j)])
+            removed.push_back(j);
     }
+}
+
+// Evaluates a thinning sub-iteration for all rows with a non-empty active span.
+// A pixel can only be removed if its neighborhood changed during the previous two sub-iterations:
+// otherwise the same look up table already kept it two sub-iterations ago. So each row is visited
+// only in the span covered by the changes of itself and its neighbor rows.
+class ThinningIterationInvoker : public ParallelLoopBody
+{
+public:
+    ThinningIterationInvoker(const Mat& img, const uint8_t* lut, const std::vector<Range>* changed,
+                             std::vector<std::vector<int> >& removed)
+        : img_(img), lut_(lut), changed_(changed), removed_(removed) { }
+
+    void operator()(const Range& range) const CV_OVERRIDE
+    {
+        for (int i = range.start; i < range.end; i++)
+        {
+            removed_[i].clear();
+
+            int begin = img_.cols, end = 0;
+            for (int k = 0; k < 2; k++)
+            {
+                for (int r = i - 1; r <= i + 1; r++)
+                {
+                    const Range& span = changed_[k][r];
+                    if (span.start < span.end)
+                    {
+                        begin = std::min(begin, span.start - 1);
+                        end = std::max(end, span.end + 1);
+                    }
+                }
+            }
+            begin = std::max(begin, 1);
+            end = std::min(end, img_.cols - 1);
+            if (begin >= end)
+                continue;
 
-    img &= marker;
+            thinningRow(img_.ptr(i - 1), img_.ptr(i), img_.ptr(i + 1), begin, end, lut_, removed_[i]);
+        }
+    }
+
+private:
+    const Mat& img_;
+    const uint8_t* lut_;
+    const std::vector<Range>* changed_;
+    std::vector<std::vector<int> >& removed_;
+};
+
+// Applies a thinning iteration to a binary image, the columns changed in each row are stored in changed.
+// Returns whether any pixel was removed.
+static bool thinningIteration(Mat& img, int iter, int thinningType, std::vector<Range>* changed,
+                              std::vector<std::vector<int> >& removed)
+{
+    const uint8_t* lut;
+    if (thinningType == THINNING_ZHANGSUEN)
+        lut = iter == 0 ? lut_zhang_iter0 : lut_zhang_iter1;
+    else
+        lut = iter == 0 ? lut_guo_iter0 : lut_guo_iter1;
+
+    // all removals are decided on the image as it was before this sub-iteration,
+    // so they are collected first and applied afterwards
+    parallel_for_(Range(1, img.rows - 1), ThinningIterationInvoker(img, lut, changed, removed));
+
+    bool anyRemoved = false;
+    std::vector<Range>& changedNow = changed[iter];
+    for (int i = 1; i < img.rows - 1; i++)
+    {
+        const std::vector<int>& removedRow = removed[i];
+        if (removedRow.empty())
+        {
+            changedNow[i] = Range(0, 0);
+            continue;
+        }
+
+        uchar* row = img.ptr(i);
+        for (size_t k = 0; k < removedRow.size(); k++)
+            row[removedRow[k]] = 0;
+        changedNow[i] = Range(removedRow.front(), removedRow.back() + 1);
+        anyRemoved = true;
+    }
+    return anyRemoved;
 }
 
 // Apply the thinning procedure to a given image
@@ -189,17 +247,22 @@ void thinning(InputArray input, OutputArray output, int thinningType){
     // Enforce the range of the input image to be in between 0 - 255
     processed /= 255;
 
-    Mat prev = processed.clone();
-    Mat diff;
+    if (processed.rows > 2 && processed.cols > 2)
+    {
+        // the first two sub-iterations have to visit all pixels
+        std::vector<Range> changed[2];
+        changed[0].assign(processed.rows, Range(0, processed.cols));
+        changed[1].assign(processed.rows, Range(0, processed.cols));
+        changed[0].front() = changed[0].back() = changed[1].front() = changed[1].back() = Range(0, 0);
+        std::vector<std::vector<int> > removed(processed.rows);
 
-    do {
-        thinningIteration(processed, 0, thinningType);
-        thinningIteration(processed, 1, thinningType);
-        absdiff(processed, prev, diff);
-        if (!hasNonZero(diff)) break;
-        processed.copyTo(prev);
+        bool anyRemoved;
+        do {
+            anyRemoved = thinningIteration(processed, 0, thinningType, changed, removed);
+            anyRemoved = thinningIteration(processed, 1, thinningType, changed, removed) || anyRemoved;
+        }
+        while (anyRemoved);
     }
-    while (true);
 
     processed *= 255;
 
@@ -40,4 +40,54 @@ TEST(FindEllipsesTest, EllipsesOnly)
         EXPECT_TRUE(has_match) << "Wrong ellipse center:" << Point2f(ell[0], ell[1]);
     }
 }
+
+static Mat loadEllipsesImage()
+{
+    std::string filename = cvtest::TS::ptr()->get_data_path() + "cv/imgproc/stuff.jpg";
+    Mat src = imread(filename, IMREAD_GRAYSCALE);
+    EXPECT_FALSE(src.empty()) << "Invalid test image: " << filename;
+    return src;
+}
+
+static std::vector<Vec6f> findEllipsesWithThreads(const Mat& src, int threads, int maxCandidates)
+{
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    std::vector<Vec6f> ells;
+    // findEllipses smooths a single channel input in place
+    ximgproc::findEllipses(src.clone(), ells, 0.7f, 0.5f, 0.05f, maxCandidates);
+    setNumThreads(prevThreads);
+    return ells;
+}
+
+TEST(FindEllipsesTest, SameResultForAnyNumberOfThreads)
+{
+    Mat src = loadEllipsesImage();
+    ASSERT_FALSE(src.empty());
+
+    for (int maxCandidates : {0, 20})
+    {
+        std::vector<Vec6f> ref = findEllipsesWithThreads(src, 1, maxCandidates);
+        std::vector<Vec6f> ells = findEllipsesWithThreads(src, getNumThreads(), maxCandidates);
+        ASSERT_EQ(ref.size(), ells.size()) << "maxCandidates = " << maxCandidates;
+        for (size_t i = 0; i < ref.size(); i++)
+            EXPECT_EQ(0, cvtest::norm(ref[i], ells[i], NORM_INF)) << "maxCandidates = " << maxCandidates << ", ellipse " << i;
+    }
+}
+
+TEST(FindEllipsesTest, CandidateLimit)
+{
+    Mat src = loadEllipsesImage();
+    ASSERT_FALSE(src.empty());
+
+    std::vector<Vec6f> unlimited = findEllipsesWithThreads(src, getNumThreads(), 0);
+    std::vector<Vec6f> large = findEllipsesWithThreads(src, getNumThreads(), INT_MAX);
+    ASSERT_EQ(unlimited.size(), large.size());
+    for (size_t i = 0; i < unlimited.size(); i++)
+        EXPECT_EQ(0, cvtest::norm(unlimited[i], large[i], NORM_INF)) << "ellipse " << i;
+
+    // each validated candidate yields at most one ellipse
+    std::vector<Vec6f> bounded = findEllipsesWithThreads(src, getNumThreads(), 5);
+    EXPECT_LE(bounded.size(), size_t(5));
+}
 }}
\ No newline at end of file
@@ -245,5 +245,58 @@ TEST_P(RL_Paint, same_result)
 
 INSTANTIATE_TEST_CASE_P(TypicalSET, RL_Paint, Values(CV_8U, CV_16U, CV_16S, CV_32F, CV_64F));
 
+class RL_Streaming : public RLTestBase, public testing::Test
+{
+public:
+    RL_Streaming() { }
+protected:
+    virtual void SetUp() { setUp_impl(); }
+};
+
+TEST_F(RL_Streaming, threshold_strips)
+{
+    Mat theRandom;
+    generateRandomImage(theRandom);
+    Mat rlFull;
+    rl::threshold(theRandom, rlFull, 200.0, THRESH_BINARY_INV);
+
+    Mat rlStrips;
+    std::vector<Point3i> rlStripsVec;
+    const int stripHeights[] = { 1, 37, 100, 2, 150 };
+    for (int y = 0, i = 0; y < theRandom.rows; ++i)
+    {
+        Mat strip = theRandom.rowRange(y, std::min(y + stripHeights[i % 5], theRandom.rows));
+        rl::thresholdStrip(strip, rlStrips, 200.0, THRESH_BINARY_INV);
+        rl::thresholdStrip(strip, rlStripsVec, 200.0, THRESH_BINARY_INV);
+        y += strip.rows;
+    }
+
+    ASSERT_EQ(rlFull.total(), rlStrips.total());
+    EXPECT_EQ(0, cvtest::norm(rlFull.reshape(1), rlStrips.reshape(1), NORM_INF));
+    ASSERT_EQ(rlFull.total(), rlStripsVec.size());
+    EXPECT_EQ(0, cvtest::norm(rlFull.reshape(1), Mat(rlStripsVec).reshape(1), NORM_INF));
+}
+
+TEST_F(RL_Streaming, paint_tiles)
+{
+    Mat painted = Mat::zeros(img_size, CV_8UC1);
+    rl::paint(painted, test_image_rle[1], Scalar(255.0));
+
+    const Size tileSize(128, 70);
+    for (int y = -10; y < img_size.height; y += tileSize.height)
+    {
+        for (int x = -30; x < img_size.width; x += tileSize.width)
+        {
+            Mat tile = Mat::zeros(tileSize, CV_8UC1);
+            rl::paintTile(tile, test_image_rle[1], Scalar(255.0), Point(x, y));
+
+            Rect roi = Rect(Point(x, y), tileSize) & Rect(Point(0, 0), img_size);
+            Mat expected = Mat::zeros(tileSize, CV_8UC1);
+            painted(roi).copyTo(expected(roi - Point(x, y)));
+            ASSERT_TRUE(arePixelImagesIdentical(expected, tile)) << "tile at " << Point(x, y);
+        }
+    }
+}
+
 }
 }
\ No newline at end of file
@@ -54,4 +54,84 @@ TEST(ximgproc_Thinning, simple_GUOHALL)
 }
 
 
+// Straightforward implementation of the thinning rules, every sub-iteration visits all pixels
+static void thinningReference(const Mat1b& src, Mat1b& dst, int thinningType)
+{
+    dst = src / 255;
+    Mat1b marker;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int iter = 0; iter < 2; iter++)
+        {
+            marker = Mat1b::ones(dst.size());
+            for (int i = 1; i < dst.rows - 1; i++)
+            {
+                for (int j = 1; j < dst.cols - 1; j++)
+                {
+                    if (!dst(i, j))
+                        continue;
+                    int p2 = dst(i - 1, j), p3 = dst(i - 1, j + 1), p4 = dst(i, j + 1), p5 = dst(i + 1, j + 1);
+                    int p6 = dst(i + 1, j), p7 = dst(i + 1, j - 1), p8 = dst(i, j - 1), p9 = dst(i - 1, j - 1);
+                    bool remove;
+                    if (thinningType == THINNING_ZHANGSUEN)
+                    {
+                        int A  = (p2 == 0 && p3 == 1) + (p3 == 0 && p4 == 1) + (p4 == 0 && p5 == 1) + (p5 == 0 && p6 == 1) +
+                                 (p6 == 0 && p7 == 1) + (p7 == 0 && p8 == 1) + (p8 == 0 && p9 == 1) + (p9 == 0 && p2 == 1);
+                        int B  = p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9;
+                        int m1 = iter == 0 ? (p2 * p4 * p6) : (p2 * p4 * p8);
+                        int m2 = iter == 0 ? (p4 * p6 * p8) : (p2 * p6 * p8);
+                        remove = A == 1 && B >= 2 && B <= 6 && m1 == 0 && m2 == 0;
+                    }
+                    else
+                    {
+                        int C  = ((!p2) & (p3 | p4)) + ((!p4) & (p5 | p6)) + ((!p6) & (p7 | p8)) + ((!p8) & (p9 | p2));
+                        int N1 = (p9 | p2) + (p3 | p4) + (p5 | p6) + (p7 | p8);
+                        int N2 = (p2 | p3) + (p4 | p5) + (p6 | p7) + (p8 | p9);
+                        int N  = N1 < N2 ? N1 : N2;
+                        int m  = iter == 0 ? ((p6 | p7 | (!p9)) & p8) : ((p2 | p3 | (!p5)) & p4);
+                        remove = C == 1 && N >= 2 && N <= 3 && m == 0;
+                    }
+                    if (remove)
+                    {
+                        marker(i, j) = 0;
+                        changed = true;
+                    }
+                }
+            }
+            dst &= marker;
+        }
+    }
+    dst *= 255;
+}
+
+typedef testing::TestWithParam<int> ximgproc_Thinning_Reference;
+
+TEST_P(ximgproc_Thinning_Reference, matches_reference)
+{
+    const int thinningType = GetParam();
+    RNG& rng = theRNG();
+    // the 209 interior columns are not a multiple of the 16 pixel blocks of thinningRow,
+    // so the scalar loop also runs on the spans that reach the right border
+    Mat1b src = Mat1b::zeros(Size(211, 157));
+    for (int k = 0; k < 12; k++)
+    {
+        Point center(rng.uniform(0, src.cols), rng.uniform(0, src.rows));
+        Size axes(rng.uniform(3, 40), rng.uniform(3, 40));
+        ellipse(src, center, axes, rng.uniform(0, 180), 0, 360, Scalar(255), k % 3 == 0 ? FILLED : rng.uniform(1, 12));
+    }
+    Mat1b noise(src.size());
+    rng.fill(noise, RNG::UNIFORM, 0, 256);
+    src.setTo(255, noise > 250);
+
+    Mat1b dst, ref;
+    thinning(src, dst, thinningType);
+    thinningReference(src, ref, thinningType);
+    EXPECT_EQ(0, cvtest::norm(dst, ref, NORM_INF));
+}
+
+INSTANTIATE_TEST_CASE_P(/**/, ximgproc_Thinning_Reference, testing::Values(THINNING_ZHANGSUEN, THINNING_GUOHALL));
+
+
 }} // namespace
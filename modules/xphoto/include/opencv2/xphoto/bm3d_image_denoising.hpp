@@ -179,6 +179,61 @@ namespace cv
             int normType = cv::NORM_L2,
             int step = cv::xphoto::BM3D_STEPALL,
             int transformType = cv::xphoto::HAAR);
+
+        /** @brief BM3D denoiser for image sequences.
+
+        The denoiser keeps its block matching and aggregation buffers between calls, so consecutive
+        frames do not allocate them again. The 2D transforms of all blocks of a frame are computed
+        once and kept together with the frame.
+
+        With a temporal window larger than one frame, the blocks of every frame are also matched
+        against the previous frames of the window, as in VBM3D. Similar blocks of the previous frames
+        take part in the collaborative filtering of the current frame, only the blocks of the current
+        frame are aggregated into the result. With a window of one frame, the result is the same
+        as the one of bm3dDenoising with BM3D_STEPALL.
+
+        The window holds, for every frame, the bordered frame and its basic estimate, and the
+        transforms of their blocks, i.e. 2*templateWindowSize^2 coefficients per pixel.
+        */
+        class CV_EXPORTS_W Bm3dDenoiser : public Algorithm
+        {
+        public:
+            /** @brief Denoises the next frame of the sequence.
+
+            @param src Input 8-bit or 16-bit 1-channel frame. A frame with a different size or type than
+            the previous one starts a new sequence.
+            @param dst Output frame with the same size and type as src.
+            */
+            CV_WRAP virtual void denoise(InputArray src, OutputArray dst) = 0;
+
+            /** @brief Forgets the previous frames, the next frame starts a new sequence. */
+            CV_WRAP virtual void reset() = 0;
+
+            /** @brief Number of frames the blocks are searched in, including the current one. */
+            CV_WRAP virtual int getTemporalWindowSize() const = 0;
+            /** @copybrief getTemporalWindowSize @see getTemporalWindowSize */
+            CV_WRAP virtual void setTemporalWindowSize(int temporalWindowSize) = 0;
+        };
+
+        /** @brief Creates a BM3D denoiser for image sequences.
+
+        The parameters have the same meaning as the ones of bm3dDenoising.
+        @param temporalWindowSize Number of frames the blocks are searched in, i.e. the current frame
+        and the temporalWindowSize-1 previous ones.
+
+        @sa bm3dDenoising
+        */
+        CV_EXPORTS_W Ptr<Bm3dDenoiser> createBm3dDenoiser(
+            float h = 1,
+            int templateWindowSize = 4,
+            int searchWindowSize = 16,
+            int blockMatchingStep1 = 2500,
+            int blockMatchingStep2 = 400,
+            int groupSize = 8,
+            int slidingStep = 1,
+            float beta = 2.0f,
+            int normType = cv::NORM_L2,
+            int temporalWindowSize = 1);
         //! @}
     }
 }
@@ -12,10 +12,22 @@ namespace cv { namespace xphoto {
 //! @addtogroup xphoto
 //! @{
 
+//! Filters used by TonemapDurand to extract the base layer
+enum TonemapDurandFilters
+{
+    /** Bilateral filter, see cv::bilateralFilter */
+    TONEMAP_DURAND_BILATERAL = 0,
+    /** Guided filter of the luminance computed on a downsampled image and upsampled back
+    (K. He, J. Sun, Fast Guided Filter, 2015). Approximates the bilateral filter with a cost
+    that does not depend on the filter size. */
+    TONEMAP_DURAND_FAST_GUIDED = 1
+};
+
 /** @brief This algorithm decomposes image into two layers: base layer and detail layer using bilateral filter
 and compresses contrast of the base layer thus preserving all the details.
 
-This implementation uses regular bilateral filter from OpenCV.
+This implementation uses regular bilateral filter from OpenCV by default. A faster approximation
+can be selected with setFilterType, see cv::xphoto::TonemapDurandFilters.
 
 Saturation enhancement is possible as in cv::TonemapDrago.
 
@@ -36,6 +48,11 @@ public:
 
     CV_WRAP virtual float getSigmaColor() const = 0;
     CV_WRAP virtual void setSigmaColor(float sigma_color) = 0;
+
+    /** @brief Filter used to extract the base layer, see cv::xphoto::TonemapDurandFilters */
+    CV_WRAP virtual int getFilterType() const = 0;
+    /** @copybrief getFilterType @see getFilterType */
+    CV_WRAP virtual void setFilterType(int filter_type) = 0;
 };
 
 /** @brief Creates TonemapDurand object
@@ -0,0 +1,64 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+#ifdef OPENCV_ENABLE_NONFREE
+
+namespace opencv_test { namespace {
+
+typedef tuple<Size, int> Size_TemplateWindow_t;
+typedef perf::TestBaseWithParam<Size_TemplateWindow_t> Size_TemplateWindow;
+
+PERF_TEST_P( Size_TemplateWindow, bm3dDenoising,
+    testing::Combine(
+        testing::Values( sz480p, sz720p ),
+        testing::Values( 4, 8 )
+    )
+)
+{
+    Size size = get<0>(GetParam());
+    int templateWindowSize = get<1>(GetParam());
+
+    Mat src(size, CV_8UC1);
+    Mat dst(size, CV_8UC1);
+
+    declare.in(src, WARMUP_RNG).out(dst);
+
+    TEST_CYCLE() xphoto::bm3dDenoising(src, dst, 10, templateWindowSize, 16, 2500, 400, 8, 1, 2.0f);
+
+    SANITY_CHECK_NOTHING();
+}
+
+typedef tuple<Size, int> Size_TemporalWindow_t;
+typedef perf::TestBaseWithParam<Size_TemporalWindow_t> Size_TemporalWindow;
+
+PERF_TEST_P( Size_TemporalWindow, bm3dDenoiser,
+    testing::Combine(
+        testing::Values( sz480p, sz720p ),
+        testing::Values( 1, 3 )
+    )
+)
+{
+    Size size = get<0>(GetParam());
+    int temporalWindowSize = get<1>(GetParam());
+
+    Mat src(size, CV_8UC1);
+    Mat dst(size, CV_8UC1);
+
+    declare.in(src, WARMUP_RNG).out(dst);
+    Ptr<xphoto::Bm3dDenoiser> denoiser = xphoto::createBm3dDenoiser(10);
+    denoiser->setTemporalWindowSize(temporalWindowSize);
+
+    // Fill the temporal window, so that every measured frame searches all of it
+    for (int i = 1; i < temporalWindowSize; ++i)
+        denoiser->denoise(src, dst);
+
+    TEST_CYCLE() denoiser->denoise(src, dst);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
+
+#endif  // OPENCV_ENABLE_NONFREE
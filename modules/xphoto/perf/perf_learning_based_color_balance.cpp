@@ -8,7 +8,7 @@ namespace opencv_test { namespace {
 typedef tuple<Size, MatType> learningBasedWBParams;
 typedef perf::TestBaseWithParam<learningBasedWBParams> learningBasedWBPerfTest;
 
-PERF_TEST_P(learningBasedWBPerfTest, perf, Combine(SZ_ALL_HD, Values(CV_8UC3, CV_16UC3)))
+PERF_TEST_P(learningBasedWBPerfTest, perf, Combine(Values(sz720p, sz1080p, Size(4000, 3000)), Values(CV_8UC3, CV_16UC3)))
 {
     Size size = get<0>(GetParam());
     MatType t = get<1>(GetParam());
@@ -0,0 +1,45 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+
+#ifdef OPENCV_ENABLE_NONFREE
+
+namespace opencv_test { namespace {
+
+CV_ENUM(TonemapDurandFilter, xphoto::TONEMAP_DURAND_BILATERAL, xphoto::TONEMAP_DURAND_FAST_GUIDED)
+
+typedef tuple<Size, TonemapDurandFilter> Size_TonemapDurandFilter_t;
+typedef perf::TestBaseWithParam<Size_TonemapDurandFilter_t> Size_TonemapDurandFilter;
+
+PERF_TEST_P( Size_TonemapDurandFilter, tonemapDurand,
+    testing::Combine(
+        testing::Values( sz1080p, Size(4000, 3000) ),
+        TonemapDurandFilter::all()
+    )
+)
+{
+    Size size = get<0>(GetParam());
+    int filter_type = get<1>(GetParam());
+
+    // Smooth HDR image spanning several orders of magnitude
+    Mat src_dscl(Size(size.width / 16, size.height / 16), CV_32FC3);
+    RNG rng(1234);
+    rng.fill(src_dscl, RNG::UNIFORM, -4.0f, 2.0f);
+    exp(src_dscl, src_dscl);
+    Mat src(size, CV_32FC3);
+    resize(src_dscl, src, src.size(), 0, 0, INTER_LINEAR_EXACT);
+    Mat dst(size, CV_32FC3);
+
+    declare.in(src).out(dst);
+    Ptr<xphoto::TonemapDurand> tonemap = xphoto::createTonemapDurand(2.2f);
+    tonemap->setFilterType(filter_type);
+
+    TEST_CYCLE() tonemap->process(src, dst);
+
+    SANITY_CHECK_NOTHING();
+}
+
+}} // namespace
+
+#endif  // OPENCV_ENABLE_NONFREE
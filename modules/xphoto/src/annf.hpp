@@ -98,7 +98,7 @@ private:
     void operator =(const KDTree <Tp, cn> &) const {};
 
 public:
-    void updateDist(const int leaf, const int &idx0, int &bestIdx, double &dist);
+    void updateDist(const int leaf, const int &idx0, int &bestIdx, double &dist) const;
 
     KDTree(const cv::Mat &data, const int leafNumber = 8, const int zeroThresh = 16);
     ~KDTree(){};
@@ -131,6 +131,7 @@ KDTree(const cv::Mat &img, const int _leafNumber, const int _zeroThresh)
     int imgch = img.channels();
     CV_Assert( img.isContinuous() && imgch <= cn);
 
+    data.reserve(img.total());
     for(size_t i = 0; i < img.total(); i++)
     {
         cv::Vec<Tp, cn> v = cv::Vec<Tp, cn>::all((Tp)0);
@@ -166,13 +167,14 @@ KDTree(const cv::Mat &img, const int _leafNumber, const int _zeroThresh)
         int dimIdx = getMaxSpreadN(_left, _right);
         KDTreeComparator comp( this, dimIdx );
 
-        std::vector<int> _idx(idx.begin(), idx.end());
+        // the comparator reads idx, so the range is partitioned in a copy
+        std::vector<int> _idx(idx.begin() + _left, idx.begin() + _right);
         std::nth_element(/**/
-            _idx.begin() +  _left,
-            _idx.begin() +    nth,
-            _idx.begin() + _right, comp
+            _idx.begin(),
+            _idx.begin() + (nth - _left),
+            _idx.end(), comp
                          /**/);
-        idx = _idx;
+        std::copy(_idx.begin(), _idx.end(), idx.begin() + _left);
 
           left.push(_left); right.push(nth + 1);
         left.push(nth + 1);  right.push(_right);
@@ -180,7 +182,7 @@ KDTree(const cv::Mat &img, const int _leafNumber, const int _zeroThresh)
 }
 
 template <typename Tp, int cn> void KDTree <Tp, cn>::
-updateDist(const int leaf, const int &idx0, int &bestIdx, double &dist)
+updateDist(const int leaf, const int &idx0, int &bestIdx, double &dist) const
 {
     for (int k = nodes[leaf].x; k < nodes[leaf].y; ++k)
     {
@@ -234,23 +236,45 @@ static void dominantTransforms(const cv::Mat &img, std::vector <cv::Point2i> &tr
 
     /** Propagation-assisted kd-tree search **/
 
-    for (int i = 0; i < whs.rows; ++i)
-        for (int j = 0; j < whs.cols; ++j)
+    // every pixel is propagated from its left and top neighbors,
+    // so tiles on the same anti-diagonal are independent
+    const int tileSize = 64;
+    const int tileRows = (whs.rows + tileSize - 1)/tileSize;
+    const int tileCols = (whs.cols + tileSize - 1)/tileSize;
+
+    for (int diag = 0; diag < tileRows + tileCols - 1; ++diag)
+    {
+        const int firstTile = std::max(0, diag - tileCols + 1);
+        const int lastTile = std::min(diag, tileRows - 1);
+
+        cv::parallel_for_( cv::Range(firstTile, lastTile + 1), [&](const cv::Range &range)
         {
-            double dist = std::numeric_limits <double>::max();
-            int current = i*whs.cols + j;
-
-            int dy[] = {0, 1, 0}, dx[] = {0, 0, 1};
-            for (int k = 0; k < int( sizeof(dy)/sizeof(int) ); ++k)
-                if ( i - dy[k] >= 0 && j - dx[k] >= 0 )
-                {
-                    int neighbor = (i - dy[k])*whs.cols + (j - dx[k]);
-                    int leafIdx = (dx[k] == 0 && dy[k] == 0)
-                        ? neighbor : annf[neighbor] + dy[k]*whs.cols + dx[k];
-                    kdTree.updateDist(leafIdx, current,
-                                annf[i*whs.cols + j], dist);
-                }
-        }
+            for (int ti = range.start; ti < range.end; ++ti)
+            {
+                const int tj = diag - ti;
+                const int iEnd = std::min((ti + 1)*tileSize, whs.rows);
+                const int jEnd = std::min((tj + 1)*tileSize, whs.cols);
+
+                for (int i = ti*tileSize; i < iEnd; ++i)
+                    for (int j = tj*tileSize; j < jEnd; ++j)
+                    {
+                        double dist = std::numeric_limits <double>::max();
+                        int current = i*whs.cols + j;
+
+                        int dy[] = {0, 1, 0}, dx[] = {0, 0, 1};
+                        for (int k = 0; k < int( sizeof(dy)/sizeof(int) ); ++k)
+                            if ( i - dy[k] >= 0 && j - dx[k] >= 0 )
+                            {
+                                int neighbor = (i - dy[k])*whs.cols + (j - dx[k]);
+                                int leafIdx = (dx[k] == 0 && dy[k] == 0)
+                                    ? neighbor : annf[neighbor] + dy[k]*whs.cols + dx[k];
+                                kdTree.updateDist(leafIdx, current,
+                                            annf[i*whs.cols + j], dist);
+                            }
+                    }
+            }
+        });
+    }
 
     /** Local maxima extraction **/
 
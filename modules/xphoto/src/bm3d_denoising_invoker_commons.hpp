@@ -74,6 +74,90 @@ inline bool isPowerOf2(int x)
     return (x > 0) && !(x & (x - 1));
 }
 
+// Shifts the block matching window of one search window row by one pixel to the right:
+// the column distance sums leaving the block are replaced by those of the entering column.
+template <typename D, typename T>
+inline static void updateDistSumsRow(
+    int *distSumsRow,
+    int *colDistSumsRow,
+    int *lastColDistSumsRow,
+    const T &a_up,
+    const T &a_down,
+    const T *b_up_ptr,
+    const T *b_down_ptr,
+    const int &searchWindowSize)
+{
+    int x = 0;
+#if CV_SIMD128
+    const v_int32x4 va_up = v_setall_s32((int)a_up);
+    const v_int32x4 va_down = v_setall_s32((int)a_down);
+    for (; x <= searchWindowSize - 4; x += 4)
+    {
+        v_int32x4 colDist = v_add(v_load(lastColDistSumsRow + x),
+            D::calcUpDownDist(va_up, va_down, bm3dLoad4(b_up_ptr + x), bm3dLoad4(b_down_ptr + x)));
+        v_int32x4 dist = v_add(v_sub(v_load(distSumsRow + x), v_load(colDistSumsRow + x)), colDist);
+        v_store(colDistSumsRow + x, colDist);
+        v_store(lastColDistSumsRow + x, colDist);
+        v_store(distSumsRow + x, dist);
+    }
+#endif
+    for (; x < searchWindowSize; ++x)
+    {
+        distSumsRow[x] -= colDistSumsRow[x];
+        colDistSumsRow[x] = lastColDistSumsRow[x] +
+            D::template calcUpDownDist<T>(a_up, a_down, b_up_ptr[x], b_down_ptr[x]);
+        distSumsRow[x] += colDistSumsRow[x];
+        lastColDistSumsRow[x] = colDistSumsRow[x];
+    }
+}
+
+// Adds the block weighted by the Kaiser window to the aggregation buffers
+template <typename TT>
+inline static void aggregateBlock(
+    const TT *block,
+    const float *kaiser,
+    const float &weight,
+    float *d,
+    float *dw,
+    const int &blockSize,
+    const int &dstStep,
+    const int &weiStep)
+{
+#if CV_SIMD128
+    if ((blockSize & 3) == 0)
+    {
+        const v_float32x4 vweight = v_setall_f32(weight);
+        for (int n = 0; n < blockSize; ++n)
+        {
+            for (int m = 0; m < blockSize; m += 4)
+            {
+                v_float32x4 k = v_load(kaiser + m);
+                v_float32x4 b = v_cvt_f32(bm3dLoad4(block + m));
+                v_store(d + m, v_add(v_load(d + m), v_mul(v_mul(k, b), vweight)));
+                v_store(dw + m, v_add(v_load(dw + m), v_mul(k, vweight)));
+            }
+            block += blockSize;
+            kaiser += blockSize;
+            d += dstStep;
+            dw += weiStep;
+        }
+        return;
+    }
+#endif
+    for (int n = 0; n < blockSize; ++n)
+    {
+        for (int m = 0; m < blockSize; ++m)
+        {
+            d[m] += kaiser[m] * block[m] * weight;
+            dw[m] += kaiser[m] * weight;
+        }
+        block += blockSize;
+        kaiser += blockSize;
+        d += dstStep;
+        dw += weiStep;
+    }
+}
+
 
 template <typename T>
 inline static void shrink(T &val, T &nonZeroCount, const T &threshold)
@@ -158,6 +242,119 @@ inline static int WienerFiltering(BlockMatch<T, DT, CT> *zSrc, BlockMatch<T, DT,
     return wienerCoeffs;
 }
 
+// Border added around the frames so that every block of the search windows is inside
+inline int getBm3dBorderSize(const int &templateWindowSize, const int &searchWindowSize)
+{
+    return (searchWindowSize >> 1) + (templateWindowSize >> 1);
+}
+
+// Bordered frame of a sequence together with its basic estimate. The 2D transforms of all
+// blocks of a frame are optionally precomputed, so that the frames of a temporal window
+// do not transform the same blocks again for every group they are part of.
+struct Bm3dFrame
+{
+    Mat srcExtended;
+    Mat basicExtended;
+
+    // Transform of the block with top left corner (y, x) of the bordered frame
+    // is stored at row y, columns [x * blockSizeSq, (x + 1) * blockSizeSq)
+    Mat srcTransforms;
+    Mat basicTransforms;
+};
+
+// Block matching and aggregation buffers of one stripe. Denoisers keep one per thread,
+// so that they are allocated once for a whole sequence.
+template <typename TT, typename WT>
+struct Bm3dWorkspace
+{
+    // Accumulation buffers of the filtered blocks and of their weights
+    std::vector<WT> weightedSum;
+    std::vector<WT> weights;
+
+    // 3D groups; the second one holds the noisy blocks in the Wiener step
+    std::vector<BlockMatch<TT, int, TT> > bm;
+    std::vector<BlockMatch<TT, int, TT> > bmSec;
+    std::vector<TT> blocks;
+
+    // Moving sums of block distances for every searched frame
+    std::vector<int> distSums;
+    std::vector<int> colDistSums;
+    std::vector<int> lastColDistSums;
+
+    void create(int accumulatorSize, int numFrames, int searchWindowSize, int blockSize, int cols, bool secondGroup)
+    {
+        const int searchWindowSizeSq = searchWindowSize * searchWindowSize;
+        const int blockSizeSq = blockSize * blockSize;
+        const int maxElements = numFrames * searchWindowSizeSq;
+
+        weightedSum.assign(accumulatorSize, 0);
+        weights.assign(accumulatorSize, 0);
+
+        bm.resize(maxElements);
+        bmSec.resize(secondGroup ? maxElements : 0);
+        blocks.resize((size_t)(bm.size() + bmSec.size()) * blockSizeSq);
+        for (size_t i = 0; i < bm.size(); ++i)
+            bm[i].attach(&blocks[i * blockSizeSq]);
+        for (size_t i = 0; i < bmSec.size(); ++i)
+            bmSec[i].attach(&blocks[(bm.size() + i) * blockSizeSq]);
+
+        distSums.resize(numFrames * searchWindowSizeSq);
+        colDistSums.resize(numFrames * blockSize * searchWindowSizeSq);
+        lastColDistSums.resize((size_t)numFrames * cols * searchWindowSizeSq);
+    }
+};
+
+template <typename T, typename TT, typename TC>
+struct Bm3dBlockTransformsInvoker : public ParallelLoopBody
+{
+    Bm3dBlockTransformsInvoker(const Mat &src, Mat &dst, const int &blockSize) :
+        src_(src), dst_(dst), blockSize_(blockSize)
+    {
+    }
+
+    void operator() (const Range& range) const CV_OVERRIDE
+    {
+        const int blockSizeSq = blockSize_ * blockSize_;
+        const int step = (int)(src_.step / sizeof(T));
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const T *srcPtr = src_.ptr<T>(y);
+            TT *dstPtr = dst_.ptr<TT>(y);
+            for (int x = 0; x < dst_.cols / blockSizeSq; ++x)
+                TC::forwardTransform2D(srcPtr + x, dstPtr + x * blockSizeSq, step, blockSize_);
+        }
+    }
+
+private:
+    Bm3dBlockTransformsInvoker& operator= (const Bm3dBlockTransformsInvoker&);
+
+    const Mat &src_;
+    Mat &dst_;
+    const int blockSize_;
+};
+
+// Computes the 2D transforms of all blocks of a bordered frame
+template <typename T, typename TT, typename TC>
+inline void calcBlockTransforms(const Mat &src, Mat &dst, const int &blockSize)
+{
+    TC::RegisterTransforms2D(blockSize);
+    dst.create(src.rows - blockSize + 1, (src.cols - blockSize + 1) * blockSize * blockSize, DataType<TT>::type);
+    parallel_for_(Range(0, dst.rows), Bm3dBlockTransformsInvoker<T, TT, TC>(src, dst, blockSize));
+}
+
+// Gets the 2D transform of the block with top left corner (y, x) of a bordered frame,
+// from the precomputed transforms when there are some
+template <typename T, typename TT, typename TC>
+inline void getBlockTransform(const Mat &src, const Mat &transforms, int y, int x, TT *dst, const int &blockSize)
+{
+    if (transforms.empty())
+        TC::forwardTransform2D(src.ptr<T>(y) + x, dst, (int)(src.step / sizeof(T)), blockSize);
+    else
+    {
+        const int blockSizeSq = blockSize * blockSize;
+        memcpy(dst, transforms.ptr<TT>(y) + x * blockSizeSq, blockSizeSq * sizeof(TT));
+    }
+}
 
 }  // namespace xphoto
 }  // namespace cv
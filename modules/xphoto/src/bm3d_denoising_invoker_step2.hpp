@@ -55,10 +55,14 @@ template <typename T, typename D, typename WT, typename TT, typename TC>
 struct Bm3dDenoisingInvokerStep2 : public ParallelLoopBody
 {
 public:
+    // frames[0] holds the bordered src and basic, the others are the neighbouring frames searched
+    // for similar blocks. Workspaces are optional, stripes allocate their own buffers without them.
     Bm3dDenoisingInvokerStep2(
         const Mat& src,
-        const Mat& basic,
         Mat& dst,
+        const Bm3dFrame *frames,
+        const int &numFrames,
+        TLSData<Bm3dWorkspace<TT, WT> > *workspaces,
         const int &templateWindowSize,
         const int &searchWindowSize,
         const float &h,
@@ -75,6 +79,8 @@ private:
     void operator= (const Bm3dDenoisingInvokerStep2&);
 
     void calcDistSumsForFirstElementInRow(
+        const Mat& searchImage,
+        int frame,
         int i,
         Array2d<int>& distSums,
         Array3d<int>& colDistSums,
@@ -83,6 +89,8 @@ private:
         int &elementSize) const;
 
     void calcDistSumsForAllElementsInFirstRow(
+        const Mat& searchImage,
+        int frame,
         int i,
         int j,
         int firstColNum,
@@ -94,11 +102,17 @@ private:
 
     // Image containers
     const Mat& src_;
-    const Mat& basic_;
     Mat& dst_;
     Mat srcExtended_;
     Mat basicExtended_;
 
+    // Frames searched for similar blocks, the first one is src
+    const Bm3dFrame *frames_;
+    int numFrames_;
+
+    // Per thread buffers
+    TLSData<Bm3dWorkspace<TT, WT> > *workspaces_;
+
     // Border size of the extended src and basic images
     int borderSize_;
 
@@ -133,8 +147,10 @@ private:
 template <typename T, typename D, typename WT, typename TT, typename TC>
 Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::Bm3dDenoisingInvokerStep2(
     const Mat& src,
-    const Mat& basic,
     Mat& dst,
+    const Bm3dFrame *frames,
+    const int &numFrames,
+    TLSData<Bm3dWorkspace<TT, WT> > *workspaces,
     const int &templateWindowSize,
     const int &searchWindowSize,
     const float &h,
@@ -142,8 +158,11 @@ Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::Bm3dDenoisingInvokerStep2(
     const int &groupSize,
     const int &slidingStep,
     const float &beta) :
-    src_(src), basic_(basic), dst_(dst), groupSize_(groupSize), slidingStep_(slidingStep), thrMap_(NULL), kaiser_(NULL)
+    src_(src), dst_(dst), frames_(frames), numFrames_(numFrames), workspaces_(workspaces),
+    groupSize_(groupSize), slidingStep_(slidingStep), thrMap_(NULL), kaiser_(NULL)
 {
+    CV_Assert(numFrames > 0);
+
     groupSize_ = getLargestPowerOf2SmallerThan(groupSize);
     CV_Assert(groupSize > 0);
 
@@ -154,10 +173,12 @@ Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::Bm3dDenoisingInvokerStep2(
     templateWindowSizeSq_ = templateWindowSize_ * templateWindowSize_;
     searchWindowSizeSq_ = searchWindowSize_ * searchWindowSize_;
 
-    // Extend image to avoid border problem
-    borderSize_ = halfSearchWindowSize_ + halfTemplateWindowSize_;
-    copyMakeBorder(src_, srcExtended_, borderSize_, borderSize_, borderSize_, borderSize_, BORDER_DEFAULT);
-    copyMakeBorder(basic_, basicExtended_, borderSize_, borderSize_, borderSize_, borderSize_, BORDER_DEFAULT);
+    // Images extended to avoid border problem
+    borderSize_ = getBm3dBorderSize(templateWindowSize_, searchWindowSize_);
+    srcExtended_ = frames_[0].srcExtended;
+    basicExtended_ = frames_[0].basicExtended;
+    CV_Assert(srcExtended_.rows == src_.rows + 2 * borderSize_ && srcExtended_.cols == src_.cols + 2 * borderSize_);
+    CV_Assert(basicExtended_.size() == srcExtended_.size());
 
     // Calculate block matching threshold
     hBM_ = D::template calcBlockMatchingThreshold<int>(hBM, templateWindowSizeSq_);
@@ -182,9 +203,13 @@ inline Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::~Bm3dDenoisingInvokerStep2()
 template <typename T, typename D, typename WT, typename TT, typename TC>
 void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::operator() (const Range& range) const
 {
+    Bm3dWorkspace<TT, WT> localWorkspace;
+    Bm3dWorkspace<TT, WT> &workspace = workspaces_ ? workspaces_->getRef() : localWorkspace;
+
     const int size = (range.size() + 2 * borderSize_) * srcExtended_.cols;
-    std::vector<WT> weightedSum(size, 0.0);
-    std::vector<WT> weights(size, 0.0);
+    workspace.create(size, numFrames_, searchWindowSize_, templateWindowSize_, src_.cols, true);
+    WT *weightedSum = workspace.weightedSum.data();
+    WT *weights = workspace.weights.data();
     int row_from = range.start;
     int row_to = range.end - 1;
 
@@ -198,58 +223,53 @@ void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::operator() (const Range& range
     const int hBM = hBM_;
     const int groupSize = groupSize_;
 
-    const int step = srcExtended_.cols;
     const int dstStep = srcExtended_.cols;
     const int weiStep = srcExtended_.cols;
-    const int dstcstep = dstStep - blockSize;
-    const int weicstep = weiStep - blockSize;
 
-    // Buffer to store 3D group
-    BlockMatch<TT, int, TT> *bmBasic = new BlockMatch<TT, int, TT>[searchWindowSizeSq];
-    BlockMatch<TT, int, TT> *bmSrc = new BlockMatch<TT, int, TT>[searchWindowSizeSq];
-    for (int i = 0; i < searchWindowSizeSq; ++i)
-    {
-        bmBasic[i].init(blockSizeSq);
-        bmSrc[i].init(blockSizeSq);
-    }
+    // Buffers to store 3D groups
+    BlockMatch<TT, int, TT> *bmBasic = workspace.bm.data();
+    BlockMatch<TT, int, TT> *bmSrc = workspace.bmSec.data();
 
     // First element in a group is always the reference patch. Hence distance is 0.
     bmBasic[0](0, halfSearchWindowSize, halfSearchWindowSize);
     bmSrc[0](0, halfSearchWindowSize, halfSearchWindowSize);
 
-    // Sums of columns and rows for current pixel
-    Array2d<int> distSums(searchWindowSize, searchWindowSize);
-
-    // Sums of columns for current pixel (for lazy calc optimization)
-    Array3d<int> colDistSums(blockSize, searchWindowSize, searchWindowSize);
-
-    // Last elements of column sum (for each element in a row)
-    Array3d<int> lastColDistSums(src_.cols, searchWindowSize, searchWindowSize);
-
     int firstColNum = -1;
     for (int j = row_from, jj = 0; j <= row_to; j += slidingStep_, jj += slidingStep_)
     {
         for (int i = 0; i < src_.cols; i += slidingStep_)
         {
-            const T *currentPixelSrc = srcExtended_.ptr<T>(0) + step*j + i;
-            const T *currentPixelBasic = basicExtended_.ptr<T>(0) + step*j + i;
-
             int elementSize = 1;
 
-            // Calculate distSums using moving average filter approach.
-            if (i == 0)
-            {
-                // Calculate distSums for the first element in a row
-                calcDistSumsForFirstElementInRow(j, distSums, colDistSums, lastColDistSums, bmBasic, elementSize);
-                firstColNum = 0;
-            }
-            else
+            // Search the blocks in the frame itself and in the other frames of the window
+            for (int f = 0; f < numFrames_; ++f)
             {
-                if (j == row_from)
+                const Mat &searchImage = frames_[f].basicExtended;
+
+                // Sums of columns and rows for current pixel
+                Array2d<int> distSums(workspace.distSums.data() + f * searchWindowSizeSq,
+                    searchWindowSize, searchWindowSize);
+
+                // Sums of columns for current pixel (for lazy calc optimization)
+                Array3d<int> colDistSums(workspace.colDistSums.data() + f * blockSize * searchWindowSizeSq,
+                    blockSize, searchWindowSize, searchWindowSize);
+
+                // Last elements of column sum (for each element in a row)
+                Array3d<int> lastColDistSums(workspace.lastColDistSums.data() + (size_t)f * src_.cols * searchWindowSizeSq,
+                    src_.cols, searchWindowSize, searchWindowSize);
+
+                // Calculate distSums using moving average filter approach.
+                if (i == 0)
+                {
+                    // Calculate distSums for the first element in a row
+                    calcDistSumsForFirstElementInRow(
+                        searchImage, f, j, distSums, colDistSums, lastColDistSums, bmBasic, elementSize);
+                }
+                else if (j == row_from)
                 {
                     // Calculate distSums for all elements in the first row
                     calcDistSumsForAllElementsInFirstRow(
-                        j, i, firstColNum, distSums, colDistSums, lastColDistSums, bmBasic, elementSize);
+                        searchImage, f, j, i, firstColNum, distSums, colDistSums, lastColDistSums, bmBasic, elementSize);
                 }
                 else
                 {
@@ -267,33 +287,31 @@ void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::operator() (const Range& range
                         int *colDistSumsRow = colDistSums.row_ptr(firstColNum, y);
                         int *lastColDistSumsRow = lastColDistSums.row_ptr(i, y);
 
-                        const T *b_up_ptr = basicExtended_.ptr<T>(start_by + y);
-                        const T *b_down_ptr = basicExtended_.ptr<T>(start_by + y + blockSize);
+                        const T *b_up_ptr = searchImage.ptr<T>(start_by + y) + start_bx;
+                        const T *b_down_ptr = searchImage.ptr<T>(start_by + y + blockSize) + start_bx;
+
+                        // Remove from current pixel sums column sums with index "firstColNum"
+                        // and add the ones of the new column
+                        updateDistSumsRow<D, T>(distSumsRow, colDistSumsRow, lastColDistSumsRow,
+                            a_up, a_down, b_up_ptr, b_down_ptr, searchWindowSize);
 
                         for (TT x = 0; x < searchWindowSize; x++)
                         {
-                            // Remove from current pixel sum column sum with index "firstColNum"
-                            distSumsRow[x] -= colDistSumsRow[x];
-
-                            const int bx = start_bx + x;
-                            colDistSumsRow[x] = lastColDistSumsRow[x] +
-                                D::template calcUpDownDist<T>(a_up, a_down, b_up_ptr[bx], b_down_ptr[bx]);
-
-                            distSumsRow[x] += colDistSumsRow[x];
-                            lastColDistSumsRow[x] = colDistSumsRow[x];
-
-                            if (x == halfSearchWindowSize && y == halfSearchWindowSize)
+                            if (f == 0 && x == halfSearchWindowSize && y == halfSearchWindowSize)
                                 continue;
 
                             // Save the distance, coordinate and increase the counter
                             if (distSumsRow[x] < hBM)
-                                bmBasic[elementSize++](distSumsRow[x], x, y);
+                                bmBasic[elementSize++](distSumsRow[x], x, y, f);
                         }
                     }
                 }
+            }
 
+            if (i == 0)
+                firstColNum = 0;
+            else
                 firstColNum = (firstColNum + 1) % blockSize;
-            }
 
             // Sort bmBasic by distance (first element is already sorted)
             std::sort(bmBasic + 1, bmBasic + elementSize);
@@ -306,10 +324,11 @@ void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::operator() (const Range& range
             // Transform 2D patches
             for (int n = 0; n < elementSize; ++n)
             {
-                const T *candidatePatchSrc = currentPixelSrc + step * bmBasic[n].coord_y + bmBasic[n].coord_x;
-                const T *candidatePatchBasic = currentPixelBasic + step * bmBasic[n].coord_y + bmBasic[n].coord_x;
-                TC::forwardTransform2D(candidatePatchSrc, bmSrc[n].data(), step, blockSize);
-                TC::forwardTransform2D(candidatePatchBasic, bmBasic[n].data(), step, blockSize);
+                const Bm3dFrame &frame = frames_[bmBasic[n].frame];
+                const int y = j + bmBasic[n].coord_y;
+                const int x = i + bmBasic[n].coord_x;
+                getBlockTransform<T, TT, TC>(frame.srcExtended, frame.srcTransforms, y, x, bmSrc[n].data(), blockSize);
+                getBlockTransform<T, TT, TC>(frame.basicExtended, frame.basicTransforms, y, x, bmBasic[n].data(), blockSize);
             }
 
             // Transform and shrink 1D columns
@@ -381,49 +400,30 @@ void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::operator() (const Range& range
             weight /= groupSize;
 
             // Put patches back to their original positions
-            WT *dstPtr = weightedSum.data() + jj * dstStep + i;
-            WT *weiPtr = weights.data() + jj * dstStep + i;
+            // (blocks of the other frames only contribute to the filtering)
+            WT *dstPtr = weightedSum + jj * dstStep + i;
+            WT *weiPtr = weights + jj * dstStep + i;
             const float *kaiser = kaiser_;
 
             for (int l = 0; l < elementSize; ++l)
             {
+                if (bmBasic[l].frame != 0)
+                    continue;
+
                 const TT *block = bmBasic[l].data();
                 int offset = bmBasic[l].coord_y * dstStep + bmBasic[l].coord_x;
-                WT *d = dstPtr + offset;
-                WT *dw = weiPtr + offset;
-
-                for (int n = 0; n < blockSize; ++n)
-                {
-                    for (int m = 0; m < blockSize; ++m)
-                    {
-                        unsigned idx = n * blockSize + m;
-                        *d += kaiser[idx] * block[idx] * weight;
-                        *dw += kaiser[idx] * weight;
-                        ++d, ++dw;
-                    }
-                    d += dstcstep;
-                    dw += weicstep;
-                }
+                aggregateBlock(block, kaiser, weight, dstPtr + offset, weiPtr + offset,
+                    blockSize, dstStep, weiStep);
             }
         } // i
     } // j
 
-    // Cleanup
-    for (int i = 0; i < searchWindowSizeSq; ++i)
-    {
-        bmBasic[i].release();
-        bmSrc[i].release();
-    }
-
-    delete[] bmSrc;
-    delete[] bmBasic;
-
     // Divide accumulation buffer by the corresponding weights
     for (int i = row_from, ii = 0; i <= row_to; ++i, ++ii)
     {
         T *d = dst_.ptr<T>(i);
-        float *dE = weightedSum.data() + (ii + halfSearchWindowSize + halfBlockSize) * dstStep + halfSearchWindowSize;
-        float *dw = weights.data() + (ii + halfSearchWindowSize + halfBlockSize) * dstStep + halfSearchWindowSize;
+        float *dE = weightedSum + (ii + halfSearchWindowSize + halfBlockSize) * dstStep + halfSearchWindowSize;
+        float *dw = weights + (ii + halfSearchWindowSize + halfBlockSize) * dstStep + halfSearchWindowSize;
         for (int j = 0; j < dst_.cols; ++j)
             d[j] = cv::saturate_cast<T>(dE[j + halfBlockSize] / dw[j + halfBlockSize]);
     }
@@ -432,6 +432,8 @@ void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::operator() (const Range& range
 
 template <typename T, typename D, typename WT, typename TT, typename TC>
 inline void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::calcDistSumsForFirstElementInRow(
+    const Mat& searchImage,
+    int frame,
     int i,
     Array2d<int>& distSums,
     Array3d<int>& colDistSums,
@@ -463,11 +465,8 @@ inline void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::calcDistSumsForFirstEle
                 for (int tx = 0; tx < blockSize; tx++)
                 {
                     int dist = D::template calcDist<T>(
-                        basicExtended_,
-                        ay + ty,
-                        ax + tx,
-                        start_y + ty,
-                        start_x + tx);
+                        basicExtended_.at<T>(ay + ty, ax + tx),
+                        searchImage.at<T>(start_y + ty, start_x + tx));
 
                     distSums[y][x] += dist;
                     colDistSums[tx][y][x] += dist;
@@ -475,17 +474,19 @@ inline void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::calcDistSumsForFirstEle
 
             lastColDistSums[j][y][x] = colDistSums[blockSize - 1][y][x];
 
-            if (x == halfSearchWindowSize && y == halfSearchWindowSize)
+            if (frame == 0 && x == halfSearchWindowSize && y == halfSearchWindowSize)
                 continue;
 
             if (distSums[y][x] < hBM)
-                bm[elementSize++](distSums[y][x], x, y);
+                bm[elementSize++](distSums[y][x], x, y, frame);
         }
     }
 }
 
 template <typename T, typename D, typename WT, typename TT, typename TC>
 inline void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::calcDistSumsForAllElementsInFirstRow(
+    const Mat& searchImage,
+    int frame,
     int i,
     int j,
     int firstColNum,
@@ -516,20 +517,17 @@ inline void Bm3dDenoisingInvokerStep2<T, D, WT, TT, TC>::calcDistSumsForAllEleme
 
             for (int ty = 0; ty < blockSize; ty++)
                 colDistSums[firstColNum][y][x] += D::template calcDist<T>(
-                    basicExtended_,
-                    ay + ty,
-                    ax,
-                    by + ty,
-                    bx);
+                    basicExtended_.at<T>(ay + ty, ax),
+                    searchImage.at<T>(by + ty, bx));
 
             distSums[y][x] += colDistSums[firstColNum][y][x];
             lastColDistSums[j][y][x] = colDistSums[firstColNum][y][x];
 
-            if (x == halfSearchWindowSize && y == halfSearchWindowSize)
+            if (frame == 0 && x == halfSearchWindowSize && y == halfSearchWindowSize)
                 continue;
 
             if (distSums[y][x] < hBM)
-                bm[elementSize++](distSums[y][x], x, y);
+                bm[elementSize++](distSums[y][x], x, y, frame);
         }
     }
 }
@@ -42,11 +42,47 @@
 #ifndef __OPENCV_BM3D_DENOISING_INVOKER_STRUCTS_HPP__
 #define __OPENCV_BM3D_DENOISING_INVOKER_STRUCTS_HPP__
 
+#include "opencv2/core/hal/intrin.hpp"
+
 namespace cv
 {
 namespace xphoto
 {
 
+#if CV_SIMD128
+// Loads 4 consecutive elements widened to 32-bit integers
+inline v_int32x4 bm3dLoad4(const uchar *ptr)
+{
+    return v_reinterpret_as_s32(v_load_expand_q(ptr));
+}
+
+inline v_int32x4 bm3dLoad4(const ushort *ptr)
+{
+    return v_reinterpret_as_s32(v_load_expand(ptr));
+}
+
+inline v_int32x4 bm3dLoad4(const short *ptr)
+{
+    return v_load_expand(ptr);
+}
+
+inline v_int32x4 bm3dLoad4(const int *ptr)
+{
+    return v_load(ptr);
+}
+
+// Stores 4 32-bit integers narrowed to the destination type
+inline void bm3dStore4(short *ptr, const v_int32x4 &val)
+{
+    v_pack_store(ptr, val);
+}
+
+inline void bm3dStore4(int *ptr, const v_int32x4 &val)
+{
+    v_store(ptr, val);
+}
+#endif
+
 template <typename T, typename DT, typename CT>
 class BlockMatch
 {
@@ -75,12 +111,19 @@ public:
         delete[] data_;
     }
 
+    // Use externally owned memory for data
+    void attach(T *data)
+    {
+        data_ = data;
+    }
+
     // Overloaded operator for convenient assignment
-    void operator()(const DT &_dist, const CT &_coord_x, const CT &_coord_y)
+    void operator()(const DT &_dist, const CT &_coord_x, const CT &_coord_y, const int &_frame = 0)
     {
         dist = _dist;
         coord_x = _coord_x;
         coord_y = _coord_y;
+        frame = _frame;
     }
 
     // Overloaded array subscript operator
@@ -108,6 +151,9 @@ public:
     CT coord_x;
     CT coord_y;
 
+    // Index of the frame the block comes from, 0 is the frame being denoised
+    int frame;
+
 private:
     // Pointer to the pixel values of the block
     T *data_;
@@ -179,6 +225,15 @@ public:
         return calcDist<T>(a_down, b_down) - calcDist<T>(a_up, b_up);
     };
 
+#if CV_SIMD128
+    static inline v_int32x4 calcUpDownDist(const v_int32x4 &a_up, const v_int32x4 &a_down,
+                                           const v_int32x4 &b_up, const v_int32x4 &b_down)
+    {
+        return v_sub(v_reinterpret_as_s32(v_abs(v_sub(a_down, b_down))),
+                     v_reinterpret_as_s32(v_abs(v_sub(a_up, b_up))));
+    }
+#endif
+
     template <typename T>
     static inline T calcBlockMatchingThreshold(const T &blockMatchThrL2, const T &blockSizeSq)
     {
@@ -273,6 +328,16 @@ public:
         return calcUpDownDist_<T>::f(a_up, a_down, b_up, b_down);
     };
 
+#if CV_SIMD128
+    static inline v_int32x4 calcUpDownDist(const v_int32x4 &a_up, const v_int32x4 &a_down,
+                                           const v_int32x4 &b_up, const v_int32x4 &b_down)
+    {
+        v_int32x4 A = v_sub(a_down, b_down);
+        v_int32x4 B = v_sub(a_up, b_up);
+        return v_mul(v_sub(A, B), v_add(A, B));
+    }
+#endif
+
     template <typename T>
     static inline T calcBlockMatchingThreshold(const T &blockMatchThrL2, const T &blockSizeSq)
     {
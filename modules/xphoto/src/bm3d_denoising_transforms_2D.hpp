@@ -42,6 +42,8 @@
 #ifndef __OPENCV_BM3D_DENOISING_TRANSFORMS_2D_HPP__
 #define __OPENCV_BM3D_DENOISING_TRANSFORMS_2D_HPP__
 
+#include "bm3d_denoising_invoker_structs.hpp"
+
 namespace cv
 {
 namespace xphoto
@@ -360,9 +362,64 @@ public:
         dst[3 * N] = dif1;
     }
 
+#if CV_SIMD128
+    // Each vector holds one row of the block, so that butterflies between
+    // vectors transform all 4 columns at once.
+    inline static void ForwardTransform4(v_int32x4 *v)
+    {
+        const v_int32x4 one = v_setall_s32(1);
+
+        v_int32x4 sum0 = v_shr<1>(v_add(v_add(v[0], v[1]), one));
+        v_int32x4 sum1 = v_shr<1>(v_add(v_add(v[2], v[3]), one));
+        v_int32x4 dif0 = v_sub(v[0], v[1]);
+        v_int32x4 dif1 = v_sub(v[2], v[3]);
+
+        v[0] = v_shr<1>(v_add(v_add(sum0, sum1), one));
+        v[1] = v_sub(sum0, sum1);
+        v[2] = dif0;
+        v[3] = dif1;
+    }
+
+    inline static void InverseTransform4(v_int32x4 *v)
+    {
+        v_int32x4 src0 = v_add(v[0], v[0]);
+
+        v_int32x4 sum0 = v_add(src0, v[1]);
+        v_int32x4 dif0 = v_sub(src0, v[1]);
+
+        v_int32x4 src2 = v[2];
+        v_int32x4 src3 = v[3];
+        v[0] = v_shr<1>(v_add(sum0, src2));
+        v[1] = v_shr<1>(v_sub(sum0, src2));
+        v[2] = v_shr<1>(v_add(dif0, src3));
+        v[3] = v_shr<1>(v_sub(dif0, src3));
+    }
+
+    inline static void Transpose4x4(v_int32x4 *v)
+    {
+        v_int32x4 t0, t1, t2, t3;
+        v_transpose4x4(v[0], v[1], v[2], v[3], t0, t1, t2, t3);
+        v[0] = t0; v[1] = t1; v[2] = t2; v[3] = t3;
+    }
+#endif
+
     template <typename T, typename TT>
     inline static void ForwardTransform4x4(const T *ptr, TT *dst, const int &step, const int /*blockSize*/)
     {
+#if CV_SIMD128
+        v_int32x4 v[4];
+        for (int i = 0; i < 4; ++i)
+            v[i] = bm3dLoad4(ptr + i * step);
+
+        // Transform columns, then rows of the transposed block
+        ForwardTransform4(v);
+        Transpose4x4(v);
+        ForwardTransform4(v);
+        Transpose4x4(v);
+
+        for (int i = 0; i < 4; ++i)
+            bm3dStore4(dst + i * 4, v[i]);
+#else
         TT temp[16];
 
         // Transform columns first
@@ -372,6 +429,7 @@ public:
         // Then transform rows
         for (int i = 0; i < 4; ++i)
             ForwardTransform4<TT, TT, 1>(temp + i * 4, dst + i * 4, 1);
+#endif
     }
 
     template <typename TT, int N>
@@ -394,6 +452,19 @@ public:
     template <typename T>
     inline static void InverseTransform4x4(T *src, const int /*blockSize*/)
     {
+#if CV_SIMD128
+        v_int32x4 v[4];
+        for (int i = 0; i < 4; ++i)
+            v[i] = bm3dLoad4(src + i * 4);
+
+        InverseTransform4(v);
+        Transpose4x4(v);
+        InverseTransform4(v);
+        Transpose4x4(v);
+
+        for (int i = 0; i < 4; ++i)
+            bm3dStore4(src + i * 4, v[i]);
+#else
         T temp[16];
 
         // Invert columns first
@@ -403,6 +474,7 @@ public:
         // Then invert rows
         for (int i = 0; i < 4; ++i)
             InverseTransform4<T, 1>(temp + i * 4, src + i * 4);
+#endif
     }
 
     /// Transforms for 8x8 2D block
@@ -446,9 +518,103 @@ public:
         dst[7 * N] = dif3;
     }
 
+#if CV_SIMD128
+    // Same as above for 8 rows, each of them split into two vectors (lo, hi)
+    inline static void ForwardTransform8(v_int32x4 *v)
+    {
+        const v_int32x4 one = v_setall_s32(1);
+
+        v_int32x4 sum0 = v_shr<1>(v_add(v_add(v[0], v[1]), one));
+        v_int32x4 sum1 = v_shr<1>(v_add(v_add(v[2], v[3]), one));
+        v_int32x4 sum2 = v_shr<1>(v_add(v_add(v[4], v[5]), one));
+        v_int32x4 sum3 = v_shr<1>(v_add(v_add(v[6], v[7]), one));
+        v_int32x4 dif0 = v_sub(v[0], v[1]);
+        v_int32x4 dif1 = v_sub(v[2], v[3]);
+        v_int32x4 dif2 = v_sub(v[4], v[5]);
+        v_int32x4 dif3 = v_sub(v[6], v[7]);
+
+        v_int32x4 sum00 = v_shr<1>(v_add(v_add(sum0, sum1), one));
+        v_int32x4 sum11 = v_shr<1>(v_add(v_add(sum2, sum3), one));
+        v_int32x4 dif00 = v_sub(sum0, sum1);
+        v_int32x4 dif11 = v_sub(sum2, sum3);
+
+        v[0] = v_shr<1>(v_add(v_add(sum00, sum11), one));
+        v[1] = v_sub(sum00, sum11);
+        v[2] = dif00;
+        v[3] = dif11;
+        v[4] = dif0;
+        v[5] = dif1;
+        v[6] = dif2;
+        v[7] = dif3;
+    }
+
+    inline static void InverseTransform8(v_int32x4 *v)
+    {
+        v_int32x4 src0 = v_add(v[0], v[0]);
+
+        v_int32x4 sum0 = v_add(src0, v[1]);
+        v_int32x4 dif0 = v_sub(src0, v[1]);
+
+        v_int32x4 sum00 = v_add(sum0, v[2]);
+        v_int32x4 dif00 = v_sub(sum0, v[2]);
+        v_int32x4 sum11 = v_add(dif0, v[3]);
+        v_int32x4 dif11 = v_sub(dif0, v[3]);
+
+        v_int32x4 src4 = v[4], src5 = v[5], src6 = v[6], src7 = v[7];
+        v[0] = v_shr<1>(v_add(sum00, src4));
+        v[1] = v_shr<1>(v_sub(sum00, src4));
+        v[2] = v_shr<1>(v_add(dif00, src5));
+        v[3] = v_shr<1>(v_sub(dif00, src5));
+        v[4] = v_shr<1>(v_add(sum11, src6));
+        v[5] = v_shr<1>(v_sub(sum11, src6));
+        v[6] = v_shr<1>(v_add(dif11, src7));
+        v[7] = v_shr<1>(v_sub(dif11, src7));
+    }
+
+    // Transposes the 8x8 block stored as left (lo) and right (hi) halves of the rows
+    inline static void Transpose8x8(v_int32x4 *lo, v_int32x4 *hi)
+    {
+        v_int32x4 t0[4], t1[4];
+
+        // The off-diagonal 4x4 blocks swap their places
+        v_transpose4x4(hi[0], hi[1], hi[2], hi[3], t0[0], t0[1], t0[2], t0[3]);
+        v_transpose4x4(lo[4], lo[5], lo[6], lo[7], t1[0], t1[1], t1[2], t1[3]);
+        for (int i = 0; i < 4; ++i)
+        {
+            hi[i] = t1[i];
+            lo[4 + i] = t0[i];
+        }
+
+        Transpose4x4(lo);
+        Transpose4x4(hi + 4);
+    }
+#endif
+
     template <typename T, typename TT>
     inline static void ForwardTransform8x8(const T *ptr, TT *dst, const int &step, const int /*blockSize*/)
     {
+#if CV_SIMD128
+        v_int32x4 lo[8], hi[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            lo[i] = bm3dLoad4(ptr + i * step);
+            hi[i] = bm3dLoad4(ptr + i * step + 4);
+        }
+
+        // Transform columns, then rows of the transposed block
+        ForwardTransform8(lo);
+        ForwardTransform8(hi);
+        Transpose8x8(lo, hi);
+        ForwardTransform8(lo);
+        ForwardTransform8(hi);
+        Transpose8x8(lo, hi);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            bm3dStore4(dst + i * 8, lo[i]);
+            bm3dStore4(dst + i * 8 + 4, hi[i]);
+        }
+#else
         TT temp[64];
 
         // Transform columns first
@@ -458,6 +624,7 @@ public:
         // Then transform rows
         for (int i = 0; i < 8; ++i)
             ForwardTransform8<TT, TT, 1>(temp + i * 8, dst + i * 8, 1);
+#endif
     }
 
     template <typename T, int N>
@@ -493,6 +660,27 @@ public:
     template <typename T>
     inline static void InverseTransform8x8(T *src, const int /*blockSize*/)
     {
+#if CV_SIMD128
+        v_int32x4 lo[8], hi[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            lo[i] = bm3dLoad4(src + i * 8);
+            hi[i] = bm3dLoad4(src + i * 8 + 4);
+        }
+
+        InverseTransform8(lo);
+        InverseTransform8(hi);
+        Transpose8x8(lo, hi);
+        InverseTransform8(lo);
+        InverseTransform8(hi);
+        Transpose8x8(lo, hi);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            bm3dStore4(src + i * 8, lo[i]);
+            bm3dStore4(src + i * 8 + 4, hi[i]);
+        }
+#else
         T temp[64];
 
         // Invert columns first
@@ -502,6 +690,7 @@ public:
         // Then invert rows
         for (int i = 0; i < 8; ++i)
             InverseTransform8<T, 1>(temp + i * 8, src + i * 8);
+#endif
     }
 };
 
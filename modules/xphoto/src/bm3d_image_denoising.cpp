@@ -73,6 +73,10 @@ static void bm3dDenoising_(
     const int &step)
 {
     double granularity = (double)std::max(1., (double)src.total() / (1 << 16));
+    const int borderSize = getBm3dBorderSize(templateWindowSize, searchWindowSize);
+
+    Bm3dFrame frame;
+    copyMakeBorder(src, frame.srcExtended, borderSize, borderSize, borderSize, borderSize, BORDER_DEFAULT);
 
     switch (CV_MAT_CN(src.type())) {
     case 1:
@@ -82,6 +86,9 @@ static void bm3dDenoising_(
                 Bm3dDenoisingInvokerStep1<ST, D, float, TT, HaarTransform<ST, TT> >(
                     src,
                     basic,
+                    &frame,
+                    1,
+                    NULL,
                     templateWindowSize,
                     searchWindowSize,
                     h,
@@ -93,11 +100,14 @@ static void bm3dDenoising_(
         }
         if (step == BM3D_STEP2 || step == BM3D_STEPALL)
         {
+            copyMakeBorder(basic, frame.basicExtended, borderSize, borderSize, borderSize, borderSize, BORDER_DEFAULT);
             parallel_for_(cv::Range(0, src.rows),
                 Bm3dDenoisingInvokerStep2<ST, D, float, TT, HaarTransform<ST, TT> >(
                     src,
-                    basic,
                     dst,
+                    &frame,
+                    1,
+                    NULL,
                     templateWindowSize,
                     searchWindowSize,
                     h,
@@ -267,6 +277,251 @@ void bm3dDenoising(
         _dst.assign(basic);
 }
 
+// Frames of the temporal window and per thread buffers of a sequence with one pixel type
+class Bm3dSequence
+{
+public:
+    virtual ~Bm3dSequence() {}
+
+    virtual void denoise(
+        const Mat& src,
+        Mat& dst,
+        const float& h,
+        const int &templateWindowSize,
+        const int &searchWindowSize,
+        const int &hBMStep1,
+        const int &hBMStep2,
+        const int &groupSize,
+        const int &slidingStep,
+        const float &beta,
+        const int &temporalWindowSize) = 0;
+};
+
+template<typename ST, typename D, typename TT>
+class Bm3dSequence_ : public Bm3dSequence
+{
+public:
+    void denoise(
+        const Mat& src,
+        Mat& dst,
+        const float& h,
+        const int &templateWindowSize,
+        const int &searchWindowSize,
+        const int &hBMStep1,
+        const int &hBMStep2,
+        const int &groupSize,
+        const int &slidingStep,
+        const float &beta,
+        const int &temporalWindowSize) CV_OVERRIDE
+    {
+        typedef HaarTransform<ST, TT> TC;
+
+        double granularity = (double)std::max(1., (double)src.total() / (1 << 16));
+        const int borderSize = getBm3dBorderSize(templateWindowSize, searchWindowSize);
+
+        // The frame leaving the window gives its buffers to the new one
+        if ((int)frames_.size() > temporalWindowSize)
+            frames_.resize(temporalWindowSize);
+        if ((int)frames_.size() < temporalWindowSize)
+            frames_.push_back(Bm3dFrame());
+        std::rotate(frames_.begin(), frames_.end() - 1, frames_.end());
+        const int numFrames = (int)frames_.size();
+
+        Bm3dFrame &frame = frames_[0];
+        copyMakeBorder(src, frame.srcExtended, borderSize, borderSize, borderSize, borderSize, BORDER_DEFAULT);
+        calcBlockTransforms<ST, TT, TC>(frame.srcExtended, frame.srcTransforms, templateWindowSize);
+
+        basic_.create(src.size(), src.type());
+        parallel_for_(cv::Range(0, src.rows),
+            Bm3dDenoisingInvokerStep1<ST, D, float, TT, TC>(
+                src,
+                basic_,
+                &frames_[0],
+                numFrames,
+                &workspaces_,
+                templateWindowSize,
+                searchWindowSize,
+                h,
+                hBMStep1,
+                groupSize,
+                slidingStep,
+                beta),
+            granularity);
+
+        copyMakeBorder(basic_, frame.basicExtended, borderSize, borderSize, borderSize, borderSize, BORDER_DEFAULT);
+        calcBlockTransforms<ST, TT, TC>(frame.basicExtended, frame.basicTransforms, templateWindowSize);
+
+        parallel_for_(cv::Range(0, src.rows),
+            Bm3dDenoisingInvokerStep2<ST, D, float, TT, TC>(
+                src,
+                dst,
+                &frames_[0],
+                numFrames,
+                &workspaces_,
+                templateWindowSize,
+                searchWindowSize,
+                h,
+                hBMStep2,
+                groupSize,
+                slidingStep,
+                beta),
+            granularity);
+    }
+
+private:
+    // Most recent frame first
+    std::vector<Bm3dFrame> frames_;
+
+    Mat basic_;
+    TLSData<Bm3dWorkspace<TT, float> > workspaces_;
+};
+
+class Bm3dDenoiserImpl CV_FINAL : public Bm3dDenoiser
+{
+public:
+    Bm3dDenoiserImpl(
+        float h,
+        int templateWindowSize,
+        int searchWindowSize,
+        int blockMatchingStep1,
+        int blockMatchingStep2,
+        int groupSize,
+        int slidingStep,
+        float beta,
+        int normType,
+        int temporalWindowSize) :
+        h_(h),
+        templateWindowSize_(templateWindowSize),
+        searchWindowSize_(searchWindowSize),
+        blockMatchingStep1_(blockMatchingStep1),
+        blockMatchingStep2_(blockMatchingStep2),
+        groupSize_(groupSize),
+        slidingStep_(slidingStep),
+        beta_(beta),
+        normType_(normType),
+        temporalWindowSize_(temporalWindowSize),
+        sequenceType_(-1)
+    {
+        CV_Assert(searchWindowSize > templateWindowSize);
+        CV_Assert(slidingStep > 0 && slidingStep < templateWindowSize);
+        CV_Assert(normType == NORM_L2 || normType == NORM_L1);
+        CV_Assert(temporalWindowSize > 0);
+    }
+
+    void denoise(InputArray _src, OutputArray _dst) CV_OVERRIDE
+    {
+        int type = _src.type(), depth = CV_MAT_DEPTH(type), cn = CV_MAT_CN(type);
+        CV_Assert(1 == cn);
+
+        Mat src = _src.getMat();
+        if (type != sequenceType_ || src.size() != sequenceSize_)
+        {
+            switch (normType_) {
+            case cv::NORM_L2:
+                switch (depth) {
+                case CV_8U:
+                    sequence_ = makePtr<Bm3dSequence_<uchar, DistSquared, short> >();
+                    break;
+                default:
+                    CV_Error(Error::StsBadArg,
+                        "Unsupported depth! Only CV_8U is supported for NORM_L2");
+                }
+                break;
+            case cv::NORM_L1:
+                switch (depth) {
+                case CV_8U:
+                    sequence_ = makePtr<Bm3dSequence_<uchar, DistAbs, short> >();
+                    break;
+                case CV_16U:
+                    sequence_ = makePtr<Bm3dSequence_<ushort, DistAbs, int> >();
+                    break;
+                default:
+                    CV_Error(Error::StsBadArg,
+                        "Unsupported depth! Only CV_8U and CV_16U are supported for NORM_L1");
+                }
+                break;
+            default:
+                CV_Error(Error::StsBadArg,
+                    "Unsupported norm type! Only NORM_L2 and NORM_L1 are supported");
+            }
+            sequenceType_ = type;
+            sequenceSize_ = src.size();
+        }
+
+        // src is copied into the window before dst is written, in place denoising is fine
+        _dst.create(src.size(), type);
+        Mat dst = _dst.getMat();
+
+        sequence_->denoise(
+            src,
+            dst,
+            h_,
+            templateWindowSize_,
+            searchWindowSize_,
+            blockMatchingStep1_,
+            blockMatchingStep2_,
+            groupSize_,
+            slidingStep_,
+            beta_,
+            temporalWindowSize_);
+    }
+
+    void reset() CV_OVERRIDE
+    {
+        sequence_.release();
+        sequenceType_ = -1;
+    }
+
+    int getTemporalWindowSize() const CV_OVERRIDE { return temporalWindowSize_; }
+    void setTemporalWindowSize(int temporalWindowSize) CV_OVERRIDE
+    {
+        CV_Assert(temporalWindowSize > 0);
+        temporalWindowSize_ = temporalWindowSize;
+    }
+
+private:
+    float h_;
+    int templateWindowSize_;
+    int searchWindowSize_;
+    int blockMatchingStep1_;
+    int blockMatchingStep2_;
+    int groupSize_;
+    int slidingStep_;
+    float beta_;
+    int normType_;
+    int temporalWindowSize_;
+
+    // Frames and buffers of the current sequence
+    Ptr<Bm3dSequence> sequence_;
+    int sequenceType_;
+    Size sequenceSize_;
+};
+
+Ptr<Bm3dDenoiser> createBm3dDenoiser(
+    float h,
+    int templateWindowSize,
+    int searchWindowSize,
+    int blockMatchingStep1,
+    int blockMatchingStep2,
+    int groupSize,
+    int slidingStep,
+    float beta,
+    int normType,
+    int temporalWindowSize)
+{
+    return makePtr<Bm3dDenoiserImpl>(
+        h,
+        templateWindowSize,
+        searchWindowSize,
+        blockMatchingStep1,
+        blockMatchingStep2,
+        groupSize,
+        slidingStep,
+        beta,
+        normType,
+        temporalWindowSize);
+}
+
 #else
 
 void bm3dDenoising(
@@ -343,6 +598,36 @@ void bm3dDenoising(
         "Set OPENCV_ENABLE_NONFREE CMake option and rebuild the library");
 }
 
+Ptr<Bm3dDenoiser> createBm3dDenoiser(
+    float h,
+    int templateWindowSize,
+    int searchWindowSize,
+    int blockMatchingStep1,
+    int blockMatchingStep2,
+    int groupSize,
+    int slidingStep,
+    float beta,
+    int normType,
+    int temporalWindowSize)
+{
+    // Empty implementation
+
+    CV_UNUSED(h);
+    CV_UNUSED(templateWindowSize);
+    CV_UNUSED(searchWindowSize);
+    CV_UNUSED(blockMatchingStep1);
+    CV_UNUSED(blockMatchingStep2);
+    CV_UNUSED(groupSize);
+    CV_UNUSED(slidingStep);
+    CV_UNUSED(beta);
+    CV_UNUSED(normType);
+    CV_UNUSED(temporalWindowSize);
+
+    CV_Error(Error::StsNotImplemented,
+        "This algorithm is patented and is excluded in this configuration;"
+        "Set OPENCV_ENABLE_NONFREE CMake option and rebuild the library");
+}
+
 #endif
 
 }  // namespace xphoto
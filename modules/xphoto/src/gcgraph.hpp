@@ -50,6 +50,7 @@ public:
     GCGraph( unsigned int vtxCount, unsigned int edgeCount );
     ~GCGraph();
     void create( unsigned int vtxCount, unsigned int edgeCount );
+    void clear();
     int addVtx();
     void addEdges( int i, int j, TWeight w, TWeight revw );
     void addTermWeights( int i, TWeight sourceW, TWeight sinkW );
@@ -102,6 +103,15 @@ void GCGraph<TWeight>::create( unsigned int vtxCount, unsigned int edgeCount )
     flow = 0;
 }
 
+// removes all vertices and edges, keeping the allocated memory for reuse
+template <class TWeight>
+void GCGraph<TWeight>::clear()
+{
+    vtcs.clear();
+    edges.clear();
+    flow = 0;
+}
+
 template <class TWeight>
 int GCGraph<TWeight>::addVtx()
 {
@@ -121,44 +121,50 @@ namespace xphoto
         std::vector <std::vector <int> >  linkIdx( pPath.size() );                  // neighbor links for pointSeq elements
         std::vector <std::vector <unsigned char > > maskSeq( pPath.size() );        // corresponding mask
 
-        for (size_t i = 0; i < pPath.size(); ++i)
+        cv::parallel_for_( cv::Range(0, int(pPath.size())), [&](const cv::Range &range)
         {
-            uint8_t xmask = dmask.template at<uint8_t>(pPath[i]);
-
-            for (int j = 0; j < nTransform + 1; ++j)
+            for (int i = range.start; i < range.end; ++i)
             {
-                cv::Point2i u = pPath[i] + transforms[j];
+                maskSeq[i].reserve(nTransform + 1);
+                pointSeq[i].reserve(nTransform + 1);
 
-                unsigned char vmask = 0;
-                cv::Vec <float, cn> vimg = 0;
+                uint8_t xmask = dmask.template at<uint8_t>(pPath[i]);
 
-                if ( u.y < src.rows && u.y >= 0
-                &&   u.x < src.cols && u.x >= 0 )
+                for (int j = 0; j < nTransform + 1; ++j)
                 {
-                    if ( xmask == 0 || j == nTransform )
-                        vmask = mask.template at<uint8_t>(u);
-                    vimg = img.template at<cv::Vec<float, cn> >(u);
-                }
+                    cv::Point2i u = pPath[i] + transforms[j];
 
-                maskSeq[i].push_back(vmask);
-                pointSeq[i].push_back(vimg);
+                    unsigned char vmask = 0;
+                    cv::Vec <float, cn> vimg = 0;
 
-                if (vmask != 0)
-                    labelSeq[i] = j;
-            }
+                    if ( u.y < src.rows && u.y >= 0
+                    &&   u.x < src.cols && u.x >= 0 )
+                    {
+                        if ( xmask == 0 || j == nTransform )
+                            vmask = mask.template at<uint8_t>(u);
+                        vimg = img.template at<cv::Vec<float, cn> >(u);
+                    }
 
-            cv::Point2i  p[] = {
-                                 pPath[i] + cv::Point2i(0, +1),
-                                 pPath[i] + cv::Point2i(+1, 0)
-                               };
+                    maskSeq[i].push_back(vmask);
+                    pointSeq[i].push_back(vimg);
 
-            for (uint j = 0; j < sizeof(p)/sizeof(cv::Point2i); ++j)
-                if ( p[j].y < src.rows && p[j].y >= 0 &&
-                     p[j].x < src.cols && p[j].x >= 0 )
-                    linkIdx[i].push_back( backref(p[j]) );
-                else
-                    linkIdx[i].push_back( -1 );
-        }
+                    if (vmask != 0)
+                        labelSeq[i] = j;
+                }
+
+                cv::Point2i  p[] = {
+                                     pPath[i] + cv::Point2i(0, +1),
+                                     pPath[i] + cv::Point2i(+1, 0)
+                                   };
+
+                for (uint j = 0; j < sizeof(p)/sizeof(cv::Point2i); ++j)
+                    if ( p[j].y < src.rows && p[j].y >= 0 &&
+                         p[j].x < src.cols && p[j].x >= 0 )
+                        linkIdx[i].push_back( backref(p[j]) );
+                    else
+                        linkIdx[i].push_back( -1 );
+            }
+        });
 
         /** Stitching **/
         photomontage( pointSeq, maskSeq, linkIdx, labelSeq );
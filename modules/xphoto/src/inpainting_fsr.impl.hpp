@@ -92,34 +92,30 @@ icvStandardDeviation(const Mat& distorted_block_2d, const Mat& error_mask_2d) {
     return sigma_n;
 }
 
+// spatial weighting of the known samples, decaying with the distance to the block center
 static void
-icvExtrapolateBlock(Mat& distorted_block, Mat& error_mask, fsr_parameters& fsr_params, double rho, double normedStdDev, Mat& extrapolated_block)
+icvDistanceWeighting(int fft_size_, int M, int N, double rho, Mat& weighting)
 {
-    double fft_size = fsr_params.fft_size;
-    double orthogonality_correction = fsr_params.orthogonality_correction;
-    int M = distorted_block.rows;
-    int N = distorted_block.cols;
+    double fft_size = fft_size_;
     int fft_x_offset = cvFloor((fft_size - N) / 2);
     int fft_y_offset = cvFloor((fft_size - M) / 2);
-
-    // weighting function
-    Mat w = Mat::zeros(fsr_params.fft_size, fsr_params.fft_size, CV_64F);
-    error_mask.copyTo(w(Range(fft_y_offset, fft_y_offset + M), Range(fft_x_offset, fft_x_offset + N)));
+    weighting.create(fft_size_, fft_size_, CV_64F);
     for (int u = 0; u < fft_size; ++u)
     {
+        double* weighting_row = weighting.ptr<double>(u);
         for (int v = 0; v < fft_size; ++v)
         {
-            w.at<double>(u, v) *= std::pow(rho, std::sqrt(std::pow(u + 0.5 - (fft_y_offset + M / 2), 2) + std::pow(v + 0.5 - (fft_x_offset + N / 2), 2)));
+            weighting_row[v] = std::pow(rho, std::sqrt(std::pow(u + 0.5 - (fft_y_offset + M / 2), 2) + std::pow(v + 0.5 - (fft_x_offset + N / 2), 2)));
         }
     }
-    Mat W;
-    dft(w, W, DFT_COMPLEX_OUTPUT);
-    Mat W_padded;
-    hconcat(W, W, W_padded);
-    vconcat(W_padded, W_padded, W_padded);
+}
 
-    // frequency weighting
-    Mat frequency_weighting = Mat::ones(fsr_params.fft_size, fsr_params.fft_size / 2 + 1, CV_64F);
+// weighting of the frequencies favoring the low ones, only depends on the fft size
+static void
+icvFrequencyWeighting(int fft_size_, Mat& frequency_weighting)
+{
+    double fft_size = fft_size_;
+    frequency_weighting = Mat::ones(fft_size_, fft_size_ / 2 + 1, CV_64F);
     for (int y = 0; y < fft_size; ++y)
     {
         for (int x = 0; x < (fft_size / 2 + 1); ++x)
@@ -129,6 +125,40 @@ icvExtrapolateBlock(Mat& distorted_block, Mat& error_mask, fsr_parameters& fsr_p
             frequency_weighting.at<double>(y, x) = 1 - std::sqrt(x2*x2 + y2 * y2)*std::sqrt(2) / fft_size;
         }
     }
+}
+
+// distance_weighting is the precomputed spatial weighting for full fft sized areas,
+// areas clipped by the image border compute their own
+static void
+icvExtrapolateBlock(const Mat& distorted_block, const Mat& error_mask, const fsr_parameters& fsr_params, double rho, double normedStdDev,
+                    const Mat& frequency_weighting, const Mat& distance_weighting, Mat& extrapolated_block)
+{
+    double fft_size = fsr_params.fft_size;
+    double orthogonality_correction = fsr_params.orthogonality_correction;
+    int M = distorted_block.rows;
+    int N = distorted_block.cols;
+    int fft_x_offset = cvFloor((fft_size - N) / 2);
+    int fft_y_offset = cvFloor((fft_size - M) / 2);
+
+    // weighting function
+    Mat w = Mat::zeros(fsr_params.fft_size, fsr_params.fft_size, CV_64F);
+    error_mask.copyTo(w(Range(fft_y_offset, fft_y_offset + M), Range(fft_x_offset, fft_x_offset + N)));
+    if (M == fsr_params.fft_size && N == fsr_params.fft_size && !distance_weighting.empty())
+    {
+        w = w.mul(distance_weighting);
+    }
+    else
+    {
+        Mat block_distance_weighting;
+        icvDistanceWeighting(fsr_params.fft_size, M, N, rho, block_distance_weighting);
+        w = w.mul(block_distance_weighting);
+    }
+    Mat W;
+    dft(w, W, DFT_COMPLEX_OUTPUT);
+    Mat W_padded;
+    hconcat(W, W, W_padded);
+    vconcat(W_padded, W_padded, W_padded);
+
     // pad image to fft window size
     Mat f(Size(fsr_params.fft_size, fsr_params.fft_size), CV_64F, Scalar::all(0));
     distorted_block.copyTo(f(Range(fft_y_offset, fft_y_offset + M), Range(fft_x_offset, fft_x_offset + N)));
@@ -292,15 +322,41 @@ icvExtrapolateBlock(Mat& distorted_block, Mat& error_mask, fsr_parameters& fsr_p
 
 
 static void
-icvGetTodoBlocks(Mat& sampled_img, Mat& sampling_mask, std::vector< std::tuple< int, int > >& set_todo, int block_size, int block_size_min, int border_width, double homo_threshold, Mat& set_process_this_block_size, std::vector< std::tuple< int, int > >& set_later, Mat& sigma_n_array)
+icvGetTodoBlocks(const Mat& sampled_img, const Mat& sampling_mask, std::vector< std::tuple< int, int > >& set_todo, int block_size, int block_size_min, int border_width, double homo_threshold, Mat& set_process_this_block_size, std::vector< std::tuple< int, int > >& set_later, Mat& sigma_n_array)
 {
     std::vector< std::tuple< int, int > > set_now;
     set_later.clear();
     size_t list_length = set_todo.size();
     int img_height = sampled_img.rows;
     int img_width = sampled_img.cols;
-    Mat reconstructed_img;
-    sampled_img.copyTo(reconstructed_img);
+
+    // determine normalized and weighted standard deviation of all blocks concurrently
+    std::vector<double> sigma_n_list(list_length, 0.0);
+    if (block_size > block_size_min)
+    {
+        parallel_for_(Range(0, (int)list_length), [&](const Range& range)
+        {
+            for (int entry = range.start; entry < range.end; ++entry)
+            {
+                int xblock_counter = std::get<0>(set_todo[entry]);
+                int yblock_counter = std::get<1>(set_todo[entry]);
+                if (xblock_counter >= sigma_n_array.cols || yblock_counter >= sigma_n_array.rows)
+                {
+                    continue;
+                }
+
+                int left_border = std::min(xblock_counter*block_size, border_width);
+                int top_border = std::min(yblock_counter*block_size, border_width);
+                int right_border = std::max(0, std::min(img_width - (xblock_counter + 1)*block_size, border_width));
+                int bottom_border = std::max(0, std::min(img_height - (yblock_counter + 1)*block_size, border_width));
+
+                // extract blocks from images
+                Range rows(yblock_counter*block_size - top_border, std::min(img_height, (yblock_counter*block_size + block_size + bottom_border)));
+                Range cols(xblock_counter*block_size - left_border, std::min(img_width, (xblock_counter*block_size + block_size + right_border)));
+                sigma_n_list[entry] = icvStandardDeviation(sampled_img(rows, cols), sampling_mask(rows, cols));
+            }
+        });
+    }
 
     // calculate block lists
     for (size_t entry = 0; entry < list_length; ++entry)
@@ -308,19 +364,9 @@ icvGetTodoBlocks(Mat& sampled_img, Mat& sampling_mask, std::vector< std::tuple<
         int xblock_counter = std::get<0>(set_todo[entry]);
         int yblock_counter = std::get<1>(set_todo[entry]);
 
-        int left_border = std::min(xblock_counter*block_size, border_width);
-        int top_border = std::min(yblock_counter*block_size, border_width);
-        int right_border = std::max(0, std::min(img_width - (xblock_counter + 1)*block_size, border_width));
-        int bottom_border = std::max(0, std::min(img_height - (yblock_counter + 1)*block_size, border_width));
-
-        // extract blocks from images
-        Mat distorted_block_2d = reconstructed_img(Range(yblock_counter*block_size - top_border, std::min(img_height, (yblock_counter*block_size + block_size + bottom_border))), Range(xblock_counter*block_size - left_border, std::min(img_width, (xblock_counter*block_size + block_size + right_border))));
-        Mat error_mask_2d = sampling_mask(Range(yblock_counter*block_size - top_border, std::min(img_height, (yblock_counter*block_size + block_size + bottom_border))), Range(xblock_counter*block_size - left_border, std::min(img_width, (xblock_counter*block_size + block_size + right_border))));
-
-        // determine normalized and weighted standard deviation
         if (block_size > block_size_min && xblock_counter < sigma_n_array.cols && yblock_counter < sigma_n_array.rows)
         {
-            double sigma_n = icvStandardDeviation(distorted_block_2d, error_mask_2d);
+            double sigma_n = sigma_n_list[entry];
             sigma_n_array.at<double>( yblock_counter, xblock_counter) = sigma_n;
 
             // homogeneous case
@@ -370,6 +416,34 @@ icvGetTodoBlocks(Mat& sampled_img, Mat& sampling_mask, std::vector< std::tuple<
 }
 
 
+// assigns every block of the list to a processing stage such that a block is processed
+// after all preceding blocks within the given radius (in blocks), returns the number of stages
+static int
+icvScheduleBlocks(const std::vector< std::tuple< int, int > >& block_list, int num_blocks, int radius, int blocks_per_column, int blocks_per_line, std::vector<int>& block_stage)
+{
+    Mat stage_map = Mat::zeros(blocks_per_column, blocks_per_line, CV_32S);
+    int num_stages = 0;
+    for (int bl_counter = 0; bl_counter < num_blocks; ++bl_counter)
+    {
+        int yblock_counter = std::get<0>(block_list[bl_counter]);
+        int xblock_counter = std::get<1>(block_list[bl_counter]);
+        int stage = 0;
+        for (int y = std::max(0, yblock_counter - radius); y <= std::min(blocks_per_column - 1, yblock_counter + radius); ++y)
+        {
+            const int* stage_row = stage_map.ptr<int>(y);
+            for (int x = std::max(0, xblock_counter - radius); x <= std::min(blocks_per_line - 1, xblock_counter + radius); ++x)
+            {
+                stage = std::max(stage, stage_row[x]);
+            }
+        }
+        stage_map.at<int>(yblock_counter, xblock_counter) = stage + 1;
+        block_stage[bl_counter] = stage;
+        num_stages = std::max(num_stages, stage + 1);
+    }
+    return num_stages;
+}
+
+
 static void
 icvDetermineProcessingOrder(
     const Mat& _sampled_img, const Mat& _sampling_mask,
@@ -389,6 +463,10 @@ icvDetermineProcessingOrder(
 
     _sampling_mask.convertTo(sampling_mask, CV_64F);
 
+    // weighting tables shared by all blocks
+    Mat frequency_weighting, distance_weighting;
+    icvFrequencyWeighting(fft_size, frequency_weighting);
+
     double threshold_stddev_LUT[3];
     if (channel == "Y")
     {
@@ -433,6 +511,7 @@ icvDetermineProcessingOrder(
     int border_width = 0;
     while (block_size >= block_size_min)
     {
+        icvDistanceWeighting(fft_size, fft_size, fft_size, rho, distance_weighting);
         int blocks_per_column = cvCeil(img_height / block_size);
         int blocks_per_line = cvCeil(img_width / block_size);
         Mat nen_array = Mat::zeros(blocks_per_column, blocks_per_line, CV_64F);
@@ -453,14 +532,27 @@ icvDetermineProcessingOrder(
             set_process_this_block_size.setTo(Scalar(255));
         }
 
+        // minimum and maximum of the sampling mask per block
+        Mat block_min_array(blocks_per_column, blocks_per_line, CV_64F);
+        Mat block_max_array(blocks_per_column, blocks_per_line, CV_64F);
+        parallel_for_(Range(0, blocks_per_column), [&](const Range& range)
+        {
+            for (int yblock_counter = range.start; yblock_counter < range.end; ++yblock_counter)
+            {
+                for (int xblock_counter = 0; xblock_counter < blocks_per_line; ++xblock_counter)
+                {
+                    Mat curr_block = sampling_mask(Range(yblock_counter*block_size, std::min(img_height, (yblock_counter + 1)*block_size)), Range(xblock_counter*block_size, std::min(img_width, (xblock_counter + 1)*block_size)));
+                    minMaxLoc(curr_block, &block_min_array.at<double>(yblock_counter, xblock_counter), &block_max_array.at<double>(yblock_counter, xblock_counter));
+                }
+            }
+        });
+
         // if block to be extrapolated, increase nen of neighboring pixels
         for (int yblock_counter = 0; yblock_counter < blocks_per_column; ++yblock_counter)
         {
             for (int xblock_counter = 0; xblock_counter < blocks_per_line; ++xblock_counter)
             {
-                Mat curr_block = sampling_mask(Range(yblock_counter*block_size, std::min(img_height, (yblock_counter + 1)*block_size)), Range(xblock_counter*block_size, std::min(img_width, (xblock_counter + 1)*block_size)));
-                double min_block, max_block;
-                minMaxLoc(curr_block, &min_block, &max_block);
+                double min_block = block_min_array.at<double>(yblock_counter, xblock_counter);
                 if (min_block == 0)
                 {
                     if (yblock_counter > 0 && xblock_counter > 0)
@@ -504,9 +596,7 @@ icvDetermineProcessingOrder(
         {
             for (int xblock_counter = 0; xblock_counter < blocks_per_line; ++xblock_counter)
             {
-                Mat curr_block = sampling_mask(Range(yblock_counter*block_size, std::min(img_height, (yblock_counter + 1)*block_size)), Range(xblock_counter*block_size, std::min(img_width, (xblock_counter + 1)*block_size)));
-                double min_block, max_block;
-                minMaxLoc(curr_block, &min_block, &max_block);
+                double min_block = block_min_array.at<double>(yblock_counter, xblock_counter);
                 if (min_block != 0)
                 {
                     nen_array.at<double>(yblock_counter, xblock_counter) = -1;
@@ -558,9 +648,7 @@ icvDetermineProcessingOrder(
             {
                 for (int xblock_counter = 0; xblock_counter < blocks_per_line; ++xblock_counter)
                 {
-                    Mat curr_block = sampling_mask(Range(yblock_counter*block_size, std::min(img_height, (yblock_counter + 1)*block_size)), Range(xblock_counter*block_size, std::min(img_width, (xblock_counter + 1)*block_size)));
-                    double min_block, max_block;
-                    minMaxLoc(curr_block, &min_block, &max_block);
+                    double max_block = block_max_array.at<double>(yblock_counter, xblock_counter);
                     if (max_block == 0)
                     {
                         nen_array.at<double>(yblock_counter, xblock_counter)++;
@@ -650,37 +738,65 @@ icvDetermineProcessingOrder(
             {
                 all_blocks_finished = 1;
             }
+
+            // blocks whose extrapolation areas overlap another block of the list are
+            // processed in later stages, keeping the order of the sequential processing
+            std::vector<int> block_stage(max_bl_counter);
+            int num_stages = icvScheduleBlocks(block_list, max_bl_counter, (border_width + block_size - 1) / block_size, blocks_per_column, blocks_per_line, block_stage);
+
             // blockwise extrapolation of all blocks that can be processed in parallel
+            std::vector<int> stage_blocks;
+            for (int stage = 0; stage < num_stages; ++stage)
+            {
+                stage_blocks.clear();
+                for (bl_counter = 0; bl_counter < max_bl_counter; ++bl_counter)
+                {
+                    if (block_stage[bl_counter] == stage)
+                    {
+                        stage_blocks.push_back(bl_counter);
+                    }
+                }
+
+                parallel_for_(Range(0, (int)stage_blocks.size()), [&](const Range& range)
+                {
+                    for (int i = range.start; i < range.end; ++i)
+                    {
+                        int yblock_counter = std::get<0>(block_list[stage_blocks[i]]);
+                        int xblock_counter = std::get<1>(block_list[stage_blocks[i]]);
+
+                        // calculation of the extrapolation area's borders
+                        int left_border = std::min(xblock_counter*block_size, border_width);
+                        int top_border = std::min(yblock_counter*block_size, border_width);
+                        int right_border = std::max(0, std::min(img_width - (xblock_counter + 1)*block_size, border_width));
+                        int bottom_border = std::max(0, std::min(img_height - (yblock_counter + 1)*block_size, border_width));
+
+                        // extract blocks from images
+                        Mat distorted_block_2d = reconstructed_img(Range(yblock_counter*block_size - top_border, std::min(img_height, (yblock_counter*block_size + block_size + bottom_border))), Range(xblock_counter*block_size - left_border, std::min(img_width, (xblock_counter*block_size + block_size + right_border))));
+                        Mat error_mask_2d = sampling_mask(Range(yblock_counter*block_size - top_border, std::min(img_height, (yblock_counter*block_size + block_size + bottom_border))), Range(xblock_counter*block_size - left_border, std::min(img_width, xblock_counter*block_size + block_size + right_border)));
+                        // get actual stddev value as it is needed to estimate the
+                        // best number of iterations
+                        double sigma_n_a = sigma_n_array.at<double>(yblock_counter, xblock_counter);
+
+                        // actual extrapolation
+                        Mat extrapolated_block_2d;
+                        icvExtrapolateBlock(distorted_block_2d, error_mask_2d, fsr_params, rho, sigma_n_a, frequency_weighting, distance_weighting, extrapolated_block_2d);
+
+                        // update image and mask
+                        extrapolated_block_2d(Range(top_border, extrapolated_block_2d.rows - bottom_border), Range(left_border, extrapolated_block_2d.cols - right_border)).copyTo(reconstructed_img(Range(yblock_counter*block_size, std::min(img_height, (yblock_counter + 1)*block_size)), Range(xblock_counter*block_size, std::min(img_width, (xblock_counter + 1)*block_size))));
+
+                        Mat signs;
+                        icvSgnMat(error_mask_2d(Range(top_border, error_mask_2d.rows - bottom_border), Range(left_border, error_mask_2d.cols - right_border)), signs);
+                        Mat tmp_mask = error_mask_2d(Range(top_border, error_mask_2d.rows - bottom_border), Range(left_border, error_mask_2d.cols - right_border)) + (1 - signs) *conc_weighting;
+                        tmp_mask.copyTo(sampling_mask(Range(yblock_counter*block_size, std::min(img_height, (yblock_counter + 1)*block_size)), Range(xblock_counter*block_size, std::min(img_width, (xblock_counter + 1)*block_size))));
+                    }
+                });
+            }
+
             for (bl_counter = 0; bl_counter < max_bl_counter; ++bl_counter)
             {
                 int yblock_counter = std::get<0>(block_list[bl_counter]);
                 int xblock_counter = std::get<1>(block_list[bl_counter]);
 
-                // calculation of the extrapolation area's borders
-                int left_border = std::min(xblock_counter*block_size, border_width);
-                int top_border = std::min(yblock_counter*block_size, border_width);
-                int right_border = std::max(0, std::min(img_width - (xblock_counter + 1)*block_size, border_width));
-                int bottom_border = std::max(0, std::min(img_height - (yblock_counter + 1)*block_size, border_width));
-
-                // extract blocks from images
-                Mat distorted_block_2d = reconstructed_img(Range(yblock_counter*block_size - top_border, std::min(img_height, (yblock_counter*block_size + block_size + bottom_border))), Range(xblock_counter*block_size - left_border, std::min(img_width, (xblock_counter*block_size + block_size + right_border))));
-                Mat error_mask_2d = sampling_mask(Range(yblock_counter*block_size - top_border, std::min(img_height, (yblock_counter*block_size + block_size + bottom_border))), Range(xblock_counter*block_size - left_border, std::min(img_width, xblock_counter*block_size + block_size + right_border)));
-                // get actual stddev value as it is needed to estimate the
-                // best number of iterations
-                double sigma_n_a = sigma_n_array.at<double>(yblock_counter, xblock_counter);
-
-                // actual extrapolation
-                Mat extrapolated_block_2d;
-                icvExtrapolateBlock(distorted_block_2d, error_mask_2d, fsr_params, rho, sigma_n_a, extrapolated_block_2d);
-
-                // update image and mask
-                extrapolated_block_2d(Range(top_border, extrapolated_block_2d.rows - bottom_border), Range(left_border, extrapolated_block_2d.cols - right_border)).copyTo(reconstructed_img(Range(yblock_counter*block_size, std::min(img_height, (yblock_counter + 1)*block_size)), Range(xblock_counter*block_size, std::min(img_width, (xblock_counter + 1)*block_size))));
-
-                Mat signs;
-                icvSgnMat(error_mask_2d(Range(top_border, error_mask_2d.rows - bottom_border), Range(left_border, error_mask_2d.cols - right_border)), signs);
-                Mat tmp_mask = error_mask_2d(Range(top_border, error_mask_2d.rows - bottom_border), Range(left_border, error_mask_2d.cols - right_border)) + (1 - signs) *conc_weighting;
-                tmp_mask.copyTo(sampling_mask(Range(yblock_counter*block_size, std::min(img_height, (yblock_counter + 1)*block_size)), Range(xblock_counter*block_size, std::min(img_width, (xblock_counter + 1)*block_size))));
-
                 // update nen-array
                 nen_array.at<double>(yblock_counter, xblock_counter) = -1;
                 if (yblock_counter > 0 && xblock_counter > 0)
@@ -715,7 +831,6 @@ icvDetermineProcessingOrder(
                 {
                     nen_array.at<double>(yblock_counter + 1, xblock_counter + 1)--;
                 }
-
             }
 
         }
@@ -168,6 +168,83 @@ class LearningBasedWBImpl : public LearningBasedWB
     }
 };
 
+/* Computes the mask of non-saturated pixels and the maximum pixel value
+ * over the pixel range [start, end)
+ */
+static int getSaturationMask(const uchar *src_ptr, uchar *mask_ptr, int start, int end, int thresh)
+{
+    int i = start;
+    int local_max;
+    int src_max_val = -1;
+#if CV_SIMD128
+    v_uint8x16 v_inB, v_inG, v_inR, v_local_max;
+    v_uint8x16 v_global_max = v_setall_u8(0), v_mask, v_thresh = v_setall_u8((uchar)thresh);
+    for (; i < end - 15; i += 16)
+    {
+        v_load_deinterleave(src_ptr + 3 * i, v_inB, v_inG, v_inR);
+        v_local_max = v_max(v_inB, v_max(v_inG, v_inR));
+        v_global_max = v_max(v_local_max, v_global_max);
+        v_mask = (v_lt(v_local_max, v_thresh));
+        v_store(mask_ptr + i, v_mask);
+    }
+    uchar global_max[16];
+    v_store(global_max, v_global_max);
+    for (int j = 0; j < 16; j++)
+    {
+        if (global_max[j] > src_max_val)
+            src_max_val = global_max[j];
+    }
+#endif
+    for (; i < end; i++)
+    {
+        local_max = max(src_ptr[3 * i], max(src_ptr[3 * i + 1], src_ptr[3 * i + 2]));
+        if (local_max > src_max_val)
+            src_max_val = local_max;
+        if (local_max < thresh)
+            mask_ptr[i] = 255;
+        else
+            mask_ptr[i] = 0;
+    }
+    return src_max_val;
+}
+
+static int getSaturationMask(const ushort *src_ptr, uchar *mask_ptr, int start, int end, int thresh)
+{
+    int i = start;
+    int local_max;
+    int src_max_val = -1;
+#if CV_SIMD128
+    v_uint16x8 v_inB, v_inG, v_inR, v_local_max;
+    v_uint16x8 v_global_max = v_setall_u16(0), v_mask, v_thresh = v_setall_u16((ushort)thresh);
+    for (; i < end - 7; i += 8)
+    {
+        v_load_deinterleave(src_ptr + 3 * i, v_inB, v_inG, v_inR);
+        v_local_max = v_max(v_inB, v_max(v_inG, v_inR));
+        v_global_max = v_max(v_local_max, v_global_max);
+        v_mask = (v_lt(v_local_max, v_thresh));
+        v_pack_store(mask_ptr + i, v_mask);
+    }
+    ushort global_max[8];
+    v_store(global_max, v_global_max);
+    for (int j = 0; j < 8; j++)
+    {
+        if (global_max[j] > src_max_val)
+            src_max_val = global_max[j];
+    }
+#endif
+    for (; i < end; i++)
+    {
+        local_max = max(src_ptr[3 * i], max(src_ptr[3 * i + 1], src_ptr[3 * i + 2]));
+        if (local_max > src_max_val)
+            src_max_val = local_max;
+        if (local_max < thresh)
+            mask_ptr[i] = 255;
+        else
+            mask_ptr[i] = 0;
+    }
+    return src_max_val;
+}
+
 /* Computes a mask for non-saturated pixels and maximum pixel value
  * which are then used for feature computation
  */
@@ -175,275 +252,292 @@ void LearningBasedWBImpl::preprocessing(Mat &src)
 {
     mask.create(src.size(), CV_8U);
     uchar *mask_ptr = mask.ptr<uchar>();
-    int src_len = src.rows * src.cols;
     int thresh = (int)(saturation_thresh * range_max_val);
-    int i = 0;
-    int local_max;
     src_max_val = -1;
 
-    if (src.type() == CV_8UC3)
+    Mutex mtx;
+    parallel_for_(Range(0, src.rows), [&](const Range &range)
     {
-        uchar *src_ptr = src.ptr<uchar>();
-#if CV_SIMD128
-        v_uint8x16 v_inB, v_inG, v_inR, v_local_max;
-        v_uint8x16 v_global_max = v_setall_u8(0), v_mask, v_thresh = v_setall_u8((uchar)thresh);
-        for (; i < src_len - 15; i += 16)
-        {
-            v_load_deinterleave(src_ptr + 3 * i, v_inB, v_inG, v_inR);
-            v_local_max = v_max(v_inB, v_max(v_inG, v_inR));
-            v_global_max = v_max(v_local_max, v_global_max);
-            v_mask = (v_lt(v_local_max, v_thresh));
-            v_store(mask_ptr + i, v_mask);
-        }
-        uchar global_max[16];
-        v_store(global_max, v_global_max);
-        for (int j = 0; j < 16; j++)
-        {
-            if (global_max[j] > src_max_val)
-                src_max_val = global_max[j];
-        }
-#endif
-        for (; i < src_len; i++)
-        {
-            local_max = max(src_ptr[3 * i], max(src_ptr[3 * i + 1], src_ptr[3 * i + 2]));
-            if (local_max > src_max_val)
-                src_max_val = local_max;
-            if (local_max < thresh)
-                mask_ptr[i] = 255;
-            else
-                mask_ptr[i] = 0;
-        }
+        int start = range.start * src.cols, end = range.end * src.cols;
+        int local_max_val = -1;
+        if (src.type() == CV_8UC3)
+            local_max_val = getSaturationMask(src.ptr<uchar>(), mask_ptr, start, end, thresh);
+        else if (src.type() == CV_16UC3)
+            local_max_val = getSaturationMask(src.ptr<ushort>(), mask_ptr, start, end, thresh);
+
+        AutoLock lock(mtx);
+        src_max_val = max(src_max_val, local_max_val);
+    });
+}
+
+/* Channel sums over the non-saturated pixels of a range and the brightest of them.
+ * The brightest pixel (first one with the largest channel sum) is tracked for every
+ * SIMD lane separately, so that results of consecutive ranges merged in order are
+ * identical to a single pass over the whole image.
+ */
+struct ColorStats
+{
+    enum { MAX_LANES = 8 };
+
+    uint64 sumB, sumG, sumR;
+    uint max_sum[MAX_LANES];
+    uint brightestB[MAX_LANES], brightestG[MAX_LANES], brightestR[MAX_LANES];
+
+    ColorStats() : sumB(0), sumG(0), sumR(0)
+    {
+        for (int j = 0; j < MAX_LANES; j++)
+            max_sum[j] = brightestB[j] = brightestG[j] = brightestR[j] = 0;
     }
-    else if (src.type() == CV_16UC3)
+
+    // merges the statistics of the range following the current one
+    void merge(const ColorStats &next)
     {
-        ushort *src_ptr = src.ptr<ushort>();
-#if CV_SIMD128
-        v_uint16x8 v_inB, v_inG, v_inR, v_local_max;
-        v_uint16x8 v_global_max = v_setall_u16(0), v_mask, v_thresh = v_setall_u16((ushort)thresh);
-        for (; i < src_len - 7; i += 8)
+        sumB += next.sumB;
+        sumG += next.sumG;
+        sumR += next.sumR;
+        for (int j = 0; j < MAX_LANES; j++)
         {
-            v_load_deinterleave(src_ptr + 3 * i, v_inB, v_inG, v_inR);
-            v_local_max = v_max(v_inB, v_max(v_inG, v_inR));
-            v_global_max = v_max(v_local_max, v_global_max);
-            v_mask = (v_lt(v_local_max, v_thresh));
-            v_pack_store(mask_ptr + i, v_mask);
+            if (next.max_sum[j] > max_sum[j])
+            {
+                max_sum[j] = next.max_sum[j];
+                brightestB[j] = next.brightestB[j];
+                brightestG[j] = next.brightestG[j];
+                brightestR[j] = next.brightestR[j];
+            }
         }
-        ushort global_max[8];
-        v_store(global_max, v_global_max);
-        for (int j = 0; j < 8; j++)
+    }
+};
+
+template <typename T>
+static void accumulateColorStats(const T *src_ptr, const uchar *mask_ptr, int i, int end, ColorStats &stats)
+{
+    for (; i < end; i++)
+    {
+        uint sum_val = src_ptr[3 * i] + src_ptr[3 * i + 1] + src_ptr[3 * i + 2];
+        if (mask_ptr[i])
         {
-            if (global_max[j] > src_max_val)
-                src_max_val = global_max[j];
+            stats.sumB += src_ptr[3 * i];
+            stats.sumG += src_ptr[3 * i + 1];
+            stats.sumR += src_ptr[3 * i + 2];
+            if (sum_val > stats.max_sum[0])
+            {
+                stats.max_sum[0] = sum_val;
+                stats.brightestB[0] = src_ptr[3 * i];
+                stats.brightestG[0] = src_ptr[3 * i + 1];
+                stats.brightestR[0] = src_ptr[3 * i + 2];
+            }
         }
+    }
+}
+
+static void getColorStats(const uchar *src_ptr, const uchar *mask_ptr, int start, int end, ColorStats &stats)
+{
+    int i = start;
+#if CV_SIMD128
+    v_uint16x8 v_max_sum = v_setall_u16(0), v_brightestR = v_setall_u16(0), v_brightestG = v_setall_u16(0), v_brightestB = v_setall_u16(0);
+    v_uint32x4 v_SB = v_setzero_u32(), v_SG = v_setzero_u32(), v_SR = v_setzero_u32();
+    for (; i < end - 15; i += 16)
+    {
+        v_uint8x16 v_inB, v_inG, v_inR;
+        v_load_deinterleave(src_ptr + 3 * i, v_inB, v_inG, v_inR);
+        v_uint8x16 v_mask = v_load(mask_ptr + i);
+
+        v_inB = v_and(v_inB, v_mask);
+        v_inG = v_and(v_inG, v_mask);
+        v_inR = v_and(v_inR, v_mask);
+
+        v_uint16x8 v_sR1, v_sR2, v_sG1, v_sG2, v_sB1, v_sB2;
+        v_expand(v_inB, v_sB1, v_sB2);
+        v_expand(v_inG, v_sG1, v_sG2);
+        v_expand(v_inR, v_sR1, v_sR2);
+
+        // update the brightest (R,G,B) tuple (process left half):
+        v_uint16x8 v_sum = v_add(v_add(v_sB1, v_sG1), v_sR1);
+        v_uint16x8 v_max_mask = (v_gt(v_sum, v_max_sum));
+        v_max_sum = v_max(v_sum, v_max_sum);
+        v_brightestB = v_add(v_and(v_sB1, v_max_mask), v_and(v_brightestB, v_not(v_max_mask)));
+        v_brightestG = v_add(v_and(v_sG1, v_max_mask), v_and(v_brightestG, v_not(v_max_mask)));
+        v_brightestR = v_add(v_and(v_sR1, v_max_mask), v_and(v_brightestR, v_not(v_max_mask)));
+
+        // update the brightest (R,G,B) tuple (process right half):
+        v_sum = v_add(v_add(v_sB2, v_sG2), v_sR2);
+        v_max_mask = (v_gt(v_sum, v_max_sum));
+        v_max_sum = v_max(v_sum, v_max_sum);
+        v_brightestB = v_add(v_and(v_sB2, v_max_mask), v_and(v_brightestB, v_not(v_max_mask)));
+        v_brightestG = v_add(v_and(v_sG2, v_max_mask), v_and(v_brightestG, v_not(v_max_mask)));
+        v_brightestR = v_add(v_and(v_sR2, v_max_mask), v_and(v_brightestR, v_not(v_max_mask)));
+
+        // update sums:
+        v_sB1 = v_add(v_sB1, v_sB2);
+        v_sG1 = v_add(v_sG1, v_sG2);
+        v_sR1 = v_add(v_sR1, v_sR2);
+
+        v_uint32x4 v_uint1, v_uint2;
+        v_expand(v_sB1, v_uint1, v_uint2);
+        v_SB = v_add(v_SB, v_add(v_uint1, v_uint2));
+        v_expand(v_sG1, v_uint1, v_uint2);
+        v_SG = v_add(v_SG, v_add(v_uint1, v_uint2));
+        v_expand(v_sR1, v_uint1, v_uint2);
+        v_SR = v_add(v_SR, v_add(v_uint1, v_uint2));
+    }
+    stats.sumB = v_reduce_sum(v_SB);
+    stats.sumG = v_reduce_sum(v_SG);
+    stats.sumR = v_reduce_sum(v_SR);
+    ushort brightestB_arr[8], brightestG_arr[8], brightestR_arr[8], max_sum_arr[8];
+    v_store(brightestB_arr, v_brightestB);
+    v_store(brightestG_arr, v_brightestG);
+    v_store(brightestR_arr, v_brightestR);
+    v_store(max_sum_arr, v_max_sum);
+    for (int j = 0; j < 8; j++)
+    {
+        stats.max_sum[j] = max_sum_arr[j];
+        stats.brightestB[j] = brightestB_arr[j];
+        stats.brightestG[j] = brightestG_arr[j];
+        stats.brightestR[j] = brightestR_arr[j];
+    }
 #endif
-        for (; i < src_len; i++)
-        {
-            local_max = max(src_ptr[3 * i], max(src_ptr[3 * i + 1], src_ptr[3 * i + 2]));
-            if (local_max > src_max_val)
-                src_max_val = local_max;
-            if (local_max < thresh)
-                mask_ptr[i] = 255;
-            else
-                mask_ptr[i] = 0;
-        }
+    accumulateColorStats(src_ptr, mask_ptr, i, end, stats);
+}
+
+static void getColorStats(const ushort *src_ptr, const uchar *mask_ptr, int start, int end, ColorStats &stats)
+{
+    int i = start;
+#if CV_SIMD128
+    const v_uint16x8 v_mask_lower = v_setall_u16(255);
+    v_uint32x4 v_max_sum = v_setall_u32(0), v_brightestR = v_setall_u32(0), v_brightestG = v_setall_u32(0), v_brightestB = v_setall_u32(0);
+    v_uint64x2 v_SB = v_setzero_u64(), v_SG = v_setzero_u64(), v_SR = v_setzero_u64();
+    for (; i < end - 7; i += 8)
+    {
+        v_uint16x8 v_inB, v_inG, v_inR;
+        v_load_deinterleave(src_ptr + 3 * i, v_inB, v_inG, v_inR);
+        v_uint16x8 v_mask = v_load_expand(mask_ptr + i);
+        v_mask = v_or(v_mask, v_shl<8>(v_and(v_mask, v_mask_lower)));
+
+        v_inB = v_and(v_inB, v_mask);
+        v_inG = v_and(v_inG, v_mask);
+        v_inR = v_and(v_inR, v_mask);
+
+        v_uint32x4 v_iR1, v_iR2, v_iG1, v_iG2, v_iB1, v_iB2;
+        v_expand(v_inB, v_iB1, v_iB2);
+        v_expand(v_inG, v_iG1, v_iG2);
+        v_expand(v_inR, v_iR1, v_iR2);
+
+        // update the brightest (R,G,B) tuple (process left half):
+        v_uint32x4 v_sum = v_add(v_add(v_iB1, v_iG1), v_iR1);
+        v_uint32x4 v_max_mask = (v_gt(v_sum, v_max_sum));
+        v_max_sum = v_max(v_sum, v_max_sum);
+        v_brightestB = v_add(v_and(v_iB1, v_max_mask), v_and(v_brightestB, v_not(v_max_mask)));
+        v_brightestG = v_add(v_and(v_iG1, v_max_mask), v_and(v_brightestG, v_not(v_max_mask)));
+        v_brightestR = v_add(v_and(v_iR1, v_max_mask), v_and(v_brightestR, v_not(v_max_mask)));
+
+        // update the brightest (R,G,B) tuple (process right half):
+        v_sum = v_add(v_add(v_iB2, v_iG2), v_iR2);
+        v_max_mask = (v_gt(v_sum, v_max_sum));
+        v_max_sum = v_max(v_sum, v_max_sum);
+        v_brightestB = v_add(v_and(v_iB2, v_max_mask), v_and(v_brightestB, v_not(v_max_mask)));
+        v_brightestG = v_add(v_and(v_iG2, v_max_mask), v_and(v_brightestG, v_not(v_max_mask)));
+        v_brightestR = v_add(v_and(v_iR2, v_max_mask), v_and(v_brightestR, v_not(v_max_mask)));
+
+        // update sums:
+        v_iB1 = v_add(v_iB1, v_iB2);
+        v_iG1 = v_add(v_iG1, v_iG2);
+        v_iR1 = v_add(v_iR1, v_iR2);
+        v_uint64x2 v_uint64_1, v_uint64_2;
+        v_expand(v_iB1, v_uint64_1, v_uint64_2);
+        v_SB = v_add(v_SB, v_add(v_uint64_1, v_uint64_2));
+        v_expand(v_iG1, v_uint64_1, v_uint64_2);
+        v_SG = v_add(v_SG, v_add(v_uint64_1, v_uint64_2));
+        v_expand(v_iR1, v_uint64_1, v_uint64_2);
+        v_SR = v_add(v_SR, v_add(v_uint64_1, v_uint64_2));
     }
+    uint64 sum_arr[2];
+    v_store(sum_arr, v_SB);
+    stats.sumB = sum_arr[0] + sum_arr[1];
+    v_store(sum_arr, v_SG);
+    stats.sumG = sum_arr[0] + sum_arr[1];
+    v_store(sum_arr, v_SR);
+    stats.sumR = sum_arr[0] + sum_arr[1];
+    uint brightestB_arr[4], brightestG_arr[4], brightestR_arr[4], max_sum_arr[4];
+    v_store(brightestB_arr, v_brightestB);
+    v_store(brightestG_arr, v_brightestG);
+    v_store(brightestR_arr, v_brightestR);
+    v_store(max_sum_arr, v_max_sum);
+    for (int j = 0; j < 4; j++)
+    {
+        stats.max_sum[j] = max_sum_arr[j];
+        stats.brightestB[j] = brightestB_arr[j];
+        stats.brightestG[j] = brightestG_arr[j];
+        stats.brightestR[j] = brightestR_arr[j];
+    }
+#endif
+    accumulateColorStats(src_ptr, mask_ptr, i, end, stats);
 }
 
 void LearningBasedWBImpl::getAverageAndBrightestColorChromaticity(Vec2f &average_chromaticity,
                                                                   Vec2f &brightest_chromaticity, Mat &src)
 {
-    int i = 0;
     int src_len = src.rows * src.cols;
-    uchar *mask_ptr = mask.ptr<uchar>();
-    uint brightestB = 0, brightestG = 0, brightestR = 0;
-    uint max_sum = 0;
-    if (src.type() == CV_8UC3)
-    {
-        uint sumB = 0, sumG = 0, sumR = 0;
-        uchar *src_ptr = src.ptr<uchar>();
+    const uchar *mask_ptr = mask.ptr<uchar>();
+
+    // stripes consist of whole SIMD blocks, the remaining pixels are processed
+    // after the lanes are merged, exactly like in a single pass
 #if CV_SIMD128
-        v_uint16x8 v_max_sum = v_setall_u16(0), v_brightestR = v_setall_u16(0), v_brightestG = v_setall_u16(0), v_brightestB = v_setall_u16(0);
-        v_uint32x4 v_SB = v_setzero_u32(), v_SG = v_setzero_u32(), v_SR = v_setzero_u32();
-        for (; i < src_len - 15; i += 16)
-        {
-            v_uint8x16 v_inB, v_inG, v_inR;
-            v_load_deinterleave(src_ptr + 3 * i, v_inB, v_inG, v_inR);
-            v_uint8x16 v_mask = v_load(mask_ptr + i);
-
-            v_inB = v_and(v_inB, v_mask);
-            v_inG = v_and(v_inG, v_mask);
-            v_inR = v_and(v_inR, v_mask);
-
-            v_uint16x8 v_sR1, v_sR2, v_sG1, v_sG2, v_sB1, v_sB2;
-            v_expand(v_inB, v_sB1, v_sB2);
-            v_expand(v_inG, v_sG1, v_sG2);
-            v_expand(v_inR, v_sR1, v_sR2);
-
-            // update the brightest (R,G,B) tuple (process left half):
-            v_uint16x8 v_sum = v_add(v_add(v_sB1, v_sG1), v_sR1);
-            v_uint16x8 v_max_mask = (v_gt(v_sum, v_max_sum));
-            v_max_sum = v_max(v_sum, v_max_sum);
-            v_brightestB = v_add(v_and(v_sB1, v_max_mask), v_and(v_brightestB, v_not(v_max_mask)));
-            v_brightestG = v_add(v_and(v_sG1, v_max_mask), v_and(v_brightestG, v_not(v_max_mask)));
-            v_brightestR = v_add(v_and(v_sR1, v_max_mask), v_and(v_brightestR, v_not(v_max_mask)));
-
-            // update the brightest (R,G,B) tuple (process right half):
-            v_sum = v_add(v_add(v_sB2, v_sG2), v_sR2);
-            v_max_mask = (v_gt(v_sum, v_max_sum));
-            v_max_sum = v_max(v_sum, v_max_sum);
-            v_brightestB = v_add(v_and(v_sB2, v_max_mask), v_and(v_brightestB, v_not(v_max_mask)));
-            v_brightestG = v_add(v_and(v_sG2, v_max_mask), v_and(v_brightestG, v_not(v_max_mask)));
-            v_brightestR = v_add(v_and(v_sR2, v_max_mask), v_and(v_brightestR, v_not(v_max_mask)));
-
-            // update sums:
-            v_sB1 = v_add(v_sB1, v_sB2);
-            v_sG1 = v_add(v_sG1, v_sG2);
-            v_sR1 = v_add(v_sR1, v_sR2);
-
-            v_uint32x4 v_uint1, v_uint2;
-            v_expand(v_sB1, v_uint1, v_uint2);
-            v_SB = v_add(v_SB, v_add(v_uint1, v_uint2));
-            v_expand(v_sG1, v_uint1, v_uint2);
-            v_SG = v_add(v_SG, v_add(v_uint1, v_uint2));
-            v_expand(v_sR1, v_uint1, v_uint2);
-            v_SR = v_add(v_SR, v_add(v_uint1, v_uint2));
-        }
-        sumB = v_reduce_sum(v_SB);
-        sumG = v_reduce_sum(v_SG);
-        sumR = v_reduce_sum(v_SR);
-        ushort brightestB_arr[8], brightestG_arr[8], brightestR_arr[8], max_sum_arr[8];
-        v_store(brightestB_arr, v_brightestB);
-        v_store(brightestG_arr, v_brightestG);
-        v_store(brightestR_arr, v_brightestR);
-        v_store(max_sum_arr, v_max_sum);
-        for (int j = 0; j < 8; j++)
+    const int block_len = src.type() == CV_8UC3 ? 16 : 8;
+#else
+    const int block_len = 1;
+#endif
+    const int num_blocks = src_len / block_len;
+    const int num_stripes = max(1, min(num_blocks, 4 * getNumThreads()));
+    vector<ColorStats> stripe_stats(num_stripes);
+    parallel_for_(Range(0, num_stripes), [&](const Range &range)
+    {
+        for (int s = range.start; s < range.end; s++)
         {
-            if (max_sum_arr[j] > max_sum)
-            {
-                max_sum = max_sum_arr[j];
-                brightestB = brightestB_arr[j];
-                brightestG = brightestG_arr[j];
-                brightestR = brightestR_arr[j];
-            }
+            int start = block_len * (int)((int64)num_blocks * s / num_stripes);
+            int end = block_len * (int)((int64)num_blocks * (s + 1) / num_stripes);
+            if (src.type() == CV_8UC3)
+                getColorStats(src.ptr<uchar>(), mask_ptr, start, end, stripe_stats[s]);
+            else
+                getColorStats(src.ptr<ushort>(), mask_ptr, start, end, stripe_stats[s]);
         }
-#endif
-        for (; i < src_len; i++)
+    });
+
+    ColorStats stats;
+    for (int s = 0; s < num_stripes; s++)
+        stats.merge(stripe_stats[s]);
+
+    ColorStats total;
+    total.sumB = stats.sumB;
+    total.sumG = stats.sumG;
+    total.sumR = stats.sumR;
+    for (int j = 0; j < ColorStats::MAX_LANES; j++)
+    {
+        if (stats.max_sum[j] > total.max_sum[0])
         {
-            uint sum_val = src_ptr[3 * i] + src_ptr[3 * i + 1] + src_ptr[3 * i + 2];
-            if (mask_ptr[i])
-            {
-                sumB += src_ptr[3 * i];
-                sumG += src_ptr[3 * i + 1];
-                sumR += src_ptr[3 * i + 2];
-                if (sum_val > max_sum)
-                {
-                    max_sum = sum_val;
-                    brightestB = src_ptr[3 * i];
-                    brightestG = src_ptr[3 * i + 1];
-                    brightestR = src_ptr[3 * i + 2];
-                }
-            }
+            total.max_sum[0] = stats.max_sum[j];
+            total.brightestB[0] = stats.brightestB[j];
+            total.brightestG[0] = stats.brightestG[j];
+            total.brightestR[0] = stats.brightestR[j];
         }
+    }
+    if (src.type() == CV_8UC3)
+        accumulateColorStats(src.ptr<uchar>(), mask_ptr, num_blocks * block_len, src_len, total);
+    else
+        accumulateColorStats(src.ptr<ushort>(), mask_ptr, num_blocks * block_len, src_len, total);
+
+    if (src.type() == CV_8UC3)
+    {
+        uint sumB = (uint)total.sumB, sumG = (uint)total.sumG, sumR = (uint)total.sumR;
         double maxRGB = (double)max(sumR, max(sumG, sumB));
         getChromaticity(average_chromaticity, (float)(sumR / maxRGB), (float)(sumG / maxRGB), (float)(sumB / maxRGB));
-        getChromaticity(brightest_chromaticity, (float)brightestR, (float)brightestG, (float)brightestB);
     }
-    else if (src.type() == CV_16UC3)
+    else
     {
-        uint64 sumB = 0, sumG = 0, sumR = 0;
-        ushort *src_ptr = src.ptr<ushort>();
-#if CV_SIMD128
-        const v_uint16x8 v_mask_lower = v_setall_u16(255);
-        v_uint32x4 v_max_sum = v_setall_u32(0), v_brightestR = v_setall_u32(0), v_brightestG = v_setall_u32(0), v_brightestB = v_setall_u32(0);
-        v_uint64x2 v_SB = v_setzero_u64(), v_SG = v_setzero_u64(), v_SR = v_setzero_u64();
-        for (; i < src_len - 7; i += 8)
-        {
-            v_uint16x8 v_inB, v_inG, v_inR;
-            v_load_deinterleave(src_ptr + 3 * i, v_inB, v_inG, v_inR);
-            v_uint16x8 v_mask = v_load_expand(mask_ptr + i);
-            v_mask = v_or(v_mask, v_shl<8>(v_and(v_mask, v_mask_lower)));
-
-            v_inB = v_and(v_inB, v_mask);
-            v_inG = v_and(v_inG, v_mask);
-            v_inR = v_and(v_inR, v_mask);
-
-            v_uint32x4 v_iR1, v_iR2, v_iG1, v_iG2, v_iB1, v_iB2;
-            v_expand(v_inB, v_iB1, v_iB2);
-            v_expand(v_inG, v_iG1, v_iG2);
-            v_expand(v_inR, v_iR1, v_iR2);
-
-            // update the brightest (R,G,B) tuple (process left half):
-            v_uint32x4 v_sum = v_add(v_add(v_iB1, v_iG1), v_iR1);
-            v_uint32x4 v_max_mask = (v_gt(v_sum, v_max_sum));
-            v_max_sum = v_max(v_sum, v_max_sum);
-            v_brightestB = v_add(v_and(v_iB1, v_max_mask), v_and(v_brightestB, v_not(v_max_mask)));
-            v_brightestG = v_add(v_and(v_iG1, v_max_mask), v_and(v_brightestG, v_not(v_max_mask)));
-            v_brightestR = v_add(v_and(v_iR1, v_max_mask), v_and(v_brightestR, v_not(v_max_mask)));
-
-            // update the brightest (R,G,B) tuple (process right half):
-            v_sum = v_add(v_add(v_iB2, v_iG2), v_iR2);
-            v_max_mask = (v_gt(v_sum, v_max_sum));
-            v_max_sum = v_max(v_sum, v_max_sum);
-            v_brightestB = v_add(v_and(v_iB2, v_max_mask), v_and(v_brightestB, v_not(v_max_mask)));
-            v_brightestG = v_add(v_and(v_iG2, v_max_mask), v_and(v_brightestG, v_not(v_max_mask)));
-            v_brightestR = v_add(v_and(v_iR2, v_max_mask), v_and(v_brightestR, v_not(v_max_mask)));
-
-            // update sums:
-            v_iB1 = v_add(v_iB1, v_iB2);
-            v_iG1 = v_add(v_iG1, v_iG2);
-            v_iR1 = v_add(v_iR1, v_iR2);
-            v_uint64x2 v_uint64_1, v_uint64_2;
-            v_expand(v_iB1, v_uint64_1, v_uint64_2);
-            v_SB = v_add(v_SB, v_add(v_uint64_1, v_uint64_2));
-            v_expand(v_iG1, v_uint64_1, v_uint64_2);
-            v_SG = v_add(v_SG, v_add(v_uint64_1, v_uint64_2));
-            v_expand(v_iR1, v_uint64_1, v_uint64_2);
-            v_SR = v_add(v_SR, v_add(v_uint64_1, v_uint64_2));
-        }
-        uint64 sum_arr[2];
-        v_store(sum_arr, v_SB);
-        sumB = sum_arr[0] + sum_arr[1];
-        v_store(sum_arr, v_SG);
-        sumG = sum_arr[0] + sum_arr[1];
-        v_store(sum_arr, v_SR);
-        sumR = sum_arr[0] + sum_arr[1];
-        uint brightestB_arr[4], brightestG_arr[4], brightestR_arr[4], max_sum_arr[4];
-        v_store(brightestB_arr, v_brightestB);
-        v_store(brightestG_arr, v_brightestG);
-        v_store(brightestR_arr, v_brightestR);
-        v_store(max_sum_arr, v_max_sum);
-        for (int j = 0; j < 4; j++)
-        {
-            if (max_sum_arr[j] > max_sum)
-            {
-                max_sum = max_sum_arr[j];
-                brightestB = brightestB_arr[j];
-                brightestG = brightestG_arr[j];
-                brightestR = brightestR_arr[j];
-            }
-        }
-#endif
-        for (; i < src_len; i++)
-        {
-            uint sum_val = src_ptr[3 * i] + src_ptr[3 * i + 1] + src_ptr[3 * i + 2];
-            if (mask_ptr[i])
-            {
-                sumB += src_ptr[3 * i];
-                sumG += src_ptr[3 * i + 1];
-                sumR += src_ptr[3 * i + 2];
-                if (sum_val > max_sum)
-                {
-                    max_sum = sum_val;
-                    brightestB = src_ptr[3 * i];
-                    brightestG = src_ptr[3 * i + 1];
-                    brightestR = src_ptr[3 * i + 2];
-                }
-            }
-        }
+        uint64 sumB = total.sumB, sumG = total.sumG, sumR = total.sumR;
         double maxRGB = (double)max(sumR, max(sumG, sumB));
         getChromaticity(average_chromaticity, (float)(sumR / maxRGB), (float)(sumG / maxRGB), (float)(sumB / maxRGB));
-        getChromaticity(brightest_chromaticity, (float)brightestR, (float)brightestG, (float)brightestB);
     }
+    getChromaticity(brightest_chromaticity, (float)total.brightestR[0], (float)total.brightestG[0], (float)total.brightestB[0]);
 }
 
 /* Returns the most high-density point (i.e. mode) of the color palette.
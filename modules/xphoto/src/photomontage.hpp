@@ -88,6 +88,8 @@ private:
 
     std::vector <labelTp> &labelSeq;                   // current best labeling
 
+    cv::TLSData <GCGraph <TWeight> > graphs;           // per-thread graphs reused between expansions
+
     TWeight singleExpansion(const int alpha);          // single neighbor computing
 
     class ParallelExpansion : public cv::ParallelLoopBody
@@ -169,7 +171,9 @@ setWeights(GCGraph <TWeight> &graph, const int idx1, const int idx2,
 template <typename Tp> TWeight Photomontage <Tp>::
 singleExpansion(const int alpha)
 {
-    GCGraph <TWeight> graph( 3*int(pointSeq.size()), 4*int(pointSeq.size()) );
+    GCGraph <TWeight> &graph = *graphs.get();
+    graph.clear();
+    graph.create( 3*int(pointSeq.size()), 4*int(pointSeq.size()) );
 
     /** Terminal links **/
     for (size_t i = 0; i < maskSeq.size(); ++i)
@@ -30,6 +30,75 @@ void log_(const Mat& src, Mat& dst)
     log(dst, dst);
 }
 
+// Self guided filter of a single channel image, computed on a downsampled image and upsampled back.
+// The window radius follows sigma_space and the regularization follows sigma_color, so that
+// edges larger than sigma_color are preserved as with the bilateral filter.
+static void fastGuidedFilter(const Mat& src, Mat& dst, float sigma_color, float sigma_space)
+{
+    const int radius = std::max(1, cvRound(2.0f * sigma_space));
+    const int scale = std::max(1, radius / 2);
+    const Size ksize(2 * (radius / scale) + 1, 2 * (radius / scale) + 1);
+    const float eps = sigma_color * sigma_color;
+
+    Mat small_src;
+    if (scale > 1)
+        resize(src, small_src, Size((src.cols + scale - 1) / scale, (src.rows + scale - 1) / scale), 0, 0, INTER_AREA);
+    else
+        small_src = src;
+
+    Mat mean_src, sqr_mean_src;
+    boxFilter(small_src, mean_src, CV_32F, ksize, Point(-1, -1), true, BORDER_REFLECT);
+    sqrBoxFilter(small_src, sqr_mean_src, CV_32F, ksize, Point(-1, -1), true, BORDER_REFLECT);
+
+    // Coefficients of the local linear models, a * I + b
+    Mat a(small_src.size(), CV_32F), b(small_src.size(), CV_32F);
+    parallel_for_(Range(0, small_src.rows), [&](const Range& range)
+    {
+        for (int y = range.start; y < range.end; y++)
+        {
+            const float* m = mean_src.ptr<float>(y);
+            const float* m2 = sqr_mean_src.ptr<float>(y);
+            float* pa = a.ptr<float>(y);
+            float* pb = b.ptr<float>(y);
+            for (int x = 0; x < small_src.cols; x++)
+            {
+                float var = std::max(m2[x] - m[x] * m[x], 0.0f);
+                pa[x] = var / (var + eps);
+                pb[x] = m[x] * (1.0f - pa[x]);
+            }
+        }
+    });
+
+    // Average of the models of all windows covering a pixel
+    Mat mean_a, mean_b;
+    boxFilter(a, mean_a, CV_32F, ksize, Point(-1, -1), true, BORDER_REFLECT);
+    boxFilter(b, mean_b, CV_32F, ksize, Point(-1, -1), true, BORDER_REFLECT);
+    if (scale > 1)
+    {
+        resize(mean_a, a, src.size(), 0, 0, INTER_LINEAR);
+        resize(mean_b, b, src.size(), 0, 0, INTER_LINEAR);
+    }
+    else
+    {
+        a = mean_a;
+        b = mean_b;
+    }
+
+    dst.create(src.size(), CV_32F);
+    parallel_for_(Range(0, src.rows), [&](const Range& range)
+    {
+        for (int y = range.start; y < range.end; y++)
+        {
+            const float* s = src.ptr<float>(y);
+            const float* pa = a.ptr<float>(y);
+            const float* pb = b.ptr<float>(y);
+            float* d = dst.ptr<float>(y);
+            for (int x = 0; x < src.cols; x++)
+                d[x] = pa[x] * s[x] + pb[x];
+        }
+    });
+}
+
 class TonemapDurandImpl CV_FINAL : public TonemapDurand
 {
 public:
@@ -39,7 +108,8 @@ public:
         contrast(_contrast),
         saturation(_saturation),
         sigma_color(_sigma_color),
-        sigma_space(_sigma_space)
+        sigma_space(_sigma_space),
+        filter_type(TONEMAP_DURAND_BILATERAL)
     {
     }
 
@@ -54,21 +124,30 @@ public:
         Ptr<Tonemap> linear = createTonemap(1.0f);
         linear->process(src, img);
 
-        Mat gray_img;
-        cvtColor(img, gray_img, COLOR_RGB2GRAY);
-        Mat log_img;
-        log_(gray_img, log_img);
+        // per-pixel steps are done in row stripes, so that intermediate results stay in cache
+        Mat gray_img(img.size(), CV_32F), log_img(img.size(), CV_32F);
+        parallel_for_(Range(0, img.rows), [&](const Range& range)
+        {
+            Mat gray_rows = gray_img.rowRange(range), log_rows = log_img.rowRange(range);
+            cvtColor(img.rowRange(range), gray_rows, COLOR_RGB2GRAY);
+            log_(gray_rows, log_rows);
+        });
         Mat map_img;
-        bilateralFilter(log_img, map_img, -1, sigma_color, sigma_space);
+        if (filter_type == TONEMAP_DURAND_FAST_GUIDED)
+            fastGuidedFilter(log_img, map_img, sigma_color, sigma_space);
+        else
+            bilateralFilter(log_img, map_img, -1, sigma_color, sigma_space);
 
         double min, max;
         minMaxLoc(map_img, &min, &max);
         float scale = contrast / static_cast<float>(max - min);
-        exp(map_img * (scale - 1.0f) + log_img, map_img);
-        log_img.release();
-
-        mapLuminance(img, img, gray_img, map_img, saturation);
-        pow(img, 1.0f / gamma, img);
+        parallel_for_(Range(0, img.rows), [&](const Range& range)
+        {
+            Mat img_rows = img.rowRange(range), map_rows = map_img.rowRange(range);
+            exp(map_rows * (scale - 1.0f) + log_img.rowRange(range), map_rows);
+            mapLuminance(img_rows, img_rows, gray_img.rowRange(range), map_rows, saturation);
+            pow(img_rows, 1.0f / gamma, img_rows);
+        });
     }
 
     float getGamma() const CV_OVERRIDE { return gamma; }
@@ -86,6 +165,13 @@ public:
     float getSigmaSpace() const CV_OVERRIDE { return sigma_space; }
     void setSigmaSpace(float val) CV_OVERRIDE { sigma_space = val; }
 
+    int getFilterType() const CV_OVERRIDE { return filter_type; }
+    void setFilterType(int val) CV_OVERRIDE
+    {
+        CV_Assert(val == TONEMAP_DURAND_BILATERAL || val == TONEMAP_DURAND_FAST_GUIDED);
+        filter_type = val;
+    }
+
     void write(FileStorage& fs) const CV_OVERRIDE
     {
         writeFormat(fs);
@@ -94,7 +180,8 @@ public:
            << "contrast" << contrast
            << "sigma_color" << sigma_color
            << "sigma_space" << sigma_space
-           << "saturation" << saturation;
+           << "saturation" << saturation
+           << "filter_type" << filter_type;
     }
 
     void read(const FileNode& fn) CV_OVERRIDE
@@ -106,11 +193,13 @@ public:
         sigma_color = fn["sigma_color"];
         sigma_space = fn["sigma_space"];
         saturation = fn["saturation"];
+        filter_type = fn["filter_type"].empty() ? (int)TONEMAP_DURAND_BILATERAL : (int)fn["filter_type"];
     }
 
 protected:
     String name;
     float gamma, contrast, saturation, sigma_color, sigma_space;
+    int filter_type;
 };
 
 Ptr<TonemapDurand> createTonemapDurand(float gamma, float contrast, float saturation, float sigma_color, float sigma_space)
@@ -157,6 +157,72 @@ namespace opencv_test { namespace {
         ASSERT_LT(cvtest::norm(result, expected, cv::NORM_L2), 200);
     }
 
+    TEST(xphoto_DenoisingBm3dSequence, single_frame_window)
+    {
+        std::string folder = std::string(cvtest::TS::ptr()->get_data_path()) + "cv/xphoto/bm3d_image_denoising/";
+        std::string original_path = folder + "lena_noised_gaussian_sigma=10.png";
+
+        cv::Mat original = cv::imread(original_path, cv::IMREAD_GRAYSCALE);
+        ASSERT_FALSE(original.empty()) << "Could not load input image " << original_path;
+
+        cv::Mat expected;
+        cv::xphoto::bm3dDenoising(original, expected, 10, 4, 16, 2500, 400, 8, 1, 2.0f, cv::NORM_L2, cv::xphoto::BM3D_STEPALL);
+
+        // Buffers reused by the following frames must not change the result
+        cv::Ptr<cv::xphoto::Bm3dDenoiser> denoiser =
+            cv::xphoto::createBm3dDenoiser(10, 4, 16, 2500, 400, 8, 1, 2.0f, cv::NORM_L2, 1);
+        for (int i = 0; i < 3; ++i)
+        {
+            cv::Mat result;
+            denoiser->denoise(original, result);
+            ASSERT_EQ(cvtest::norm(result, expected, cv::NORM_INF), 0) << "frame " << i;
+        }
+
+        // In place
+        cv::Mat inplace = original.clone();
+        denoiser->reset();
+        denoiser->denoise(inplace, inplace);
+        ASSERT_EQ(cvtest::norm(inplace, expected, cv::NORM_INF), 0);
+    }
+
+    TEST(xphoto_DenoisingBm3dSequence, temporal_window)
+    {
+        std::string folder = std::string(cvtest::TS::ptr()->get_data_path()) + "cv/xphoto/bm3d_image_denoising/";
+        std::string original_path = folder + "lena_noised_gaussian_sigma=10.png";
+
+        cv::Mat original = cv::imread(original_path, cv::IMREAD_GRAYSCALE);
+        ASSERT_FALSE(original.empty()) << "Could not load input image " << original_path;
+
+        // Static scene with independent noise in every frame
+        cv::Mat clean;
+        cv::xphoto::bm3dDenoising(original, clean, 10);
+
+        cv::Ptr<cv::xphoto::Bm3dDenoiser> denoiser = cv::xphoto::createBm3dDenoiser(15);
+        denoiser->setTemporalWindowSize(3);
+        ASSERT_EQ(denoiser->getTemporalWindowSize(), 3);
+
+        cv::RNG rng(0);
+        for (int i = 0; i < 4; ++i)
+        {
+            cv::Mat noise(clean.size(), CV_16S), frame;
+            rng.fill(noise, cv::RNG::NORMAL, 0, 15);
+            cv::add(clean, noise, frame, cv::noArray(), CV_8U);
+
+            cv::Mat single, result;
+            cv::xphoto::bm3dDenoising(frame, single, 15);
+            denoiser->denoise(frame, result);
+
+            ASSERT_EQ(result.size(), frame.size());
+            ASSERT_EQ(result.type(), frame.type());
+
+            // The first frame has no previous frames to search in
+            if (i == 0)
+                ASSERT_EQ(cvtest::norm(result, single, cv::NORM_INF), 0);
+            else
+                ASSERT_LT(cvtest::norm(result, clean, cv::NORM_L2), cvtest::norm(single, clean, cv::NORM_L2));
+        }
+    }
+
 #ifdef TEST_TRANSFORMS
 
     TEST(xphoto_DenoisingBm3dKaiserWindow, regression_4)
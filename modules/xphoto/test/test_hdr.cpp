@@ -64,6 +64,76 @@ TEST(Photo_Tonemap, Durand_property_regression)
     ASSERT_EQ(saturation, durand2->getSaturation());
     ASSERT_EQ(sigma_color, durand2->getSigmaColor());
     ASSERT_EQ(sigma_space, durand2->getSigmaSpace());
+
+    ASSERT_EQ((int)TONEMAP_DURAND_BILATERAL, durand2->getFilterType());
+    durand2->setFilterType(TONEMAP_DURAND_FAST_GUIDED);
+    ASSERT_EQ((int)TONEMAP_DURAND_FAST_GUIDED, durand2->getFilterType());
+}
+
+// Durand tonemapping with a plain full resolution guided filter as the base layer filter
+static void referenceDurandGuided(const Mat& src, Mat& dst, float gamma, float contrast, float saturation,
+                                  float sigma_color, float sigma_space)
+{
+    Mat img;
+    createTonemap(1.0f)->process(src, img);
+    Mat gray_img, log_img;
+    cvtColor(img, gray_img, COLOR_RGB2GRAY);
+    max(gray_img, Scalar::all(1e-4), log_img);
+    log(log_img, log_img);
+
+    const int radius = std::max(1, cvRound(2.0f * sigma_space));
+    const Size ksize(2 * radius + 1, 2 * radius + 1);
+    Mat mean_I, mean_II, a, b;
+    boxFilter(log_img, mean_I, CV_32F, ksize, Point(-1, -1), true, BORDER_REFLECT);
+    sqrBoxFilter(log_img, mean_II, CV_32F, ksize, Point(-1, -1), true, BORDER_REFLECT);
+    Mat var = max(mean_II - mean_I.mul(mean_I), 0.0);
+    divide(var, var + sigma_color * sigma_color, a);
+    b = mean_I - a.mul(mean_I);
+    boxFilter(a, a, CV_32F, ksize, Point(-1, -1), true, BORDER_REFLECT);
+    boxFilter(b, b, CV_32F, ksize, Point(-1, -1), true, BORDER_REFLECT);
+    Mat map_img = a.mul(log_img) + b;
+
+    double min, max;
+    minMaxLoc(map_img, &min, &max);
+    float scale = contrast / static_cast<float>(max - min);
+    exp(map_img * (scale - 1.0f) + log_img, map_img);
+
+    std::vector<Mat> channels;
+    split(img, channels);
+    for (int i = 0; i < 3; i++)
+    {
+        channels[i] = channels[i].mul(1.0f / gray_img);
+        pow(channels[i], saturation, channels[i]);
+        channels[i] = channels[i].mul(map_img);
+    }
+    merge(channels, dst);
+    pow(dst, 1.0f / gamma, dst);
+}
+
+TEST(Photo_Tonemap, Durand_fast_guided)
+{
+    string test_path = string(cvtest::TS::ptr()->get_data_path()) + "cv/hdr/tonemap/";
+
+    Mat img, expected, result;
+    loadImage(test_path + "image.hdr", img);
+    const float gamma = 2.2f, contrast = 4.0f, saturation = 1.0f, sigma_color = 2.0f;
+
+    // sigma_space 1 keeps the window small enough for the filter to run at full resolution,
+    // sigma_space 2 (the default) runs it on a 2x downsampled image
+    const float sigma_space[] = { 1.0f, 2.0f };
+    const double threshold[] = { 1e-4, 0.05 };
+    for (int i = 0; i < 2; i++)
+    {
+        Ptr<TonemapDurand> durand = createTonemapDurand(gamma, contrast, saturation, sigma_color, sigma_space[i]);
+        durand->setFilterType(TONEMAP_DURAND_FAST_GUIDED);
+        durand->process(img, result);
+        referenceDurandGuided(img, expected, gamma, contrast, saturation, sigma_color, sigma_space[i]);
+
+        ASSERT_EQ(expected.size(), result.size());
+        ASSERT_EQ(expected.type(), result.type());
+        ASSERT_TRUE(checkRange(result));
+        EXPECT_LE(cvtest::norm(result, expected, NORM_INF), threshold[i]) << "sigma_space=" << sigma_space[i];
+    }
 }
 
 #endif // OPENCV_ENABLE_NONFREE